@@ -392,6 +392,71 @@ static void module_serde(void)
     JS_FreeRuntime(rt);
 }
 
+static void read_in_place(void)
+{
+    static const char code[] =
+        "var s = 'a string constant longer than a few words';\n"
+        "function f() { throw new Error(s.slice(2, 30)); }\n"
+        "var line;\n"
+        "try { f(); } catch (e) { line = e.stack.match(/:(\\d+):/)[1]; }\n"
+        "var t = s; t += '!';\n"
+        "[s, t, s.slice(2, 30), line].join('|')";
+    static const char expected[] =
+        "a string constant longer than a few words|"
+        "a string constant longer than a few words!|"
+        "string constant longer than |2";
+    JSRuntime *rt = new_runtime();
+    JSContext *ctx = JS_NewContext(rt);
+    JSValue obj = JS_Eval(ctx, code, strlen(code), "<input>",
+                          JS_EVAL_TYPE_GLOBAL|JS_EVAL_FLAG_COMPILE_ONLY);
+    assert(!JS_IsException(obj));
+    size_t len = 0;
+    uint8_t *buf = JS_WriteObject(ctx, &len, obj, JS_WRITE_OBJ_BYTECODE);
+    assert(buf);
+    JS_FreeValue(ctx, obj);
+    // 'buf' is shared by the runtimes and must outlive them
+    for (int i = 0; i < 2; i++) {
+        JSRuntime *rt1 = new_runtime();
+        JSContext *ctx1 = JS_NewContext(rt1);
+        obj = JS_ReadObject(ctx1, buf, len,
+                            JS_READ_OBJ_BYTECODE|JS_READ_OBJ_IN_PLACE);
+        assert(!JS_IsException(obj));
+        JSValue ret = JS_EvalFunction(ctx1, obj);
+        assert(!JS_IsException(ret));
+        const char *str = JS_ToCString(ctx1, ret);
+        assert(str);
+        assert(!strcmp(str, expected));
+        JS_FreeCString(ctx1, str);
+        JS_FreeValue(ctx1, ret);
+        JS_FreeContext(ctx1);
+        JS_FreeRuntime(rt1);
+    }
+    // the obsolete JS_READ_OBJ_ROM_DATA copies the data: the buffer can
+    // be reused before the function is run
+    uint8_t *tmp = malloc(len);
+    assert(tmp);
+    memcpy(tmp, buf, len);
+    JSRuntime *rt1 = new_runtime();
+    JSContext *ctx1 = JS_NewContext(rt1);
+    obj = JS_ReadObject(ctx1, tmp, len,
+                        JS_READ_OBJ_BYTECODE|JS_READ_OBJ_ROM_DATA);
+    assert(!JS_IsException(obj));
+    memset(tmp, 0, len);
+    JSValue ret = JS_EvalFunction(ctx1, obj);
+    assert(!JS_IsException(ret));
+    const char *str = JS_ToCString(ctx1, ret);
+    assert(str);
+    assert(!strcmp(str, expected));
+    JS_FreeCString(ctx1, str);
+    JS_FreeValue(ctx1, ret);
+    JS_FreeContext(ctx1);
+    JS_FreeRuntime(rt1);
+    free(tmp);
+    js_free(ctx, buf);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+}
+
 struct rejection_counts {
     int reject_count;
     int handle_count;
@@ -700,6 +765,147 @@ struct {
     int hook_type_call_count[4];
 } promise_hook_state;
 
+static void gc_step(void)
+{
+    static const char code[] =
+    "var ref;"
+    "for (let i = 0; i < 1500; i++) {"
+    "  const a = { i }, b = { a };"
+    "  a.b = b;"
+    "  if (i == 0) ref = new WeakRef(a);"
+    "}";
+    JSMemoryUsage before, after;
+    int steps;
+
+    JSRuntime *rt = new_runtime();
+    JSContext *ctx = JS_NewContext(rt);
+    JS_ComputeMemoryUsage(rt, &before);
+    JS_SetGCThreshold(rt, before.malloc_size + 512 * 1024);
+    assert(!JS_RunGCStep(rt, 1000)); // nothing to do
+    JSValue ret = eval(ctx, code);
+    assert(!JS_IsException(ret));
+    JS_FreeValue(ctx, ret);
+    JS_ComputeMemoryUsage(rt, &before);
+    steps = 0;
+    do {
+        // the cycles are unreachable after the first step
+        if (steps++ == 1) {
+            ret = eval(ctx, "ref.deref()");
+            assert(JS_IsUndefined(ret));
+        }
+    } while (JS_RunGCStep(rt, 1));
+    JS_ComputeMemoryUsage(rt, &after);
+    assert(after.obj_count + 2900 <= before.obj_count);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+
+    // the shapes of the pending cycles are not given to new objects
+    rt = new_runtime();
+    ctx = JS_NewContext(rt);
+    JS_ComputeMemoryUsage(rt, &before);
+    JS_SetGCThreshold(rt, before.malloc_size + 512 * 1024);
+    // the automatic collections may run at any point of the loop
+    do {
+        ret = eval(ctx, "for (let i = 0; i < 1000; i++) {"
+                        "  const o = { k: i, b: null };"
+                        "  o.b = o;"
+                        "}");
+        assert(!JS_IsException(ret));
+        JS_FreeValue(ctx, ret);
+    } while (!JS_RunGCStep(rt, 1));
+    ret = eval(ctx, "var a = [];"
+                    "for (let i = 0; i < 20000; i++) a.push({ k: i, b: null });");
+    assert(!JS_IsException(ret));
+    JS_FreeValue(ctx, ret);
+    while (JS_RunGCStep(rt, 1))
+        continue;
+    ret = eval(ctx, "a.every((o, i) => o.k === i && o.b === null)");
+    assert(JS_IsBool(ret) && JS_VALUE_GET_BOOL(ret));
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+}
+
+static void regexp_cache(void)
+{
+    static const char code[] =
+    "var r = [];"
+    "for (let i = 0; i < 100; i++) r.push(new RegExp('a' + (i % 4), 'g'));"
+    "r[0] !== r[4] && r[0].test('a0') && r[4].lastIndex === 0"
+    " && new RegExp('a0', 'i').flags === 'i'";
+    JSMemoryUsage stats;
+
+    JSRuntime *rt = new_runtime();
+    JSContext *ctx = JS_NewContext(rt);
+    JSValue ret = eval(ctx, code);
+    assert(JS_IsBool(ret) && JS_ToBool(ctx, ret));
+    JS_FreeValue(ctx, ret);
+    JS_ComputeMemoryUsage(rt, &stats);
+    assert(stats.regexp_cache_count == 5);
+    assert(stats.regexp_cache_miss_count == 5);
+    assert(stats.regexp_cache_hit_count == 96);
+    // the cache is bounded
+    ret = eval(ctx, "for (let i = 0; i < 1000; i++) new RegExp('b' + i)");
+    assert(!JS_IsException(ret));
+    JS_FreeValue(ctx, ret);
+    JS_ComputeMemoryUsage(rt, &stats);
+    assert(stats.regexp_cache_count <= 64);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+}
+
+static int json_parser_cb(JSContext *ctx, JSValueConst key,
+                          JSValueConst value, int depth, void *opaque)
+{
+    int64_t *sum = opaque;
+    int32_t v;
+
+    assert(depth == 2);
+    assert(JS_IsString(key));
+    assert(!JS_ToInt32(ctx, &v, value));
+    *sum += v;
+    return 0;
+}
+
+static int json_parser_free_cb(JSContext *ctx, JSValueConst key,
+                               JSValueConst value, int depth, void *opaque)
+{
+    JSJSONParser **pp = opaque;
+
+    // freed when JS_WriteJSONParser() returns
+    JS_FreeJSONParser(JS_GetRuntime(ctx), *pp);
+    return 0;
+}
+
+static void json_parser(void)
+{
+    static const char input[] = "{\"a\": {\"x\": 1, \"y\": 20}, \"b\": {\"z\": 300}}";
+    int64_t sum = 0;
+    size_t i;
+
+    JSRuntime *rt = new_runtime();
+    JSContext *ctx = JS_NewContext(rt);
+    JSJSONParser *p = JS_NewJSONParser(ctx, 2, json_parser_cb, &sum);
+    assert(p);
+    // one byte at a time
+    for (i = 0; i < sizeof(input) - 1; i++)
+        assert(JS_WriteJSONParser(p, &input[i], 1) == 0);
+    assert(JS_EndJSONParser(p) == 0);
+    assert(sum == 321);
+    // an incomplete input is an error
+    assert(JS_WriteJSONParser(p, "{\"a\":", 5) == 0);
+    assert(JS_EndJSONParser(p) < 0);
+    JSValue exc = JS_GetException(ctx);
+    assert(JS_IsError(exc));
+    JS_FreeValue(ctx, exc);
+    JS_FreeJSONParser(rt, p);
+    // the parser can be freed by the callback
+    p = JS_NewJSONParser(ctx, 0, json_parser_free_cb, &p);
+    assert(p);
+    assert(JS_WriteJSONParser(p, "1 2 3 ", 6) == 0);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+}
+
 static void promise_hook_cb(JSContext *ctx, JSPromiseHookType type,
                             JSValueConst promise, JSValueConst parent_promise,
                             void *opaque)
@@ -891,6 +1097,100 @@ static void dump_memory_usage(void)
     JS_FreeRuntime(rt);
 }
 
+static void cpu_profile(void)
+{
+    JSRuntime *rt = new_runtime();
+    JSContext *ctx = JS_NewContext(rt);
+    char buf[4096];
+    size_t len;
+
+    static const char code[] =
+    "function spin() {"
+    "  const t = Date.now();"
+    "  while (Date.now() - t < 20);"
+    "}"
+    "spin();";
+
+    assert(JS_StartCPUProfile(rt, 100) == 0);
+    JSValue ret = eval(ctx, code);
+    assert(!JS_IsException(ret));
+    JS_FreeValue(ctx, ret);
+    JS_StopCPUProfile(rt);
+
+    FILE *temp = tmpfile();
+    assert(temp != NULL);
+    JS_DumpCPUProfile(temp, rt);
+    rewind(temp);
+    len = fread(buf, 1, sizeof(buf) - 1, temp);
+    buf[len] = '\0';
+    fclose(temp);
+    assert(strstr(buf, "<eval> (<input>:1);spin (<input>:1)"));
+
+    // the time spent in the host between two calls is not sampled
+    JS_FreeValue(ctx, eval(ctx, "function spin2() { spin(); }"));
+    assert(JS_StartCPUProfile(rt, 100) == 0);
+    JS_FreeValue(ctx, eval(ctx, "spin()"));
+    uint64_t t = js__hrtime_ns();
+    while (js__hrtime_ns() - t < 200 * 1000000)
+        continue;
+    JS_FreeValue(ctx, eval(ctx, "spin2()"));
+    JS_StopCPUProfile(rt);
+    temp = tmpfile();
+    assert(temp != NULL);
+    JS_DumpCPUProfile(temp, rt);
+    rewind(temp);
+    len = fread(buf, 1, sizeof(buf) - 1, temp);
+    buf[len] = '\0';
+    fclose(temp);
+    static const char spin2_stack[] = "spin2 (<input>:1);spin (<input>:1) ";
+    const char *s = strstr(buf, spin2_stack);
+    assert(s);
+    // 20 ms are 200 intervals, the 200 ms in the host would be 2000
+    assert(atoi(s + strlen(spin2_stack)) < 1000);
+
+    // the calls shorter than the interval are sampled, with the line of
+    // the current pc
+    static const char short_code[] =
+    "function short_spin() {\n"
+    "  const t = performance.now();\n"
+    "  while (performance.now() - t < 0.2);\n"
+    "}\n"
+    "short_spin";
+    JSValue func = eval(ctx, short_code);
+    assert(JS_IsFunction(ctx, func));
+    assert(JS_StartCPUProfile(rt, 1000) == 0);
+    for (int i = 0; i < 500; i++) {
+        ret = JS_Call(ctx, func, JS_UNDEFINED, 0, NULL);
+        assert(!JS_IsException(ret));
+        JS_FreeValue(ctx, ret);
+    }
+    JS_StopCPUProfile(rt);
+    JS_FreeValue(ctx, func);
+    temp = tmpfile();
+    assert(temp != NULL);
+    JS_DumpCPUProfile(temp, rt);
+    rewind(temp);
+    len = fread(buf, 1, sizeof(buf) - 1, temp);
+    buf[len] = '\0';
+    fclose(temp);
+    assert(strstr(buf, "short_spin (<input>:3)"));
+    // 500 calls of 0.2 ms are 100 intervals
+    int count = 0;
+    for (s = buf; *s != '\0'; s = strchr(s, '\n') + 1) {
+        const char *p = strchr(s, '\n');
+        assert(p);
+        if (strncmp(s, "short_spin (", 12))
+            continue;
+        while (p[-1] != ' ')
+            p--;
+        count += atoi(p);
+    }
+    assert(count >= 50);
+
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+}
+
 static void new_errors(void)
 {
     typedef struct {
@@ -1876,6 +2176,75 @@ static void transfer_default_managed_array_buffer(void)
     JS_FreeRuntime(rt);
 }
 
+static void transfer_array_buffer_between_runtimes(void)
+{
+    JSTransferredArrayBuffer *tb;
+    JSValue obj, ret, global;
+    uint8_t *p, *q;
+    size_t size;
+
+    JSRuntime *rt1 = new_runtime();
+    JSContext *ctx1 = JS_NewContext(rt1);
+    JSRuntime *rt2 = new_runtime();
+    JSContext *ctx2 = JS_NewContext(rt2);
+
+    // large buffers are moved without copy, the source is detached
+    obj = eval(ctx1, "new Uint8Array(65536).fill(7).buffer");
+    assert(JS_IsArrayBuffer(obj));
+    p = JS_GetArrayBuffer(ctx1, &size, obj);
+    tb = JS_TransferArrayBuffer(ctx1, obj);
+    assert(tb);
+    assert(!JS_GetArrayBuffer(ctx1, &size, obj));
+    JS_FreeValue(ctx1, JS_GetException(ctx1));
+    JS_FreeValue(ctx1, obj);
+    // the source runtime can go away before the buffer is received
+    JS_FreeContext(ctx1);
+    JS_FreeRuntime(rt1);
+    obj = JS_NewTransferredArrayBuffer(ctx2, tb);
+    assert(JS_IsArrayBuffer(obj));
+    q = JS_GetArrayBuffer(ctx2, &size, obj);
+    assert(q == p);
+    assert(size == 65536);
+    assert(q[0] == 7 && q[65535] == 7);
+    JS_FreeValue(ctx2, obj);
+
+    // small buffers are copied, resizable buffers stay resizable
+    obj = eval(ctx2, "var ab = new ArrayBuffer(4, { maxByteLength: 8 });"
+                     "new Uint8Array(ab).fill(3); ab");
+    tb = JS_TransferArrayBuffer(ctx2, obj);
+    assert(tb);
+    JS_FreeValue(ctx2, obj);
+    obj = JS_NewTransferredArrayBuffer(ctx2, tb);
+    assert(JS_IsArrayBuffer(obj));
+    global = JS_GetGlobalObject(ctx2);
+    JS_SetPropertyStr(ctx2, global, "ab2", obj);
+    JS_FreeValue(ctx2, global);
+    ret = eval(ctx2, "ab.detached && ab2.resizable && ab2.byteLength == 4 &&"
+                     "(ab2.resize(8), new Uint8Array(ab2).join()) =="
+                     "'3,3,3,3,0,0,0,0'");
+    assert(JS_IsBool(ret) && JS_VALUE_GET_BOOL(ret));
+
+    // detached and immutable buffers cannot be transferred
+    obj = eval(ctx2, "ab");
+    assert(!JS_TransferArrayBuffer(ctx2, obj));
+    JS_FreeValue(ctx2, JS_GetException(ctx2));
+    JS_FreeValue(ctx2, obj);
+    obj = eval(ctx2, "new ArrayBuffer(8).transferToImmutable()");
+    assert(!JS_TransferArrayBuffer(ctx2, obj));
+    JS_FreeValue(ctx2, JS_GetException(ctx2));
+    JS_FreeValue(ctx2, obj);
+
+    // a buffer which is never received is freed by its owner
+    obj = eval(ctx2, "new ArrayBuffer(100000)");
+    tb = JS_TransferArrayBuffer(ctx2, obj);
+    assert(tb);
+    JS_FreeValue(ctx2, obj);
+    JS_FreeTransferredArrayBuffer(tb);
+
+    JS_FreeContext(ctx2);
+    JS_FreeRuntime(rt2);
+}
+
 static void get_class_name(void)
 {
     static const struct {
@@ -2061,14 +2430,19 @@ int main(void)
     raw_context_global_var();
     is_array();
     module_serde();
+    read_in_place();
     module_unhandled_rejection();
     promise_mark_as_handled();
     promise_then();
     runtime_cstring_free();
     utf16_string();
     weak_map_gc_check();
+    gc_step();
+    regexp_cache();
+    json_parser();
     promise_hook();
     dump_memory_usage();
+    cpu_profile();
     new_errors();
     dom_exception_added_twice();
     backtrace_oom_current_exception();
@@ -2086,6 +2460,7 @@ int main(void)
     transfer_external_array_buffer();
     resize_external_array_buffer();
     transfer_default_managed_array_buffer();
+    transfer_array_buffer_between_runtimes();
     get_class_name();
     object_from();
     add_intrinsic_bigint();
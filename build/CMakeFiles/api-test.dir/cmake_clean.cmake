@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/api-test.dir/api-test.c.o"
+  "CMakeFiles/api-test.dir/api-test.c.o.d"
+  "api-test"
+  "api-test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/api-test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/function_source.dir/gen/function_source.c.o"
+  "CMakeFiles/function_source.dir/gen/function_source.c.o.d"
+  "function_source"
+  "function_source.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/function_source.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
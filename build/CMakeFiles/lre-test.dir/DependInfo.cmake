@@ -0,0 +1,21 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/libregexp.c" "CMakeFiles/lre-test.dir/libregexp.c.o" "gcc" "CMakeFiles/lre-test.dir/libregexp.c.o.d"
+  "/root/repo/libunicode.c" "CMakeFiles/lre-test.dir/libunicode.c.o" "gcc" "CMakeFiles/lre-test.dir/libunicode.c.o.d"
+  "/root/repo/lre-test.c" "CMakeFiles/lre-test.dir/lre-test.c.o" "gcc" "CMakeFiles/lre-test.dir/lre-test.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
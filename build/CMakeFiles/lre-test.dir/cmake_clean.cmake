@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/lre-test.dir/libregexp.c.o"
+  "CMakeFiles/lre-test.dir/libregexp.c.o.d"
+  "CMakeFiles/lre-test.dir/libunicode.c.o"
+  "CMakeFiles/lre-test.dir/libunicode.c.o.d"
+  "CMakeFiles/lre-test.dir/lre-test.c.o"
+  "CMakeFiles/lre-test.dir/lre-test.c.o.d"
+  "lre-test"
+  "lre-test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/lre-test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/qjs-libc.dir/quickjs-libc.c.o"
+  "CMakeFiles/qjs-libc.dir/quickjs-libc.c.o.d"
+  "libqjs-libc.a"
+  "libqjs-libc.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/qjs-libc.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,22 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/dtoa.c" "CMakeFiles/qjs.dir/dtoa.c.o" "gcc" "CMakeFiles/qjs.dir/dtoa.c.o.d"
+  "/root/repo/libregexp.c" "CMakeFiles/qjs.dir/libregexp.c.o" "gcc" "CMakeFiles/qjs.dir/libregexp.c.o.d"
+  "/root/repo/libunicode.c" "CMakeFiles/qjs.dir/libunicode.c.o" "gcc" "CMakeFiles/qjs.dir/libunicode.c.o.d"
+  "/root/repo/quickjs.c" "CMakeFiles/qjs.dir/quickjs.c.o" "gcc" "CMakeFiles/qjs.dir/quickjs.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
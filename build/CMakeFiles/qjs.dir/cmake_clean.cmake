@@ -0,0 +1,17 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/qjs.dir/dtoa.c.o"
+  "CMakeFiles/qjs.dir/dtoa.c.o.d"
+  "CMakeFiles/qjs.dir/libregexp.c.o"
+  "CMakeFiles/qjs.dir/libregexp.c.o.d"
+  "CMakeFiles/qjs.dir/libunicode.c.o"
+  "CMakeFiles/qjs.dir/libunicode.c.o.d"
+  "CMakeFiles/qjs.dir/quickjs.c.o"
+  "CMakeFiles/qjs.dir/quickjs.c.o.d"
+  "libqjs.a"
+  "libqjs.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/qjs.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,23 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/gen/repl.c" "CMakeFiles/qjs_exe.dir/gen/repl.c.o" "gcc" "CMakeFiles/qjs_exe.dir/gen/repl.c.o.d"
+  "/root/repo/gen/standalone.c" "CMakeFiles/qjs_exe.dir/gen/standalone.c.o" "gcc" "CMakeFiles/qjs_exe.dir/gen/standalone.c.o.d"
+  "/root/repo/qjs.c" "CMakeFiles/qjs_exe.dir/qjs.c.o" "gcc" "CMakeFiles/qjs_exe.dir/qjs.c.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/build/CMakeFiles/qjs-libc.dir/DependInfo.cmake"
+  "/root/repo/build/CMakeFiles/qjs.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
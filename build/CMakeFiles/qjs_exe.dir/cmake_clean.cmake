@@ -0,0 +1,15 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/qjs_exe.dir/gen/repl.c.o"
+  "CMakeFiles/qjs_exe.dir/gen/repl.c.o.d"
+  "CMakeFiles/qjs_exe.dir/gen/standalone.c.o"
+  "CMakeFiles/qjs_exe.dir/gen/standalone.c.o.d"
+  "CMakeFiles/qjs_exe.dir/qjs.c.o"
+  "CMakeFiles/qjs_exe.dir/qjs.c.o.d"
+  "qjs"
+  "qjs_cli.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/qjs_exe.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/qjsc.dir/qjsc.c.o"
+  "CMakeFiles/qjsc.dir/qjsc.c.o.d"
+  "qjsc"
+  "qjsc.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/qjsc.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
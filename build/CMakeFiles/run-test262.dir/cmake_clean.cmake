@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/run-test262.dir/run-test262.c.o"
+  "CMakeFiles/run-test262.dir/run-test262.c.o.d"
+  "run-test262"
+  "run-test262.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/run-test262.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/unicode_gen.dir/unicode_gen.c.o"
+  "CMakeFiles/unicode_gen.dir/unicode_gen.c.o.d"
+  "unicode_gen"
+  "unicode_gen.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang C)
+  include(CMakeFiles/unicode_gen.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
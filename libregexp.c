@@ -49,10 +49,8 @@ uint32_t const lre_id_continue_table_ascii[4] = {
   - remove REOP_char_i and REOP_range_i by precomputing the case folding.
   - add specific opcodes for simple unicode property tests so that the
     generated bytecode is smaller.
-  - Add a lock step execution mode (=linear time execution guaranteed)
-    when the regular expression is "simple" i.e. no backreference nor
-    complicated lookahead. The opcodes are designed for this execution
-    model.
+  - support the large loops with a counter in the lock step execution
+    mode.
 */
 
 #if defined(TEST)
@@ -74,6 +72,8 @@ typedef enum {
 /* must be large enough to have a negligible runtime cost and small
    enough to call the interrupt callback often. */
 #define INTERRUPT_COUNTER_INIT 10000
+/* maximum size of the bytecode of an unrolled quantifier */
+#define UNROLL_SIZE_MAX 256
 
 /* unicode code points */
 #define CP_LS   0x2028
@@ -125,8 +125,24 @@ static const REOpCode reopcode_info[REOP_COUNT] = {
 #define RE_HEADER_CAPTURE_COUNT  2
 #define RE_HEADER_REGISTER_COUNT 3
 #define RE_HEADER_BYTECODE_LEN   4
+#define RE_HEADER_PREFILTER      8  /* RE_PREFILTER_x flags */
+#define RE_HEADER_PREFIX_LEN     9  /* length of the literal prefix */
+#define RE_HEADER_PREFIX         10 /* literal prefix (16 bit characters) */
+#define RE_HEADER_FIRST_CHARS    (RE_HEADER_PREFIX + RE_PREFIX_LEN_MAX * 2)
 
-#define RE_HEADER_LEN 8
+#define RE_HEADER_LEN (RE_HEADER_FIRST_CHARS + 32)
+
+#define RE_PREFIX_LEN_MAX 16
+
+/* set if a match starts with one of the characters of the
+   RE_HEADER_FIRST_CHARS bitmap (characters < 256) */
+#define RE_PREFILTER_FIRST_CHARS (1 << 0)
+/* set if a match may also start with a character >= 256 */
+#define RE_PREFILTER_HIGH_CHARS  (1 << 1)
+
+/* length of the 'split_goto_first any goto' loop which starts the
+   non sticky regexps */
+#define RE_SEARCH_LOOP_LEN (5 + 1 + 5)
 
 static inline int lre_is_digit(int c) {
     return c >= '0' && c <= '9';
@@ -505,6 +521,22 @@ static __maybe_unused void lre_dump_bytecode(const uint8_t *buf,
         printf("\n");
         assert(p == (char *)(buf + buf_len));
     }
+    if (buf[RE_HEADER_PREFIX_LEN] != 0) {
+        printf("prefix: ");
+        for(i = 0; i < buf[RE_HEADER_PREFIX_LEN]; i++)
+            printf("\\u%04x", get_u16(buf + RE_HEADER_PREFIX + i * 2));
+        printf("\n");
+    }
+    if (buf[RE_HEADER_PREFILTER] & RE_PREFILTER_FIRST_CHARS) {
+        printf("first chars:");
+        for(i = 0; i < 256; i++) {
+            if (buf[RE_HEADER_FIRST_CHARS + (i >> 3)] & (1 << (i & 7)))
+                printf(" %02x", i);
+        }
+        if (buf[RE_HEADER_PREFILTER] & RE_PREFILTER_HIGH_CHARS)
+            printf(" >=100");
+        printf("\n");
+    }
     printf("bytecode_len=%d\n", bc_len);
 
     buf += RE_HEADER_LEN;
@@ -1595,6 +1627,204 @@ static int re_parse_char_class(REParseState *s, const uint8_t **pp)
     return -1;
 }
 
+static void re_first_chars_add(uint8_t *first_chars, bool *phigh_chars,
+                               uint32_t low, uint32_t high)
+{
+    uint32_t c;
+
+    if (high >= 256) {
+        *phigh_chars = true;
+        high = 255;
+    }
+    for(c = low; c <= high; c++)
+        first_chars[c >> 3] |= 1 << (c & 7);
+}
+
+/* return true if the canonicalized character 'c' is in the ranges */
+static bool re_range_contains(const uint8_t *p, int n, bool is_range32,
+                              uint32_t c)
+{
+    int i;
+
+    for(i = 0; i < n; i++) {
+        if (is_range32) {
+            if (c >= get_u32(p + i * 8) && c <= get_u32(p + i * 8 + 4))
+                return true;
+        } else {
+            if (c >= get_u16(p + i * 4) && c <= get_u16(p + i * 4 + 2))
+                return true;
+        }
+    }
+    return false;
+}
+
+/* Compute the set of the characters which can be consumed first when
+   executing the bytecode. Return false if it is not known or if the
+   end of the bytecode (or a 'match') can be reached without consuming
+   a character. 'first_chars' is a bitmap of the characters < 256 and
+   '*phigh_chars' is set if a character >= 256 may be consumed
+   first. They are not updated if 'first_chars' is NULL. */
+static bool re_get_first_chars(void *opaque, uint8_t *first_chars,
+                               bool *phigh_chars, bool is_unicode,
+                               const uint8_t *bc_buf, int bc_buf_len)
+{
+    int *stack, sp, pos, opcode, len, n, target;
+    uint32_t c, c1;
+    uint8_t *visited;
+    bool ret;
+
+    stack = lre_realloc(opaque, NULL, (sizeof(int) + 1) * (bc_buf_len + 1));
+    if (!stack)
+        return false;
+    visited = (uint8_t *)(stack + bc_buf_len + 1);
+    memset(visited, 0, bc_buf_len + 1);
+    ret = false;
+    sp = 0;
+    stack[sp++] = 0;
+    visited[0] = 1;
+    while (sp > 0) {
+        pos = stack[--sp];
+        if (pos == bc_buf_len)
+            goto done;
+        opcode = bc_buf[pos];
+        len = reopcode_info[opcode].size;
+        switch(opcode) {
+        case REOP_char:
+        case REOP_char32:
+            if (first_chars) {
+                if (opcode == REOP_char)
+                    c = get_u16(bc_buf + pos + 1);
+                else
+                    c = get_u32(bc_buf + pos + 1);
+                re_first_chars_add(first_chars, phigh_chars, c, c);
+            }
+            continue;
+        case REOP_char_i:
+        case REOP_char32_i:
+            if (first_chars) {
+                if (opcode == REOP_char_i)
+                    c = get_u16(bc_buf + pos + 1);
+                else
+                    c = get_u32(bc_buf + pos + 1);
+                /* the characters >= 256 may have a canonical form < 256 */
+                *phigh_chars = true;
+                for(c1 = 0; c1 < 256; c1++) {
+                    if (lre_canonicalize(c1, is_unicode) == c)
+                        re_first_chars_add(first_chars, phigh_chars, c1, c1);
+                }
+            }
+            continue;
+        case REOP_dot:
+            if (first_chars) {
+                re_first_chars_add(first_chars, phigh_chars, 0, '\n' - 1);
+                re_first_chars_add(first_chars, phigh_chars, '\n' + 1, '\r' - 1);
+                re_first_chars_add(first_chars, phigh_chars, '\r' + 1, 0xffff);
+            }
+            continue;
+        case REOP_any:
+        case REOP_not_space:
+            if (first_chars)
+                re_first_chars_add(first_chars, phigh_chars, 0, 0xffff);
+            continue;
+        case REOP_space:
+            if (first_chars) {
+                for(c = 0; c < 256; c++) {
+                    if (lre_is_space(c))
+                        re_first_chars_add(first_chars, phigh_chars, c, c);
+                }
+                *phigh_chars = true;
+            }
+            continue;
+        case REOP_range:
+        case REOP_range_i:
+        case REOP_range32:
+        case REOP_range32_i:
+            if (first_chars) {
+                bool is_range32 = (opcode == REOP_range32 ||
+                                   opcode == REOP_range32_i);
+                const uint8_t *p = bc_buf + pos + 3;
+                n = get_u16(bc_buf + pos + 1);
+                if (opcode == REOP_range_i || opcode == REOP_range32_i) {
+                    *phigh_chars = true;
+                    for(c1 = 0; c1 < 256; c1++) {
+                        if (re_range_contains(p, n, is_range32,
+                                              lre_canonicalize(c1, is_unicode)))
+                            re_first_chars_add(first_chars, phigh_chars, c1, c1);
+                    }
+                } else {
+                    while (n-- > 0) {
+                        if (is_range32) {
+                            re_first_chars_add(first_chars, phigh_chars,
+                                               get_u32(p), get_u32(p + 4));
+                            p += 8;
+                        } else {
+                            re_first_chars_add(first_chars, phigh_chars,
+                                               get_u16(p), get_u16(p + 2));
+                            p += 4;
+                        }
+                    }
+                }
+            }
+            continue;
+        case REOP_goto:
+            pos += len + (int)get_u32(bc_buf + pos + 1);
+            len = 0;
+            break;
+        case REOP_split_goto_first:
+        case REOP_split_next_first:
+        case REOP_loop:
+        case REOP_loop_split_goto_first:
+        case REOP_loop_split_next_first:
+        case REOP_loop_check_adv_split_goto_first:
+        case REOP_loop_check_adv_split_next_first:
+            target = pos + len + (int)get_u32(bc_buf + pos + len - 4);
+            if (target < 0 || target > bc_buf_len)
+                goto done;
+            if (!visited[target]) {
+                visited[target] = 1;
+                stack[sp++] = target;
+            }
+            break;
+        case REOP_lookahead:
+        case REOP_negative_lookahead:
+            /* the lookahead does not consume characters: continue
+               after it */
+            pos += len + (int)get_u32(bc_buf + pos + 1);
+            len = 0;
+            break;
+        case REOP_line_start:
+        case REOP_line_start_m:
+        case REOP_line_end:
+        case REOP_line_end_m:
+        case REOP_set_i32:
+        case REOP_set_char_pos:
+        case REOP_check_advance:
+        case REOP_word_boundary:
+        case REOP_word_boundary_i:
+        case REOP_not_word_boundary:
+        case REOP_not_word_boundary_i:
+        case REOP_save_start:
+        case REOP_save_end:
+        case REOP_save_reset:
+            break;
+        default:
+            /* match, back references, ... */
+            goto done;
+        }
+        pos += len;
+        if (pos < 0 || pos > bc_buf_len)
+            goto done;
+        if (!visited[pos]) {
+            visited[pos] = 1;
+            stack[sp++] = pos;
+        }
+    }
+    ret = true;
+ done:
+    lre_realloc(opaque, stack, 0);
+    return ret;
+}
+
 /* need_check_adv: false if the opcodes always advance the char pointer
    need_capture_init: true if all the captures in the atom are not set
 */
@@ -1886,6 +2116,26 @@ static bool update_modifier(bool val, int add_mask, int remove_mask,
     return val;
 }
 
+/* size of the bytecode of the unrolled quantifier on an atom of
+   length 'len' */
+static int64_t re_unrolled_size(int len, int quant_min, int quant_max,
+                                bool add_zero_advance_check)
+{
+    int64_t size;
+
+    size = (int64_t)quant_min * len;
+    if (quant_max == INT32_MAX) {
+        if (add_zero_advance_check)
+            size += 5 + 2 + len + 2 + 5;
+        else
+            size += 5;
+    } else if (quant_max > quant_min) {
+        size += (int64_t)(quant_max - quant_min) *
+            (5 + add_zero_advance_check * 2 * 2 + len);
+    }
+    return size;
+}
+
 static int re_parse_term(REParseState *s, bool is_backward_dir)
 {
     const uint8_t *p;
@@ -2315,6 +2565,12 @@ static int re_parse_term(REParseState *s, bool is_backward_dir)
                     re_need_check_adv_and_capture_init(&need_capture_init,
                                                        s->byte_code.buf + last_atom_start,
                                                        s->byte_code.size - last_atom_start);
+                if (add_zero_advance_check) {
+                    add_zero_advance_check =
+                        !re_get_first_chars(s->opaque, NULL, NULL, s->is_unicode,
+                                            s->byte_code.buf + last_atom_start,
+                                            s->byte_code.size - last_atom_start);
+                }
             
                 /* general case: need to reset the capture at each
                    iteration. We don't do it if there are no captures
@@ -2332,7 +2588,73 @@ static int re_parse_term(REParseState *s, bool is_backward_dir)
                 }
 
                 len = s->byte_code.size - last_atom_start;
-                if (quant_min == 0) {
+                /* small counted quantifiers are unrolled so that no
+                   counter is needed, which also allows the lock step
+                   execution. The iterations after the first quant_min
+                   ones are optional and keep their zero advance check. */
+                if (quant_max >= 1 &&
+                    !(quant_min == 0 && (quant_max == 1 || quant_max == INT32_MAX)) &&
+                    !(quant_min == 1 && quant_max == INT32_MAX && !add_zero_advance_check) &&
+                    re_unrolled_size(len, quant_min, quant_max,
+                                     add_zero_advance_check) <= UNROLL_SIZE_MAX) {
+                    uint8_t *atom_buf;
+                    int i, opt_count, opt_len, check_len;
+
+                    if (quant_min == quant_max)
+                        add_zero_advance_check = false;
+                    if (quant_min == 0 && !need_capture_init &&
+                        last_capture_count != s->capture_count) {
+                        /* reset the captures in case the atom is not
+                           executed */
+                        if (dbuf_insert(&s->byte_code, last_atom_start, 3))
+                            goto out_of_memory;
+                        s->byte_code.buf[last_atom_start++] = REOP_save_reset;
+                        s->byte_code.buf[last_atom_start++] = last_capture_count;
+                        s->byte_code.buf[last_atom_start++] = s->capture_count - 1;
+                    }
+                    atom_buf = lre_realloc(s->opaque, NULL, len);
+                    if (!atom_buf)
+                        goto out_of_memory;
+                    memcpy(atom_buf, s->byte_code.buf + last_atom_start, len);
+                    s->byte_code.size = last_atom_start;
+                    for(i = 0; i < quant_min; i++) {
+                        last_atom_start = s->byte_code.size;
+                        dbuf_put(&s->byte_code, atom_buf, len);
+                    }
+                    check_len = add_zero_advance_check * 2 * 2;
+                    if (quant_max == INT32_MAX) {
+                        if (add_zero_advance_check) {
+                            /* same as x* */
+                            last_atom_start = s->byte_code.size;
+                            re_emit_op_u32(s, REOP_split_goto_first + greedy,
+                                           check_len + len + 5);
+                            re_emit_op_u8(s, REOP_set_char_pos, 0);
+                            dbuf_put(&s->byte_code, atom_buf, len);
+                            re_emit_op_u8(s, REOP_check_advance, 0);
+                            re_emit_goto(s, REOP_goto, last_atom_start);
+                        } else {
+                            /* the last iteration is x+ */
+                            re_emit_goto(s, REOP_split_next_first - greedy,
+                                         last_atom_start);
+                        }
+                    } else {
+                        /* the optional iterations all jump to the end */
+                        opt_count = quant_max - quant_min;
+                        opt_len = 5 + check_len + len;
+                        for(i = 0; i < opt_count; i++) {
+                            re_emit_op_u32(s, REOP_split_goto_first + greedy,
+                                           opt_len - 5 + (opt_count - 1 - i) * opt_len);
+                            if (add_zero_advance_check)
+                                re_emit_op_u8(s, REOP_set_char_pos, 0);
+                            dbuf_put(&s->byte_code, atom_buf, len);
+                            if (add_zero_advance_check)
+                                re_emit_op_u8(s, REOP_check_advance, 0);
+                        }
+                    }
+                    lre_realloc(s->opaque, atom_buf, 0);
+                    if (dbuf_error(&s->byte_code))
+                        goto out_of_memory;
+                } else if (quant_min == 0) {
                     /* need to reset the capture in case the atom is
                        not executed */
                     if (!need_capture_init && last_capture_count != s->capture_count) {
@@ -2559,6 +2881,157 @@ static int compute_register_count(uint8_t *bc_buf, int bc_buf_len)
     return stack_size_max;
 }
 
+/* Return the maximum number of threads of the lock step execution
+   (i.e. the number of instructions consuming a character plus the
+   final match) or -1 if the regexp uses a feature which cannot be
+   executed in lock step: back references, lookarounds and loops
+   with a counter keep a state which is not described by the program
+   counter. */
+static int re_get_thread_count(const uint8_t *bc_buf, int bc_buf_len)
+{
+    int pos, opcode, len, thread_count;
+
+    thread_count = 0;
+    pos = 0;
+    while (pos < bc_buf_len) {
+        opcode = bc_buf[pos];
+        len = reopcode_info[opcode].size;
+        switch(opcode) {
+        case REOP_char:
+        case REOP_char_i:
+        case REOP_char32:
+        case REOP_char32_i:
+        case REOP_dot:
+        case REOP_any:
+        case REOP_space:
+        case REOP_not_space:
+        case REOP_match:
+            thread_count++;
+            break;
+        case REOP_range:
+        case REOP_range_i:
+            len += get_u16(bc_buf + pos + 1) * 4;
+            thread_count++;
+            break;
+        case REOP_range32:
+        case REOP_range32_i:
+            len += get_u16(bc_buf + pos + 1) * 8;
+            thread_count++;
+            break;
+        case REOP_line_start:
+        case REOP_line_start_m:
+        case REOP_line_end:
+        case REOP_line_end_m:
+        case REOP_goto:
+        case REOP_split_goto_first:
+        case REOP_split_next_first:
+        case REOP_save_start:
+        case REOP_save_end:
+        case REOP_save_reset:
+        case REOP_word_boundary:
+        case REOP_word_boundary_i:
+        case REOP_not_word_boundary:
+        case REOP_not_word_boundary_i:
+        case REOP_set_char_pos:
+        case REOP_check_advance:
+            break;
+        default:
+            return -1;
+        }
+        pos += len;
+    }
+    return thread_count;
+}
+
+/* Return true if the bytecode has an alternative or a loop. Otherwise
+   the backtracking executes each instruction at most once per start
+   position, which is as good as the lock step execution and faster. */
+static bool re_has_split(const uint8_t *bc_buf, int bc_buf_len)
+{
+    int pos, opcode, len;
+
+    pos = 0;
+    while (pos < bc_buf_len) {
+        opcode = bc_buf[pos];
+        len = reopcode_info[opcode].size;
+        switch(opcode) {
+        case REOP_split_goto_first:
+        case REOP_split_next_first:
+            return true;
+        case REOP_range:
+        case REOP_range_i:
+            len += get_u16(bc_buf + pos + 1) * 4;
+            break;
+        case REOP_range32:
+        case REOP_range32_i:
+            len += get_u16(bc_buf + pos + 1) * 8;
+            break;
+        }
+        pos += len;
+    }
+    return false;
+}
+
+/* above this number of ASCII first characters (e.g. \w), most
+   positions are candidates and the search loop is faster */
+#define RE_FIRST_CHARS_MAX 32
+
+static int re_count_first_chars(const uint8_t *first_chars)
+{
+    int i, n;
+
+    n = 0;
+    for(i = 0; i < 128; i++)
+        n += (first_chars[i >> 3] >> (i & 7)) & 1;
+    return n;
+}
+
+/* Fill the prefilter fields of the header so that lre_exec() can skip
+   the positions where no match can start: a literal prefix which each
+   match starts with and the set of the possible first characters. */
+static void re_compute_prefilter(REParseState *s, uint8_t *buf)
+{
+    const uint8_t *bc_buf;
+    int bc_buf_len, pos, prefix_len, opcode;
+    uint32_t c;
+    bool high_chars;
+
+    /* the search loop is skipped by the prefilter */
+    bc_buf = buf + RE_HEADER_LEN + RE_SEARCH_LOOP_LEN;
+    bc_buf_len = get_u32(buf + RE_HEADER_BYTECODE_LEN) - RE_SEARCH_LOOP_LEN;
+
+    /* literal prefix: characters executed before any branch */
+    prefix_len = 0;
+    pos = 0;
+    while (pos < bc_buf_len && prefix_len < RE_PREFIX_LEN_MAX) {
+        opcode = bc_buf[pos];
+        if (opcode == REOP_char) {
+            c = get_u16(bc_buf + pos + 1);
+            /* a surrogate may be part of a pair in unicode mode */
+            if (is_surrogate(c))
+                break;
+            put_u16(buf + RE_HEADER_PREFIX + prefix_len * 2, c);
+            prefix_len++;
+        } else if (opcode != REOP_save_start && opcode != REOP_save_end &&
+                   opcode != REOP_save_reset) {
+            break;
+        }
+        pos += reopcode_info[opcode].size;
+    }
+    buf[RE_HEADER_PREFIX_LEN] = prefix_len;
+
+    high_chars = false;
+    if (re_get_first_chars(s->opaque, buf + RE_HEADER_FIRST_CHARS,
+                           &high_chars, s->is_unicode, bc_buf, bc_buf_len) &&
+        re_count_first_chars(buf + RE_HEADER_FIRST_CHARS) <= RE_FIRST_CHARS_MAX) {
+        buf[RE_HEADER_PREFILTER] = RE_PREFILTER_FIRST_CHARS;
+        if (high_chars)
+            buf[RE_HEADER_PREFILTER] |= RE_PREFILTER_HIGH_CHARS;
+    } else {
+        memset(buf + RE_HEADER_FIRST_CHARS, 0, 32);
+    }
+}
+
 static void *lre_bytecode_realloc(void *opaque, void *ptr, size_t size)
 {
     if (size > (INT32_MAX / 2)) {
@@ -2579,9 +3052,10 @@ uint8_t *lre_compile(int *plen, char *error_msg, int error_msg_size,
                      void *opaque)
 {
     REParseState s_s, *s = &s_s;
-    int register_count;
+    int register_count, search_len;
     bool is_sticky;
 
+    re_flags &= ~LRE_FLAG_LINEAR;
     memset(s, 0, sizeof(*s));
     s->opaque = opaque;
     s->buf_ptr = (const uint8_t *)buf;
@@ -2605,6 +3079,9 @@ uint8_t *lre_compile(int *plen, char *error_msg, int error_msg_size,
     dbuf_putc(&s->byte_code, 0); /* second element is the number of captures */
     dbuf_putc(&s->byte_code, 0); /* stack size */
     dbuf_put_u32(&s->byte_code, 0); /* bytecode length */
+    /* prefilter */
+    while (s->byte_code.size < RE_HEADER_LEN)
+        dbuf_putc(&s->byte_code, 0);
 
     if (!is_sticky) {
         /* iterate thru all positions (about the same as .*?( ... ) )
@@ -2651,6 +3128,20 @@ uint8_t *lre_compile(int *plen, char *error_msg, int error_msg_size,
     put_u32(s->byte_code.buf + RE_HEADER_BYTECODE_LEN,
             s->byte_code.size - RE_HEADER_LEN);
 
+    /* select the execution engine: lock step if the regexp supports
+       it and the backtracking could be slower than linear */
+    search_len = is_sticky ? 0 : RE_SEARCH_LOOP_LEN;
+    if (re_get_thread_count(s->byte_code.buf + RE_HEADER_LEN,
+                            s->byte_code.size - RE_HEADER_LEN) >= 0 &&
+        re_has_split(s->byte_code.buf + RE_HEADER_LEN + search_len,
+                     s->byte_code.size - RE_HEADER_LEN - search_len)) {
+        put_u16(s->byte_code.buf + RE_HEADER_FLAGS,
+                lre_get_flags(s->byte_code.buf) | LRE_FLAG_LINEAR);
+    }
+
+    if (!is_sticky)
+        re_compute_prefilter(s, s->byte_code.buf);
+
     /* add the named groups if needed */
     if (s->group_names.size > (s->capture_count - 1) * LRE_GROUP_NAME_TRAILER_LEN) {
         if (dbuf_put(&s->byte_code, s->group_names.buf, s->group_names.size)) {
@@ -2828,6 +3319,40 @@ static no_inline int stack_realloc(REExecContext *s, size_t n)
     return 0;
 }
 
+/* return true if the word boundary assertion 'opcode' holds at 'cptr' */
+static bool lre_test_word_boundary(REExecContext *s, const uint8_t *cptr,
+                                   int opcode)
+{
+    bool v1, v2;
+    uint32_t c;
+    int cbuf_type = s->cbuf_type;
+    int ignore_case = (opcode == REOP_word_boundary_i || opcode == REOP_not_word_boundary_i);
+    bool is_boundary = (opcode == REOP_word_boundary || opcode == REOP_word_boundary_i);
+    /* char before */
+    if (cptr == s->cbuf) {
+        v1 = false;
+    } else {
+        PEEK_PREV_CHAR(c, cptr, s->cbuf, cbuf_type);
+        if (c < 256) {
+            v1 = (lre_is_word_byte(c) != 0);
+        } else {
+            v1 = ignore_case && (c == 0x017f || c == 0x212a);
+        }
+    }
+    /* current char */
+    if (cptr >= s->cbuf_end) {
+        v2 = false;
+    } else {
+        PEEK_CHAR(c, cptr, s->cbuf_end, cbuf_type);
+        if (c < 256) {
+            v2 = (lre_is_word_byte(c) != 0);
+        } else {
+            v2 = ignore_case && (c == 0x017f || c == 0x212a);
+        }
+    }
+    return !(v1 ^ v2 ^ is_boundary);
+}
+
 /* return 1 if match, 0 if not match or < 0 if error. */
 static intptr_t lre_exec_backtrack(REExecContext *s, uint8_t **capture,
                                    const uint8_t *pc, const uint8_t *cptr)
@@ -3199,35 +3724,8 @@ static intptr_t lre_exec_backtrack(REExecContext *s, uint8_t **capture,
         case REOP_word_boundary_i:
         case REOP_not_word_boundary:
         case REOP_not_word_boundary_i:
-            {
-                bool v1, v2;
-                int ignore_case = (opcode == REOP_word_boundary_i || opcode == REOP_not_word_boundary_i);
-                bool is_boundary = (opcode == REOP_word_boundary || opcode == REOP_word_boundary_i);
-                /* char before */
-                if (cptr == s->cbuf) {
-                    v1 = false;
-                } else {
-                    PEEK_PREV_CHAR(c, cptr, s->cbuf, cbuf_type);
-                    if (c < 256) {
-                        v1 = (lre_is_word_byte(c) != 0);
-                    } else {
-                        v1 = ignore_case && (c == 0x017f || c == 0x212a);
-                    }
-                }
-                /* current char */
-                if (cptr >= cbuf_end) {
-                    v2 = false;
-                } else {
-                    PEEK_CHAR(c, cptr, cbuf_end, cbuf_type);
-                    if (c < 256) {
-                        v2 = (lre_is_word_byte(c) != 0);
-                    } else {
-                        v2 = ignore_case && (c == 0x017f || c == 0x212a);
-                    }
-                }
-                if (v1 ^ v2 ^ is_boundary)
-                    goto no_match;
-            }
+            if (!lre_test_word_boundary(s, cptr, opcode))
+                goto no_match;
             break;
         case REOP_back_reference:
         case REOP_back_reference_i:
@@ -3380,6 +3878,538 @@ static intptr_t lre_exec_backtrack(REExecContext *s, uint8_t **capture,
     }
 }
 
+/* Lock step execution (Pike VM): all the threads advance by one
+   character at a time and at most one thread exists per program
+   counter, so the execution time is linear in the input length. The
+   threads are kept in priority order, so the first thread reaching a
+   given instruction wins as it does with backtracking.
+
+   The zero advance check of the loops (set_char_pos / check_advance)
+   does not need registers: a check fails if and only if the loop body
+   was entered in the same epsilon closure, i.e. without consuming a
+   character. Since a body can only be left through its check, a
+   single 'empty' flag per path is enough even with nested loops. */
+
+typedef struct {
+    int count;
+    const uint8_t **pc; /* instructions consuming a character or match */
+    uint8_t **capture; /* capture_count * 2 entries per thread */
+} REThreadList;
+
+typedef struct {
+    const uint8_t *pc; /* NULL for a capture restore entry */
+    int idx; /* capture index or 'empty' flag of the path */
+    uint8_t *val;
+} REThreadJob;
+
+typedef struct {
+    REExecContext *s;
+    const uint8_t *bc_buf;
+    uint32_t *visited; /* generation of the last visit, per instruction
+                          and 'empty' flag */
+    uint32_t gen;
+    uint8_t **capture; /* capture of the thread being added */
+    REThreadJob *jobs;
+    int job_count;
+    int job_size;
+    REThreadJob static_jobs[32]; /* to avoid allocation in most cases */
+} RELockStepState;
+
+static no_inline int re_realloc_jobs(RELockStepState *ls)
+{
+    REThreadJob *new_jobs;
+    int new_size;
+
+    new_size = ls->job_size * 3 / 2;
+    if (ls->jobs == ls->static_jobs) {
+        new_jobs = lre_realloc(ls->s->opaque, NULL,
+                               new_size * sizeof(ls->jobs[0]));
+        if (!new_jobs)
+            return -1;
+        memcpy(new_jobs, ls->jobs, ls->job_size * sizeof(ls->jobs[0]));
+    } else {
+        new_jobs = lre_realloc(ls->s->opaque, ls->jobs,
+                               new_size * sizeof(ls->jobs[0]));
+        if (!new_jobs)
+            return -1;
+    }
+    ls->jobs = new_jobs;
+    ls->job_size = new_size;
+    return 0;
+}
+
+static inline int re_push_job(RELockStepState *ls, const uint8_t *pc, int idx,
+                              uint8_t *val)
+{
+    if (unlikely(ls->job_count >= ls->job_size)) {
+        if (re_realloc_jobs(ls))
+            return -1;
+    }
+    ls->jobs[ls->job_count++] = (REThreadJob){ pc, idx, val };
+    return 0;
+}
+
+/* save the capture and set it to 'val' in the current thread */
+static int re_set_capture(RELockStepState *ls, int idx, uint8_t *val)
+{
+    if (re_push_job(ls, NULL, idx, ls->capture[idx]))
+        return -1;
+    ls->capture[idx] = val;
+    return 0;
+}
+
+/* Add to 'l' the threads reachable from 'pc' at position 'cptr'
+   without consuming a character. ls->capture is the capture of the
+   thread, it is restored on return. */
+static int re_add_thread(RELockStepState *ls, REThreadList *l,
+                         const uint8_t *pc, const uint8_t *cptr)
+{
+    REExecContext *s = ls->s;
+    int cbuf_type = s->cbuf_type;
+    int capture_len = s->capture_count * 2;
+    uint32_t val, val2, c, pos;
+    int opcode, job_base, empty;
+    REThreadJob *job;
+
+    job_base = ls->job_count;
+    empty = 0;
+    for(;;) {
+        for(;;) {
+            pos = (pc - ls->bc_buf) * 2 + empty;
+            if (ls->visited[pos] == ls->gen)
+                break;
+            ls->visited[pos] = ls->gen;
+            opcode = *pc;
+            switch(opcode) {
+            case REOP_goto:
+                pc += 5 + (int)get_u32(pc + 1);
+                continue;
+            case REOP_split_goto_first:
+            case REOP_split_next_first:
+                {
+                    const uint8_t *pc1, *pc2;
+                    pc1 = pc + 5;
+                    pc2 = pc1 + (int)get_u32(pc + 1);
+                    if (opcode == REOP_split_goto_first) {
+                        const uint8_t *tmp = pc1;
+                        pc1 = pc2;
+                        pc2 = tmp;
+                    }
+                    /* the lower priority branch is explored last */
+                    if (re_push_job(ls, pc2, empty, NULL))
+                        return -1;
+                    pc = pc1;
+                }
+                continue;
+            case REOP_set_char_pos:
+                empty = 1;
+                pc += 2;
+                continue;
+            case REOP_check_advance:
+                if (empty)
+                    break;
+                pc += 2;
+                continue;
+            case REOP_save_start:
+            case REOP_save_end:
+                val = pc[1];
+                if (val >= (uint32_t)s->capture_count)
+                    return LRE_RET_BYTECODE_ERROR;
+                if (re_set_capture(ls, 2 * val + opcode - REOP_save_start,
+                                   (uint8_t *)cptr))
+                    return -1;
+                pc += 2;
+                continue;
+            case REOP_save_reset:
+                val2 = pc[2];
+                if (val2 >= (uint32_t)s->capture_count)
+                    return LRE_RET_BYTECODE_ERROR;
+                for(val = pc[1]; val <= val2; val++) {
+                    if (re_set_capture(ls, 2 * val, NULL) ||
+                        re_set_capture(ls, 2 * val + 1, NULL))
+                        return -1;
+                }
+                pc += 3;
+                continue;
+            case REOP_line_start:
+            case REOP_line_start_m:
+                if (cptr != s->cbuf) {
+                    if (opcode == REOP_line_start)
+                        break;
+                    PEEK_PREV_CHAR(c, cptr, s->cbuf, cbuf_type);
+                    if (!is_line_terminator(c))
+                        break;
+                }
+                pc++;
+                continue;
+            case REOP_line_end:
+            case REOP_line_end_m:
+                if (cptr != s->cbuf_end) {
+                    if (opcode == REOP_line_end)
+                        break;
+                    PEEK_CHAR(c, cptr, s->cbuf_end, cbuf_type);
+                    if (!is_line_terminator(c))
+                        break;
+                }
+                pc++;
+                continue;
+            case REOP_word_boundary:
+            case REOP_word_boundary_i:
+            case REOP_not_word_boundary:
+            case REOP_not_word_boundary_i:
+                if (!lre_test_word_boundary(s, cptr, opcode))
+                    break;
+                pc++;
+                continue;
+            default:
+                /* consuming instruction or match: the thread state
+                   does not depend on the 'empty' flag */
+                if (empty) {
+                    pos--;
+                    if (ls->visited[pos] == ls->gen)
+                        break;
+                    ls->visited[pos] = ls->gen;
+                }
+                l->pc[l->count] = pc;
+                memcpy(l->capture + l->count * capture_len, ls->capture,
+                       capture_len * sizeof(ls->capture[0]));
+                l->count++;
+                break;
+            }
+            break;
+        }
+        /* explore the next branch and restore the captures */
+        for(;;) {
+            if (ls->job_count == job_base)
+                return 0;
+            job = &ls->jobs[--ls->job_count];
+            if (job->pc)
+                break;
+            ls->capture[job->idx] = job->val;
+        }
+        pc = job->pc;
+        empty = job->idx;
+    }
+}
+
+static bool re_range_match(const uint8_t *pc, uint32_t c, bool is_range32)
+{
+    uint32_t low, high;
+    int n, idx_min, idx_max, idx;
+
+    n = get_u16(pc); /* n must be >= 1 */
+    pc += 2;
+    idx_min = 0;
+    idx_max = n - 1;
+    while (idx_min <= idx_max) {
+        idx = (idx_min + idx_max) / 2;
+        if (is_range32) {
+            low = get_u32(pc + idx * 8);
+            high = get_u32(pc + idx * 8 + 4);
+        } else {
+            low = get_u16(pc + idx * 4);
+            high = get_u16(pc + idx * 4 + 2);
+            /* 0xffff in for last value means +infinity */
+            if (high == 0xffff && idx == n - 1)
+                high = UINT32_MAX;
+        }
+        if (c < low)
+            idx_max = idx - 1;
+        else if (c > high)
+            idx_min = idx + 1;
+        else
+            return true;
+    }
+    return false;
+}
+
+/* return the next instruction if the consuming instruction at 'pc'
+   matches 'c', otherwise NULL */
+static const uint8_t *re_match_char(REExecContext *s, const uint8_t *pc,
+                                    uint32_t c)
+{
+    int opcode = *pc;
+
+    switch(opcode) {
+    case REOP_char:
+    case REOP_char_i:
+        if (opcode == REOP_char_i)
+            c = lre_canonicalize(c, s->is_unicode);
+        return c == get_u16(pc + 1) ? pc + 3 : NULL;
+    case REOP_char32:
+    case REOP_char32_i:
+        if (opcode == REOP_char32_i)
+            c = lre_canonicalize(c, s->is_unicode);
+        return c == get_u32(pc + 1) ? pc + 5 : NULL;
+    case REOP_dot:
+        return is_line_terminator(c) ? NULL : pc + 1;
+    case REOP_any:
+        return pc + 1;
+    case REOP_space:
+        return lre_is_space(c) ? pc + 1 : NULL;
+    case REOP_not_space:
+        return lre_is_space(c) ? NULL : pc + 1;
+    case REOP_range:
+    case REOP_range_i:
+        if (opcode == REOP_range_i)
+            c = lre_canonicalize(c, s->is_unicode);
+        if (!re_range_match(pc + 1, c, false))
+            return NULL;
+        return pc + 3 + get_u16(pc + 1) * 4;
+    case REOP_range32:
+    case REOP_range32_i:
+        if (opcode == REOP_range32_i)
+            c = lre_canonicalize(c, s->is_unicode);
+        if (!re_range_match(pc + 1, c, true))
+            return NULL;
+        return pc + 3 + get_u16(pc + 1) * 8;
+    default:
+        return NULL;
+    }
+}
+
+/* Return the first position >= cptr where a match may start according
+   to the prefilter of the regexp or NULL if there is none. */
+static const uint8_t *re_prefilter_search(REExecContext *s,
+                                          const uint8_t *bc_buf,
+                                          const uint8_t *cptr)
+{
+    const uint8_t *cbuf_end = s->cbuf_end;
+    const uint8_t *first_chars = bc_buf + RE_HEADER_FIRST_CHARS;
+    const uint8_t *prefix = bc_buf + RE_HEADER_PREFIX;
+    int prefix_len, i;
+    bool high_chars;
+    uint32_t c;
+
+    prefix_len = bc_buf[RE_HEADER_PREFIX_LEN];
+    if (s->cbuf_type == 0) {
+        uint8_t prefix8[RE_PREFIX_LEN_MAX];
+
+        if (prefix_len != 0) {
+            for(i = 0; i < prefix_len; i++) {
+                c = get_u16(prefix + i * 2);
+                if (c >= 256)
+                    return NULL;
+                prefix8[i] = c;
+            }
+            while (cbuf_end - cptr >= prefix_len) {
+                cptr = memchr(cptr, prefix8[0], cbuf_end - cptr - prefix_len + 1);
+                if (!cptr)
+                    return NULL;
+                if (!memcmp(cptr + 1, prefix8 + 1, prefix_len - 1))
+                    return cptr;
+                cptr++;
+            }
+            return NULL;
+        }
+        for(; cptr < cbuf_end; cptr++) {
+            c = *cptr;
+            if (first_chars[c >> 3] & (1 << (c & 7)))
+                return cptr;
+        }
+    } else {
+        const uint16_t *p = (const uint16_t *)cptr;
+        const uint16_t *p_end = (const uint16_t *)cbuf_end;
+        uint16_t c0;
+
+        if (prefix_len != 0) {
+            c0 = get_u16(prefix);
+            for(; p_end - p >= prefix_len; p++) {
+                if (*p != c0)
+                    continue;
+                for(i = 1; i < prefix_len; i++) {
+                    if (p[i] != get_u16(prefix + i * 2))
+                        break;
+                }
+                if (i == prefix_len)
+                    return (const uint8_t *)p;
+            }
+            return NULL;
+        }
+        high_chars = (bc_buf[RE_HEADER_PREFILTER] & RE_PREFILTER_HIGH_CHARS) != 0;
+        for(; p < p_end; p++) {
+            c = *p;
+            if (c < 256) {
+                if (first_chars[c >> 3] & (1 << (c & 7)))
+                    return (const uint8_t *)p;
+            } else if (high_chars) {
+                /* the search loop does not stop in the middle of a
+                   surrogate pair */
+                if (s->cbuf_type == 2 && is_lo_surrogate(c) &&
+                    p > (const uint16_t *)s->cbuf && is_hi_surrogate(p[-1]))
+                    continue;
+                return (const uint8_t *)p;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* return 1 if match, 0 if not match or < 0 if error. 'buf' is the
+   regexp with its header. */
+static int lre_exec_lock_step(REExecContext *s, uint8_t **capture,
+                              const uint8_t *buf, const uint8_t *cptr)
+{
+    RELockStepState ls_s, *ls = &ls_s;
+    REThreadList lists[2], *clist, *nlist, *tmp;
+    int thread_count, capture_len, i, ret, cbuf_type, matched, bc_buf_len;
+    const uint8_t *bc_buf, *pc, *cptr1, *search_pc, *start_pc;
+    uint8_t *mem, **p;
+    void *static_mem[256]; /* to avoid allocation in most cases */
+    size_t size;
+    uint32_t c;
+
+    bc_buf = buf + RE_HEADER_LEN;
+    bc_buf_len = get_u32(buf + RE_HEADER_BYTECODE_LEN);
+    thread_count = re_get_thread_count(bc_buf, bc_buf_len);
+    if (thread_count < 0)
+        return LRE_RET_BYTECODE_ERROR;
+    start_pc = bc_buf;
+    capture_len = s->capture_count * 2;
+    cbuf_type = s->cbuf_type;
+
+    search_pc = NULL;
+    if (!(lre_get_flags(buf) & LRE_FLAG_STICKY)) {
+        if (bc_buf[RE_SEARCH_LOOP_LEN + 2] == REOP_line_start) {
+            /* the regexp starts with '^': only the start of the input
+               can match, so the search loop is skipped */
+            if (cptr != s->cbuf)
+                return 0;
+            start_pc = bc_buf + RE_SEARCH_LOOP_LEN;
+        } else if (buf[RE_HEADER_PREFILTER] != 0) {
+            /* 'any' instruction of the search loop: when it is the
+               only thread, the next start position is given by the
+               prefilter */
+            search_pc = bc_buf + 5;
+            cptr = re_prefilter_search(s, buf, cptr);
+            if (!cptr)
+                return 0;
+        }
+    }
+
+    /* thread lists, current capture and visited instructions */
+    size = (2 * thread_count * (1 + capture_len) + capture_len) * sizeof(void *) +
+        2 * bc_buf_len * sizeof(uint32_t);
+    if (size <= sizeof(static_mem)) {
+        mem = (uint8_t *)static_mem;
+    } else {
+        mem = lre_realloc(s->opaque, NULL, size);
+        if (!mem)
+            return LRE_RET_MEMORY_ERROR;
+    }
+    p = (uint8_t **)mem;
+    for(i = 0; i < 2; i++) {
+        lists[i].count = 0;
+        lists[i].pc = (const uint8_t **)p;
+        p += thread_count;
+        lists[i].capture = p;
+        p += thread_count * capture_len;
+    }
+    ls->s = s;
+    ls->bc_buf = bc_buf;
+    ls->capture = p;
+    p += capture_len;
+    ls->visited = (uint32_t *)p;
+    memset(ls->visited, 0, 2 * bc_buf_len * sizeof(uint32_t));
+    ls->gen = 1;
+    ls->jobs = ls->static_jobs;
+    ls->job_count = 0;
+    ls->job_size = countof(ls->static_jobs);
+
+    clist = &lists[0];
+    nlist = &lists[1];
+    for(i = 0; i < capture_len; i++)
+        ls->capture[i] = NULL;
+    matched = 0;
+    ret = re_add_thread(ls, clist, start_pc, cptr);
+    if (ret < 0)
+        goto done;
+    while (clist->count != 0) {
+        ret = lre_poll_timeout(s);
+        if (ret < 0)
+            goto done;
+        if (clist->count == 1 && clist->pc[0] == search_pc) {
+            /* no match can start at 'cptr' */
+            if (cptr >= s->cbuf_end)
+                break;
+            GET_CHAR(c, cptr, s->cbuf_end, cbuf_type);
+            cptr = re_prefilter_search(s, buf, cptr);
+            if (!cptr)
+                break;
+            ls->gen++;
+            clist->count = 0;
+            ret = re_add_thread(ls, clist, bc_buf, cptr);
+            if (ret < 0)
+                goto done;
+            continue;
+        }
+        cptr1 = cptr;
+        c = 0;
+        if (cptr1 < s->cbuf_end)
+            GET_CHAR(c, cptr1, s->cbuf_end, cbuf_type);
+        ls->gen++;
+        nlist->count = 0;
+        for(i = 0; i < clist->count; i++) {
+            pc = clist->pc[i];
+            if (*pc == REOP_match) {
+                /* the lower priority threads are discarded */
+                memcpy(capture, clist->capture + i * capture_len,
+                       capture_len * sizeof(capture[0]));
+                matched = 1;
+                break;
+            }
+            if (cptr >= s->cbuf_end)
+                continue;
+            pc = re_match_char(s, pc, c);
+            if (pc) {
+                memcpy(ls->capture, clist->capture + i * capture_len,
+                       capture_len * sizeof(capture[0]));
+                ret = re_add_thread(ls, nlist, pc, cptr1);
+                if (ret < 0)
+                    goto done;
+            }
+        }
+        if (cptr >= s->cbuf_end)
+            break;
+        tmp = clist;
+        clist = nlist;
+        nlist = tmp;
+        cptr = cptr1;
+    }
+    ret = matched;
+ done:
+    if (ls->jobs != ls->static_jobs)
+        lre_realloc(s->opaque, ls->jobs, 0);
+    if (mem != (uint8_t *)static_mem)
+        lre_realloc(s->opaque, mem, 0);
+    return ret;
+}
+
+/* Same as the search loop of a non sticky regexp, but the positions are
+   first selected with the prefilter. */
+static intptr_t lre_exec_prefilter(REExecContext *s, uint8_t **capture,
+                                   const uint8_t *bc_buf, const uint8_t *cptr)
+{
+    intptr_t ret;
+    uint32_t c;
+    int i;
+
+    for(;;) {
+        cptr = re_prefilter_search(s, bc_buf, cptr);
+        if (!cptr)
+            return 0;
+        for(i = 0; i < s->capture_count * 2; i++)
+            capture[i] = NULL;
+        ret = lre_exec_backtrack(s, capture,
+                                 bc_buf + RE_HEADER_LEN + RE_SEARCH_LOOP_LEN,
+                                 cptr);
+        if (ret != 0)
+            break;
+        GET_CHAR(c, cptr, s->cbuf_end, s->cbuf_type);
+    }
+    return ret;
+}
+
 /* Return 1 if match, 0 if not match or < 0 if error (see LRE_RET_x). cindex is the
    starting position of the match and must be such as 0 <= cindex <=
    clen. */
@@ -3416,7 +4446,14 @@ int lre_exec(uint8_t **capture,
         }
     }
 
-    ret = lre_exec_backtrack(s, capture, bc_buf + RE_HEADER_LEN, cptr);
+    /* the engine is selected by lre_compile(): the regexps which can
+       be executed in linear time always run in lock step mode */
+    if (re_flags & LRE_FLAG_LINEAR)
+        ret = lre_exec_lock_step(s, capture, bc_buf, cptr);
+    else if (bc_buf[RE_HEADER_PREFILTER] != 0 && !(re_flags & LRE_FLAG_STICKY))
+        ret = lre_exec_prefilter(s, capture, bc_buf, cptr);
+    else
+        ret = lre_exec_backtrack(s, capture, bc_buf + RE_HEADER_LEN, cptr);
 
     if (s->stack_buf != s->static_stack_buf)
         lre_realloc(s->opaque, s->stack_buf, 0);
@@ -3440,6 +4477,10 @@ int lre_check_bytecode(const uint8_t *bc_buf, int bc_buf_len)
     re_bytecode_len = get_u32(bc_buf + RE_HEADER_BYTECODE_LEN);
     if (re_bytecode_len > (uint32_t)(bc_buf_len - RE_HEADER_LEN))
         return -1;
+    if (bc_buf[RE_HEADER_PREFIX_LEN] > RE_PREFIX_LEN_MAX)
+        return -1;
+    if (bc_buf[RE_HEADER_PREFILTER] != 0 && re_bytecode_len < RE_SEARCH_LOOP_LEN)
+        return -1;
     return 0;
 }
 
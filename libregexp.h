@@ -42,6 +42,7 @@ extern "C" {
 #define LRE_FLAG_INDICES    (1 << 6) /* Unused by libregexp, just recorded. */
 #define LRE_FLAG_NAMED_GROUPS (1 << 7) /* named groups are present in the regexp */
 #define LRE_FLAG_UNICODE_SETS (1 << 8)
+#define LRE_FLAG_LINEAR     (1 << 9) /* set by lre_compile() if the regexp is executed in lock step mode (linear time) */
 
 #define LRE_RET_MEMORY_ERROR   (-1)
 #define LRE_RET_TIMEOUT        (-2)
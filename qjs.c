@@ -83,7 +83,8 @@ static JSValue load_standalone_module(JSContext *ctx)
 {
     JSModuleDef *m;
     JSValue obj, val;
-    obj = JS_ReadObject(ctx, qjsc_standalone, qjsc_standalone_size, JS_READ_OBJ_BYTECODE);
+    obj = JS_ReadObject(ctx, qjsc_standalone, qjsc_standalone_size,
+                        JS_READ_OBJ_BYTECODE | JS_READ_OBJ_IN_PLACE);
     if (JS_IsException(obj))
         goto exception;
     assert(JS_VALUE_GET_TAG(obj) == JS_TAG_MODULE);
@@ -203,6 +204,20 @@ static int64_t parse_limit(const char *arg) {
     return (int64_t)(d * unit);
 }
 
+static void write_cpu_profile(JSRuntime *rt, const char *filename)
+{
+    FILE *f;
+
+    JS_StopCPUProfile(rt);
+    f = fopen(filename, "w");
+    if (!f) {
+        perror(filename);
+        return;
+    }
+    JS_DumpCPUProfile(f, rt);
+    fclose(f);
+}
+
 static JSValue js_gc(JSContext *ctx, JSValueConst this_val,
                      int argc, JSValueConst *argv)
 {
@@ -389,9 +404,12 @@ void help(int exit_status)
            "-i  --interactive  go to interactive mode\n"
            "-C  --script       load as JS classic script (default=autodetect)\n"
            "-m  --module       load as ES module (default=autodetect)\n"
+           "-b  --bytecode     run a file compiled with 'qjsc -b'\n"
            "-I  --include file include an additional file\n"
            "    --std          make 'std', 'os' and 'bjson' available to script\n"
            "-T  --trace        trace memory allocation\n"
+           "    --cpu-prof FILE write a CPU profile (folded stacks) to FILE\n"
+           "    --cpu-prof-interval n  sampling interval in microseconds (default 1000)\n"
            "-d  --dump         dump the memory usage stats\n"
            "-D  --dump-flags   flags for dumping debug data (see DUMP_* defines)\n",
            JS_GetVersion());
@@ -427,11 +445,14 @@ int main(int argc, char **argv)
     int trace_memory = 0;
     int empty_run = 0;
     int module = -1;
+    int bytecode = 0;
     int load_std = 0;
     char *include_list[32];
     int i, include_count = 0;
     int64_t memory_limit = -1;
     int64_t stack_size = -1;
+    char *cpu_prof_file = NULL;
+    int cpu_prof_interval = 1000;
 
     /* save for later */
     qjs__argc = argc;
@@ -516,6 +537,10 @@ int main(int argc, char **argv)
                 module = 0;
                 continue;
             }
+            if (opt == 'b' || !strcmp(longopt, "bytecode")) {
+                bytecode = 1;
+                continue;
+            }
             if (opt == 'd' || !strcmp(longopt, "dump")) {
                 dump_memory++;
                 continue;
@@ -547,6 +572,28 @@ int main(int argc, char **argv)
                 memory_limit = parse_limit(optarg);
                 break;
             }
+            if (!strcmp(longopt, "cpu-prof")) {
+                if (!optarg) {
+                    if (optind >= argc) {
+                        fprintf(stderr, "qjs: missing file for --cpu-prof\n");
+                        exit(1);
+                    }
+                    optarg = argv[optind++];
+                }
+                cpu_prof_file = optarg;
+                break;
+            }
+            if (!strcmp(longopt, "cpu-prof-interval")) {
+                if (!optarg) {
+                    if (optind >= argc) {
+                        fprintf(stderr, "expecting sampling interval\n");
+                        exit(1);
+                    }
+                    optarg = argv[optind++];
+                }
+                cpu_prof_interval = strtol(optarg, NULL, 0);
+                break;
+            }
             if (!strcmp(longopt, "stack-size")) {
                 if (!optarg) {
                     if (optind >= argc) {
@@ -626,6 +673,10 @@ start:
         JS_SetMaxStackSize(rt, (size_t)stack_size);
     if (dump_flags != 0)
         JS_SetDumpFlags(rt, dump_flags);
+    if (cpu_prof_file && JS_StartCPUProfile(rt, cpu_prof_interval)) {
+        fprintf(stderr, "qjs: cannot start the CPU profiler\n");
+        exit(2);
+    }
     js_std_set_worker_new_context_func(JS_NewCustomContext);
     js_std_init_handlers(rt);
     ctx = JS_NewCustomContext(rt);
@@ -697,7 +748,9 @@ start:
         } else {
             const char *filename;
             filename = argv[optind];
-            if (eval_file(ctx, filename, module))
+            if (bytecode)
+                js_std_eval_binary_file(ctx, filename, 0);
+            else if (eval_file(ctx, filename, module))
                 goto fail;
         }
         if (interactive) {
@@ -725,6 +778,8 @@ start:
         JS_ComputeMemoryUsage(rt, &stats);
         JS_DumpMemoryUsage(stdout, &stats, rt);
     }
+    if (cpu_prof_file)
+        write_cpu_profile(rt, cpu_prof_file);
     js_std_free_handlers(rt);
     JS_FreeContext(ctx);
     JS_FreeRuntime(rt);
@@ -755,6 +810,8 @@ start:
     }
     return 0;
  fail:
+    if (cpu_prof_file)
+        write_cpu_profile(rt, cpu_prof_file);
     js_std_free_handlers(rt);
     JS_FreeContext(ctx);
     JS_FreeRuntime(rt);
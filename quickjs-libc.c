@@ -58,11 +58,16 @@
 #else
 #include <sys/ioctl.h>
 #include <poll.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define USE_EPOLL // persistent registration of the os.setReadHandler fds
+#endif
 #if !defined(__wasi__)
 #include <dlfcn.h>
 #include <termios.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <grp.h>
 #endif
 
@@ -118,10 +123,15 @@ extern char **environ;
    - add socket calls
 */
 
-typedef struct {
+typedef struct JSOSRWHandler {
     struct list_head link;
+    struct JSOSRWHandler *hash_next; /* in JSThreadState.rw_handler_hash */
     int fd;
     JSValue rw_func[2];
+#ifdef USE_EPOLL
+    bool polled; /* not supported by epoll (e.g. regular file): use poll() */
+    bool registered; /* in ts->epoll_fd */
+#endif
 } JSOSRWHandler;
 
 typedef struct {
@@ -147,13 +157,17 @@ typedef struct {
 
 #ifdef USE_WORKER
 
-typedef struct {
-    struct list_head link;
-    uint8_t *data;
+typedef struct JSWorkerMessage {
+    struct JSWorkerMessage *next; /* in JSWorkerMessagePipe.msg_head */
+    struct list_head link; /* in JSWorkerMessagePipe.msg_queue */
+    uint8_t *data; /* allocated with the message */
     size_t data_len;
     /* list of SharedArrayBuffers, necessary to free the message */
     uint8_t **sab_tab;
     size_t sab_tab_len;
+    /* transferred ArrayBuffers, NULL once taken by the receiver */
+    JSTransferredArrayBuffer **transfer_tab;
+    size_t transfer_tab_len;
 } JSWorkerMessage;
 
 typedef struct JSWaker {
@@ -165,9 +179,12 @@ typedef struct JSWaker {
 #endif
 } JSWaker;
 
+/* The senders push their messages on a lock-free stack. The receiving
+   thread takes the whole stack at once and moves it in posting order
+   to 'msg_queue', which only it accesses. */
 typedef struct {
     int ref_count;
-    js_mutex_t mutex;
+    JSWorkerMessage *_Atomic msg_head; /* last posted message */
     struct list_head msg_queue; /* list of JSWorkerMessage.link */
     JSWaker waker;
 } JSWorkerMessagePipe;
@@ -182,6 +199,10 @@ typedef struct {
 
 typedef struct JSThreadState {
     struct list_head os_rw_handlers; /* list of JSOSRWHandler.link */
+    /* JSOSRWHandler indexed by fd */
+    struct JSOSRWHandler **rw_handler_hash;
+    uint32_t rw_handler_hash_size; /* power of two */
+    uint32_t rw_handler_count;
     struct list_head os_signal_handlers; /* list JSOSSignalHandler.link */
     struct list_head os_timers; /* list of JSOSTimer.link */
     struct list_head port_list; /* list of JSWorkerMessageHandler.link */
@@ -189,6 +210,10 @@ typedef struct JSThreadState {
     int eval_script_recurse; /* only used in the main thread */
     int64_t next_timer_id; /* for setTimeout / setInterval */
     bool can_js_os_poll;
+#ifdef USE_EPOLL
+    int epoll_fd; /* -1 if not available */
+    int polled_rw_handler_count; /* number of JSOSRWHandler.polled */
+#endif
     /* not used in the main thread */
 #ifdef USE_WORKER
     JSWorkerMessagePipe *recv_pipe, *send_pipe;
@@ -196,6 +221,7 @@ typedef struct JSThreadState {
     void *recv_pipe;
 #endif // USE_WORKER
     JSClassID std_file_class_id;
+    JSClassID std_json_parser_class_id;
     JSClassID worker_class_id;
 } JSThreadState;
 
@@ -1083,6 +1109,51 @@ static JSValue js_std_gc(JSContext *ctx, JSValueConst this_val,
     return JS_UNDEFINED;
 }
 
+static JSValue js_std_memoryUsage(JSContext *ctx, JSValueConst this_val,
+                                  int argc, JSValueConst *argv)
+{
+    static const struct {
+        const char *name;
+        size_t offset;
+    } fields[] = {
+#define FIELD(name) { #name, offsetof(JSMemoryUsage, name) }
+        FIELD(malloc_size), FIELD(malloc_limit), FIELD(memory_used_size),
+        FIELD(malloc_peak_size),
+        FIELD(malloc_count), FIELD(memory_used_count),
+        FIELD(atom_count), FIELD(atom_size),
+        FIELD(str_count), FIELD(str_size),
+        FIELD(obj_count), FIELD(obj_size),
+        FIELD(prop_count), FIELD(prop_size),
+        FIELD(shape_count), FIELD(shape_size),
+        FIELD(js_func_count), FIELD(js_func_size), FIELD(js_func_code_size),
+        FIELD(js_func_pc2line_count), FIELD(js_func_pc2line_size),
+        FIELD(c_func_count), FIELD(array_count),
+        FIELD(fast_array_count), FIELD(fast_array_elements),
+        FIELD(binary_object_count), FIELD(binary_object_size),
+        FIELD(gc_count), FIELD(gc_young_count),
+#undef FIELD
+    };
+    JSMemoryUsage stats;
+    JSValue obj;
+    int64_t v;
+    int i;
+
+    JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &stats);
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj))
+        return JS_EXCEPTION;
+    for(i = 0; i < countof(fields); i++) {
+        memcpy(&v, (uint8_t *)&stats + fields[i].offset, sizeof(v));
+        if (JS_DefinePropertyValueStr(ctx, obj, fields[i].name,
+                                      JS_NewInt64(ctx, v),
+                                      JS_PROP_C_W_E) < 0) {
+            JS_FreeValue(ctx, obj);
+            return JS_EXCEPTION;
+        }
+    }
+    return obj;
+}
+
 static int interrupt_handler(JSRuntime *rt, void *opaque)
 {
     return (os_pending_signals >> SIGINT) & 1;
@@ -1892,6 +1963,166 @@ static JSValue js_std_urlGet(JSContext *ctx, JSValueConst this_val,
 }
 #endif // !defined(__wasi__)
 
+/* JSONParser */
+
+typedef struct {
+    JSValue func;
+    JSJSONParser *parser;
+} JSSTDJSONParser;
+
+static void js_std_json_parser_finalizer(JSRuntime *rt, JSValueConst val)
+{
+    JSThreadState *ts = js_get_thread_state(rt);
+    JSSTDJSONParser *s = JS_GetOpaque(val, ts->std_json_parser_class_id);
+    if (s) {
+        JS_FreeJSONParser(rt, s->parser);
+        JS_FreeValueRT(rt, s->func);
+        js_free_rt(rt, s);
+    }
+}
+
+static void js_std_json_parser_mark(JSRuntime *rt, JSValueConst val,
+                                    JS_MarkFunc *mark_func)
+{
+    JSThreadState *ts = js_get_thread_state(rt);
+    JSSTDJSONParser *s = JS_GetOpaque(val, ts->std_json_parser_class_id);
+    if (s)
+        JS_MarkValue(rt, s->func, mark_func);
+}
+
+static JSClassDef js_std_json_parser_class = {
+    "JSONParser",
+    .finalizer = js_std_json_parser_finalizer,
+    .gc_mark = js_std_json_parser_mark,
+};
+
+static int js_std_json_parser_cb(JSContext *ctx, JSValueConst key,
+                                 JSValueConst value, int depth, void *opaque)
+{
+    JSSTDJSONParser *s = opaque;
+    JSValueConst args[3];
+    JSValue func, ret;
+
+    args[0] = value;
+    args[1] = key;
+    args[2] = JS_NewInt32(ctx, depth);
+    /* 'func' is kept alive if the parser is freed by the callback */
+    func = JS_DupValue(ctx, s->func);
+    ret = JS_Call(ctx, func, JS_UNDEFINED, countof(args), args);
+    JS_FreeValue(ctx, func);
+    if (JS_IsException(ret))
+        return -1;
+    JS_FreeValue(ctx, ret);
+    return 0;
+}
+
+static JSValue js_std_json_parser_ctor(JSContext *ctx, JSValueConst new_target,
+                                       int argc, JSValueConst *argv)
+{
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    JSThreadState *ts = js_get_thread_state(rt);
+    JSValue obj = JS_UNDEFINED, proto, val;
+    JSSTDJSONParser *s;
+    int32_t depth;
+
+    if (!JS_IsFunction(ctx, argv[0]))
+        return JS_ThrowTypeError(ctx, "not a function");
+    depth = 0;
+    if (argc > 1 && JS_IsObject(argv[1])) {
+        val = JS_GetPropertyStr(ctx, argv[1], "depth");
+        if (JS_IsException(val))
+            return JS_EXCEPTION;
+        if (!JS_IsUndefined(val) && JS_ToInt32(ctx, &depth, val)) {
+            JS_FreeValue(ctx, val);
+            return JS_EXCEPTION;
+        }
+        JS_FreeValue(ctx, val);
+    }
+
+    proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+    if (JS_IsException(proto))
+        goto fail;
+    obj = JS_NewObjectProtoClass(ctx, proto, ts->std_json_parser_class_id);
+    JS_FreeValue(ctx, proto);
+    if (JS_IsException(obj))
+        goto fail;
+    s = js_mallocz(ctx, sizeof(*s));
+    if (!s)
+        goto fail;
+    s->func = JS_DupValue(ctx, argv[0]);
+    JS_SetOpaque(obj, s);
+    s->parser = JS_NewJSONParser(ctx, depth, js_std_json_parser_cb, s);
+    if (!s->parser)
+        goto fail;
+    return obj;
+ fail:
+    JS_FreeValue(ctx, obj);
+    return JS_EXCEPTION;
+}
+
+static JSValue js_std_json_parser_write(JSContext *ctx, JSValueConst this_val,
+                                        int argc, JSValueConst *argv)
+{
+    JSThreadState *ts = js_get_thread_state(JS_GetRuntime(ctx));
+    JSSTDJSONParser *s = JS_GetOpaque2(ctx, this_val, ts->std_json_parser_class_id);
+    const char *str;
+    uint8_t *buf;
+    size_t len, offset, size;
+    JSValue abuf;
+    int ret;
+
+    if (!s)
+        return JS_EXCEPTION;
+    if (JS_IsString(argv[0])) {
+        str = JS_ToCStringLen(ctx, &len, argv[0]);
+        if (!str)
+            return JS_EXCEPTION;
+        ret = JS_WriteJSONParser(s->parser, str, len);
+        JS_FreeCString(ctx, str);
+    } else {
+        if (JS_IsArrayBuffer(argv[0])) {
+            abuf = JS_DupValue(ctx, argv[0]);
+            offset = 0;
+            len = -1;
+        } else {
+            abuf = JS_GetTypedArrayBuffer(ctx, argv[0], &offset, &len, NULL);
+            if (JS_IsException(abuf))
+                return JS_EXCEPTION;
+        }
+        buf = JS_GetArrayBuffer(ctx, &size, abuf);
+        if (!buf) {
+            JS_FreeValue(ctx, abuf);
+            return JS_EXCEPTION;
+        }
+        if (len == (size_t)-1)
+            len = size;
+        /* the buffer is not accessed by the callbacks */
+        ret = JS_WriteJSONParser(s->parser, (const char *)buf + offset, len);
+        JS_FreeValue(ctx, abuf);
+    }
+    if (ret < 0)
+        return JS_EXCEPTION;
+    return JS_UNDEFINED;
+}
+
+static JSValue js_std_json_parser_end(JSContext *ctx, JSValueConst this_val,
+                                      int argc, JSValueConst *argv)
+{
+    JSThreadState *ts = js_get_thread_state(JS_GetRuntime(ctx));
+    JSSTDJSONParser *s = JS_GetOpaque2(ctx, this_val, ts->std_json_parser_class_id);
+
+    if (!s)
+        return JS_EXCEPTION;
+    if (JS_EndJSONParser(s->parser) < 0)
+        return JS_EXCEPTION;
+    return JS_UNDEFINED;
+}
+
+static const JSCFunctionListEntry js_std_json_parser_proto_funcs[] = {
+    JS_CFUNC_DEF("write", 1, js_std_json_parser_write ),
+    JS_CFUNC_DEF("end", 0, js_std_json_parser_end ),
+};
+
 static JSClassDef js_std_file_class = {
     "FILE",
     .finalizer = js_std_file_finalizer,
@@ -1917,6 +2148,7 @@ static const JSCFunctionListEntry js_std_error_props[] = {
 static const JSCFunctionListEntry js_std_funcs[] = {
     JS_CFUNC_DEF("exit", 1, js_std_exit ),
     JS_CFUNC_DEF("gc", 0, js_std_gc ),
+    JS_CFUNC_DEF("memoryUsage", 0, js_std_memoryUsage ),
     JS_CFUNC_DEF("evalScript", 1, js_evalScript ),
     JS_CFUNC_DEF("loadScript", 1, js_loadScript ),
     JS_CFUNC_DEF("getenv", 1, js_std_getenv ),
@@ -1970,7 +2202,7 @@ static const JSCFunctionListEntry js_std_file_proto_funcs[] = {
 
 static int js_std_init(JSContext *ctx, JSModuleDef *m)
 {
-    JSValue proto;
+    JSValue proto, obj;
     JSRuntime *rt = JS_GetRuntime(ctx);
     JSThreadState *ts = js_get_thread_state(rt);
 
@@ -1984,6 +2216,18 @@ static int js_std_init(JSContext *ctx, JSModuleDef *m)
                                countof(js_std_file_proto_funcs));
     JS_SetClassProto(ctx, ts->std_file_class_id, proto);
 
+    /* JSONParser class */
+    JS_NewClassID(rt, &ts->std_json_parser_class_id);
+    JS_NewClass(rt, ts->std_json_parser_class_id, &js_std_json_parser_class);
+    proto = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, proto, js_std_json_parser_proto_funcs,
+                               countof(js_std_json_parser_proto_funcs));
+    obj = JS_NewCFunction2(ctx, js_std_json_parser_ctor, "JSONParser", 1,
+                           JS_CFUNC_constructor, 0);
+    JS_SetConstructor(ctx, obj, proto);
+    JS_SetClassProto(ctx, ts->std_json_parser_class_id, proto);
+    JS_SetModuleExport(ctx, m, "JSONParser", obj);
+
     JS_SetModuleExportList(ctx, m, js_std_funcs,
                            countof(js_std_funcs));
     JS_SetModuleExport(ctx, m, "in", js_new_std_file(ctx, stdin, false));
@@ -2002,6 +2246,7 @@ JSModuleDef *js_init_module_std(JSContext *ctx, const char *module_name)
     JS_AddModuleExport(ctx, m, "in");
     JS_AddModuleExport(ctx, m, "out");
     JS_AddModuleExport(ctx, m, "err");
+    JS_AddModuleExport(ctx, m, "JSONParser");
     return m;
 }
 
@@ -2267,19 +2512,59 @@ static bool is_main_thread(JSRuntime *rt)
 static JSOSRWHandler *find_rh(JSThreadState *ts, int fd)
 {
     JSOSRWHandler *rh;
-    struct list_head *el;
 
-    list_for_each(el, &ts->os_rw_handlers) {
-        rh = list_entry(el, JSOSRWHandler, link);
+    if (!ts->rw_handler_hash)
+        return NULL;
+    rh = ts->rw_handler_hash[(uint32_t)fd & (ts->rw_handler_hash_size - 1)];
+    for(; rh != NULL; rh = rh->hash_next) {
         if (rh->fd == fd)
             return rh;
     }
     return NULL;
 }
 
+static int add_rw_handler(JSContext *ctx, JSThreadState *ts,
+                          JSOSRWHandler *rh)
+{
+    JSOSRWHandler **new_hash, *rh1, *next;
+    uint32_t i, h, new_size;
+
+    if (ts->rw_handler_count >= ts->rw_handler_hash_size) {
+        new_size = max_int(ts->rw_handler_hash_size * 2, 16);
+        new_hash = js_mallocz(ctx, sizeof(new_hash[0]) * new_size);
+        if (!new_hash)
+            return -1;
+        for(i = 0; i < ts->rw_handler_hash_size; i++) {
+            for(rh1 = ts->rw_handler_hash[i]; rh1 != NULL; rh1 = next) {
+                next = rh1->hash_next;
+                h = (uint32_t)rh1->fd & (new_size - 1);
+                rh1->hash_next = new_hash[h];
+                new_hash[h] = rh1;
+            }
+        }
+        js_free(ctx, ts->rw_handler_hash);
+        ts->rw_handler_hash = new_hash;
+        ts->rw_handler_hash_size = new_size;
+    }
+    h = (uint32_t)rh->fd & (ts->rw_handler_hash_size - 1);
+    rh->hash_next = ts->rw_handler_hash[h];
+    ts->rw_handler_hash[h] = rh;
+    ts->rw_handler_count++;
+    list_add_tail(&rh->link, &ts->os_rw_handlers);
+    return 0;
+}
+
 static void free_rw_handler(JSRuntime *rt, JSOSRWHandler *rh)
 {
+    JSThreadState *ts = js_get_thread_state(rt);
+    JSOSRWHandler **prh;
     int i;
+
+    prh = &ts->rw_handler_hash[(uint32_t)rh->fd & (ts->rw_handler_hash_size - 1)];
+    while (*prh != rh)
+        prh = &(*prh)->hash_next;
+    *prh = rh->hash_next;
+    ts->rw_handler_count--;
     list_del(&rh->link);
     for(i = 0; i < 2; i++) {
         JS_FreeValueRT(rt, rh->rw_func[i]);
@@ -2287,6 +2572,83 @@ static void free_rw_handler(JSRuntime *rt, JSOSRWHandler *rh)
     js_free_rt(rt, rh);
 }
 
+#ifdef USE_EPOLL
+static void rebuild_epoll_set(JSThreadState *ts);
+
+/* update the epoll registration of 'rh' after its handlers changed */
+static void update_rw_handler_events(JSThreadState *ts, JSOSRWHandler *rh)
+{
+    struct epoll_event ev;
+    uint32_t events;
+    int ret;
+
+    if (ts->epoll_fd < 0)
+        return;
+    events = EPOLLIN * !JS_IsNull(rh->rw_func[0]) |
+        EPOLLOUT * !JS_IsNull(rh->rw_func[1]);
+    if (rh->polled) {
+        if (!events) {
+            rh->polled = false;
+            ts->polled_rw_handler_count--;
+        }
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    /* not 'rh': the registration outlives it if the fd was closed while
+       a duplicate keeps the file open */
+    ev.data.fd = rh->fd;
+    if (!events) {
+        if (rh->registered) {
+            rh->registered = false;
+            /* fails if the fd was closed: the registration stays as long
+               as a duplicate keeps the file open */
+            if (epoll_ctl(ts->epoll_fd, EPOLL_CTL_DEL, rh->fd, &ev) < 0)
+                rebuild_epoll_set(ts);
+        }
+        return;
+    }
+    ret = epoll_ctl(ts->epoll_fd, EPOLL_CTL_ADD, rh->fd, &ev);
+    if (ret < 0 && errno == EEXIST) {
+        ret = epoll_ctl(ts->epoll_fd, EPOLL_CTL_MOD, rh->fd, &ev);
+    } else if (rh->registered) {
+        /* the fd was closed with its handler set and maybe reused: the
+           old file may still be registered with the same data.fd */
+        rebuild_epoll_set(ts);
+        return;
+    }
+    if (ret < 0) {
+        /* poll() reports regular files as ready and invalid fds with
+           POLLNVAL, so it handles the fds which epoll rejects */
+        epoll_ctl(ts->epoll_fd, EPOLL_CTL_DEL, rh->fd, &ev);
+        rh->polled = true;
+        ts->polled_rw_handler_count++;
+    } else {
+        rh->registered = true;
+    }
+}
+
+/* Recreate the epoll set. It is the only way to remove the registrations
+   of the fds closed before their handler while a duplicate keeps the
+   file open. */
+static void rebuild_epoll_set(JSThreadState *ts)
+{
+    struct list_head *el;
+    JSOSRWHandler *rh;
+
+    close(ts->epoll_fd);
+    ts->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    list_for_each(el, &ts->os_rw_handlers) {
+        rh = list_entry(el, JSOSRWHandler, link);
+        rh->registered = false;
+    }
+    list_for_each(el, &ts->os_rw_handlers) {
+        rh = list_entry(el, JSOSRWHandler, link);
+        update_rw_handler_events(ts, rh);
+    }
+}
+#endif
+
 static JSValue js_os_setReadHandler(JSContext *ctx, JSValueConst this_val,
                                     int argc, JSValueConst *argv, int magic)
 {
@@ -2304,6 +2666,9 @@ static JSValue js_os_setReadHandler(JSContext *ctx, JSValueConst this_val,
         if (rh) {
             JS_FreeValue(ctx, rh->rw_func[magic]);
             rh->rw_func[magic] = JS_NULL;
+#ifdef USE_EPOLL
+            update_rw_handler_events(ts, rh);
+#endif
             if (JS_IsNull(rh->rw_func[0]) &&
                 JS_IsNull(rh->rw_func[1])) {
                 /* remove the entry */
@@ -2321,10 +2686,16 @@ static JSValue js_os_setReadHandler(JSContext *ctx, JSValueConst this_val,
             rh->fd = fd;
             rh->rw_func[0] = JS_NULL;
             rh->rw_func[1] = JS_NULL;
-            list_add_tail(&rh->link, &ts->os_rw_handlers);
+            if (add_rw_handler(ctx, ts, rh)) {
+                js_free(ctx, rh);
+                return JS_EXCEPTION;
+            }
         }
         JS_FreeValue(ctx, rh->rw_func[magic]);
         rh->rw_func[magic] = JS_DupValue(ctx, func);
+#ifdef USE_EPOLL
+        update_rw_handler_events(ts, rh);
+#endif
     }
     return JS_UNDEFINED;
 }
@@ -2671,33 +3042,106 @@ static void js_waker_close(JSWaker *w)
 #endif // _WIN32
 
 static void js_free_message(JSWorkerMessage *msg);
+static JSWorkerMessagePipe *js_dup_message_pipe(JSWorkerMessagePipe *ps);
+static void js_free_message_pipe(JSWorkerMessagePipe *ps);
+
+/* can be called from any thread. The receiver is only woken up when
+   the stack was empty. */
+static void js_post_message(JSWorkerMessagePipe *ps, JSWorkerMessage *msg)
+{
+    JSWorkerMessage *head;
 
-/* return 1 if a message was handled, 0 if no message */
+    head = atomic_load(&ps->msg_head);
+    do {
+        msg->next = head;
+    } while (!atomic_compare_exchange_strong(&ps->msg_head, &head, msg));
+    if (!head)
+        js_waker_signal(&ps->waker);
+}
+
+/* move the posted messages to 'msg_queue' */
+static void js_fetch_posted_messages(JSWorkerMessagePipe *ps)
+{
+    JSWorkerMessage *msg, *next;
+    struct list_head *tail;
+
+    /* must be cleared before taking the stack so that the messages
+       posted after it signal the waker again */
+    js_waker_clear(&ps->waker);
+    msg = atomic_exchange(&ps->msg_head, NULL);
+    /* the stack is in reverse posting order */
+    tail = ps->msg_queue.prev;
+    while (msg) {
+        next = msg->next;
+        list_add(&msg->link, tail);
+        msg = next;
+    }
+}
+
+static JSWorkerMessageHandler *find_port(JSThreadState *ts,
+                                         JSWorkerMessagePipe *ps)
+{
+    struct list_head *el;
+    list_for_each(el, &ts->port_list) {
+        JSWorkerMessageHandler *port = list_entry(el, JSWorkerMessageHandler, link);
+        if (port->recv_pipe == ps && !JS_IsNull(port->on_message_func))
+            return port;
+    }
+    return NULL;
+}
+
+/* handle the messages received so far until a handler queues promise
+   jobs, which must run before the next message. Return 1 if a message
+   was handled, 0 if no message */
 static int handle_posted_message(JSRuntime *rt, JSContext *ctx,
                                  JSWorkerMessageHandler *port)
 {
-    JSWorkerMessagePipe *ps = port->recv_pipe;
+    JSThreadState *ts = js_get_thread_state(rt);
+    JSWorkerMessagePipe *ps;
     int ret;
-    struct list_head *el;
     JSWorkerMessage *msg;
     JSValue obj, data_obj, func, retval;
+    JSValue *transfer_tab;
+    size_t i, n;
 
-    js_mutex_lock(&ps->mutex);
-    if (!list_empty(&ps->msg_queue)) {
-        el = ps->msg_queue.next;
-        msg = list_entry(el, JSWorkerMessage, link);
+    /* the handlers may free 'port' and its reference to the pipe */
+    ps = js_dup_message_pipe(port->recv_pipe);
+    js_fetch_posted_messages(ps);
+    ret = 0;
+    while (!list_empty(&ps->msg_queue)) {
+        msg = list_entry(ps->msg_queue.next, JSWorkerMessage, link);
 
         /* remove the message from the queue */
         list_del(&msg->link);
 
-        // drain read end of pipe
-        if (list_empty(&ps->msg_queue))
-            js_waker_clear(&ps->waker);
-
-        js_mutex_unlock(&ps->mutex);
-
-        data_obj = JS_ReadObject(ctx, msg->data, msg->data_len,
-                                 JS_READ_OBJ_SAB | JS_READ_OBJ_REFERENCE);
+        /* receive the transferred ArrayBuffers first so that the
+           serialized data can reference them */
+        transfer_tab = NULL;
+        n = 0;
+        if (msg->transfer_tab_len > 0) {
+            transfer_tab = js_malloc(ctx, sizeof(transfer_tab[0]) *
+                                     msg->transfer_tab_len);
+            if (!transfer_tab) {
+                js_free_message(msg);
+                goto fail;
+            }
+            for(n = 0; n < msg->transfer_tab_len; n++) {
+                transfer_tab[n] = JS_NewTransferredArrayBuffer(ctx, msg->transfer_tab[n]);
+                msg->transfer_tab[n] = NULL;
+                if (JS_IsException(transfer_tab[n]))
+                    break;
+            }
+        }
+        if (n < msg->transfer_tab_len) {
+            data_obj = JS_EXCEPTION;
+        } else {
+            data_obj = JS_ReadObject3(ctx, msg->data, msg->data_len,
+                                      JS_READ_OBJ_SAB | JS_READ_OBJ_REFERENCE,
+                                      NULL, (JSValueConst *)transfer_tab, n);
+        }
+        for(i = 0; i < n; i++)
+            JS_FreeValue(ctx, transfer_tab[i]);
+        js_free(ctx, transfer_tab);
 
         js_free_message(msg);
 
@@ -2723,10 +3167,17 @@ static int handle_posted_message(JSRuntime *rt, JSContext *ctx,
             JS_FreeValue(ctx, retval);
         }
         ret = 1;
-    } else {
-        js_mutex_unlock(&ps->mutex);
-        ret = 0;
+        /* return to the event loop to run the jobs */
+        if (JS_IsJobPending(rt) || !list_empty(&ts->rejected_promise_list))
+            break;
+        port = find_port(ts, ps);
+        if (!port)
+            break;
     }
+    /* keep the remaining messages for the next call */
+    if (!list_empty(&ps->msg_queue))
+        js_waker_signal(&ps->waker);
+    js_free_message_pipe(ps);
     return ret;
 }
 
@@ -2830,6 +3281,134 @@ int js_std_poll_io(JSContext *ctx, int timeout_ms)
     return ret;
 }
 #else // !defined(_WIN32)
+#ifdef USE_EPOLL
+static int call_rw_handler(JSContext *ctx, JSOSRWHandler *rh, bool readable,
+                           bool writable)
+{
+    if (readable && !JS_IsNull(rh->rw_func[0]))
+        return call_handler(ctx, rh->rw_func[0]);
+    if (writable && !JS_IsNull(rh->rw_func[1]))
+        return call_handler(ctx, rh->rw_func[1]);
+    return 0;
+}
+
+/* The fds of the read/write handlers stay registered in ts->epoll_fd,
+   so a loop iteration does not depend on their number. The fds which
+   epoll does not support and the worker message pipes (a few at most)
+   are waited for with poll() together with ts->epoll_fd. */
+static int js_os_epoll_internal(JSContext *ctx, JSThreadState *ts,
+                                int min_delay, int flags)
+{
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    struct epoll_event ev;
+    struct list_head *el;
+    struct pollfd *pfd, *pfds, pfds_local[64];
+    JSOSRWHandler *rh;
+    int r, w, ret, nfds;
+
+    nfds = ts->polled_rw_handler_count;
+#ifdef USE_WORKER
+    if (flags & JS_OS_POLL_WORKERS) {
+        list_for_each(el, &ts->port_list) {
+            JSWorkerMessageHandler *port = list_entry(el, JSWorkerMessageHandler, link);
+            nfds += !JS_IsNull(port->on_message_func);
+        }
+    }
+#endif // USE_WORKER
+
+    ret = 0;
+    pfds = pfds_local;
+    if (nfds > 0) {
+        nfds++; /* for ts->epoll_fd */
+        pfd = pfds;
+        if (nfds > (int)countof(pfds_local)) {
+            pfd = pfds = js_malloc(ctx, nfds * sizeof(*pfd));
+            if (!pfd)
+                return -1;
+        }
+        *pfd++ = (struct pollfd){ts->epoll_fd, POLLIN, 0};
+        if (ts->polled_rw_handler_count > 0) {
+            list_for_each(el, &ts->os_rw_handlers) {
+                rh = list_entry(el, JSOSRWHandler, link);
+                if (rh->polled) {
+                    r = POLLIN * !JS_IsNull(rh->rw_func[0]);
+                    w = POLLOUT * !JS_IsNull(rh->rw_func[1]);
+                    *pfd++ = (struct pollfd){rh->fd, r|w, 0};
+                }
+            }
+        }
+#ifdef USE_WORKER
+        if (flags & JS_OS_POLL_WORKERS) {
+            list_for_each(el, &ts->port_list) {
+                JSWorkerMessageHandler *port = list_entry(el, JSWorkerMessageHandler, link);
+                if (!JS_IsNull(port->on_message_func)) {
+                    JSWorkerMessagePipe *ps = port->recv_pipe;
+                    *pfd++ = (struct pollfd){ps->waker.read_fd, POLLIN, 0};
+                }
+            }
+        }
+#endif // USE_WORKER
+        nfds = poll(pfds, nfds, min_delay);
+        if (nfds < 0) {
+            ret = -1;
+            goto done;
+        }
+        nfds -= (pfds[0].revents != 0);
+        for (pfd = pfds + 1; nfds > 0; pfd++) {
+            if (!pfd->revents)
+                continue;
+            nfds--;
+            rh = find_rh(ts, pfd->fd);
+            if (rh) {
+                ret = call_rw_handler(ctx, rh,
+                                      pfd->revents & (POLLERR|POLLHUP|POLLNVAL|POLLIN),
+                                      pfd->revents & (POLLERR|POLLHUP|POLLNVAL|POLLOUT));
+                goto done;
+                /* must stop because the list may have been modified */
+            }
+#ifdef USE_WORKER
+            else if (flags & JS_OS_POLL_WORKERS) {
+                list_for_each(el, &ts->port_list) {
+                    JSWorkerMessageHandler *port = list_entry(el, JSWorkerMessageHandler, link);
+                    if (!JS_IsNull(port->on_message_func)) {
+                        JSWorkerMessagePipe *ps = port->recv_pipe;
+                        if (pfd->fd == ps->waker.read_fd) {
+                            if (handle_posted_message(rt, ctx, port))
+                                goto done;
+                        }
+                    }
+                }
+            }
+#endif // USE_WORKER
+        }
+        if (!pfds[0].revents)
+            goto done;
+        min_delay = 0;
+    }
+
+    /* only one event so that the handler cannot invalidate the others */
+    nfds = epoll_wait(ts->epoll_fd, &ev, 1, min_delay);
+    if (nfds < 0) {
+        ret = -1;
+        goto done;
+    }
+    if (nfds > 0) {
+        rh = find_rh(ts, ev.data.fd);
+        if (rh) {
+            ret = call_rw_handler(ctx, rh, ev.events & (EPOLLERR|EPOLLHUP|EPOLLIN),
+                                  ev.events & (EPOLLERR|EPOLLHUP|EPOLLOUT));
+        } else {
+            /* stale registration of a closed fd: the event is dropped */
+            rebuild_epoll_set(ts);
+        }
+    }
+done:
+    if (pfds != pfds_local)
+        js_free(ctx, pfds);
+    return ret;
+}
+#endif // USE_EPOLL
+
 static int js_os_poll_internal(JSContext *ctx, int timeout_ms, int flags)
 {
     JSRuntime *rt = JS_GetRuntime(ctx);
@@ -2868,6 +3447,11 @@ static int js_os_poll_internal(JSContext *ctx, int timeout_ms, int flags)
                 return -1; /* no more events */
     }
 
+#ifdef USE_EPOLL
+    if (ts->epoll_fd >= 0 && !list_empty(&ts->os_rw_handlers))
+        return js_os_epoll_internal(ctx, ts, min_delay, flags);
+#endif
+
     nfds = 0;
     list_for_each(el, &ts->os_rw_handlers) {
         rh = list_entry(el, JSOSRWHandler, link);
@@ -2933,7 +3517,11 @@ static int js_os_poll_internal(JSContext *ctx, int timeout_ms, int flags)
         ret = -1;
         goto done;
     }
-    for (pfd = pfds; nfds-- > 0; pfd++) {
+    for (pfd = pfds; nfds > 0; pfd++) {
+        /* 'nfds' is the number of fds with events, not their position */
+        if (!pfd->revents)
+            continue;
+        nfds--;
         rh = find_rh(ts, pfd->fd);
         if (rh) {
             r = (POLLERR|POLLHUP|POLLNVAL|POLLIN) * !JS_IsNull(rh->rw_func[0]);
@@ -3984,8 +4572,8 @@ static JSWorkerMessagePipe *js_new_message_pipe(void)
         return NULL;
     }
     ps->ref_count = 1;
+    ps->msg_head = NULL;
     init_list_head(&ps->msg_queue);
-    js_mutex_init(&ps->mutex);
     return ps;
 }
 
@@ -4003,14 +4591,18 @@ static void js_free_message(JSWorkerMessage *msg)
         js_sab_free(NULL, msg->sab_tab[i]);
     }
     free(msg->sab_tab);
-    free(msg->data);
+    /* free the transferred ArrayBuffers which were not received */
+    for(i = 0; i < msg->transfer_tab_len; i++) {
+        JS_FreeTransferredArrayBuffer(msg->transfer_tab[i]);
+    }
+    free(msg->transfer_tab);
     free(msg);
 }
 
 static void js_free_message_pipe(JSWorkerMessagePipe *ps)
 {
     struct list_head *el, *el1;
-    JSWorkerMessage *msg;
+    JSWorkerMessage *msg, *next;
     int ref_count;
 
     if (!ps)
@@ -4019,11 +4611,14 @@ static void js_free_message_pipe(JSWorkerMessagePipe *ps)
     ref_count = atomic_add_int(&ps->ref_count, -1);
     assert(ref_count >= 0);
     if (ref_count == 0) {
+        for(msg = ps->msg_head; msg != NULL; msg = next) {
+            next = msg->next;
+            js_free_message(msg);
+        }
         list_for_each_safe(el, el1, &ps->msg_queue) {
             msg = list_entry(el, JSWorkerMessage, link);
             js_free_message(msg);
         }
-        js_mutex_destroy(&ps->mutex);
         js_waker_close(&ps->waker);
         free(ps);
     }
@@ -4230,31 +4825,74 @@ static JSValue js_worker_postMessage(JSContext *ctx, JSValueConst this_val,
     JSRuntime *rt = JS_GetRuntime(ctx);
     JSThreadState *ts = js_get_thread_state(rt);
     JSWorkerData *worker = JS_GetOpaque2(ctx, this_val, ts->worker_class_id);
-    JSWorkerMessagePipe *ps;
-    size_t data_len, i;
+    size_t data_len, i, j, size;
     uint8_t *data;
     JSWorkerMessage *msg;
     JSSABTab sab_tab;
+    JSValue *transfer_tab;
+    int64_t len;
+    uint32_t transfer_len;
 
     if (!worker)
         return JS_EXCEPTION;
 
-    data = JS_WriteObject2(ctx, &data_len, argv[0],
+    /* optional list of the ArrayBuffers whose contents are moved to
+       the receiver instead of being copied */
+    transfer_tab = NULL;
+    transfer_len = 0;
+    if (argc > 1 && !JS_IsUndefined(argv[1])) {
+        if (!JS_IsArray(argv[1]))
+            return JS_ThrowTypeError(ctx, "transfer list must be an array");
+        if (JS_GetLength(ctx, argv[1], &len))
+            return JS_EXCEPTION;
+        if (len > UINT32_MAX)
+            return JS_ThrowRangeError(ctx, "transfer list too long");
+        if (len > 0) {
+            transfer_tab = js_malloc(ctx, sizeof(transfer_tab[0]) * len);
+            if (!transfer_tab)
+                return JS_EXCEPTION;
+        }
+        for(transfer_len = 0; transfer_len < len; transfer_len++) {
+            transfer_tab[transfer_len] = JS_GetPropertyUint32(ctx, argv[1],
+                                                              transfer_len);
+            if (JS_IsException(transfer_tab[transfer_len]))
+                goto fail_transfer;
+        }
+        for(i = 0; i < transfer_len; i++) {
+            if (!JS_IsArrayBuffer(transfer_tab[i])) {
+                JS_ThrowTypeError(ctx, "only ArrayBuffers can be transferred");
+                goto fail_transfer;
+            }
+            if (!JS_GetArrayBuffer(ctx, &size, transfer_tab[i]))
+                goto fail_transfer; /* detached */
+            if (JS_IsImmutableArrayBuffer(transfer_tab[i])) {
+                JS_ThrowTypeError(ctx, "immutable ArrayBuffers cannot be transferred");
+                goto fail_transfer;
+            }
+            for(j = 0; j < i; j++) {
+                if (JS_IsStrictEqual(ctx, transfer_tab[i], transfer_tab[j])) {
+                    JS_ThrowTypeError(ctx, "duplicate ArrayBuffer in transfer list");
+                    goto fail_transfer;
+                }
+            }
+        }
+    }
+
+    data = JS_WriteObject3(ctx, &data_len, argv[0],
                            JS_WRITE_OBJ_SAB | JS_WRITE_OBJ_REFERENCE,
-                           &sab_tab);
+                           &sab_tab, (JSValueConst *)transfer_tab,
+                           transfer_len);
     if (!data)
-        return JS_EXCEPTION;
+        goto fail_transfer;
 
-    msg = malloc(sizeof(*msg));
+    /* must reallocate because the allocator may be different */
+    msg = malloc(sizeof(*msg) + data_len);
     if (!msg)
         goto fail;
-    msg->data = NULL;
     msg->sab_tab = NULL;
-
-    /* must reallocate because the allocator may be different */
-    msg->data = malloc(data_len);
-    if (!msg->data)
-        goto fail;
+    msg->transfer_tab = NULL;
+    msg->transfer_tab_len = 0;
+    msg->data = (uint8_t *)(msg + 1);
     memcpy(msg->data, data, data_len);
     msg->data_len = data_len;
 
@@ -4266,32 +4904,50 @@ static JSValue js_worker_postMessage(JSContext *ctx, JSValueConst this_val,
     }
     msg->sab_tab_len = sab_tab.len;
 
+    if (transfer_len > 0) {
+        msg->transfer_tab = malloc(sizeof(msg->transfer_tab[0]) * transfer_len);
+        if (!msg->transfer_tab)
+            goto fail;
+    }
+
     js_free(ctx, data);
     js_free(ctx, sab_tab.tab);
+    data = NULL;
+    sab_tab.tab = NULL;
 
     /* increment the SAB reference counts */
     for(i = 0; i < msg->sab_tab_len; i++) {
         js_sab_dup(NULL, msg->sab_tab[i]);
     }
 
-    ps = worker->send_pipe;
-    js_mutex_lock(&ps->mutex);
-    /* indicate that data is present */
-    if (list_empty(&ps->msg_queue))
-        js_waker_signal(&ps->waker);
-    list_add_tail(&msg->link, &ps->msg_queue);
-    js_mutex_unlock(&ps->mutex);
+    /* detach the transferred ArrayBuffers and take their contents */
+    for(i = 0; i < transfer_len; i++) {
+        msg->transfer_tab[i] = JS_TransferArrayBuffer(ctx, transfer_tab[i]);
+        if (!msg->transfer_tab[i]) {
+            msg->transfer_tab_len = i;
+            js_free_message(msg);
+            goto fail_transfer;
+        }
+    }
+    msg->transfer_tab_len = transfer_len;
+    for(i = 0; i < transfer_len; i++)
+        JS_FreeValue(ctx, transfer_tab[i]);
+    js_free(ctx, transfer_tab);
+
+    js_post_message(worker->send_pipe, msg);
     return JS_UNDEFINED;
  fail:
     if (msg) {
-        free(msg->data);
         free(msg->sab_tab);
         free(msg);
     }
     js_free(ctx, data);
     js_free(ctx, sab_tab.tab);
+ fail_transfer:
+    for(i = 0; i < transfer_len; i++)
+        JS_FreeValue(ctx, transfer_tab[i]);
+    js_free(ctx, transfer_tab);
     return JS_EXCEPTION;
-
 }
 
 static JSValue js_worker_set_onmessage(JSContext *ctx, JSValueConst this_val,
@@ -4631,6 +5287,11 @@ void js_std_add_helpers(JSContext *ctx, int argc, char **argv)
 static void js_std_finalize(JSRuntime *rt, void *arg)
 {
     JSThreadState *ts = arg;
+#ifdef USE_EPOLL
+    if (ts->epoll_fd >= 0)
+        close(ts->epoll_fd);
+#endif
+    js_free_rt(rt, ts->rw_handler_hash);
     js_set_thread_state(rt, NULL);
     js_free_rt(rt, ts);
 }
@@ -4651,6 +5312,9 @@ void js_std_init_handlers(JSRuntime *rt)
     init_list_head(&ts->rejected_promise_list);
 
     ts->next_timer_id = 1;
+#ifdef USE_EPOLL
+    ts->epoll_fd = epoll_create1(EPOLL_CLOEXEC); /* poll() is used if it fails */
+#endif
 
     js_set_thread_state(rt, ts);
     JS_AddRuntimeFinalizer(rt, js_std_finalize, ts);
@@ -4928,11 +5592,11 @@ JSValue js_std_await(JSContext *ctx, JSValue obj)
     return ret;
 }
 
-void js_std_eval_binary(JSContext *ctx, const uint8_t *buf, size_t buf_len,
-                        int load_only)
+static void js_std_eval_binary2(JSContext *ctx, const uint8_t *buf,
+                                size_t buf_len, int read_flags, int load_only)
 {
     JSValue obj, val;
-    obj = JS_ReadObject(ctx, buf, buf_len, JS_READ_OBJ_BYTECODE);
+    obj = JS_ReadObject(ctx, buf, buf_len, JS_READ_OBJ_BYTECODE | read_flags);
     if (JS_IsException(obj))
         goto exception;
     if (load_only) {
@@ -4963,6 +5627,89 @@ void js_std_eval_binary(JSContext *ctx, const uint8_t *buf, size_t buf_len,
     }
 }
 
+void js_std_eval_binary(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                        int load_only)
+{
+    js_std_eval_binary2(ctx, buf, buf_len, 0, load_only);
+}
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+} JSMappedFile;
+
+static void js_unmap_file(JSRuntime *rt, void *opaque)
+{
+    JSMappedFile *mf = opaque;
+#if defined(_WIN32) || defined(__wasi__)
+    free(mf->buf);
+#else
+    munmap(mf->buf, mf->len);
+#endif
+    free(mf);
+}
+
+/* map 'filename' read-only until the runtime is freed. Return NULL if
+   error. */
+static const uint8_t *js_map_file(JSContext *ctx, size_t *pbuf_len,
+                                  const char *filename)
+{
+    JSMappedFile *mf;
+
+    mf = malloc(sizeof(*mf));
+    if (!mf)
+        return NULL;
+#if defined(_WIN32) || defined(__wasi__)
+    mf->buf = js_load_file(NULL, &mf->len, filename);
+    if (!mf->buf)
+        goto fail;
+#else
+    {
+        struct stat st;
+        int fd;
+
+        fd = open(filename, O_RDONLY);
+        if (fd < 0)
+            goto fail;
+        if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+            close(fd);
+            goto fail;
+        }
+        mf->len = st.st_size;
+        mf->buf = mmap(NULL, mf->len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mf->buf == MAP_FAILED)
+            goto fail;
+    }
+#endif
+    if (JS_AddRuntimeFinalizer(JS_GetRuntime(ctx), js_unmap_file, mf) < 0) {
+        js_unmap_file(JS_GetRuntime(ctx), mf);
+        return NULL;
+    }
+    *pbuf_len = mf->len;
+    return mf->buf;
+ fail:
+    free(mf);
+    return NULL;
+}
+
+/* the file is mapped and read with JS_READ_OBJ_IN_PLACE so that the
+   runtimes loading it share its string constants and debug info */
+void js_std_eval_binary_file(JSContext *ctx, const char *filename,
+                             int load_only)
+{
+    const uint8_t *buf;
+    size_t buf_len = 0;
+
+    buf = js_map_file(ctx, &buf_len, filename);
+    if (!buf) {
+        JS_ThrowReferenceError(ctx, "could not load '%s'", filename);
+        js_std_dump_error(ctx);
+        exit(1);
+    }
+    js_std_eval_binary2(ctx, buf, buf_len, JS_READ_OBJ_IN_PLACE, load_only);
+}
+
 static JSValue js_bjson_read(JSContext *ctx, JSValueConst this_val,
                              int argc, JSValueConst *argv)
 {
@@ -4978,7 +5725,7 @@ static JSValue js_bjson_read(JSContext *ctx, JSValueConst this_val,
         return JS_EXCEPTION;
     if (JS_ToInt32(ctx, &flags, argv[3]))
         return JS_EXCEPTION;
-    flags &= ~JS_READ_OBJ_SAB;
+    flags &= ~(JS_READ_OBJ_SAB | JS_READ_OBJ_IN_PLACE);
     buf = JS_GetArrayBuffer(ctx, &size, argv[0]);
     if (!buf)
         return JS_EXCEPTION;
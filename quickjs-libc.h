@@ -68,6 +68,10 @@ JS_LIBC_EXTERN int js_module_check_attributes(JSContext *ctx, void *opaque,
                                               JSValueConst attributes);
 JS_LIBC_EXTERN void js_std_eval_binary(JSContext *ctx, const uint8_t *buf,
                                        size_t buf_len, int flags);
+// like js_std_eval_binary but for a file produced by `qjsc -b`; the file
+// stays mapped until the runtime is freed (see JS_READ_OBJ_IN_PLACE)
+JS_LIBC_EXTERN void js_std_eval_binary_file(JSContext *ctx,
+                                            const char *filename, int flags);
 JS_LIBC_EXTERN void js_std_promise_rejection_tracker(JSContext *ctx,
                                                      JSValueConst promise,
                                                      JSValueConst reason,
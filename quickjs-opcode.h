@@ -124,9 +124,9 @@ DEF(         regexp, 1, 2, 1, none) /* create a RegExp object from the pattern a
 DEF(      get_super, 1, 1, 1, none)
 DEF(         import, 1, 2, 1, none) /* dynamic module import */
 
-DEF(  get_var_undef, 5, 0, 1, atom) /* push undefined if the variable does not exist */
-DEF(        get_var, 5, 0, 1, atom) /* throw an exception if the variable does not exist */
-DEF(        put_var, 5, 1, 0, atom) /* must come after get_var */
+DEF(  get_var_undef, 7, 0, 1, atom_u16) /* push undefined if the variable does not exist */
+DEF(        get_var, 7, 0, 1, atom_u16) /* throw an exception if the variable does not exist */
+DEF(        put_var, 7, 1, 0, atom_u16) /* must come after get_var */
 DEF(   put_var_init, 5, 1, 0, atom) /* must come after put_var. Used to initialize a global lexical variable */
 
 DEF(  get_ref_value, 1, 2, 3, none)
@@ -136,10 +136,10 @@ DEF(     define_var, 6, 0, 0, atom_u8)
 DEF(check_define_var, 6, 0, 0, atom_u8)
 DEF(    define_func, 6, 1, 0, atom_u8)
 
-// order matters, see IC counterparts
-DEF(      get_field, 5, 1, 1, atom)
-DEF(     get_field2, 5, 1, 2, atom)
-DEF(      put_field, 5, 2, 0, atom)
+/* the u16 operand is the inline cache slot (see js_bytecode_init_ic()) */
+DEF(      get_field, 7, 1, 1, atom_u16)
+DEF(     get_field2, 7, 1, 2, atom_u16)
+DEF(      put_field, 7, 2, 0, atom_u16)
 
 DEF( get_private_field, 1, 2, 1, none) /* obj prop -> value */
 DEF( put_private_field, 1, 3, 0, none) /* obj value prop -> */
@@ -290,7 +290,7 @@ def(scope_get_private_field, 7, 1, 1, atom_u16) /* obj -> value, emitted in phas
 def(scope_get_private_field2, 7, 1, 2, atom_u16) /* obj -> obj value, emitted in phase 1, removed in phase 2 */
 def(scope_put_private_field, 7, 2, 0, atom_u16) /* obj value ->, emitted in phase 1, removed in phase 2 */
 def(scope_in_private_field, 7, 1, 1, atom_u16) /* obj -> res emitted in phase 1, removed in phase 2 */
-def(get_field_opt_chain, 5, 1, 1, atom) /* emitted in phase 1, removed in phase 2 */
+def(get_field_opt_chain, 7, 1, 1, atom_u16) /* emitted in phase 1, removed in phase 2 */
 def(get_array_el_opt_chain, 1, 2, 1, none) /* emitted in phase 1, removed in phase 2 */
 def( set_class_name, 5, 1, 1, u32) /* emitted in phase 1, removed in phase 2 */
 
@@ -355,7 +355,7 @@ DEF(   set_var_ref1, 1, 1, 1, none_var_ref)
 DEF(   set_var_ref2, 1, 1, 1, none_var_ref)
 DEF(   set_var_ref3, 1, 1, 1, none_var_ref)
 
-DEF(     get_length, 1, 1, 1, none)
+DEF(     get_length, 3, 1, 1, u16) /* u16: inline cache slot */
 
 DEF(      if_false8, 2, 1, 0, label8)
 DEF(       if_true8, 2, 1, 0, label8) /* must come after if_false8 */
@@ -372,6 +372,13 @@ DEF(        is_null, 1, 1, 1, none)
 DEF(typeof_is_undefined, 1, 1, 1, none)
 DEF( typeof_is_function, 1, 1, 1, none)
 
+/* quickened opcodes: never emitted by the compiler nor serialized. The
+   interpreter rewrites the generic opcode in place (see js_quicken()) */
+DEF(         lt_f64, 1, 2, 1, none) /* must be in the same order as lt */
+DEF(        lte_f64, 1, 2, 1, none)
+DEF(         gt_f64, 1, 2, 1, none)
+DEF(        gte_f64, 1, 2, 1, none)
+
 #undef DEF
 #undef def
 #endif  /* DEF */
@@ -48,6 +48,15 @@
 #include "libregexp.h"
 #include "dtoa.h"
 
+/* vector instructions used by the string search functions */
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JS_HAVE_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define JS_HAVE_NEON
+#endif
+
 #if defined(EMSCRIPTEN) || defined(_MSC_VER)
 #define DIRECT_DISPATCH  0
 #else
@@ -77,6 +86,13 @@
 #define CONFIG_ATOMICS
 #endif
 
+// the baseline JIT only emits x86-64 code for the System V ABI
+#if defined(QJS_ENABLE_JIT) && defined(__x86_64__) && !defined(_WIN32) && \
+    !JS_NAN_BOXING && !defined(JS_CHECK_JSVALUE)
+#include <sys/mman.h>
+#define CONFIG_JIT
+#endif
+
 #ifndef __GNUC__
 #define __extension__
 #endif
@@ -223,6 +239,9 @@ typedef enum JSErrorEnum {
 // 1,024 bytes is about the cutoff point where it starts getting
 // more profitable to ref slice than to copy
 #define JS_STRING_SLICE_LEN_MAX 1024 // in bytes
+// shorter strings are copied even with JS_READ_OBJ_IN_PLACE because
+// the header of a JS_STRING_KIND_ROM string is almost as large
+#define JS_STRING_ROM_LEN_MIN 16 // in bytes
 
 /* strings <= this length are not concatenated using ropes. if too
    small, the rope memory overhead becomes high. */
@@ -238,6 +257,7 @@ typedef struct JSShape JSShape;
 typedef struct JSString JSString;
 typedef struct JSString JSAtomStruct;
 typedef struct JSStringRope JSStringRope;
+typedef struct JSRegExpCacheEntry JSRegExpCacheEntry;
 
 #define JS_VALUE_GET_OBJ(v) ((JSObject *)JS_VALUE_GET_PTR(v))
 #define JS_VALUE_GET_STRING(v) ((JSString *)JS_VALUE_GET_PTR(v))
@@ -252,6 +272,7 @@ typedef enum {
 typedef struct JSMallocState {
     size_t malloc_count;
     size_t malloc_size;
+    size_t malloc_peak_size; /* highest value of malloc_size */
     size_t malloc_limit;
     void *opaque; /* user opaque */
 } JSMallocState;
@@ -291,7 +312,8 @@ typedef struct JSMallocBlockHeader {
     uint8_t  block_size_idx;
     /* GC/refcount header merged into the allocator header:
        the object body keeps only JSGCObjectHeader.link (no ref_count/flags). */
-    uint8_t  gc_obj_type : 7; /* JSGCObjectTypeEnum for GC objects */
+    uint8_t  gc_obj_type : 6; /* JSGCObjectTypeEnum for GC objects */
+    uint8_t  young : 1;       /* in JSRuntime.gc_young_obj_list */
     uint8_t  mark : 1;        /* used by the cycle collector */
     int      ref_count;
     _Alignas(JS_ARENA_ALIGN) uint8_t user_data[];
@@ -346,11 +368,27 @@ struct JSRuntime {
     /* list of JSGCObjectHeader.link. List of allocated GC objects (used
        by the garbage collector) */
     struct list_head gc_obj_list;
+    /* list of JSGCObjectHeader.link. GC objects allocated since the last
+       collection. They are moved to gc_obj_list when they survive it. */
+    struct list_head gc_young_obj_list;
     /* list of JSGCObjectHeader.link. Used during JS_FreeValueRT() */
     struct list_head gc_zero_ref_count_list;
-    struct list_head tmp_obj_list; /* used during GC */
+    /* used during GC. Not empty between two JS_RunGCStep() calls if
+       the garbage cycles are not all freed. */
+    struct list_head tmp_obj_list;
+    /* list of JSGCObjectHeader.link. Objects of the garbage cycles which
+       are freed but still referenced by the other objects of the
+       cycles */
+    struct list_head gc_zombie_obj_list;
     JSGCPhaseEnum gc_phase : 8;
     size_t malloc_gc_threshold;
+    /* above this size, all the GC objects are scanned instead of the
+       young ones */
+    size_t gc_major_threshold;
+    size_t gc_last_size; /* malloc_size after the last collection */
+    /* number of collections, reported by JS_ComputeMemoryUsage() */
+    int64_t gc_count;
+    int64_t gc_young_count;
 #ifdef ENABLE_DUMPS // JS_DUMP_LEAKS
     struct list_head string_list; /* list of JSString.link */
 #endif
@@ -371,6 +409,8 @@ struct JSRuntime {
 
     JSInterruptHandler *interrupt_handler;
     void *interrupt_opaque;
+    /* CPU profiler state, NULL if never started */
+    struct JSCPUProfile *cpu_profile;
 
     JSPromiseHook *promise_hook;
     void *promise_hook_opaque;
@@ -409,6 +449,14 @@ struct JSRuntime {
     int shape_hash_size;
     int shape_hash_count; /* number of hashed shapes */
     JSShape **shape_hash;
+    uint64_t shape_id_counter; /* last JSShape.id, 0 is never used */
+
+    /* cache of the compiled regexps (see js_compile_regexp()) */
+    struct list_head regexp_cache_list; /* LRU order, most recent first */
+    JSRegExpCacheEntry **regexp_cache_hash; /* NULL if not allocated */
+    int regexp_cache_count;
+    int64_t regexp_cache_hit_count;
+    int64_t regexp_cache_miss_count;
     void *user_opaque;
     void *libc_opaque;
     JSRuntimeFinalizerState *finalizers;
@@ -507,8 +555,36 @@ static inline JSMallocBlockHeader *js_rc(const void *p) {
 #define JS_REF_COUNT(p) (js_rc(p)->ref_count)
 #define JS_GC_TYPE(p)   (js_rc(p)->gc_obj_type)
 #define JS_GC_MARK(p)   (js_rc(p)->mark)
+#define JS_GC_YOUNG(p)  (js_rc(p)->young)
+
+/* return the GC object list containing 'h' */
+static inline struct list_head *gc_obj_list_of(JSRuntime *rt,
+                                               JSGCObjectHeader *h)
+{
+    return JS_GC_YOUNG(h) ? &rt->gc_young_obj_list : &rt->gc_obj_list;
+}
+
+static inline struct list_head *gc_obj_next(JSRuntime *rt,
+                                            struct list_head *el)
+{
+    el = el->next;
+    if (el == &rt->gc_obj_list)
+        el = rt->gc_young_obj_list.next;
+    return el;
+}
+
+/* iterate over the old then the young GC objects */
+#define gc_obj_for_each(el, rt)                                     \
+    for(el = gc_obj_next(rt, &(rt)->gc_obj_list);                   \
+        el != &(rt)->gc_young_obj_list; el = gc_obj_next(rt, el))
 
 /* bigint */
+
+/* The limb size follows the size of short_big_int in JSValueUnion */
+#define JS_LIMB_BITS JS_SHORT_BIG_INT_BITS
+
+#if JS_LIMB_BITS == 32
+
 typedef int32_t js_slimb_t;
 typedef uint32_t js_limb_t;
 typedef int64_t js_sdlimb_t;
@@ -516,13 +592,29 @@ typedef uint64_t js_dlimb_t;
 
 #define JS_LIMB_DIGITS 9
 
-/* Must match the size of short_big_int in JSValueUnion */
-#define JS_LIMB_BITS 32
-#define JS_SHORT_BIG_INT_BITS JS_LIMB_BITS
-#define JS_BIGINT_MAX_SIZE ((1024 * 1024) / JS_LIMB_BITS) /* in limbs */
 #define JS_SHORT_BIG_INT_MIN INT32_MIN
 #define JS_SHORT_BIG_INT_MAX INT32_MAX
 
+#else
+
+#if !defined(__SIZEOF_INT128__) || (defined(JS_NAN_BOXING) && JS_NAN_BOXING)
+#error "JS_SHORT_BIG_INT_BITS = 64 needs a 128 bit integer type and no NaN boxing"
+#endif
+
+typedef int64_t js_slimb_t;
+typedef uint64_t js_limb_t;
+typedef __int128 js_sdlimb_t;
+typedef unsigned __int128 js_dlimb_t;
+
+#define JS_LIMB_DIGITS 19
+
+#define JS_SHORT_BIG_INT_MIN INT64_MIN
+#define JS_SHORT_BIG_INT_MAX INT64_MAX
+
+#endif
+
+#define JS_BIGINT_MAX_SIZE ((1024 * 1024) / JS_LIMB_BITS) /* in limbs */
+
 
 typedef struct JSBigInt {
     uint32_t len; /* number of limbs, >= 1 */
@@ -554,6 +646,8 @@ enum {
 /* must be large enough to have a negligible runtime cost and small
    enough to call the interrupt callback often. */
 #define JS_INTERRUPT_COUNTER_INIT 10000
+/* interrupt counter used while the CPU profiler is running */
+#define JS_CPU_PROFILE_COUNTER_INIT 500
 
 struct JSContext {
     JSGCObjectHeader header; /* must come first */
@@ -643,10 +737,10 @@ typedef struct JSWeakRefRecord {
 
 typedef struct JSMapRecord {
     int ref_count; /* used during enumeration to avoid freeing the record */
+    uint32_t hash; /* map_hash_key() of the key */
     bool empty; /* true if the record is deleted */
     struct JSMapState *map;
     struct list_head link;
-    struct list_head hash_link;
     JSValue key;
     JSValue value;
 } JSMapRecord;
@@ -655,10 +749,12 @@ typedef struct JSMapState {
     bool is_weak; /* true if WeakSet/WeakMap */
     struct list_head records; /* list of JSMapRecord.link */
     uint32_t record_count;
-    struct list_head *hash_table;
-    uint32_t hash_size; /* must be a power of two */
-    uint32_t record_count_threshold; /* count at which a hash table
-                                        resize is needed */
+    /* open addressed index of the live records with linear probing. A
+       slot is NULL if free or MAP_TOMBSTONE if its record was deleted */
+    struct JSMapRecord **hash_table;
+    uint32_t hash_size; /* 0 or a power of two */
+    uint32_t hash_bits; /* log2(hash_size) */
+    uint32_t tombstone_count;
 } JSMapState;
 
 enum
@@ -689,6 +785,7 @@ typedef enum {
     JS_STRING_KIND_NORMAL,
     JS_STRING_KIND_SLICE,
     JS_STRING_KIND_INDIRECT,
+    JS_STRING_KIND_ROM, /* like INDIRECT but the data is not owned */
 } JSStringKind;
 
 #define JS_ATOM_HASH_MASK  ((1 << 28) - 1)
@@ -734,6 +831,7 @@ static inline void *strv(JSString *p)
         slice = (void *)&p[1];
         return (char *)&slice->parent[1] + slice->start;
     case JS_STRING_KIND_INDIRECT:
+    case JS_STRING_KIND_ROM:
         indirect = (void *)&p[1];
         return *indirect;
     }
@@ -852,6 +950,26 @@ typedef enum JSFunctionKindEnum {
     JS_FUNC_ASYNC_GENERATOR = (JS_FUNC_GENERATOR | JS_FUNC_ASYNC),
 } JSFunctionKindEnum;
 
+/* number of receiver shapes remembered by an inline cache slot */
+#define JS_IC_WAYS 4
+/* slot number of the property accesses which are not cached */
+#define JS_IC_SLOT_NONE 0xffff
+/* minimum number of cache misses before the caches of a function are
+   allocated */
+#define JS_IC_WARMUP 16
+
+typedef struct JSInlineCacheEntry {
+    uint64_t shape_id; /* receiver shape, 0 if the entry is free */
+    /* 0 if the property is owned by the receiver, otherwise shape of
+       the receiver prototype which holds it */
+    uint64_t holder_shape_id;
+    uint32_t prop_idx; /* index in JSObject.prop of the holder */
+} JSInlineCacheEntry;
+
+typedef struct JSInlineCache {
+    JSInlineCacheEntry entries[JS_IC_WAYS]; /* most recent first */
+} JSInlineCache;
+
 typedef struct JSFunctionBytecode {
     JSGCObjectHeader header; /* must come first */
     uint8_t is_strict_mode : 1;
@@ -866,7 +984,10 @@ typedef struct JSFunctionBytecode {
     uint8_t super_allowed : 1;
     uint8_t arguments_allowed : 1;
     uint8_t backtrace_barrier : 1; /* stop backtrace on this function */
-    /* XXX: 5 bits available */
+    uint8_t read_only_pc2line : 1; /* pc2line_buf is JS_READ_OBJ_IN_PLACE input */
+    /* XXX: 3 bits available */
+    /* number of quickened opcodes restored to their generic version */
+    uint8_t deopt_count;
     uint8_t *byte_code_buf; /* (self pointer) */
     int byte_code_len;
     JSAtom func_name;
@@ -888,8 +1009,65 @@ typedef struct JSFunctionBytecode {
     int pc2line_len;
     uint8_t *pc2line_buf;
     char *source;
+    /* inline caches of the property accesses, allocated when the
+       function is executed often enough (see js_ic_add()) */
+    int ic_count;
+    int ic_warmup;
+    JSInlineCache *ic;
+#ifdef CONFIG_JIT
+    uint16_t jit_counter; /* calls and loop iterations before compiling */
+    struct JSJITCode *jit; /* native code, NULL if not compiled */
+#endif
 } JSFunctionBytecode;
 
+#ifdef CONFIG_JIT
+/* number of calls and loop iterations before a function is compiled */
+#define JS_JIT_THRESHOLD 100
+/* larger functions are never compiled */
+#define JS_JIT_MAX_BYTECODE_LEN (64 * 1024)
+/* the functions without loops are compiled if they have at least
+   JS_JIT_MIN_INLINE_OPS inlined opcodes and if at most one opcode out
+   of JS_JIT_HELPER_RATIO calls js_jit_op() */
+#define JS_JIT_MIN_INLINE_OPS 24
+#define JS_JIT_HELPER_RATIO 16
+
+typedef struct JSJITCode {
+    uint8_t *code; /* executable mapping */
+    size_t code_size;
+    /* native offset of each opcode indexed by its position in the byte
+       code, 0 if the opcode is not translated */
+    uint32_t *pc_map;
+} JSJITCode;
+
+typedef enum {
+    JS_JIT_RETURN,
+    JS_JIT_EXCEPTION,
+    JS_JIT_BAILOUT,
+} JSJITStatusEnum;
+
+/* state of the interpreter frame, shared with the native code */
+typedef struct JSJITFrame {
+    JSContext *ctx;
+    JSValue *sp;
+    JSValue *var_buf;
+    JSValue *arg_buf;
+    JSStackFrame *sf;
+    void *entry; /* where the native code starts */
+    /* bailout: next opcode to interpret. exception: current position */
+    const uint8_t *pc;
+    JSValue ret_val;
+    JSContext *caller_ctx;
+    JSFunctionBytecode *b;
+    struct JSVarRef **var_refs;
+    JSValueConst this_obj;
+    JSValueConst new_target;
+    int argc;
+    JSValueConst *argv;
+} JSJITFrame;
+
+typedef JSJITStatusEnum JSJITFunc(JSJITFrame *f);
+#endif
+
 typedef struct JSBoundFunction {
     JSValue func_obj;
     JSValue this_val;
@@ -929,6 +1107,20 @@ typedef struct JSRegExp {
     JSString *bytecode; /* also contains the flags */
 } JSRegExp;
 
+#define JS_REGEXP_CACHE_SIZE      64
+#define JS_REGEXP_CACHE_HASH_SIZE 128 /* power of two */
+/* longer patterns are not cached */
+#define JS_REGEXP_CACHE_PATTERN_LEN_MAX 4096
+
+struct JSRegExpCacheEntry {
+    struct list_head link; /* rt->regexp_cache_list */
+    JSRegExpCacheEntry *hash_next;
+    uint32_t hash;
+    int re_flags;
+    JSString *pattern;
+    JSString *bytecode; /* shared with the JSRegExp objects */
+};
+
 typedef struct JSProxyData {
     JSValue target;
     JSValue handler;
@@ -1117,6 +1309,10 @@ struct JSShape {
     int prop_size; /* allocated properties */
     int prop_count; /* include deleted properties */
     int deleted_prop_count;
+    /* unique identifier of the shape layout (prototype, property atoms
+       and flags). It changes every time the shape is modified in place
+       so that the inline caches can never see a stale layout. */
+    uint64_t id;
     JSShape *shape_hash_next; /* in JSRuntime.shape_hash[h] list */
     JSObject *proto;
     uint32_t hash_table[]; /* prop_hash_mask + 1 elements, then prop[prop_size] */
@@ -1264,10 +1460,18 @@ typedef enum OPCodeEnum {
 } OPCodeEnum;
 
 static int JS_InitAtoms(JSRuntime *rt);
+static void js_free_cpu_profile(JSRuntime *rt);
 static JSAtom __JS_NewAtomInit(JSRuntime *rt, const char *str, int len,
                                int atom_type);
 static void JS_FreeAtomStruct(JSRuntime *rt, JSAtomStruct *p);
 static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b);
+#ifdef CONFIG_JIT
+static bool js_jit_compile(JSContext *ctx, JSFunctionBytecode *b);
+static void js_jit_free(JSRuntime *rt, JSJITCode *jit);
+#endif
+static no_inline void js_ic_add(JSRuntime *rt, JSFunctionBytecode *b,
+                                int slot, JSObject *p, JSObject *holder,
+                                JSProperty *pr);
 static JSValue js_call_c_function(JSContext *ctx, JSValueConst func_obj,
                                   JSValueConst this_obj,
                                   int argc, JSValueConst *argv, int flags);
@@ -1380,9 +1584,12 @@ static JSValue JS_ToPropertyKeyInternal(JSContext *ctx, JSValueConst val,
 static JSValue js_new_string8_len(JSContext *ctx, const char *buf, int len);
 static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
                                  JSValueConst flags);
+static void js_regexp_cache_free(JSRuntime *rt);
 static JSValue js_regexp_constructor_internal(JSContext *ctx, JSValueConst ctor,
                                               JSValue pattern, JSValue bc);
 static void gc_decref(JSRuntime *rt);
+static void gc_run_young(JSRuntime *rt);
+static void gc_update_thresholds(JSRuntime *rt, bool major_gc);
 static int JS_NewClass1(JSRuntime *rt, JSClassID class_id,
                         const JSClassDef *class_def, JSAtom name);
 static JSValue js_array_push(JSContext *ctx, JSValueConst this_val,
@@ -1644,10 +1851,17 @@ static inline bool js_arith_to_float64(JSValue v, double *pd)
     return true;
 }
 
-static JSValue __JS_NewShortBigInt(JSContext *ctx, int32_t d)
+static JSValue __JS_NewShortBigInt(JSContext *ctx, int64_t d)
 {
     (void)&ctx;
+#if JS_SHORT_BIG_INT_BITS == 32
     return JS_MKVAL(JS_TAG_SHORT_BIG_INT, d);
+#else
+    JSValue v;
+    v.u.short_big_int = d;
+    v.tag = JS_TAG_SHORT_BIG_INT;
+    return v;
+#endif
 }
 
 JSValue JS_NewNumber(JSContext *ctx, double d)
@@ -1679,24 +1893,34 @@ JSValue JS_DupValueRT(JSRuntime *rt, JSValueConst v)
     return js_dup(v);
 }
 
+/* maximum allocated size between two collections. Above
+   gc_major_threshold, only the young GC objects are scanned. */
+#define JS_GC_YOUNG_SIZE (8 * 1024 * 1024)
+
 static void js_trigger_gc(JSRuntime *rt, size_t size)
 {
-    bool force_gc;
+    bool force_gc, major_gc;
 #ifdef FORCE_GC_AT_MALLOC
     force_gc = true;
+    major_gc = true;
 #else
     force_gc = ((rt->malloc_state.malloc_size + size) >
                 rt->malloc_gc_threshold);
+    major_gc = ((rt->malloc_state.malloc_size + size) >
+                rt->gc_major_threshold);
 #endif
-    if (force_gc) {
+    if (force_gc && rt->gc_phase == JS_GC_PHASE_NONE) {
 #ifdef ENABLE_DUMPS // JS_DUMP_GC
         if (check_dump_flag(rt, JS_DUMP_GC)) {
-            printf("GC: size=%zd\n", rt->malloc_state.malloc_size);
+            printf("GC: size=%zd%s\n", rt->malloc_state.malloc_size,
+                   major_gc ? "" : " (young)");
         }
 #endif
-        JS_RunGC(rt);
-        rt->malloc_gc_threshold = rt->malloc_state.malloc_size +
-            (rt->malloc_state.malloc_size >> 1);
+        if (major_gc)
+            JS_RunGC(rt);
+        else
+            gc_run_young(rt);
+        gc_update_thresholds(rt, major_gc);
     }
 }
 
@@ -1931,6 +2155,7 @@ static void *js_arena_realloc(JSRuntime *rt, void *ptr, size_t size)
             /* carry the merged GC/refcount fields to the relocated block */
             JSMallocBlockHeader *nb = container_of(new_ptr, JSMallocBlockHeader, user_data);
             nb->gc_obj_type = b->gc_obj_type;
+            nb->young = b->young;
             nb->mark = b->mark;
             nb->ref_count = b->ref_count;
         }
@@ -1978,6 +2203,12 @@ static void js_arena_free_all(JSRuntime *rt)
     }
 }
 
+static inline void js_malloc_update_peak(JSMallocState *s)
+{
+    if (s->malloc_size > s->malloc_peak_size)
+        s->malloc_peak_size = s->malloc_size;
+}
+
 void *js_calloc_rt(JSRuntime *rt, size_t count, size_t size)
 {
     void *ptr;
@@ -2001,6 +2232,7 @@ void *js_calloc_rt(JSRuntime *rt, size_t count, size_t size)
 
     s->malloc_count++;
     s->malloc_size += js_arena_usable_size(rt, ptr) + MALLOC_OVERHEAD;
+    js_malloc_update_peak(s);
     return ptr;
 }
 
@@ -2024,6 +2256,7 @@ void *js_malloc_rt(JSRuntime *rt, size_t size)
 
     s->malloc_count++;
     s->malloc_size += js_arena_usable_size(rt, ptr) + MALLOC_OVERHEAD;
+    js_malloc_update_peak(s);
     return ptr;
 }
 
@@ -2070,6 +2303,7 @@ void *js_realloc_rt(JSRuntime *rt, void *ptr, size_t size)
         return NULL;
 
     s->malloc_size += js_arena_usable_size(rt, ptr) - old_size;
+    js_malloc_update_peak(s);
     return ptr;
 }
 
@@ -2331,19 +2565,25 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque)
     /* Inline what js_malloc_rt does since we cannot use it here. */
     ms.malloc_count++;
     ms.malloc_size += rt->mf.js_malloc_usable_size(rt) + MALLOC_OVERHEAD;
+    ms.malloc_peak_size = ms.malloc_size;
     rt->malloc_state = ms;
     js_arena_init(rt);
     rt->malloc_gc_threshold = 256 * 1024;
+    rt->gc_major_threshold = rt->malloc_gc_threshold;
 
     init_list_head(&rt->context_list);
     init_list_head(&rt->gc_obj_list);
+    init_list_head(&rt->gc_young_obj_list);
     init_list_head(&rt->gc_zero_ref_count_list);
+    init_list_head(&rt->tmp_obj_list);
+    init_list_head(&rt->gc_zombie_obj_list);
     rt->gc_phase = JS_GC_PHASE_NONE;
 
 #ifdef ENABLE_DUMPS // JS_DUMP_LEAKS
     init_list_head(&rt->string_list);
 #endif
     init_list_head(&rt->job_list);
+    init_list_head(&rt->regexp_cache_list);
 
     if (JS_InitAtoms(rt))
         goto fail;
@@ -2467,6 +2707,8 @@ size_t JS_GetGCThreshold(JSRuntime *rt) {
 void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold)
 {
     rt->malloc_gc_threshold = gc_threshold;
+    rt->gc_major_threshold = gc_threshold;
+    rt->gc_last_size = rt->malloc_state.malloc_size;
 }
 
 #define malloc(s) malloc_is_forbidden(s)
@@ -2630,6 +2872,8 @@ static inline void js_free_string0(JSRuntime *rt, JSString *str)
         case JS_STRING_KIND_INDIRECT:
             js_free_rt(rt, strv(str));
             break;
+        case JS_STRING_KIND_ROM:
+            break; /* the data belongs to the JS_ReadObject() input */
         }
         js_free_rt(rt, str);
     }
@@ -2658,6 +2902,8 @@ void JS_FreeRuntime(JSRuntime *rt)
     }
     init_list_head(&rt->job_list);
 
+    js_regexp_cache_free(rt);
+
     JS_RunGC(rt);
 
 #ifdef ENABLE_DUMPS // JS_DUMP_LEAKS
@@ -2702,6 +2948,7 @@ void JS_FreeRuntime(JSRuntime *rt)
 #endif
 
     assert(list_empty(&rt->gc_obj_list));
+    assert(list_empty(&rt->gc_young_obj_list));
 
     /* free the classes */
     for(i = 0; i < rt->class_count; i++) {
@@ -2711,6 +2958,7 @@ void JS_FreeRuntime(JSRuntime *rt)
         }
     }
     js_free_rt(rt, rt->class_array);
+    js_free_cpu_profile(rt);
 
 #ifdef ENABLE_DUMPS // JS_DUMP_ATOM_LEAKS
     /* only the atoms defined in JS_InitAtoms() should be left */
@@ -3060,7 +3308,7 @@ void JS_FreeContext(JSContext *ctx)
         JSGCObjectHeader *p;
         printf("JSObjects: {\n");
         JS_DumpObjectHeader(ctx->rt);
-        list_for_each(el, &rt->gc_obj_list) {
+        gc_obj_for_each(el, rt) {
             p = list_entry(el, JSGCObjectHeader, link);
             JS_DumpGCObject(rt, p);
         }
@@ -3249,17 +3497,56 @@ static uint32_t hash_string(JSString *str, uint32_t h)
     return h;
 }
 
+/* hash the characters of a rope without the final mixing step, so
+   that the result matches hash_string() of the flattened string */
+static uint32_t hash_string_rope1(JSValueConst val, uint32_t h)
+{
+    if (JS_VALUE_GET_TAG(val) == JS_TAG_STRING) {
+        JSString *p = JS_VALUE_GET_STRING(val);
+        uint32_t i;
+        if (p->is_wide_char) {
+            const uint16_t *str = str16(p);
+            for(i = 0; i < p->len; i++)
+                h = h * 263 + str[i];
+        } else {
+            const uint8_t *str = str8(p);
+            for(i = 0; i < p->len; i++)
+                h = h * 263 + str[i];
+        }
+        return h;
+    } else {
+        JSStringRope *r = JS_VALUE_GET_STRING_ROPE(val);
+        h = hash_string_rope1(r->left, h);
+        return hash_string_rope1(r->right, h);
+    }
+}
+
 static uint32_t hash_string_rope(JSValueConst val, uint32_t h)
 {
     if (JS_VALUE_GET_TAG(val) == JS_TAG_STRING) {
         return hash_string(JS_VALUE_GET_STRING(val), h);
     } else {
         JSStringRope *r = JS_VALUE_GET_STRING_ROPE(val);
-        h = hash_string_rope(r->left, h);
-        return hash_string_rope(r->right, h);
+        return hash_string_rope1(val, h) ^ hash32(r->len);
     }
 }
 
+/* Return the atom hash of a string (JS_ATOM_TYPE_STRING seed). For
+   non atom strings, it is computed once and cached in the 'hash'
+   field, 0 meaning that it is not computed yet. */
+static uint32_t js_string_hash(JSString *p)
+{
+    uint32_t h;
+
+    if (p->atom_type == JS_ATOM_TYPE_STRING ||
+        (p->atom_type == 0 && p->hash != 0))
+        return p->hash;
+    h = hash_string(p, JS_ATOM_TYPE_STRING) & JS_ATOM_HASH_MASK;
+    if (p->atom_type == 0)
+        p->hash = h;
+    return h;
+}
+
 static __maybe_unused void JS_DumpString(JSRuntime *rt, JSString *p)
 {
     int i, c, sep;
@@ -3475,8 +3762,12 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
         }
         /* try and locate an already registered atom */
         len = str->len;
-        h = hash_string(str, atom_type);
-        h &= JS_ATOM_HASH_MASK;
+        if (atom_type == JS_ATOM_TYPE_STRING) {
+            h = js_string_hash(str);
+        } else {
+            h = hash_string(str, atom_type);
+            h &= JS_ATOM_HASH_MASK;
+        }
         h1 = h & (rt->atom_hash_size - 1);
         i = rt->atom_hash[h1];
         while (i != 0) {
@@ -4300,6 +4591,26 @@ static JSValue js_new_string_char(JSContext *ctx, uint16_t c)
     }
 }
 
+/* 'buf' is referenced, not copied: it must stay valid until the
+   runtime is freed (see JS_READ_OBJ_IN_PLACE) */
+static JSString *js_new_rom_string(JSContext *ctx, const void *buf,
+                                   uint32_t len, int is_wide_char)
+{
+    JSString *p;
+    const void **indirect;
+
+    // allocate as 16 bit wide string to avoid wastage
+    p = js_alloc_string(ctx, sizeof(*indirect)/2, /*is_wide_char*/true);
+    if (!p)
+        return NULL;
+    p->is_wide_char = is_wide_char;
+    p->kind = JS_STRING_KIND_ROM;
+    p->len = len;
+    indirect = (void *)&p[1];
+    *indirect = buf;
+    return p;
+}
+
 static JSValue js_sub_string(JSContext *ctx, JSString *p, int start, int end)
 {
     JSStringSlice *slice;
@@ -4313,6 +4624,15 @@ static JSValue js_sub_string(JSContext *ctx, JSString *p, int start, int end)
     if (len <= 0) {
         return js_empty_string(ctx->rt);
     }
+    if (p->kind == JS_STRING_KIND_ROM &&
+        (len << p->is_wide_char) >= JS_STRING_ROM_LEN_MIN) {
+        /* no need to reference the parent string */
+        q = js_new_rom_string(ctx, (uint8_t *)strv(p) + (start << p->is_wide_char),
+                              len, p->is_wide_char);
+        if (!q)
+            return JS_EXCEPTION;
+        return JS_MKPTR(JS_TAG_STRING, q);
+    }
     if (len > (JS_STRING_SLICE_LEN_MAX >> p->is_wide_char)) {
         if (p->kind == JS_STRING_KIND_SLICE) {
             slice = (void *)&p[1];
@@ -5462,8 +5782,10 @@ static JSValue JS_ConcatString2(JSContext *ctx, JSValue op1, JSValue op2)
         goto ret_op1;
     }
     if (JS_REF_COUNT(p1) == 1 && p1->is_wide_char == p2->is_wide_char
+    &&  p1->kind == JS_STRING_KIND_NORMAL && p1->atom_type == 0
     &&  js_malloc_usable_size(ctx, p1) >= sizeof(*p1) + ((p1->len + p2->len) << p2->is_wide_char) + 1 - p1->is_wide_char) {
         /* Concatenate in place in available space at the end of p1 */
+        p1->hash = 0; /* invalidate the cached hash */
         if (p1->is_wide_char) {
             memcpy(str16(p1) + p1->len, str16(p2), p2->len << 1);
             p1->len += p2->len;
@@ -5697,6 +6019,7 @@ static inline JSShape *js_new_shape_nohash(JSContext *ctx, JSObject *proto,
     sh->prop_size = prop_size;
     sh->prop_count = 0;
     sh->deleted_prop_count = 0;
+    sh->id = ++rt->shape_id_counter;
     sh->is_hashed = false;
     return sh;
 }
@@ -5785,6 +6108,7 @@ static JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1)
     JS_REF_COUNT(sh) = 1;
     add_gc_object(ctx->rt, &sh->header, JS_GC_OBJ_TYPE_SHAPE);
     sh->is_hashed = false;
+    sh->id = ++ctx->rt->shape_id_counter;
     if (sh->proto) {
         js_dup(JS_MKPTR(JS_TAG_OBJECT, sh->proto));
     }
@@ -5869,12 +6193,13 @@ static no_inline int resize_properties(JSContext *ctx, JSShape **psh,
         /* copy the shape header, then the properties. Their location relative
            to the struct differs by layout, so copy via get_shape_prop(). */
         memcpy(sh, old_sh, sizeof(JSShape));
-        list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
         /* the GC/refcount fields live in the block header, not the struct, so
            the memcpy above did not carry them: transfer them explicitly */
         JS_REF_COUNT(sh) = JS_REF_COUNT(old_sh);
         JS_GC_TYPE(sh) = JS_GC_TYPE(old_sh);
         JS_GC_MARK(sh) = JS_GC_MARK(old_sh);
+        JS_GC_YOUNG(sh) = JS_GC_YOUNG(old_sh);
+        list_add_tail(&sh->header.link, gc_obj_list_of(ctx->rt, &sh->header));
         new_hash_mask = new_hash_size - 1;
         sh->prop_hash_mask = new_hash_mask;
         memcpy(get_shape_prop(sh), get_shape_prop(old_sh),
@@ -5896,11 +6221,11 @@ static no_inline int resize_properties(JSContext *ctx, JSShape **psh,
                               get_shape_size(new_hash_size, new_size));
         if (unlikely(!sh_alloc)) {
             /* insert again in the GC list */
-            list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+            list_add_tail(&sh->header.link, gc_obj_list_of(ctx->rt, &sh->header));
             return -1;
         }
         sh = get_shape_from_alloc(sh_alloc, new_hash_size);
-        list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
+        list_add_tail(&sh->header.link, gc_obj_list_of(ctx->rt, &sh->header));
     }
     *psh = sh;
     sh->prop_size = new_size;
@@ -5937,12 +6262,13 @@ static int compact_properties(JSContext *ctx, JSObject *p)
     sh = get_shape_from_alloc(sh_alloc, new_hash_size);
     list_del(&old_sh->header.link);
     memcpy(sh, old_sh, sizeof(JSShape));
-    list_add_tail(&sh->header.link, &ctx->rt->gc_obj_list);
     /* the GC/refcount fields live in the block header, not the struct, so the
        memcpy above did not carry them: transfer them explicitly */
     JS_REF_COUNT(sh) = JS_REF_COUNT(old_sh);
     JS_GC_TYPE(sh) = JS_GC_TYPE(old_sh);
     JS_GC_MARK(sh) = JS_GC_MARK(old_sh);
+    JS_GC_YOUNG(sh) = JS_GC_YOUNG(old_sh);
+    list_add_tail(&sh->header.link, gc_obj_list_of(ctx->rt, &sh->header));
 
     /* set the new hash mask before prop_hash_end()/get_shape_prop() are used,
        as their locations depend on it in the merged-header layout */
@@ -5972,6 +6298,7 @@ static int compact_properties(JSContext *ctx, JSObject *p)
     sh->prop_size = new_size;
     sh->deleted_prop_count = 0;
     sh->prop_count = j;
+    sh->id = ++ctx->rt->shape_id_counter;
 
     p->shape = sh;
     js_free(ctx, get_alloc_from_shape(old_sh));
@@ -6018,6 +6345,7 @@ static int add_shape_property(JSContext *ctx, JSShape **psh,
     pr = &prop[sh->prop_count++];
     pr->atom = JS_DupAtom(ctx, atom);
     pr->flags = prop_flags;
+    sh->id = ++rt->shape_id_counter;
     /* add in hash table */
     hash_mask = sh->prop_hash_mask;
     h = atom & hash_mask;
@@ -6111,7 +6439,7 @@ static __maybe_unused void JS_DumpShapes(JSRuntime *rt)
         }
     }
     /* dump non-hashed shapes */
-    list_for_each(el, &rt->gc_obj_list) {
+    gc_obj_for_each(el, rt) {
         gp = list_entry(el, JSGCObjectHeader, link);
         if (JS_GC_TYPE(gp) == JS_GC_OBJ_TYPE_JS_OBJECT) {
             p = (JSObject *)gp;
@@ -7080,7 +7408,7 @@ static void free_object(JSRuntime *rt, JSObject *p)
 
     remove_gc_object(&p->header);
     if (rt->gc_phase == JS_GC_PHASE_REMOVE_CYCLES && JS_REF_COUNT(p) != 0) {
-        list_add_tail(&p->header.link, &rt->gc_zero_ref_count_list);
+        list_add_tail(&p->header.link, &rt->gc_zombie_obj_list);
     } else {
         js_free_rt(rt, p);
     }
@@ -7160,6 +7488,11 @@ static void js_free_value_rt(JSRuntime *rt, JSValue v)
                 if (rt->gc_phase == JS_GC_PHASE_NONE) {
                     free_zero_refcount(rt);
                 }
+            } else if (!JS_GC_MARK(p)) {
+                /* not in the freed cycles (e.g. an old object only
+                   referenced by young cycles): free it with them */
+                list_del(&p->link);
+                list_add_tail(&p->link, &rt->tmp_obj_list);
             }
         }
         break;
@@ -7206,7 +7539,8 @@ static void add_gc_object(JSRuntime *rt, JSGCObjectHeader *h,
 {
     JS_GC_MARK(h) = 0;
     JS_GC_TYPE(h) = type;
-    list_add_tail(&h->link, &rt->gc_obj_list);
+    JS_GC_YOUNG(h) = 1;
+    list_add_tail(&h->link, &rt->gc_young_obj_list);
 }
 
 static void remove_gc_object(JSGCObjectHeader *h)
@@ -7362,7 +7696,16 @@ static void gc_decref_child(JSRuntime *rt, JSGCObjectHeader *p)
     }
 }
 
-static void gc_decref(JSRuntime *rt)
+/* the old objects are considered as referenced from outside the young
+   objects: their refcount and list are not modified */
+static void gc_decref_young_child(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (JS_GC_YOUNG(p))
+        gc_decref_child(rt, p);
+}
+
+static void gc_decref2(JSRuntime *rt, struct list_head *obj_list,
+                       JS_MarkFunc *decref_child)
 {
     struct list_head *el, *el1;
     JSGCObjectHeader *p;
@@ -7372,10 +7715,10 @@ static void gc_decref(JSRuntime *rt)
     /* decrement the refcount of all the children of all the GC
        objects and move the GC objects with zero refcount to
        tmp_obj_list */
-    list_for_each_safe(el, el1, &rt->gc_obj_list) {
+    list_for_each_safe(el, el1, obj_list) {
         p = list_entry(el, JSGCObjectHeader, link);
         assert(JS_GC_MARK(p) == 0);
-        mark_children(rt, p, gc_decref_child);
+        mark_children(rt, p, decref_child);
         JS_GC_MARK(p) = 1;
         if (JS_REF_COUNT(p) == 0) {
             list_del(&p->link);
@@ -7384,14 +7727,19 @@ static void gc_decref(JSRuntime *rt)
     }
 }
 
+static void gc_decref(JSRuntime *rt)
+{
+    gc_decref2(rt, &rt->gc_obj_list, gc_decref_child);
+}
+
 static void gc_scan_incref_child(JSRuntime *rt, JSGCObjectHeader *p)
 {
     JS_REF_COUNT(p)++;
     if (JS_REF_COUNT(p) == 1) {
         /* ref_count was 0: remove from tmp_obj_list and add at the
-           end of gc_obj_list */
+           end of its GC object list */
         list_del(&p->link);
-        list_add_tail(&p->link, &rt->gc_obj_list);
+        list_add_tail(&p->link, gc_obj_list_of(rt, p));
         JS_GC_MARK(p) = 0; /* reset the mark for the next GC call */
     }
 }
@@ -7401,40 +7749,81 @@ static void gc_scan_incref_child2(JSRuntime *rt, JSGCObjectHeader *p)
     JS_REF_COUNT(p)++;
 }
 
-static void gc_scan(JSRuntime *rt)
+static void gc_scan_incref_young_child(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (JS_GC_YOUNG(p))
+        gc_scan_incref_child(rt, p);
+}
+
+static void gc_scan_incref_young_child2(JSRuntime *rt, JSGCObjectHeader *p)
+{
+    if (JS_GC_YOUNG(p))
+        JS_REF_COUNT(p)++;
+}
+
+static void gc_scan2(JSRuntime *rt, struct list_head *obj_list,
+                     JS_MarkFunc *incref_child, JS_MarkFunc *incref_child2)
 {
     struct list_head *el;
     JSGCObjectHeader *p;
 
     /* keep the objects with a refcount > 0 and their children. */
-    list_for_each(el, &rt->gc_obj_list) {
+    list_for_each(el, obj_list) {
         p = list_entry(el, JSGCObjectHeader, link);
         assert(JS_REF_COUNT(p) > 0);
         JS_GC_MARK(p) = 0; /* reset the mark for the next GC call */
-        mark_children(rt, p, gc_scan_incref_child);
+        mark_children(rt, p, incref_child);
     }
 
     /* restore the refcount of the objects to be deleted. */
     list_for_each(el, &rt->tmp_obj_list) {
         p = list_entry(el, JSGCObjectHeader, link);
-        mark_children(rt, p, gc_scan_incref_child2);
+        mark_children(rt, p, incref_child2);
     }
 }
 
-static void gc_free_cycles(JSRuntime *rt)
+static void gc_scan(JSRuntime *rt)
+{
+    gc_scan2(rt, &rt->gc_obj_list, gc_scan_incref_child,
+             gc_scan_incref_child2);
+}
+
+/* move the young objects to gc_obj_list */
+static void gc_promote_young(JSRuntime *rt)
+{
+    struct list_head *el, *el1;
+    JSGCObjectHeader *p;
+
+    list_for_each_safe(el, el1, &rt->gc_young_obj_list) {
+        p = list_entry(el, JSGCObjectHeader, link);
+        JS_GC_YOUNG(p) = 0;
+        list_del(&p->link);
+        list_add_tail(&p->link, &rt->gc_obj_list);
+    }
+}
+
+/* free the objects of tmp_obj_list. If 'deadline_ns' is not zero, stop
+   when it is reached and return false if some objects remain. */
+static bool gc_free_cycles2(JSRuntime *rt, uint64_t deadline_ns)
 {
     struct list_head *el, *el1;
     JSGCObjectHeader *p;
+    int n;
 #ifdef ENABLE_DUMPS // JS_DUMP_GC_FREE
     bool header_done = false;
 #endif
 
     rt->gc_phase = JS_GC_PHASE_REMOVE_CYCLES;
 
-    for(;;) {
+    for(n = 0;; n++) {
         el = rt->tmp_obj_list.next;
         if (el == &rt->tmp_obj_list)
             break;
+        if (deadline_ns != 0 && (n % 32) == 31 &&
+            js__hrtime_ns() >= deadline_ns) {
+            rt->gc_phase = JS_GC_PHASE_NONE;
+            return false;
+        }
         p = list_entry(el, JSGCObjectHeader, link);
         /* Only need to free the GC object associated with JS
            values. The rest will be automatically removed because they
@@ -7456,35 +7845,132 @@ static void gc_free_cycles(JSRuntime *rt)
             break;
         default:
             list_del(&p->link);
-            list_add_tail(&p->link, &rt->gc_zero_ref_count_list);
+            list_add_tail(&p->link, &rt->gc_zombie_obj_list);
             break;
         }
     }
     rt->gc_phase = JS_GC_PHASE_NONE;
 
-    list_for_each_safe(el, el1, &rt->gc_zero_ref_count_list) {
+    list_for_each_safe(el, el1, &rt->gc_zombie_obj_list) {
         p = list_entry(el, JSGCObjectHeader, link);
         assert(JS_GC_TYPE(p) == JS_GC_OBJ_TYPE_JS_OBJECT ||
                JS_GC_TYPE(p) == JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
         js_free_rt(rt, p);
     }
 
-    init_list_head(&rt->gc_zero_ref_count_list);
+    init_list_head(&rt->gc_zombie_obj_list);
+    return true;
 }
 
-void JS_RunGC(JSRuntime *rt)
+static void gc_free_cycles(JSRuntime *rt)
+{
+    gc_free_cycles2(rt, 0);
+}
+
+/* Free the cycles made only of young objects. A reference from an old
+   object is handled like a reference from the stack, so the cycles
+   containing old objects are left to JS_RunGC(). The surviving young
+   objects become old. */
+static void gc_mark_young(JSRuntime *rt)
+{
+    rt->gc_young_count++;
+    gc_decref2(rt, &rt->gc_young_obj_list, gc_decref_young_child);
+    gc_scan2(rt, &rt->gc_young_obj_list, gc_scan_incref_young_child,
+             gc_scan_incref_young_child2);
+    /* the objects allocated by the finalizers stay young */
+    gc_promote_young(rt);
+}
+
+static void gc_run_young(JSRuntime *rt)
+{
+    /* finish the cycles found by JS_RunGCStep() */
+    gc_free_cycles(rt);
+    gc_mark_young(rt);
+    gc_free_cycles(rt);
+}
+
+static void gc_mark(JSRuntime *rt)
 {
+    rt->gc_count++;
+    gc_promote_young(rt);
+
     /* decrement the reference of the children of each object. mark =
        1 after this pass. */
     gc_decref(rt);
 
     /* keep the GC objects with a non zero refcount and their childs */
     gc_scan(rt);
+}
 
+void JS_RunGC(JSRuntime *rt)
+{
+    gc_free_cycles(rt);
+    gc_mark(rt);
     /* free the GC objects in a cycle */
     gc_free_cycles(rt);
 }
 
+static void gc_update_thresholds(JSRuntime *rt, bool major_gc)
+{
+    size_t size = rt->malloc_state.malloc_size;
+
+    if (major_gc)
+        rt->gc_major_threshold = size + (size >> 1);
+    /* the young collections are done at a fixed allocation rate so
+       that their duration does not depend on the heap size */
+    rt->malloc_gc_threshold = size + min_int64(size >> 1, JS_GC_YOUNG_SIZE);
+    rt->gc_last_size = size;
+}
+
+/* Incremental GC: the garbage cycles are found in one step but they are
+   freed in several steps, between which the JS code may run. It is
+   possible because no live object references them. Their weak
+   references and their shapes in the shape hash table are removed at
+   once so that they cannot be reached anymore. The collection is started in advance, when half of the
+   allocation budget before the next automatic GC is used. Return true
+   if there is remaining work. */
+bool JS_RunGCStep(JSRuntime *rt, int budget_us)
+{
+    struct list_head *el;
+    JSGCObjectHeader *p;
+    uint64_t deadline_ns;
+    size_t size;
+    bool major_gc;
+
+    if (rt->gc_phase != JS_GC_PHASE_NONE)
+        return false;
+    deadline_ns = js__hrtime_ns() + (uint64_t)max_int(budget_us, 1) * 1000;
+    if (list_empty(&rt->tmp_obj_list)) {
+        size = rt->malloc_state.malloc_size;
+        if (size <= rt->gc_last_size ||
+            size - rt->gc_last_size <
+            (rt->malloc_gc_threshold - rt->gc_last_size) / 2)
+            return false;
+        /* same choice as the next automatic GC */
+        major_gc = (rt->malloc_gc_threshold >= rt->gc_major_threshold);
+        if (major_gc)
+            gc_mark(rt);
+        else
+            gc_mark_young(rt);
+        rt->gc_phase = JS_GC_PHASE_REMOVE_CYCLES;
+        list_for_each(el, &rt->tmp_obj_list) {
+            p = list_entry(el, JSGCObjectHeader, link);
+            if (JS_GC_TYPE(p) == JS_GC_OBJ_TYPE_JS_OBJECT &&
+                ((JSObject *)p)->first_weak_ref) {
+                reset_weak_ref(rt, &((JSObject *)p)->first_weak_ref);
+            } else if (JS_GC_TYPE(p) == JS_GC_OBJ_TYPE_SHAPE &&
+                       ((JSShape *)p)->is_hashed) {
+                /* the new objects must not find the garbage shapes */
+                js_shape_hash_unlink(rt, (JSShape *)p);
+                ((JSShape *)p)->is_hashed = false;
+            }
+        }
+        rt->gc_phase = JS_GC_PHASE_NONE;
+        gc_update_thresholds(rt, major_gc);
+    }
+    return !gc_free_cycles2(rt, deadline_ns);
+}
+
 /* Return false if not an object or if the object has already been
    freed (zombie objects are visible in finalizers when freeing
    cycles). */
@@ -7544,6 +8030,10 @@ static void compute_bytecode_size(JSFunctionBytecode *b, JSMemoryUsage_helper *h
     if (b->byte_code_buf) {
         hp->js_func_code_size += b->byte_code_len;
     }
+    if (b->ic) {
+        memory_used_count++;
+        js_func_size += b->ic_count * sizeof(*b->ic);
+    }
     memory_used_count++;
     js_func_size += b->source_len + 1;
     if (b->pc2line_len) {
@@ -7577,11 +8067,23 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
     memset(s, 0, sizeof(*s));
     s->malloc_count = rt->malloc_state.malloc_count;
     s->malloc_size = rt->malloc_state.malloc_size;
+    s->malloc_peak_size = rt->malloc_state.malloc_peak_size;
     s->malloc_limit = rt->malloc_state.malloc_limit;
+    s->gc_count = rt->gc_count;
+    s->gc_young_count = rt->gc_young_count;
 
     s->memory_used_count = 2; /* rt + rt->class_array */
     s->memory_used_size = sizeof(JSRuntime) + sizeof(JSClass) * rt->class_count;
 
+    s->regexp_cache_count = rt->regexp_cache_count;
+    s->regexp_cache_hit_count = rt->regexp_cache_hit_count;
+    s->regexp_cache_miss_count = rt->regexp_cache_miss_count;
+    if (rt->regexp_cache_hash) {
+        s->memory_used_count += 1 + rt->regexp_cache_count;
+        s->memory_used_size += sizeof(rt->regexp_cache_hash[0]) * JS_REGEXP_CACHE_HASH_SIZE +
+            sizeof(JSRegExpCacheEntry) * rt->regexp_cache_count;
+    }
+
     list_for_each(el, &rt->context_list) {
         JSContext *ctx = list_entry(el, JSContext, link);
         JSShape *sh = ctx->array_shape;
@@ -7630,7 +8132,7 @@ void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s)
         }
     }
 
-    list_for_each(el, &rt->gc_obj_list) {
+    gc_obj_for_each(el, rt) {
         JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
         JSObject *p;
         JSShape *sh;
@@ -7896,7 +8398,7 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt)
             int obj_classes[JS_CLASS_INIT_COUNT + 1] = { 0 };
             int class_id;
             struct list_head *el;
-            list_for_each(el, &rt->gc_obj_list) {
+            gc_obj_for_each(el, rt) {
                 JSGCObjectHeader *gp = list_entry(el, JSGCObjectHeader, link);
                 JSObject *p;
                 if (JS_GC_TYPE(gp) == JS_GC_OBJ_TYPE_JS_OBJECT) {
@@ -7981,6 +8483,15 @@ void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt)
         fprintf(fp, "%-20s %8"PRId64" %8"PRId64"\n",
                 "binary objects", s->binary_object_count, s->binary_object_size);
     }
+    if (s->gc_count || s->gc_young_count) {
+        fprintf(fp, "%-20s %8"PRId64"\n", "GCs", s->gc_count);
+        fprintf(fp, "%-20s %8"PRId64"\n", "young GCs", s->gc_young_count);
+    }
+    if (s->regexp_cache_hit_count || s->regexp_cache_miss_count) {
+        fprintf(fp, "%-20s %8"PRId64"  (%"PRId64" hits, %"PRId64" misses)\n",
+                "regexp cache", s->regexp_cache_count,
+                s->regexp_cache_hit_count, s->regexp_cache_miss_count);
+    }
 }
 
 JSValue JS_GetGlobalObject(JSContext *ctx)
@@ -8641,10 +9152,308 @@ static void JS_ThrowInterrupted(JSContext *ctx)
     JS_SetUncatchableError(ctx, ctx->rt->current_exception);
 }
 
+/* CPU profiler: the JS stack is sampled from the interrupt poll. The
+   time spent in JS since the previous sample is attributed to the
+   current stack, so the samples are only taken while bytecode is
+   executing but the time spent in native code is not lost. The clock
+   is paused while the host runs, e.g. between two event loop callbacks.
+   The stacks are aggregated as strings in the "folded" format of
+   flamegraph.pl. */
+
+#define JS_CPU_PROFILE_MAX_DEPTH 128
+
+typedef struct JSCPUProfileEntry {
+    struct JSCPUProfileEntry *hash_next;
+    uint32_t hash;
+    uint32_t len;
+    int64_t count; /* number of sampling intervals */
+    char stack[]; /* not zero terminated */
+} JSCPUProfileEntry;
+
+typedef struct JSCPUProfile {
+    bool running;
+    bool in_js; /* the host has called JS code */
+    int64_t interval_ns;
+    uint64_t enter_ns; /* start of the JS time not added to 'js_ns' */
+    int64_t js_ns; /* JS time not yet attributed to a sample */
+    uint32_t hash_size; /* power of two */
+    uint32_t entry_count;
+    JSCPUProfileEntry **hash;
+    DynBuf dbuf; /* stack of the current sample */
+} JSCPUProfile;
+
+static void *js_cpu_profile_realloc(void *opaque, void *ptr, size_t size)
+{
+    return js_realloc_rt(opaque, ptr, size);
+}
+
+static void js_cpu_profile_reset(JSRuntime *rt, JSCPUProfile *prof)
+{
+    JSCPUProfileEntry *e, *e_next;
+    uint32_t i;
+
+    for(i = 0; i < prof->hash_size; i++) {
+        for(e = prof->hash[i]; e != NULL; e = e_next) {
+            e_next = e->hash_next;
+            js_free_rt(rt, e);
+        }
+        prof->hash[i] = NULL;
+    }
+    prof->entry_count = 0;
+}
+
+static void js_free_cpu_profile(JSRuntime *rt)
+{
+    JSCPUProfile *prof = rt->cpu_profile;
+
+    if (!prof)
+        return;
+    js_cpu_profile_reset(rt, prof);
+    js_free_rt(rt, prof->hash);
+    dbuf_free(&prof->dbuf);
+    js_free_rt(rt, prof);
+    rt->cpu_profile = NULL;
+}
+
+/* append 'str' in UTF-8 without ';' which separates the frames */
+static void js_cpu_profile_put_str(DynBuf *dbuf, JSString *str)
+{
+    char buf[256], *q;
+
+    if (str->is_wide_char)
+        utf8_encode_buf16(buf, sizeof(buf), str16(str), str->len);
+    else
+        utf8_encode_buf8(buf, sizeof(buf), str8(str), str->len);
+    for(q = buf; *q != '\0'; q++) {
+        if (*q == ';')
+            *q = ':';
+    }
+    dbuf_putstr(dbuf, buf);
+}
+
+static void js_cpu_profile_put_atom(JSRuntime *rt, DynBuf *dbuf, JSAtom atom)
+{
+    if (atom == JS_ATOM_NULL || __JS_AtomIsTaggedInt(atom) ||
+        atom >= rt->atom_size)
+        dbuf_putstr(dbuf, "<anonymous>");
+    else
+        js_cpu_profile_put_str(dbuf, rt->atom_array[atom]);
+}
+
+static void js_cpu_profile_put_frame(JSContext *ctx, DynBuf *dbuf,
+                                     JSStackFrame *sf)
+{
+    JSRuntime *rt = ctx->rt;
+    JSObject *p;
+    JSFunctionBytecode *b;
+    JSProperty *pr;
+    JSShapeProperty *prs;
+    int line_num, col_num;
+
+    if (JS_VALUE_GET_TAG(sf->cur_func) != JS_TAG_OBJECT) {
+        dbuf_putstr(dbuf, "<unknown>");
+        return;
+    }
+    p = JS_VALUE_GET_OBJ(sf->cur_func);
+    if (js_class_has_bytecode(p->class_id)) {
+        /* the line of the current pc. The frames which have not called a
+           function or polled the interrupts yet use the line of the
+           function. */
+        b = p->u.func.function_bytecode;
+        line_num = b->line_num;
+        if (sf->cur_pc) {
+            line_num = find_line_num(ctx, b, sf->cur_pc - b->byte_code_buf - 1,
+                                     &col_num);
+        }
+        js_cpu_profile_put_atom(rt, dbuf, b->func_name);
+        dbuf_putstr(dbuf, " (");
+        js_cpu_profile_put_atom(rt, dbuf, b->filename);
+        dbuf_printf(dbuf, ":%d)", line_num);
+    } else {
+        /* same rule as get_func_name() */
+        prs = find_own_property(&pr, p, JS_ATOM_name);
+        if (prs && (prs->flags & JS_PROP_TMASK) == JS_PROP_NORMAL &&
+            JS_VALUE_GET_TAG(pr->u.value) == JS_TAG_STRING &&
+            JS_VALUE_GET_STRING(pr->u.value)->len != 0) {
+            js_cpu_profile_put_str(dbuf, JS_VALUE_GET_STRING(pr->u.value));
+        } else {
+            dbuf_putstr(dbuf, "<anonymous>");
+        }
+        dbuf_putstr(dbuf, " (native)");
+    }
+}
+
+static int js_cpu_profile_resize(JSRuntime *rt, JSCPUProfile *prof,
+                                 uint32_t new_hash_size)
+{
+    JSCPUProfileEntry **new_hash, *e, *e_next;
+    uint32_t i, h;
+
+    new_hash = js_mallocz_rt(rt, sizeof(new_hash[0]) * new_hash_size);
+    if (!new_hash)
+        return -1;
+    for(i = 0; i < prof->hash_size; i++) {
+        for(e = prof->hash[i]; e != NULL; e = e_next) {
+            e_next = e->hash_next;
+            h = e->hash & (new_hash_size - 1);
+            e->hash_next = new_hash[h];
+            new_hash[h] = e;
+        }
+    }
+    js_free_rt(rt, prof->hash);
+    prof->hash = new_hash;
+    prof->hash_size = new_hash_size;
+    return 0;
+}
+
+static no_inline void js_cpu_profile_sample(JSContext *ctx)
+{
+    JSRuntime *rt = ctx->rt;
+    JSCPUProfile *prof = rt->cpu_profile;
+    JSStackFrame *tab[JS_CPU_PROFILE_MAX_DEPTH], *sf;
+    JSCPUProfileEntry *e;
+    uint64_t now;
+    int64_t count;
+    uint32_t h;
+    int n, i;
+
+    now = js__hrtime_ns();
+    prof->js_ns += now - prof->enter_ns;
+    prof->enter_ns = now;
+    count = prof->js_ns / prof->interval_ns;
+    if (count <= 0)
+        return;
+    prof->js_ns -= count * prof->interval_ns;
+
+    /* keep the innermost frames if the stack is too deep */
+    n = 0;
+    for(sf = rt->current_stack_frame; sf != NULL; sf = sf->prev_frame) {
+        if (n == JS_CPU_PROFILE_MAX_DEPTH)
+            break;
+        tab[n++] = sf;
+    }
+    if (n == 0)
+        return;
+    prof->dbuf.size = 0;
+    prof->dbuf.error = false;
+    if (sf != NULL)
+        dbuf_putstr(&prof->dbuf, "<truncated>;");
+    for(i = n - 1; i >= 0; i--) {
+        js_cpu_profile_put_frame(ctx, &prof->dbuf, tab[i]);
+        if (i != 0)
+            dbuf_putc(&prof->dbuf, ';');
+    }
+    if (dbuf_error(&prof->dbuf))
+        return;
+
+    h = hash_string8(prof->dbuf.buf, prof->dbuf.size, 0);
+    for(e = prof->hash[h & (prof->hash_size - 1)]; e != NULL; e = e->hash_next) {
+        if (e->hash == h && e->len == prof->dbuf.size &&
+            !memcmp(e->stack, prof->dbuf.buf, e->len)) {
+            e->count += count;
+            return;
+        }
+    }
+    if (prof->entry_count >= prof->hash_size * 2) {
+        /* on memory error, the hash chains are just longer */
+        js_cpu_profile_resize(rt, prof, prof->hash_size * 2);
+    }
+    e = js_malloc_rt(rt, sizeof(*e) + prof->dbuf.size);
+    if (!e)
+        return; /* the sample is lost */
+    e->hash = h;
+    e->len = prof->dbuf.size;
+    e->count = count;
+    memcpy(e->stack, prof->dbuf.buf, e->len);
+    h &= prof->hash_size - 1;
+    e->hash_next = prof->hash[h];
+    prof->hash[h] = e;
+    prof->entry_count++;
+}
+
+/* start sampling the JS stack every 'interval_us' microseconds. The
+   samples of a previous profile are discarded. Return -1 if memory
+   error. */
+int JS_StartCPUProfile(JSRuntime *rt, int interval_us)
+{
+    JSCPUProfile *prof = rt->cpu_profile;
+
+    if (!prof) {
+        prof = js_mallocz_rt(rt, sizeof(*prof));
+        if (!prof)
+            return -1;
+        dbuf_init2(&prof->dbuf, rt, js_cpu_profile_realloc);
+        rt->cpu_profile = prof;
+        if (js_cpu_profile_resize(rt, prof, 256)) {
+            js_free_cpu_profile(rt);
+            return -1;
+        }
+    } else {
+        js_cpu_profile_reset(rt, prof);
+    }
+    prof->interval_ns = (int64_t)max_int(interval_us, 1) * 1000;
+    prof->enter_ns = js__hrtime_ns();
+    prof->js_ns = 0;
+    prof->running = true;
+    return 0;
+}
+
+/* stop sampling. The samples are kept until the next call to
+   JS_StartCPUProfile(). */
+void JS_StopCPUProfile(JSRuntime *rt)
+{
+    if (rt->cpu_profile)
+        rt->cpu_profile->running = false;
+}
+
+/* called when the host calls JS code: the clock of the profile only runs
+   until the call returns, so the time spent in the host (e.g. waiting
+   for events) is not charged to the next sampled stack */
+static no_inline JSValue js_cpu_profile_call(JSContext *ctx,
+                                             JSValueConst func_obj,
+                                             JSValueConst this_obj,
+                                             JSValueConst new_target,
+                                             int argc, JSValueConst *argv,
+                                             int flags)
+{
+    JSCPUProfile *prof = ctx->rt->cpu_profile;
+    JSValue ret;
+
+    prof->in_js = true;
+    prof->enter_ns = js__hrtime_ns();
+    ret = JS_CallInternal(ctx, func_obj, this_obj, new_target,
+                          argc, argv, flags);
+    if (prof->running)
+        prof->js_ns += js__hrtime_ns() - prof->enter_ns;
+    prof->in_js = false;
+    return ret;
+}
+
+/* one line per distinct stack: the frames from the outermost one,
+   separated by ';', followed by the number of sampling intervals. */
+void JS_DumpCPUProfile(FILE *fp, JSRuntime *rt)
+{
+    JSCPUProfile *prof = rt->cpu_profile;
+    JSCPUProfileEntry *e;
+    uint32_t i;
+
+    if (!prof)
+        return;
+    for(i = 0; i < prof->hash_size; i++) {
+        for(e = prof->hash[i]; e != NULL; e = e->hash_next) {
+            fprintf(fp, "%.*s %" PRId64 "\n", (int)e->len, e->stack, e->count);
+        }
+    }
+}
+
 static no_inline __exception int __js_poll_interrupts(JSContext *ctx)
 {
     JSRuntime *rt = ctx->rt;
     ctx->interrupt_counter = JS_INTERRUPT_COUNTER_INIT;
+    if (rt->cpu_profile && rt->cpu_profile->running) {
+        ctx->interrupt_counter = JS_CPU_PROFILE_COUNTER_INIT;
+        js_cpu_profile_sample(ctx);
+    }
     if (rt->interrupt_handler) {
         if (rt->interrupt_handler(rt, rt->interrupt_opaque)) {
             JS_ThrowInterrupted(ctx);
@@ -8663,6 +9472,20 @@ static inline __exception int js_poll_interrupts(JSContext *ctx)
     }
 }
 
+/* same as js_poll_interrupts() for the branches of JS_CallInternal():
+   'pc' is saved so that the CPU profiler has the current line */
+static inline __exception int js_poll_interrupts_pc(JSContext *ctx,
+                                                    JSStackFrame *sf,
+                                                    uint8_t *pc)
+{
+    if (unlikely(--ctx->interrupt_counter <= 0)) {
+        sf->cur_pc = pc;
+        return __js_poll_interrupts(ctx);
+    } else {
+        return 0;
+    }
+}
+
 /* return -1 (exception) or true/false */
 static int JS_SetPrototypeInternal(JSContext *ctx, JSValueConst obj,
                                    JSValueConst proto_val, bool throw_flag)
@@ -11174,6 +11997,8 @@ static int js_shape_prepare_update(JSContext *ctx, JSObject *p,
             sh->is_hashed = false;
         }
     }
+    /* the caller modifies the shape in place */
+    sh->id = ++ctx->rt->shape_id_counter;
     return 0;
 }
 
@@ -11762,10 +12587,12 @@ static int JS_DefineGlobalFunction(JSContext *ctx, JSAtom prop,
     return 0;
 }
 
+/* 'slot' is the inline cache slot of 'b' (see js_ic_find_global()) */
 static JSValue JS_GetGlobalVar(JSContext *ctx, JSAtom prop,
-                               bool throw_ref_error)
+                               bool throw_ref_error,
+                               JSFunctionBytecode *b, int slot)
 {
-    JSObject *p;
+    JSObject *p, *p1;
     JSShapeProperty *prs;
     JSProperty *pr;
 
@@ -11776,15 +12603,18 @@ static JSValue JS_GetGlobalVar(JSContext *ctx, JSAtom prop,
         /* XXX: should handle JS_PROP_TMASK properties */
         if (unlikely(JS_IsUninitialized(pr->u.value)))
             return JS_ThrowReferenceErrorUninitialized(ctx, prs->atom);
+        js_ic_add(ctx->rt, b, slot, p, p, pr);
         return js_dup(pr->u.value);
     }
 
     /* fast path */
-    p = JS_VALUE_GET_OBJ(ctx->global_obj);
-    prs = find_own_property(&pr, p, prop);
+    p1 = JS_VALUE_GET_OBJ(ctx->global_obj);
+    prs = find_own_property(&pr, p1, prop);
     if (prs) {
-        if (likely((prs->flags & JS_PROP_TMASK) == 0))
+        if (likely((prs->flags & JS_PROP_TMASK) == 0)) {
+            js_ic_add(ctx->rt, b, slot, p, p1, pr);
             return js_dup(pr->u.value);
+        }
     }
     return JS_GetPropertyInternal(ctx, ctx->global_obj, prop,
                                  ctx->global_obj, throw_ref_error);
@@ -11831,9 +12661,9 @@ static int JS_GetGlobalVarRef(JSContext *ctx, JSAtom prop, JSValue *sp)
    flag = 1: initialize lexical variable
 */
 static inline int JS_SetGlobalVar(JSContext *ctx, JSAtom prop, JSValue val,
-                                  int flag)
+                                  int flag, JSFunctionBytecode *b, int slot)
 {
-    JSObject *p;
+    JSObject *p, *p1;
     JSShapeProperty *prs;
     JSProperty *pr;
     int ret;
@@ -11853,17 +12683,19 @@ static inline int JS_SetGlobalVar(JSContext *ctx, JSAtom prop, JSValue val,
                 JS_FreeValue(ctx, val);
                 return JS_ThrowTypeErrorReadOnly(ctx, JS_PROP_THROW, prop);
             }
+            js_ic_add(ctx->rt, b, slot, p, p, pr);
         }
         set_value(ctx, &pr->u.value, val);
         return 0;
     }
 
-    p = JS_VALUE_GET_OBJ(ctx->global_obj);
-    prs = find_own_property(&pr, p, prop);
+    p1 = JS_VALUE_GET_OBJ(ctx->global_obj);
+    prs = find_own_property(&pr, p1, prop);
     if (prs) {
         if (likely((prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
                                   JS_PROP_LENGTH)) == JS_PROP_WRITABLE)) {
             /* fast path */
+            js_ic_add(ctx->rt, b, slot, p, p1, pr);
             set_value(ctx, &pr->u.value, val);
             return 0;
         }
@@ -12354,7 +13186,11 @@ static inline js_limb_t js_limb_clz(js_limb_t a)
 {
     if (!a)
         return JS_LIMB_BITS;
+#if JS_LIMB_BITS == 32
     return clz32(a);
+#else
+    return clz64(a);
+#endif
 }
 
 static js_limb_t js_mp_add(js_limb_t *res, const js_limb_t *op1, const js_limb_t *op2,
@@ -12459,6 +13295,147 @@ static void js_mp_mul_basecase(js_limb_t *result,
     }
 }
 
+/* Karatsuba multiplication is used when both operands have at least
+   this number of limbs (tuned on x86_64, must be >= 8) */
+#define JS_MP_KARATSUBA_THRESHOLD 32
+
+/* res = |a - b| with na >= nb. res has na limbs. Return 1 if a < b. */
+static int js_mp_abs_diff(js_limb_t *res, const js_limb_t *a, int na,
+                          const js_limb_t *b, int nb)
+{
+    int i;
+    js_limb_t k;
+
+    for(i = nb; i < na; i++) {
+        if (a[i] != 0)
+            goto a_greater;
+    }
+    for(i = nb - 1; i >= 0; i--) {
+        if (a[i] != b[i])
+            break;
+    }
+    if (i >= 0 && a[i] < b[i]) {
+        js_mp_sub(res, b, a, nb, 0);
+        for(i = nb; i < na; i++)
+            res[i] = 0;
+        return 1;
+    }
+ a_greater:
+    k = js_mp_sub(res, a, b, nb, 0);
+    for(i = nb; i < na; i++) {
+        res[i] = a[i] - k;
+        k = res[i] > a[i];
+    }
+    return 0;
+}
+
+/* number of limbs of the temporary buffer used by js_mp_mul_karatsuba() */
+static int js_mp_karatsuba_tmp_size(int n)
+{
+    int size, l;
+
+    size = 0;
+    while (n >= JS_MP_KARATSUBA_THRESHOLD) {
+        l = (n + 1) / 2;
+        size += 6 * l + 1;
+        n = l;
+    }
+    return size;
+}
+
+/* result[0..2n-1] = a[0..n-1] * b[0..n-1]. With a = a1 * B^l + a0 and
+   b = b1 * B^l + b0, the middle product is computed as a0 * b0 + a1 *
+   b1 - (a0 - a1) * (b0 - b1) so that only 3 half size products are
+   needed. */
+static void js_mp_mul_karatsuba(js_limb_t *result, const js_limb_t *a,
+                                const js_limb_t *b, int n, js_limb_t *tmp)
+{
+    js_limb_t *da, *db, *t, *mid, c;
+    int l, h, i, a_neg, b_neg;
+
+    if (n < JS_MP_KARATSUBA_THRESHOLD) {
+        js_mp_mul_basecase(result, a, n, b, n);
+        return;
+    }
+    l = (n + 1) / 2;
+    h = n - l;
+    da = tmp;
+    db = da + l;
+    t = db + l;
+    mid = t + 2 * l;
+    tmp = mid + 2 * l + 1;
+
+    a_neg = js_mp_abs_diff(da, a, l, a + l, h);
+    b_neg = js_mp_abs_diff(db, b, l, b + l, h);
+    js_mp_mul_karatsuba(t, da, db, l, tmp);
+    js_mp_mul_karatsuba(result, a, b, l, tmp);
+    js_mp_mul_karatsuba(result + 2 * l, a + l, b + l, h, tmp);
+
+    /* mid = a0 * b0 + a1 * b1 */
+    c = js_mp_add(mid, result, result + 2 * l, 2 * h, 0);
+    for(i = 2 * h; i < 2 * l; i++) {
+        ADDC(mid[i], c, result[i], 0, c);
+    }
+    mid[2 * l] = c;
+    if (a_neg ^ b_neg) {
+        mid[2 * l] += js_mp_add(mid, mid, t, 2 * l, 0);
+    } else {
+        mid[2 * l] -= js_mp_sub(mid, mid, t, 2 * l, 0);
+    }
+
+    /* no overflow is possible because 3 * l + 1 <= 2 * n */
+    c = js_mp_add(result + l, result + l, mid, 2 * l + 1, 0);
+    for(i = 3 * l + 1; i < 2 * n && c != 0; i++) {
+        ADDC(result[i], c, result[i], 0, c);
+    }
+}
+
+/* result[0..na+nb-1] = a[0..na-1] * b[0..nb-1]. Return -1 if memory
+   error. */
+static int js_mp_mul(JSContext *ctx, js_limb_t *result,
+                     const js_limb_t *a, int na, const js_limb_t *b, int nb)
+{
+    js_limb_t *tmp, *prod;
+    int i;
+
+    if (na < nb) {
+        const js_limb_t *t1 = a;
+        int t2 = na;
+        a = b;
+        na = nb;
+        b = t1;
+        nb = t2;
+    }
+    if (nb < JS_MP_KARATSUBA_THRESHOLD) {
+        js_mp_mul_basecase(result, a, na, b, nb);
+        return 0;
+    }
+    tmp = js_malloc(ctx, (js_mp_karatsuba_tmp_size(nb) + 2 * nb) *
+                    sizeof(js_limb_t));
+    if (!tmp)
+        return -1;
+    if (na == nb) {
+        js_mp_mul_karatsuba(result, a, b, nb, tmp);
+    } else {
+        /* unbalanced case: multiply 'b' by slices of 'a' of nb limbs */
+        prod = tmp + js_mp_karatsuba_tmp_size(nb);
+        memset(result, 0, (na + nb) * sizeof(js_limb_t));
+        for(i = 0; i + nb <= na; i += nb) {
+            js_mp_mul_karatsuba(prod, a + i, b, nb, tmp);
+            js_mp_add(result + i, result + i, prod, 2 * nb, 0);
+        }
+        if (i < na) {
+            if (js_mp_mul(ctx, prod, a + i, na - i, b, nb)) {
+                js_free(ctx, tmp);
+                return -1;
+            }
+            js_mp_add(result + i, result + i, prod, na - i + nb, 0);
+        }
+    }
+    js_free(ctx, tmp);
+    return 0;
+}
+
 /* tabr[] -= taba[] * b. Return the value to substract to the high
    word. */
 static js_limb_t js_mp_sub_mul1(js_limb_t *tabr, const js_limb_t *taba, js_limb_t n,
@@ -12664,6 +13641,10 @@ static JSBigInt *js_bigint_set_si64(JSBigIntBuf *buf, int64_t a)
 {
     JSBigInt *r = (JSBigInt *)buf->big_int_buf;
     /* stack JSBigIntBuf: no block-header ref_count slot (see js_bigint_set_si) */
+#if JS_LIMB_BITS == 64
+    r->len = 1;
+    r->tab[0] = a;
+#else
     if (a >= INT32_MIN && a <= INT32_MAX) {
         r->len = 1;
         r->tab[0] = a;
@@ -12672,6 +13653,7 @@ static JSBigInt *js_bigint_set_si64(JSBigIntBuf *buf, int64_t a)
         r->tab[0] = a;
         r->tab[1] = a >> JS_LIMB_BITS;
     }
+#endif
     return r;
 }
 
@@ -12687,7 +13669,11 @@ static __maybe_unused void js_bigint_dump1(JSContext *ctx, const char *str,
     int i;
     printf("%s: ", str);
     for(i = len - 1; i >= 0; i--) {
+#if JS_LIMB_BITS == 32
         printf(" %08x", tab[i]);
+#else
+        printf(" %016" PRIx64, tab[i]);
+#endif
     }
     printf("\n");
 }
@@ -12710,6 +13696,9 @@ static JSBigInt *js_bigint_new_si(JSContext *ctx, js_slimb_t a)
 
 static JSBigInt *js_bigint_new_si64(JSContext *ctx, int64_t a)
 {
+#if JS_LIMB_BITS == 64
+    return js_bigint_new_si(ctx, a);
+#else
     if (a >= INT32_MIN && a <= INT32_MAX) {
         return js_bigint_new_si(ctx, a);
     } else {
@@ -12721,6 +13710,7 @@ static JSBigInt *js_bigint_new_si64(JSContext *ctx, int64_t a)
         r->tab[1] = a >> 32;
         return r;
     }
+#endif
 }
 
 static JSBigInt *js_bigint_new_ui64(JSContext *ctx, uint64_t a)
@@ -12732,9 +13722,14 @@ static JSBigInt *js_bigint_new_ui64(JSContext *ctx, uint64_t a)
         r = js_bigint_new(ctx, (65 + JS_LIMB_BITS - 1) / JS_LIMB_BITS);
         if (!r)
             return NULL;
+#if JS_LIMB_BITS == 64
+        r->tab[0] = a;
+        r->tab[1] = 0;
+#else
         r->tab[0] = a;
         r->tab[1] = a >> 32;
         r->tab[2] = 0;
+#endif
         return r;
     }
 }
@@ -12801,9 +13796,9 @@ static js_slimb_t js_bigint_get_si_sat(const JSBigInt *a)
         return a->tab[0];
     } else {
         if (js_bigint_sign(a))
-            return INT32_MIN;
+            return JS_SHORT_BIG_INT_MIN;
         else
-            return INT32_MAX;
+            return JS_SHORT_BIG_INT_MAX;
     }
 }
 
@@ -12891,7 +13886,10 @@ static JSBigInt *js_bigint_mul(JSContext *ctx, const JSBigInt *a,
     r = js_bigint_new(ctx, a->len + b->len);
     if (!r)
         return NULL;
-    js_mp_mul_basecase(r->tab, a->tab, a->len, b->tab, b->len);
+    if (js_mp_mul(ctx, r->tab, a->tab, a->len, b->tab, b->len)) {
+        js_free(ctx, r);
+        return NULL;
+    }
     /* correct the result if negative operands (no overflow is
        possible) */
     if (js_bigint_sign(a))
@@ -13244,11 +14242,21 @@ static uint64_t js_bigint_get_mant_exp(JSContext *ctx,
         t[j] = v;
     }
 
+#if JS_LIMB_BITS == 32
     a1 = ((uint64_t)t[2] << 32) | t[1];
     a0 = (uint64_t)t[0] << 32;
+#else
+    a1 = t[1];
+    a0 = t[0];
+#endif
     a0 |= (low_bits != 0);
     /* normalize */
-    {
+    if (a1 == 0) {
+        /* only with 64 bit limbs */
+        shift = 64;
+        a1 = a0;
+        a0 = 0;
+    } else {
         shift = clz64(a1);
         if (shift != 0) {
             a1 = (a1 << shift) | (a0 >> (64 - shift));
@@ -13449,8 +14457,354 @@ static const js_limb_t js_pow_dec[JS_LIMB_DIGITS + 1] = {
     10000000U,
     100000000U,
     1000000000U,
+#if JS_LIMB_BITS == 64
+    10000000000U,
+    100000000000U,
+    1000000000000U,
+    10000000000000U,
+    100000000000000U,
+    1000000000000000U,
+    10000000000000000U,
+    100000000000000000U,
+    1000000000000000000U,
+    10000000000000000000U,
+#endif
 };
 
+/* The radix conversions of large BigInts split the digits in two
+   halves and combine them with a multiplication or a division by a
+   power of the radix. The recursion stops below these numbers of
+   limbs. */
+#define JS_FROM_DEC_THRESHOLD 64
+#define JS_TO_RADIX_THRESHOLD 32
+
+/* js_bigint_recip() uses a schoolbook division below this number of
+   limbs */
+#define JS_RECIP_THRESHOLD 32
+
+#define JS_RADIX_POW_CACHE_SIZE 64
+
+/* powers of radix_base used by the radix conversions */
+typedef struct {
+    js_limb_t radix_base;
+    int count;
+    int exp[JS_RADIX_POW_CACHE_SIZE];
+    JSBigInt *pow[JS_RADIX_POW_CACHE_SIZE];
+    JSBigInt *recip[JS_RADIX_POW_CACHE_SIZE]; /* see js_radix_recip() */
+} JSRadixPowCache;
+
+/* number of significant bits of 'a' >= 0 */
+static int js_bigint_bits(const JSBigInt *a)
+{
+    return a->len * JS_LIMB_BITS - js_limb_clz(a->tab[a->len - 1]);
+}
+
+/* return radix_base^e. The result is owned by the cache. */
+static JSBigInt *js_radix_pow(JSContext *ctx, JSRadixPowCache *s, int e)
+{
+    JSBigInt *r, *t;
+    int i;
+
+    for(i = 0; i < s->count; i++) {
+        if (s->exp[i] == e)
+            return s->pow[i];
+    }
+    if (e == 1) {
+        r = js_bigint_new_ui64(ctx, s->radix_base);
+    } else {
+        t = js_radix_pow(ctx, s, e / 2);
+        if (!t)
+            return NULL;
+        r = js_bigint_mul(ctx, t, t);
+        if (r && (e & 1)) {
+            t = js_radix_pow(ctx, s, 1);
+            if (!t) {
+                js_free(ctx, r);
+                return NULL;
+            }
+            t = js_bigint_mul(ctx, r, t);
+            js_free(ctx, r);
+            r = t;
+        }
+    }
+    if (!r)
+        return NULL;
+    /* the exponents are of the form floor(e0 / 2^n) or ceil(e0 /
+       2^n) so the cache cannot be full */
+    assert(s->count < JS_RADIX_POW_CACHE_SIZE);
+    s->exp[s->count] = e;
+    s->pow[s->count] = r;
+    s->recip[s->count] = NULL;
+    s->count++;
+    return r;
+}
+
+static void js_radix_pow_cache_free(JSContext *ctx, JSRadixPowCache *s)
+{
+    int i;
+    for(i = 0; i < s->count; i++) {
+        js_free(ctx, s->pow[i]);
+        js_free(ctx, s->recip[i]);
+    }
+}
+
+/* Adjust 'q' and 'r' = a - q * d by a few units so that 0 <= r <
+   d. They are freed in case of memory error. */
+static int js_bigint_divrem_fixup(JSContext *ctx, JSBigInt **pq,
+                                  JSBigInt **pr, const JSBigInt *d)
+{
+    JSBigIntBuf buf;
+    JSBigInt *q, *r, *t;
+    int neg;
+
+    q = *pq;
+    r = *pr;
+    for(;;) {
+        neg = js_bigint_sign(r);
+        if (!neg && js_bigint_cmp(ctx, r, d) < 0)
+            break;
+        t = js_bigint_add(ctx, r, d, !neg);
+        js_free(ctx, r);
+        r = t;
+        t = js_bigint_add(ctx, q, js_bigint_set_si(&buf, 1), neg);
+        js_free(ctx, q);
+        q = t;
+        if (!q || !r) {
+            js_free(ctx, q);
+            js_free(ctx, r);
+            *pq = *pr = NULL;
+            return -1;
+        }
+    }
+    *pq = q;
+    *pr = r;
+    return 0;
+}
+
+/* return floor(2^(2k) / d) with 2^(k-1) <= d < 2^k. The reciprocal
+   of the high half of 'd' is refined with one Newton iteration. */
+static JSBigInt *js_bigint_recip(JSContext *ctx, const JSBigInt *d, int k)
+{
+    JSBigIntBuf buf;
+    JSBigInt *p2, *x, *e, *t;
+    int h;
+
+    p2 = js_bigint_shl(ctx, js_bigint_set_si(&buf, 1), 2 * k);
+    if (!p2)
+        return NULL;
+    if (k <= JS_LIMB_BITS * JS_RECIP_THRESHOLD) {
+        x = js_bigint_divrem(ctx, p2, d, false);
+        js_free(ctx, p2);
+        return x;
+    }
+    x = e = NULL;
+    h = k / 2 + JS_LIMB_BITS;
+    t = js_bigint_shr(ctx, d, k - h);
+    if (!t)
+        goto fail;
+    x = js_bigint_recip(ctx, t, h);
+    js_free(ctx, t);
+    if (!x)
+        goto fail;
+    /* x' = x + x * (2^(2k) - d * x) / 2^(2k) with x = x_h * 2^(k -
+       h) */
+    t = js_bigint_mul(ctx, d, x);
+    if (!t)
+        goto fail;
+    e = js_bigint_shl(ctx, t, k - h);
+    js_free(ctx, t);
+    if (!e)
+        goto fail;
+    t = js_bigint_add(ctx, p2, e, 1);
+    js_free(ctx, e);
+    e = NULL;
+    if (!t)
+        goto fail;
+    e = js_bigint_mul(ctx, x, t);
+    js_free(ctx, t);
+    if (!e)
+        goto fail;
+    t = js_bigint_shr(ctx, e, k + h);
+    js_free(ctx, e);
+    e = t;
+    if (!e)
+        goto fail;
+    t = js_bigint_shl(ctx, x, k - h);
+    js_free(ctx, x);
+    x = NULL;
+    if (!t)
+        goto fail;
+    x = js_bigint_add(ctx, t, e, 0);
+    js_free(ctx, t);
+    js_free(ctx, e);
+    e = NULL;
+    if (!x)
+        goto fail;
+    /* the error is a few units */
+    t = js_bigint_mul(ctx, d, x);
+    if (!t)
+        goto fail;
+    e = js_bigint_add(ctx, p2, t, 1);
+    js_free(ctx, t);
+    if (!e)
+        goto fail;
+    js_free(ctx, p2);
+    if (js_bigint_divrem_fixup(ctx, &x, &e, d))
+        return NULL;
+    js_free(ctx, e);
+    return x;
+ fail:
+    js_free(ctx, p2);
+    js_free(ctx, x);
+    js_free(ctx, e);
+    return NULL;
+}
+
+/* return floor(2^(2k) / radix_base^e) where k is the number of bits
+   of radix_base^e, which must be in the cache. The result is owned
+   by the cache. */
+static JSBigInt *js_radix_recip(JSContext *ctx, JSRadixPowCache *s, int e)
+{
+    int i;
+
+    for(i = 0; s->exp[i] != e; i++)
+        continue;
+    if (!s->recip[i]) {
+        s->recip[i] = js_bigint_recip(ctx, s->pow[i],
+                                      js_bigint_bits(s->pow[i]));
+    }
+    return s->recip[i];
+}
+
+/* q = floor(a / d) and r = a - q * d for 0 <= a < 2^(2k) and 2^(k-1)
+   <= d < 2^k. 'v' = floor(2^(2k) / d). */
+static int js_bigint_divrem_recip(JSContext *ctx, JSBigInt **pq,
+                                  JSBigInt **pr, const JSBigInt *a,
+                                  const JSBigInt *d, const JSBigInt *v)
+{
+    JSBigInt *q, *r, *t;
+    int k;
+
+    k = js_bigint_bits(d);
+    /* q = ((a >> (k - 1)) * v) >> (k + 1) is smaller than the exact
+       quotient by at most 2 */
+    t = js_bigint_shr(ctx, a, k - 1);
+    if (!t)
+        return -1;
+    r = js_bigint_mul(ctx, t, v);
+    js_free(ctx, t);
+    if (!r)
+        return -1;
+    q = js_bigint_shr(ctx, r, k + 1);
+    js_free(ctx, r);
+    if (!q)
+        return -1;
+    t = js_bigint_mul(ctx, q, d);
+    if (!t) {
+        js_free(ctx, q);
+        return -1;
+    }
+    r = js_bigint_add(ctx, a, t, 1);
+    js_free(ctx, t);
+    if (!r) {
+        js_free(ctx, q);
+        return -1;
+    }
+    *pq = q;
+    *pr = r;
+    return js_bigint_divrem_fixup(ctx, pq, pr, d);
+}
+
+/* append the 'n_digits' decimal digits at 'p' to tab[0..len-1].
+   Return the new number of limbs. */
+static int js_mp_from_dec(js_limb_t *tab, int len, const char *p,
+                          int n_digits)
+{
+    int i, n;
+    js_limb_t v, h;
+
+    while (n_digits > 0) {
+        n = min_int(n_digits, JS_LIMB_DIGITS);
+        v = 0;
+        for(i = 0; i < n; i++)
+            v = v * 10 + (*p++ - '0');
+        n_digits -= n;
+        if (len == 1 && tab[0] == 0) {
+            tab[0] = v;
+        } else {
+            h = js_mp_mul1(tab, tab, len, js_pow_dec[n], v);
+            if (h != 0)
+                tab[len++] = h;
+        }
+    }
+    return len;
+}
+
+/* return the value of the 'n_digits' decimal digits at 'p' */
+static JSBigInt *js_bigint_from_dec(JSContext *ctx, const char *p,
+                                    int n_digits, JSRadixPowCache *s)
+{
+    JSBigInt *r, *hi, *lo, *t;
+    int e, len, n;
+
+    len = (n_digits * 27 + 7) / 8 / JS_LIMB_BITS + 1;
+    if (n_digits < JS_LIMB_DIGITS * JS_FROM_DEC_THRESHOLD ||
+        len > JS_BIGINT_MAX_SIZE - 8) {
+        /* the intermediate products have a few more limbs than the
+           result, so the last digits of the largest numbers are
+           added one limb at a time */
+        n = 0;
+        hi = NULL;
+        if (n_digits >= JS_LIMB_DIGITS * JS_FROM_DEC_THRESHOLD) {
+            n = n_digits - JS_LIMB_DIGITS * 16;
+            hi = js_bigint_from_dec(ctx, p, n, s);
+            if (!hi)
+                return NULL;
+        }
+        r = js_bigint_new(ctx, len);
+        if (!r) {
+            js_free(ctx, hi);
+            return NULL;
+        }
+        if (hi) {
+            memcpy(r->tab, hi->tab, hi->len * sizeof(r->tab[0]));
+            len = hi->len;
+            js_free(ctx, hi);
+        } else {
+            r->tab[0] = 0;
+            len = 1;
+        }
+        len = js_mp_from_dec(r->tab, len, p + n, n_digits - n);
+        /* add one extra limb to have the correct sign*/
+        if ((r->tab[len - 1] >> (JS_LIMB_BITS - 1)) != 0)
+            r->tab[len++] = 0;
+        r->len = len;
+        return r;
+    }
+    /* the low part has 'e' limbs of JS_LIMB_DIGITS digits */
+    e = (n_digits + JS_LIMB_DIGITS - 1) / JS_LIMB_DIGITS / 2;
+    t = js_radix_pow(ctx, s, e);
+    if (!t)
+        return NULL;
+    hi = js_bigint_from_dec(ctx, p, n_digits - e * JS_LIMB_DIGITS, s);
+    if (!hi)
+        return NULL;
+    r = js_bigint_mul(ctx, hi, t);
+    js_free(ctx, hi);
+    if (!r)
+        return NULL;
+    lo = js_bigint_from_dec(ctx, p + n_digits - e * JS_LIMB_DIGITS,
+                            e * JS_LIMB_DIGITS, s);
+    if (!lo) {
+        js_free(ctx, r);
+        return NULL;
+    }
+    t = js_bigint_add(ctx, r, lo, 0);
+    js_free(ctx, r);
+    js_free(ctx, lo);
+    return t;
+}
+
 /* syntax: [-]digits in base radix. Return NULL if memory error. radix
    = 10, 2, 8 or 16. */
 static JSBigInt *js_bigint_from_string(JSContext *ctx,
@@ -13458,9 +14812,9 @@ static JSBigInt *js_bigint_from_string(JSContext *ctx,
 {
     const char *p = str;
     size_t n_digits1;
-    int is_neg, n_digits, n_limbs, len, log2_radix, n_bits, i;
+    int is_neg, n_digits, n_limbs, log2_radix, n_bits, i;
     JSBigInt *r;
-    js_limb_t v, c, h;
+    js_limb_t c;
 
     is_neg = 0;
     if (*p == '-') {
@@ -13486,42 +14840,22 @@ static JSBigInt *js_bigint_from_string(JSContext *ctx,
     }
     /* we add one extra bit for the sign */
     n_limbs = max_int(1, n_bits / JS_LIMB_BITS + 1);
-    r = js_bigint_new(ctx, n_limbs);
-    if (!r)
-        return NULL;
     if (radix == 10) {
-        int digits_per_limb = JS_LIMB_DIGITS;
-        len = 1;
-        r->tab[0] = 0;
-        for(;;) {
-            /* XXX: slow */
-            v = 0;
-            for(i = 0; i < digits_per_limb; i++) {
-                c = js_to_digit(*p);
-                if (c >= radix)
-                    break;
-                p++;
-                v = v * 10 + c;
-            }
-            if (i == 0)
-                break;
-            if (len == 1 && r->tab[0] == 0) {
-                r->tab[0] = v;
-            } else {
-                h = js_mp_mul1(r->tab, r->tab, len, js_pow_dec[i], v);
-                if (h != 0) {
-                    r->tab[len++] = h;
-                }
-            }
-        }
-        /* add one extra limb to have the correct sign*/
-        if ((r->tab[len - 1] >> (JS_LIMB_BITS - 1)) != 0)
-            r->tab[len++] = 0;
-        r->len = len;
+        JSRadixPowCache s;
+
+        s.radix_base = js_pow_dec[JS_LIMB_DIGITS];
+        s.count = 0;
+        r = js_bigint_from_dec(ctx, p, n_digits, &s);
+        js_radix_pow_cache_free(ctx, &s);
+        if (!r)
+            return NULL;
     } else {
         unsigned int bit_pos, shift, pos;
 
         /* power of two base: no multiplication is needed */
+        r = js_bigint_new(ctx, n_limbs);
+        if (!r)
+            return NULL;
         r->len = n_limbs;
         memset(r->tab, 0, sizeof(r->tab[0]) * n_limbs);
         for(i = 0; i < n_digits; i++) {
@@ -13604,6 +14938,8 @@ static char *js_limb_to_a(char *q, js_limb_t n, unsigned int radix, int len)
 
 #define JS_RADIX_MAX 36
 
+#if JS_LIMB_BITS == 32
+
 static const uint8_t js_digits_per_limb_table[JS_RADIX_MAX - 1] = {
 32,20,16,13,12,11,10,10, 9, 9, 8, 8, 8, 8, 8, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
 };
@@ -13620,6 +14956,110 @@ static const js_limb_t js_radix_base_table[JS_RADIX_MAX - 1] = {
  0x5c13d840, 0x6d91b519, 0x81bf1000,
 };
 
+#else
+
+static const uint8_t js_digits_per_limb_table[JS_RADIX_MAX - 1] = {
+64,40,32,27,24,22,21,20,19,18,17,17,16,16,16,15,15,15,14,14,14,14,13,13,13,13,13,13,13,12,12,12,12,12,12,
+};
+
+static const js_limb_t js_radix_base_table[JS_RADIX_MAX - 1] = {
+ 0x0000000000000000, 0xa8b8b452291fe821,
+ 0x0000000000000000, 0x6765c793fa10079d,
+ 0x41c21cb8e1000000, 0x3642798750226111,
+ 0x8000000000000000, 0xa8b8b452291fe821,
+ 0x8ac7230489e80000, 0x4d28cb56c33fa539,
+ 0x1eca170c00000000, 0x780c7372621bd74d,
+ 0x1e39a5057d810000, 0x5b27ac993df97701,
+ 0x0000000000000000, 0x27b95e997e21d9f1,
+ 0x5da0e1e53c5c8000, 0xd2ae3299c1c4aedb,
+ 0x16bcc41e90000000, 0x2d04b7fdd9c0ef49,
+ 0x5658597bcaa24000, 0xa0e2073737609371,
+ 0x0c29e98000000000, 0x14adf4b7320334b9,
+ 0x226ed36478bfa000, 0x383d9170b85ff80b,
+ 0x5a3c23e39c000000, 0x8e65137388122bcd,
+ 0xdd41bb36d259e000, 0x0aee5720ee830681,
+ 0x1000000000000000, 0x172588ad4f5f0981,
+ 0x211e44f7d02c1000, 0x2ee56725f06e5c71,
+ 0x41c21cb8e1000000,
+};
+
+#endif
+
+/* write the digits of tab[0..len-1] backwards from 'q'. 'tab' is
+   modified. The result is padded with zeros to 'n_digits' digits. */
+static char *js_mp_to_a(char *q, js_limb_t *tab, int len, int radix,
+                        int n_digits)
+{
+    char *q_end;
+    js_limb_t radix_base, v;
+
+    q_end = q;
+    radix_base = js_radix_base_table[radix - 2];
+    for(;;) {
+        /* remove leading zero limbs */
+        while (len > 1 && tab[len - 1] == 0)
+            len--;
+        if (len == 1 && tab[0] < radix_base) {
+            v = tab[0];
+            if (v != 0) {
+                q = js_u64toa(q, v, radix);
+            }
+            break;
+        } else {
+            v = js_mp_div1(tab, tab, len, radix_base, 0);
+            q = js_limb_to_a(q, v, radix, js_digits_per_limb_table[radix - 2]);
+        }
+    }
+    while (q_end - q < n_digits)
+        *--q = '0';
+    return q;
+}
+
+/* write the digits of 0 <= a < radix_base^e backwards from 'q'. 'a'
+   is freed. If 'pad' is true, exactly e * digits_per_limb digits are
+   written. Return NULL if memory error. */
+static char *js_bigint_to_a(JSContext *ctx, char *q, JSBigInt *a, int radix,
+                            int e, bool pad, JSRadixPowCache *s)
+{
+    JSBigInt *d, *v, *hi, *lo;
+    int e_lo, digits_per_limb;
+
+    digits_per_limb = js_digits_per_limb_table[radix - 2];
+    if (e < JS_TO_RADIX_THRESHOLD) {
+        q = js_mp_to_a(q, a->tab, a->len, radix,
+                       pad ? e * digits_per_limb : 0);
+        js_free(ctx, a);
+        return q;
+    }
+    /* the high part must be smaller than radix_base^e_lo */
+    e_lo = (e + 1) / 2;
+    d = js_radix_pow(ctx, s, e_lo);
+    if (!d)
+        goto fail;
+    if (js_bigint_cmp(ctx, a, d) < 0) {
+        q = js_bigint_to_a(ctx, q, a, radix, e_lo, pad, s);
+        if (q && pad) {
+            memset(q - (e - e_lo) * digits_per_limb, '0',
+                   (e - e_lo) * digits_per_limb);
+            q -= (e - e_lo) * digits_per_limb;
+        }
+        return q;
+    }
+    v = js_radix_recip(ctx, s, e_lo);
+    if (!v || js_bigint_divrem_recip(ctx, &hi, &lo, a, d, v))
+        goto fail;
+    js_free(ctx, a);
+    q = js_bigint_to_a(ctx, q, lo, radix, e_lo, true, s);
+    if (!q) {
+        js_free(ctx, hi);
+        return NULL;
+    }
+    return js_bigint_to_a(ctx, q, hi, radix, e - e_lo, pad, s);
+ fail:
+    js_free(ctx, a);
+    return NULL;
+}
+
 static JSValue js_bigint_to_string1(JSContext *ctx, JSValueConst val, int radix)
 {
     if (JS_VALUE_GET_TAG(val) == JS_TAG_SHORT_BIG_INT) {
@@ -13670,24 +15110,30 @@ static JSValue js_bigint_to_string1(JSContext *ctx, JSValueConst val, int radix)
         *--q = '\0';
         buf_end = q;
         if (!is_binary_radix) {
-            int len;
-            js_limb_t radix_base, v;
-            radix_base = js_radix_base_table[radix - 2];
-            len = r->len;
-            for(;;) {
-                /* remove leading zero limbs */
-                while (len > 1 && r->tab[len - 1] == 0)
-                    len--;
-                if (len == 1 && r->tab[0] < radix_base) {
-                    v = r->tab[0];
-                    if (v != 0) {
-                        q = js_u64toa(q, v, radix);
-                    }
-                    break;
-                } else {
-                    v = js_mp_div1(r->tab, r->tab, len, radix_base, 0);
-                    q = js_limb_to_a(q, v, radix, js_digits_per_limb_table[radix - 2]);
-                }
+            JSRadixPowCache s;
+            js_limb_t v;
+            int e;
+
+            s.radix_base = js_radix_base_table[radix - 2];
+            s.count = 0;
+            /* the intermediate results of the divide and conquer
+               method have a few more limbs than 'r', so the last
+               digits of the largest numbers are removed one limb at
+               a time */
+            while (r->len > JS_BIGINT_MAX_SIZE - 8) {
+                v = js_mp_div1(r->tab, r->tab, r->len, s.radix_base, 0);
+                q = js_limb_to_a(q, v, radix,
+                                 js_digits_per_limb_table[radix - 2]);
+                r = js_bigint_normalize(ctx, r);
+            }
+            /* r < radix_base^e */
+            e = js_bigint_bits(r) / log2(s.radix_base) + 1;
+            q = js_bigint_to_a(ctx, q, r, radix, e, false, &s);
+            js_radix_pow_cache_free(ctx, &s);
+            tmp = NULL;
+            if (!q) {
+                js_free(ctx, buf);
+                return JS_EXCEPTION;
             }
         } else {
             int i, shift;
@@ -14679,26 +16125,35 @@ static JSValue JS_ToStringCheckObject(JSContext *ctx, JSValueConst val)
     return JS_ToString(ctx, val);
 }
 
-static JSValue JS_ToQuotedString(JSContext *ctx, JSValueConst val1)
+static inline bool is_quoted_plain_char(uint32_t c)
 {
-    JSValue val;
-    JSString *p;
-    int i;
+    return c >= 32 && c != '\"' && c != '\\' && !is_surrogate(c);
+}
+
+/* append the JSON quoted representation of 'p' */
+static int string_buffer_put_quoted(StringBuffer *b, JSString *p)
+{
+    int i, j;
     uint32_t c;
-    StringBuffer b_s, *b = &b_s;
     char buf[16];
 
-    val = JS_ToStringCheckObject(ctx, val1);
-    if (JS_IsException(val))
-        return val;
-    p = JS_VALUE_GET_STRING(val);
-
-    if (string_buffer_init(ctx, b, p->len + 2))
-        goto fail;
-
     if (string_buffer_putc8(b, '\"'))
-        goto fail;
-    for(i = 0; i < p->len; ) {
+        return -1;
+    for(i = 0;;) {
+        /* copy the runs of characters which need no escaping at once */
+        j = i;
+        if (p->is_wide_char) {
+            while (j < p->len && is_quoted_plain_char(str16(p)[j]))
+                j++;
+        } else {
+            while (j < p->len && is_quoted_plain_char(str8(p)[j]))
+                j++;
+        }
+        if (string_buffer_concat(b, p, i, j))
+            return -1;
+        i = j;
+        if (i >= p->len)
+            break;
         c = string_getc(p, &i);
         switch(c) {
         case '\t':
@@ -14720,23 +16175,40 @@ static JSValue JS_ToQuotedString(JSContext *ctx, JSValueConst val1)
         case '\\':
         quote:
             if (string_buffer_putc8(b, '\\'))
-                goto fail;
+                return -1;
             if (string_buffer_putc8(b, c))
-                goto fail;
+                return -1;
             break;
         default:
             if (c < 32 || is_surrogate(c)) {
                 snprintf(buf, sizeof(buf), "\\u%04x", c);
                 if (string_buffer_write8(b, (uint8_t*)buf, 6))
-                    goto fail;
+                    return -1;
             } else {
+                /* surrogate pair */
                 if (string_buffer_putc(b, c))
-                    goto fail;
+                    return -1;
             }
             break;
         }
     }
-    if (string_buffer_putc8(b, '\"'))
+    return string_buffer_putc8(b, '\"');
+}
+
+static JSValue JS_ToQuotedString(JSContext *ctx, JSValueConst val1)
+{
+    JSValue val;
+    JSString *p;
+    StringBuffer b_s, *b = &b_s;
+
+    val = JS_ToStringCheckObject(ctx, val1);
+    if (JS_IsException(val))
+        return val;
+    p = JS_VALUE_GET_STRING(val);
+
+    if (string_buffer_init(ctx, b, p->len + 2))
+        goto fail;
+    if (string_buffer_put_quoted(b, p))
         goto fail;
     JS_FreeValue(ctx, val);
     return string_buffer_end(b);
@@ -14937,7 +16409,11 @@ static __maybe_unused void JS_DumpValue(JSRuntime *rt, JSValueConst val)
             for(i = p->len - 1; i >= 0; i--) {
                 if (i != p->len - 1)
                     printf("_");
+#if JS_LIMB_BITS == 32
                 printf("%08x", p->tab[i]);
+#else
+                printf("%016" PRIx64, p->tab[i]);
+#endif
             }
             printf("n");
             if (sgn)
@@ -15156,8 +16632,10 @@ static int JS_ToBigInt64Free(JSContext *ctx, int64_t *pres, JSValue val)
         JSBigInt *p = JS_VALUE_GET_PTR(val);
         /* return the value mod 2^64 */
         res = p->tab[0];
+#if JS_LIMB_BITS == 32
         if (p->len >= 2)
             res |= (uint64_t)p->tab[1] << 32;
+#endif
         JS_FreeValue(ctx, val);
     }
     *pres = res;
@@ -15266,7 +16744,9 @@ static no_inline __exception int js_unary_arith_slow(JSContext *ctx,
                 {
                     JSBigIntBuf buf2;
                     JSBigInt *p2;
-                    p2 = js_bigint_set_si(&buf2, 2 * (op - OP_dec) - 1);
+                    /* 'op' is unsigned: go through 'v' to get -1 */
+                    v = 2 * (op - OP_dec) - 1;
+                    p2 = js_bigint_set_si(&buf2, v);
                     r = js_bigint_add(ctx, p1, p2, 0);
                 }
                 break;
@@ -18021,11 +19501,206 @@ static void dump_single_byte_code(JSContext *ctx, const uint8_t *pc,
 static void print_func_name(JSFunctionBytecode *b);
 #endif
 
+/* Inline caches: each get_field, get_field2, put_field and get_length
+   instruction owns a slot of JSFunctionBytecode.ic remembering, for up
+   to JS_IC_WAYS receiver shapes, where the data property was found: in
+   the receiver itself or in its direct prototype. A shape id changes
+   whenever its layout is modified, so a matching id is enough to reuse
+   the property index. */
+
+static inline JSProperty *js_ic_find(JSFunctionBytecode *b, int slot,
+                                     JSObject *p)
+{
+    JSInlineCacheEntry *e;
+    JSObject *p1;
+    uint64_t id;
+    int i;
+
+    if (!b->ic || slot >= b->ic_count)
+        return NULL;
+    id = p->shape->id;
+    e = b->ic[slot].entries;
+    for(i = 0; i < JS_IC_WAYS; i++, e++) {
+        if (e->shape_id == id) {
+            if (likely(!e->holder_shape_id))
+                return &p->prop[e->prop_idx];
+            /* same test as js_get_field_uncached() */
+            if (unlikely(p->is_exotic) && p->class_id != JS_CLASS_ARRAY)
+                return NULL;
+            p1 = p->shape->proto;
+            if (p1->shape->id != e->holder_shape_id)
+                return NULL;
+            return &p1->prop[e->prop_idx];
+        }
+    }
+    return NULL;
+}
+
+/* Global variables use the same caches with global_var_obj as receiver
+   and global_obj as holder, so that a new lexical declaration
+   invalidates the entries of the shadowed global object properties. */
+static inline JSProperty *js_ic_find_global(JSContext *ctx,
+                                            JSFunctionBytecode *b, int slot)
+{
+    JSInlineCacheEntry *e;
+    JSObject *p, *p1;
+    JSProperty *pr;
+    uint64_t id;
+    int i;
+
+    if (!b->ic || slot >= b->ic_count)
+        return NULL;
+    p = JS_VALUE_GET_OBJ(ctx->global_var_obj);
+    id = p->shape->id;
+    e = b->ic[slot].entries;
+    for(i = 0; i < JS_IC_WAYS; i++, e++) {
+        if (e->shape_id == id) {
+            if (!e->holder_shape_id) {
+                pr = &p->prop[e->prop_idx];
+                /* another realm may share the shape */
+                if (unlikely(JS_IsUninitialized(pr->u.value)))
+                    return NULL;
+                return pr;
+            }
+            p1 = JS_VALUE_GET_OBJ(ctx->global_obj);
+            if (p1->shape->id != e->holder_shape_id)
+                return NULL;
+            return &p1->prop[e->prop_idx];
+        }
+    }
+    return NULL;
+}
+
+/* remember that the property 'pr' of 'holder' was accessed through
+   'p'. 'holder' is either 'p' or its prototype (or global_obj if 'p' is
+   global_var_obj). */
+static no_inline void js_ic_add(JSRuntime *rt, JSFunctionBytecode *b,
+                                int slot, JSObject *p, JSObject *holder,
+                                JSProperty *pr)
+{
+    JSInlineCacheEntry *e;
+
+    if (slot >= b->ic_count)
+        return;
+    if (!b->ic) {
+        /* don't bother for code which is seldom executed */
+        if (b->ic_warmup < max_int(b->ic_count, JS_IC_WARMUP)) {
+            b->ic_warmup++;
+            return;
+        }
+        b->ic = js_mallocz_rt(rt, sizeof(b->ic[0]) * b->ic_count);
+        if (!b->ic) {
+            b->ic_warmup = 0;
+            return;
+        }
+    }
+    e = b->ic[slot].entries;
+    memmove(e + 1, e, sizeof(*e) * (JS_IC_WAYS - 1));
+    e->shape_id = p->shape->id;
+    if (holder == p) {
+        e->holder_shape_id = 0;
+    } else {
+        e->holder_shape_id = holder->shape->id;
+    }
+    e->prop_idx = pr - holder->prop;
+}
+
+/* fast path of get_field when the inline cache misses: look for the
+   data property 'atom' in 'p' and its prototypes without calling any
+   getter or exotic handler. Return false if the generic path must be
+   used. */
+static bool js_get_field_uncached(JSRuntime *rt, JSFunctionBytecode *b,
+                                  int slot, JSObject *p, JSAtom atom,
+                                  JSValue *pval)
+{
+    JSObject *p1;
+    JSProperty *pr;
+    JSShapeProperty *prs;
+
+    p1 = p;
+    for(;;) {
+        prs = find_own_property(&pr, p1, atom);
+        if (prs) {
+            /* found */
+            if (unlikely(prs->flags & JS_PROP_TMASK))
+                return false;
+            if (p1 == p) {
+                js_ic_add(rt, b, slot, p, p, pr);
+            } else if (p1 == p->shape->proto &&
+                       !__JS_AtomIsTaggedInt(atom)) {
+                js_ic_add(rt, b, slot, p, p1, pr);
+            }
+            *pval = js_dup(pr->u.value);
+            return true;
+        }
+        if (unlikely(p1->is_exotic)) {
+            /* Array objects are ordinary for the properties which are
+               not array indexes */
+            /* XXX: should avoid the slow path for typed arrays by
+               ensuring that 'prop' is not numeric */
+            if (p1->class_id != JS_CLASS_ARRAY || __JS_AtomIsTaggedInt(atom))
+                return false;
+        }
+        p1 = p1->shape->proto;
+        if (!p1) {
+            *pval = JS_UNDEFINED;
+            return true;
+        }
+    }
+}
+
 static bool needs_backtrace(JSValue exc)
 {
     return can_store_error_stack(exc) || can_add_backtrace(exc);
 }
 
+/* the opcodes of a function are no longer quickened after this number
+   of deoptimizations */
+#define JS_QUICKEN_MAX_DEOPT 16
+
+/* rewrite the opcode at 'pc' to its specialized version 'op' */
+static inline void js_quicken(JSFunctionBytecode *b, uint8_t *pc, int op)
+{
+    if (likely(b->deopt_count < JS_QUICKEN_MAX_DEOPT))
+        *pc = op;
+}
+
+/* restore the generic opcode 'op' at 'pc' */
+static void js_deoptimize(JSFunctionBytecode *b, uint8_t *pc, int op)
+{
+    *pc = op;
+    if (b->deopt_count < JS_QUICKEN_MAX_DEOPT)
+        b->deopt_count++;
+}
+
+/* return the generic version of a quickened opcode */
+static inline int js_generic_opcode(int op)
+{
+    if (op >= OP_lt_f64 && op <= OP_gte_f64)
+        return op - OP_lt_f64 + OP_lt;
+    return op;
+}
+
+#ifdef CONFIG_JIT
+/* count a call or a loop iteration. Return true if the function has
+   just been compiled. */
+static no_inline bool js_jit_is_hot(JSContext *ctx, JSFunctionBytecode *b)
+{
+    if (++b->jit_counter < JS_JIT_THRESHOLD)
+        return false;
+    return js_jit_compile(ctx, b);
+}
+
+/* return true if the native code of 'b' can be entered. The functions
+   which could not be compiled cost a single test. */
+static inline bool js_jit_is_ready(JSContext *ctx, JSFunctionBytecode *b)
+{
+    if (likely(b->jit_counter >= JS_JIT_THRESHOLD && !b->jit))
+        return false;
+    return b->jit || js_jit_is_hot(ctx, b);
+}
+#endif
+
 /* argv[] is modified if (flags & JS_CALL_FLAG_COPY_ARGV) = 0. */
 static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                                JSValueConst this_obj, JSValueConst new_target,
@@ -18055,11 +19730,12 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 #define DEFAULT         default
 #define BREAK           break
 #else
-    __extension__ static const void * const dispatch_table[256] = {
+    /* one extra entry so that the default range is never empty */
+    __extension__ static const void * const dispatch_table[257] = {
 #define DEF(id, size, n_pop, n_push, f) && case_OP_ ## id,
 #define def(id, size, n_pop, n_push, f)
 #include "quickjs-opcode.h"
-        [ OP_COUNT ... 255 ] = &&case_default
+        [ OP_COUNT ... 256 ] = &&case_default
     };
 #define SWITCH(pc)      DUMP_BYTECODE_OR_DONT(pc) __extension__ ({ goto *dispatch_table[opcode = *pc++]; });
 #define CASE(op)        case_ ## op
@@ -18067,6 +19743,18 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 #define BREAK           SWITCH(pc)
 #endif
 
+#ifdef CONFIG_JIT
+/* loops are executed by the native code once the function is hot */
+#define JIT_BACKWARD_BRANCH(diff) if ((diff) < 0) goto jit_loop
+#else
+#define JIT_BACKWARD_BRANCH(diff)
+#endif
+
+    if (unlikely(rt->cpu_profile != NULL) && rt->cpu_profile->running &&
+        !rt->current_stack_frame && !rt->cpu_profile->in_js) {
+        return js_cpu_profile_call(caller_ctx, func_obj, this_obj, new_target,
+                                   argc, argv, flags);
+    }
     if (js_poll_interrupts(caller_ctx))
         return JS_EXCEPTION;
     if (unlikely(JS_VALUE_GET_TAG(func_obj) != JS_TAG_OBJECT)) {
@@ -18164,6 +19852,11 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         print_func_name(b);
 #endif
 
+#ifdef CONFIG_JIT
+    if (js_jit_is_ready(ctx, b))
+        goto jit_enter;
+#endif
+
  restart:
     for(;;) {
         int call_argc;
@@ -18215,39 +19908,30 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
         CASE(OP_get_length):
             {
                 JSValue val, obj;
-                JSAtom atom;
                 JSObject *p;
                 JSProperty *pr;
-                JSShapeProperty *prs;
+                int slot;
 
-                atom = JS_ATOM_length;
+                slot = get_u16(pc);
+                pc += 2;
 
                 obj = sp[-1];
                 if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
                     p = JS_VALUE_GET_OBJ(obj);
-                    for(;;) {
-                        prs = find_own_property(&pr, p, atom);
-                        if (prs) {
-                            /* found */
-                            if (unlikely(prs->flags & JS_PROP_TMASK))
-                                goto get_length_slow_path;
-                            val = js_dup(pr->u.value);
-                            break;
-                        }
-                        if (unlikely(p->is_exotic)) {
-                            obj = JS_MKPTR(JS_TAG_OBJECT, p);
-                            goto get_length_slow_path;
-                        }
-                        p = p->shape->proto;
-                        if (!p) {
-                            val = JS_UNDEFINED;
-                            break;
-                        }
+                    pr = js_ic_find(b, slot, p);
+                    if (likely(pr)) {
+                        val = js_dup(pr->u.value);
+                    } else if (!js_get_field_uncached(rt, b, slot, p,
+                                                      JS_ATOM_length, &val)) {
+                        goto get_length_slow_path;
                     }
+                } else if (JS_VALUE_GET_TAG(obj) == JS_TAG_STRING) {
+                    val = js_int32(JS_VALUE_GET_STRING(obj)->len);
                 } else {
                 get_length_slow_path:
                     sf->cur_pc = pc;
-                    val = JS_GetPropertyInternal(ctx, obj, atom, sp[-1], false);
+                    val = JS_GetPropertyInternal(ctx, obj, JS_ATOM_length,
+                                                 sp[-1], false);
                     if (unlikely(JS_IsException(val)))
                         goto exception;
                 }
@@ -18807,18 +20491,50 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             {
                 JSValue val;
                 JSAtom atom;
+                JSProperty *pr;
+                int slot;
                 atom = get_u32(pc);
-                pc += 4;
-                sf->cur_pc = pc;
+                slot = get_u16(pc + 4);
+                pc += 6;
 
-                val = JS_GetGlobalVar(ctx, atom, opcode - OP_get_var_undef);
-                if (unlikely(JS_IsException(val)))
-                    goto exception;
+                pr = js_ic_find_global(ctx, b, slot);
+                if (likely(pr)) {
+                    val = js_dup(pr->u.value);
+                } else {
+                    sf->cur_pc = pc;
+                    val = JS_GetGlobalVar(ctx, atom, opcode - OP_get_var_undef,
+                                          b, slot);
+                    if (unlikely(JS_IsException(val)))
+                        goto exception;
+                }
                 *sp++ = val;
             }
             BREAK;
 
         CASE(OP_put_var):
+            {
+                int ret, slot;
+                JSAtom atom;
+                JSProperty *pr;
+                atom = get_u32(pc);
+                slot = get_u16(pc + 4);
+                pc += 6;
+
+                /* only writable data properties are cached */
+                pr = js_ic_find_global(ctx, b, slot);
+                if (likely(pr)) {
+                    set_value(ctx, &pr->u.value, sp[-1]);
+                    sp--;
+                } else {
+                    sf->cur_pc = pc;
+                    ret = JS_SetGlobalVar(ctx, atom, sp[-1], 0, b, slot);
+                    sp--;
+                    if (unlikely(ret < 0))
+                        goto exception;
+                }
+            }
+            BREAK;
+
         CASE(OP_put_var_init):
             {
                 int ret;
@@ -18827,7 +20543,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 pc += 4;
                 sf->cur_pc = pc;
 
-                ret = JS_SetGlobalVar(ctx, atom, sp[-1], opcode - OP_put_var);
+                ret = JS_SetGlobalVar(ctx, atom, sp[-1], 1, b, JS_IC_SLOT_NONE);
                 sp--;
                 if (unlikely(ret < 0))
                     goto exception;
@@ -19145,19 +20861,31 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             BREAK;
 
         CASE(OP_goto):
-            pc += (int32_t)get_u32(pc);
-            if (unlikely(js_poll_interrupts(ctx)))
-                goto exception;
+            {
+                int32_t diff = get_u32(pc);
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
+                pc += diff;
+                JIT_BACKWARD_BRANCH(diff);
+            }
             BREAK;
         CASE(OP_goto16):
-            pc += (int16_t)get_u16(pc);
-            if (unlikely(js_poll_interrupts(ctx)))
-                goto exception;
+            {
+                int16_t diff = get_u16(pc);
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
+                pc += diff;
+                JIT_BACKWARD_BRANCH(diff);
+            }
             BREAK;
         CASE(OP_goto8):
-            pc += (int8_t)pc[0];
-            if (unlikely(js_poll_interrupts(ctx)))
-                goto exception;
+            {
+                int8_t diff = pc[0];
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
+                pc += diff;
+                JIT_BACKWARD_BRANCH(diff);
+            }
             BREAK;
         CASE(OP_if_true):
             {
@@ -19172,11 +20900,11 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     res = JS_ToBoolFree(ctx, op1);
                 }
                 sp--;
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
                 if (res) {
                     pc += (int32_t)get_u32(pc - 4) - 4;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
-                    goto exception;
             }
             BREAK;
         CASE(OP_if_false):
@@ -19192,11 +20920,11 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     res = JS_ToBoolFree(ctx, op1);
                 }
                 sp--;
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
                 if (!res) {
                     pc += (int32_t)get_u32(pc - 4) - 4;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
-                    goto exception;
             }
             BREAK;
         CASE(OP_if_true8):
@@ -19212,11 +20940,11 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     res = JS_ToBoolFree(ctx, op1);
                 }
                 sp--;
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
                 if (res) {
                     pc += (int8_t)pc[-1] - 1;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
-                    goto exception;
             }
             BREAK;
         CASE(OP_if_false8):
@@ -19232,11 +20960,11 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                     res = JS_ToBoolFree(ctx, op1);
                 }
                 sp--;
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
                 if (!res) {
                     pc += (int8_t)pc[-1] - 1;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
-                    goto exception;
             }
             BREAK;
         CASE(OP_catch):
@@ -19541,35 +21269,21 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 JSAtom atom;
                 JSObject *p;
                 JSProperty *pr;
-                JSShapeProperty *prs;
+                int slot;
 
                 atom = get_u32(pc);
-                pc += 4;
+                slot = get_u16(pc + 4);
+                pc += 6;
 
                 obj = sp[-1];
                 if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
                     p = JS_VALUE_GET_OBJ(obj);
-                    for(;;) {
-                        prs = find_own_property(&pr, p, atom);
-                        if (prs) {
-                            /* found */
-                            if (unlikely(prs->flags & JS_PROP_TMASK))
-                                goto get_field_slow_path;
-                            val = js_dup(pr->u.value);
-                            break;
-                        }
-                        if (unlikely(p->is_exotic)) {
-                            /* XXX: should avoid the slow path for arrays
-                               and typed arrays by ensuring that 'prop' is
-                               not numeric */
-                            obj = JS_MKPTR(JS_TAG_OBJECT, p);
-                            goto get_field_slow_path;
-                        }
-                        p = p->shape->proto;
-                        if (!p) {
-                            val = JS_UNDEFINED;
-                            break;
-                        }
+                    pr = js_ic_find(b, slot, p);
+                    if (likely(pr)) {
+                        val = js_dup(pr->u.value);
+                    } else if (!js_get_field_uncached(rt, b, slot, p,
+                                                      atom, &val)) {
+                        goto get_field_slow_path;
                     }
                 } else {
                 get_field_slow_path:
@@ -19589,35 +21303,21 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 JSAtom atom;
                 JSObject *p;
                 JSProperty *pr;
-                JSShapeProperty *prs;
+                int slot;
 
                 atom = get_u32(pc);
-                pc += 4;
+                slot = get_u16(pc + 4);
+                pc += 6;
 
                 obj = sp[-1];
                 if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
                     p = JS_VALUE_GET_OBJ(obj);
-                    for(;;) {
-                        prs = find_own_property(&pr, p, atom);
-                        if (prs) {
-                            /* found */
-                            if (unlikely(prs->flags & JS_PROP_TMASK))
-                                goto get_field2_slow_path;
-                            val = js_dup(pr->u.value);
-                            break;
-                        }
-                        if (unlikely(p->is_exotic)) {
-                            /* XXX: should avoid the slow path for arrays
-                               and typed arrays by ensuring that 'prop' is
-                               not numeric */
-                            obj = JS_MKPTR(JS_TAG_OBJECT, p);
-                            goto get_field2_slow_path;
-                        }
-                        p = p->shape->proto;
-                        if (!p) {
-                            val = JS_UNDEFINED;
-                            break;
-                        }
+                    pr = js_ic_find(b, slot, p);
+                    if (likely(pr)) {
+                        val = js_dup(pr->u.value);
+                    } else if (!js_get_field_uncached(rt, b, slot, p,
+                                                      atom, &val)) {
+                        goto get_field2_slow_path;
                     }
                 } else {
                 get_field2_slow_path:
@@ -19632,7 +21332,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 
         CASE(OP_put_field):
             {
-                int ret;
+                int ret, slot;
                 JSValue obj;
                 JSAtom atom;
                 JSObject *p;
@@ -19640,21 +21340,26 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 JSShapeProperty *prs;
 
                 atom = get_u32(pc);
-                pc += 4;
+                slot = get_u16(pc + 4);
+                pc += 6;
 
                 obj = sp[-2];
                 if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
                     p = JS_VALUE_GET_OBJ(obj);
-                    prs = find_own_property(&pr, p, atom);
-                    if (!prs)
-                        goto put_field_slow_path;
-                    if (likely((prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
-                                              JS_PROP_LENGTH)) == JS_PROP_WRITABLE)) {
-                        /* fast path */
-                        set_value(ctx, &pr->u.value, sp[-1]);
-                    } else {
-                        goto put_field_slow_path;
+                    /* only writable data properties of the receiver are
+                       cached */
+                    pr = js_ic_find(b, slot, p);
+                    if (unlikely(!pr)) {
+                        prs = find_own_property(&pr, p, atom);
+                        if (!prs)
+                            goto put_field_slow_path;
+                        if (unlikely((prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
+                                                    JS_PROP_LENGTH)) != JS_PROP_WRITABLE))
+                            goto put_field_slow_path;
+                        js_ic_add(rt, b, slot, p, p, pr);
                     }
+                    /* fast path */
+                    set_value(ctx, &pr->u.value, sp[-1]);
                     JS_FreeValue(ctx, obj);
                     sp -= 2;
                 } else {
@@ -20630,10 +22335,60 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 }                                                       \
             BREAK
 
-            OP_CMP(OP_lt, <, js_relational_slow(ctx, sp, opcode));
-            OP_CMP(OP_lte, <=, js_relational_slow(ctx, sp, opcode));
-            OP_CMP(OP_gt, >, js_relational_slow(ctx, sp, opcode));
-            OP_CMP(OP_gte, >=, js_relational_slow(ctx, sp, opcode));
+/* the relational operators are quickened to their float64 variant
+   when a float64 operand is seen. The variant is deoptimized when an
+   operand is not a number. */
+#define OP_CMP_QUICKEN(opcode, binary_op)                               \
+            CASE(opcode):                                               \
+                {                                                       \
+                JSValue op1, op2;                                       \
+                double d1, d2;                                          \
+                op1 = sp[-2];                                           \
+                op2 = sp[-1];                                           \
+                if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {           \
+                    sp[-2] = js_bool(JS_VALUE_GET_INT(op1) binary_op JS_VALUE_GET_INT(op2)); \
+                    sp--;                                               \
+                } else if (js_arith_to_float64(op1, &d1) &&             \
+                           js_arith_to_float64(op2, &d2)) {             \
+                    js_quicken(b, pc - 1, opcode ## _f64);              \
+                    sp[-2] = js_bool(d1 binary_op d2);                  \
+                    sp--;                                               \
+                } else {                                                \
+                    sf->cur_pc = pc;                                    \
+                    if (js_relational_slow(ctx, sp, opcode))            \
+                        goto exception;                                 \
+                    sp--;                                               \
+                }                                                       \
+                }                                                       \
+            BREAK;                                                      \
+            CASE(opcode ## _f64):                                       \
+                {                                                       \
+                JSValue op1, op2;                                       \
+                double d1, d2;                                          \
+                op1 = sp[-2];                                           \
+                op2 = sp[-1];                                           \
+                if (likely(JS_VALUE_IS_BOTH_FLOAT(op1, op2))) {         \
+                    sp[-2] = js_bool(JS_VALUE_GET_FLOAT64(op1) binary_op \
+                                     JS_VALUE_GET_FLOAT64(op2));        \
+                    sp--;                                               \
+                } else if (js_arith_to_float64(op1, &d1) &&             \
+                           js_arith_to_float64(op2, &d2)) {             \
+                    sp[-2] = js_bool(d1 binary_op d2);                  \
+                    sp--;                                               \
+                } else {                                                \
+                    js_deoptimize(b, pc - 1, opcode);                   \
+                    sf->cur_pc = pc;                                    \
+                    if (js_relational_slow(ctx, sp, opcode))            \
+                        goto exception;                                 \
+                    sp--;                                               \
+                }                                                       \
+                }                                                       \
+            BREAK
+
+            OP_CMP_QUICKEN(OP_lt, <);
+            OP_CMP_QUICKEN(OP_lte, <=);
+            OP_CMP_QUICKEN(OP_gt, >);
+            OP_CMP_QUICKEN(OP_gte, >=);
             OP_CMP(OP_eq, ==, js_eq_slow(ctx, sp, 0));
             OP_CMP(OP_neq, !=, js_eq_slow(ctx, sp, 1));
             OP_CMP(OP_strict_eq, ==, js_strict_eq_slow(ctx, sp, 0));
@@ -20880,6 +22635,12 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             JS_FreeValue(ctx, sp[-1]);
             sp[-1] = JS_FALSE;
             BREAK;
+#ifdef CONFIG_JIT
+        jit_loop:
+            if (js_jit_is_ready(ctx, b))
+                goto jit_enter;
+            BREAK;
+#endif
         CASE(OP_invalid):
         DEFAULT:
             JS_ThrowInternalError(ctx, "invalid opcode: pc=%u opcode=0x%02x",
@@ -20887,6 +22648,47 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             goto exception;
         }
     }
+#ifdef CONFIG_JIT
+    /* outside of the dispatch loop so that the control flow of the
+       interpreter stays reducible */
+ jit_enter:
+    {
+        JSJITFrame jf;
+        uint32_t native_pos;
+
+        native_pos = b->jit->pc_map[pc - b->byte_code_buf];
+        if (!native_pos)
+            goto restart; /* opcode not supported by the JIT */
+        jf.ctx = ctx;
+        jf.sp = sp;
+        jf.var_buf = var_buf;
+        jf.arg_buf = arg_buf;
+        jf.sf = sf;
+        jf.entry = b->jit->code + native_pos;
+        jf.caller_ctx = caller_ctx;
+        jf.b = b;
+        jf.var_refs = var_refs;
+        jf.this_obj = this_obj;
+        jf.new_target = new_target;
+        jf.argc = argc;
+        jf.argv = argv;
+        switch(((JSJITFunc *)b->jit->code)(&jf)) {
+        case JS_JIT_RETURN:
+            sp = jf.sp;
+            ret_val = jf.ret_val;
+            goto done;
+        case JS_JIT_EXCEPTION:
+            sp = jf.sp;
+            pc = (uint8_t *)jf.pc;
+            goto exception;
+        default:
+            sp = jf.sp;
+            pc = (uint8_t *)jf.pc;
+            break;
+        }
+    }
+    goto restart;
+#endif
  exception:
     if (needs_backtrace(rt->current_exception)
     || JS_IsUndefined(ctx->error_back_trace)) {
@@ -22398,6 +24200,7 @@ typedef struct JSParseState {
     JSFunctionDef *cur_func;
     bool is_module; /* parsing a module */
     bool allow_html_comments;
+    int64_t json_stream_pos; /* position of buf_start in a JSON stream or -1 */
 } JSParseState;
 
 typedef struct JSOpCode {
@@ -22432,6 +24235,1865 @@ static const JSOpCode opcode_info[OP_COUNT + (OP_TEMP_END - OP_TEMP_START)] = {
     opcode_info[(op) >= OP_TEMP_START ? \
                 (op) + (OP_TEMP_END - OP_TEMP_START) : (op)]
 
+/* number the inline cache slots of the final byte code. Return the
+   number of slots. */
+static int js_bytecode_init_ic(uint8_t *bc_buf, int bc_len)
+{
+    int pos, op, n;
+
+    n = 0;
+    for(pos = 0; pos < bc_len; pos += short_opcode_info(op).size) {
+        op = bc_buf[pos];
+        switch(op) {
+        case OP_get_field:
+        case OP_get_field2:
+        case OP_put_field:
+        case OP_get_var_undef:
+        case OP_get_var:
+        case OP_put_var:
+            put_u16(bc_buf + pos + 5, n < JS_IC_SLOT_NONE ? n++ : JS_IC_SLOT_NONE);
+            break;
+        case OP_get_length:
+            put_u16(bc_buf + pos + 1, n < JS_IC_SLOT_NONE ? n++ : JS_IC_SLOT_NONE);
+            break;
+        default:
+            break;
+        }
+    }
+    return n;
+}
+
+#ifdef CONFIG_JIT
+
+/* Baseline JIT: the byte code of the hot functions is translated to
+   x86-64 code which uses the same stack frame as the interpreter
+   (var_buf, arg_buf and the value stack, whose pointer is kept in a
+   register). The int32 cases of the arithmetic and the stack and local
+   variable accesses are inlined, most of the other opcodes call
+   js_jit_op(). The remaining opcodes return to the interpreter which
+   enters the native code again at the next loop iteration, unless the
+   loop itself contains such opcodes. */
+
+/* slow paths and complex opcodes of the native code. 'a' and 'a2' are
+   the opcode operands. Return the new stack pointer or NULL if there is
+   an exception. */
+static JSValue *js_jit_op(JSJITFrame *f, JSValue *sp, int op,
+                          uint32_t a, uint32_t a2)
+{
+    JSContext *ctx = f->ctx;
+    JSRuntime *rt = ctx->rt;
+    JSFunctionBytecode *b = f->b;
+    JSStackFrame *sf = f->sf;
+    JSValue val, obj, *call_argv;
+    JSObject *p;
+    JSProperty *pr;
+    int i, ret;
+
+    switch(op) {
+    case OP_goto:
+        /* backward branch */
+        if (__js_poll_interrupts(ctx))
+            goto exception;
+        break;
+    case OP_fclosure:
+        *sp++ = js_closure(ctx, js_dup(b->cpool[a]), f->var_refs, sf);
+        if (unlikely(JS_IsException(sp[-1])))
+            goto exception;
+        break;
+    case OP_push_atom_value:
+        *sp++ = JS_AtomToValue(ctx, a);
+        break;
+    case OP_push_empty_string:
+        *sp++ = js_empty_string(rt);
+        break;
+    case OP_push_this:
+        if (!b->is_strict_mode) {
+            uint32_t tag = JS_VALUE_GET_TAG(f->this_obj);
+            if (likely(tag == JS_TAG_OBJECT)) {
+                val = js_dup(f->this_obj);
+            } else if (tag == JS_TAG_NULL || tag == JS_TAG_UNDEFINED) {
+                val = js_dup(ctx->global_obj);
+            } else {
+                val = JS_ToObject(ctx, f->this_obj);
+                if (JS_IsException(val))
+                    goto exception;
+            }
+        } else {
+            val = js_dup(f->this_obj);
+        }
+        *sp++ = val;
+        break;
+    case OP_object:
+        *sp++ = JS_NewObject(ctx);
+        if (unlikely(JS_IsException(sp[-1])))
+            goto exception;
+        break;
+    case OP_special_object:
+        switch(a) {
+        case OP_SPECIAL_OBJECT_ARGUMENTS:
+            *sp++ = js_build_arguments(ctx, f->argc, f->argv);
+            break;
+        case OP_SPECIAL_OBJECT_MAPPED_ARGUMENTS:
+            *sp++ = js_build_mapped_arguments(ctx, f->argc, f->argv, sf,
+                                              min_int(f->argc, b->arg_count));
+            break;
+        case OP_SPECIAL_OBJECT_THIS_FUNC:
+            *sp++ = js_dup(sf->cur_func);
+            break;
+        case OP_SPECIAL_OBJECT_NEW_TARGET:
+            *sp++ = js_dup(f->new_target);
+            break;
+        case OP_SPECIAL_OBJECT_HOME_OBJECT:
+            p = JS_VALUE_GET_OBJ(sf->cur_func)->u.func.home_object;
+            if (unlikely(!p))
+                *sp++ = JS_UNDEFINED;
+            else
+                *sp++ = js_dup(JS_MKPTR(JS_TAG_OBJECT, p));
+            break;
+        case OP_SPECIAL_OBJECT_VAR_OBJECT:
+            *sp++ = JS_NewObjectProto(ctx, JS_NULL);
+            break;
+        case OP_SPECIAL_OBJECT_IMPORT_META:
+            *sp++ = js_import_meta(ctx);
+            break;
+        case OP_SPECIAL_OBJECT_NULL_PROTO:
+            *sp++ = JS_NewObjectProtoClass(ctx, JS_NULL, JS_CLASS_OBJECT);
+            break;
+        default:
+            abort();
+        }
+        if (unlikely(JS_IsException(sp[-1])))
+            goto exception;
+        break;
+    case OP_rest:
+        {
+            int n;
+            i = min_int(a, f->argc);
+            n = f->argc - i;
+            *sp++ = js_create_array(ctx, n, n ? &f->argv[i] : NULL);
+            if (unlikely(JS_IsException(sp[-1])))
+                goto exception;
+        }
+        break;
+    case OP_call:
+    case OP_tail_call:
+        call_argv = sp - a;
+        val = JS_CallInternal(ctx, call_argv[-1], JS_UNDEFINED,
+                              JS_UNDEFINED, a, vc(call_argv), 0);
+        if (unlikely(JS_IsException(val)))
+            goto exception;
+        if (op == OP_tail_call) {
+            f->ret_val = val;
+            break;
+        }
+        for(i = -1; i < (int)a; i++)
+            JS_FreeValue(ctx, call_argv[i]);
+        sp -= a + 1;
+        *sp++ = val;
+        break;
+    case OP_call_method:
+    case OP_tail_call_method:
+        call_argv = sp - a;
+        val = JS_CallInternal(ctx, call_argv[-1], call_argv[-2],
+                              JS_UNDEFINED, a, vc(call_argv), 0);
+        if (unlikely(JS_IsException(val)))
+            goto exception;
+        if (op == OP_tail_call_method) {
+            f->ret_val = val;
+            break;
+        }
+        for(i = -2; i < (int)a; i++)
+            JS_FreeValue(ctx, call_argv[i]);
+        sp -= a + 2;
+        *sp++ = val;
+        break;
+    case OP_call_constructor:
+        call_argv = sp - a;
+        val = JS_CallConstructorInternal(ctx, call_argv[-2], call_argv[-1],
+                                         a, vc(call_argv), 0);
+        if (unlikely(JS_IsException(val)))
+            goto exception;
+        for(i = -2; i < (int)a; i++)
+            JS_FreeValue(ctx, call_argv[i]);
+        sp -= a + 2;
+        *sp++ = val;
+        break;
+    case OP_array_from:
+        call_argv = sp - a;
+        val = JS_NewArrayFrom(ctx, a, call_argv);
+        sp -= a;
+        if (unlikely(JS_IsException(val)))
+            goto exception;
+        *sp++ = val;
+        break;
+    case OP_get_length:
+        a2 = a;
+        a = JS_ATOM_length;
+        /* fall through */
+    case OP_get_field:
+    case OP_get_field2:
+        obj = sp[-1];
+        if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+            p = JS_VALUE_GET_OBJ(obj);
+            pr = js_ic_find(b, a2, p);
+            if (likely(pr)) {
+                val = js_dup(pr->u.value);
+                goto get_field_done;
+            }
+            if (js_get_field_uncached(rt, b, a2, p, a, &val))
+                goto get_field_done;
+        } else if (op == OP_get_length &&
+                   JS_VALUE_GET_TAG(obj) == JS_TAG_STRING) {
+            val = js_int32(JS_VALUE_GET_STRING(obj)->len);
+            goto get_field_done;
+        }
+        val = JS_GetPropertyInternal(ctx, obj, a, obj, false);
+        if (unlikely(JS_IsException(val)))
+            goto exception;
+    get_field_done:
+        if (op == OP_get_field2) {
+            *sp++ = val;
+        } else {
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = val;
+        }
+        break;
+    case OP_put_field:
+        obj = sp[-2];
+        if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+            JSShapeProperty *prs;
+            p = JS_VALUE_GET_OBJ(obj);
+            pr = js_ic_find(b, a2, p);
+            if (unlikely(!pr)) {
+                prs = find_own_property(&pr, p, a);
+                if (!prs || (prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE |
+                                           JS_PROP_LENGTH)) != JS_PROP_WRITABLE)
+                    goto put_field_slow_path;
+                js_ic_add(rt, b, a2, p, p, pr);
+            }
+            set_value(ctx, &pr->u.value, sp[-1]);
+            JS_FreeValue(ctx, obj);
+            sp -= 2;
+            break;
+        }
+    put_field_slow_path:
+        ret = JS_SetPropertyInternal2(ctx, obj, a, sp[-1], obj,
+                                      JS_PROP_THROW_STRICT);
+        JS_FreeValue(ctx, obj);
+        sp -= 2;
+        if (unlikely(ret < 0))
+            goto exception;
+        break;
+    case OP_get_array_el:
+    case OP_get_array_el2:
+        if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_OBJECT &&
+                   JS_VALUE_GET_TAG(sp[-1]) == JS_TAG_INT)) {
+            uint32_t idx = JS_VALUE_GET_INT(sp[-1]);
+            p = JS_VALUE_GET_OBJ(sp[-2]);
+            if (likely(p->class_id == JS_CLASS_ARRAY &&
+                       idx < p->u.array.count)) {
+                val = js_dup(p->u.array.u.values[idx]);
+                goto get_array_el_done;
+            }
+            if (js_get_fast_array_element(ctx, p, idx, &val))
+                goto get_array_el_done;
+        }
+        val = JS_GetPropertyValue(ctx, sp[-2], sp[-1]);
+        if (op == OP_get_array_el2) {
+            sp[-1] = val;
+            if (unlikely(JS_IsException(val)))
+                goto exception;
+            break;
+        }
+        JS_FreeValue(ctx, sp[-2]);
+        sp[-2] = val;
+        sp--;
+        if (unlikely(JS_IsException(val)))
+            goto exception;
+        break;
+    get_array_el_done:
+        if (op == OP_get_array_el2) {
+            sp[-1] = val;
+        } else {
+            JS_FreeValue(ctx, sp[-2]);
+            sp[-2] = val;
+            sp--;
+        }
+        break;
+    case OP_put_array_el:
+        if (likely(JS_VALUE_GET_TAG(sp[-2]) == JS_TAG_INT &&
+                   JS_VALUE_GET_TAG(sp[-3]) == JS_TAG_OBJECT)) {
+            uint32_t idx = JS_VALUE_GET_INT(sp[-2]);
+            p = JS_VALUE_GET_OBJ(sp[-3]);
+            if (likely(p->class_id == JS_CLASS_ARRAY &&
+                       idx < (uint32_t)p->u.array.count)) {
+                set_value(ctx, &p->u.array.u.values[idx], sp[-1]);
+                JS_FreeValue(ctx, sp[-3]);
+                sp -= 3;
+                break;
+            }
+        }
+        ret = JS_SetPropertyValue(ctx, sp[-3], sp[-2], sp[-1],
+                                  JS_PROP_THROW_STRICT);
+        JS_FreeValue(ctx, sp[-3]);
+        sp -= 3;
+        if (unlikely(ret < 0))
+            goto exception;
+        break;
+    case OP_get_var_undef:
+    case OP_get_var:
+        pr = js_ic_find_global(ctx, b, a2);
+        if (likely(pr)) {
+            val = js_dup(pr->u.value);
+        } else {
+            val = JS_GetGlobalVar(ctx, a, op - OP_get_var_undef, b, a2);
+            if (unlikely(JS_IsException(val)))
+                goto exception;
+        }
+        *sp++ = val;
+        break;
+    case OP_put_var:
+        pr = js_ic_find_global(ctx, b, a2);
+        if (likely(pr)) {
+            set_value(ctx, &pr->u.value, sp[-1]);
+            sp--;
+        } else {
+            ret = JS_SetGlobalVar(ctx, a, sp[-1], 0, b, a2);
+            sp--;
+            if (unlikely(ret < 0))
+                goto exception;
+        }
+        break;
+    case OP_get_var_ref_check:
+        val = *f->var_refs[a]->pvalue;
+        if (unlikely(JS_IsUninitialized(val)))
+            goto var_ref_uninitialized;
+        *sp++ = js_dup(val);
+        break;
+    case OP_put_var_ref_check:
+        if (unlikely(JS_IsUninitialized(*f->var_refs[a]->pvalue)))
+            goto var_ref_uninitialized;
+        set_value(ctx, f->var_refs[a]->pvalue, sp[-1]);
+        sp--;
+        break;
+    case OP_put_var_ref_check_init:
+        if (unlikely(!JS_IsUninitialized(*f->var_refs[a]->pvalue)))
+            goto var_ref_uninitialized;
+        set_value(ctx, f->var_refs[a]->pvalue, sp[-1]);
+        sp--;
+        break;
+    var_ref_uninitialized:
+        JS_ThrowReferenceErrorUninitialized2(ctx, b, a, true);
+        goto exception;
+    case OP_get_loc_check:
+        /* only called when the variable is not initialized */
+        JS_ThrowReferenceErrorUninitialized2(f->caller_ctx, b, a, false);
+        goto exception;
+    case OP_put_loc_check_init:
+        /* only called when the variable is initialized */
+        JS_ThrowReferenceError(f->caller_ctx,
+                               "'this' can be initialized only once");
+        goto exception;
+    case OP_close_loc:
+        close_lexical_var(ctx, b, sf, a);
+        break;
+    case OP_define_field:
+        ret = JS_DefinePropertyValue(ctx, sp[-2], a, sp[-1],
+                                     JS_PROP_C_W_E | JS_PROP_THROW);
+        sp--;
+        if (unlikely(ret < 0))
+            goto exception;
+        break;
+    case OP_throw:
+        JS_Throw(ctx, *--sp);
+        goto exception;
+    case OP_add:
+        if (js_add_slow(ctx, sp))
+            goto exception;
+        sp--;
+        break;
+    case OP_sub:
+    case OP_mul:
+    case OP_div:
+    case OP_mod:
+    case OP_pow:
+        if (js_binary_arith_slow(ctx, sp, op))
+            goto exception;
+        sp--;
+        break;
+    case OP_lt:
+    case OP_lte:
+    case OP_gt:
+    case OP_gte:
+        if (js_relational_slow(ctx, sp, op))
+            goto exception;
+        sp--;
+        break;
+    case OP_eq:
+    case OP_neq:
+        if (js_eq_slow(ctx, sp, op == OP_neq))
+            goto exception;
+        sp--;
+        break;
+    case OP_strict_eq:
+    case OP_strict_neq:
+        if (js_strict_eq_slow(ctx, sp, op == OP_strict_neq))
+            goto exception;
+        sp--;
+        break;
+    case OP_shl:
+    case OP_sar:
+    case OP_and:
+    case OP_or:
+    case OP_xor:
+        if (js_binary_logic_slow(ctx, sp, op))
+            goto exception;
+        sp--;
+        break;
+    case OP_shr:
+        if (js_shr_slow(ctx, sp))
+            goto exception;
+        sp--;
+        break;
+    case OP_in:
+        if (js_operator_in(ctx, sp))
+            goto exception;
+        sp--;
+        break;
+    case OP_instanceof:
+        if (js_operator_instanceof(ctx, sp))
+            goto exception;
+        sp--;
+        break;
+    case OP_plus:
+    case OP_neg:
+    case OP_inc:
+    case OP_dec:
+        if (js_unary_arith_slow(ctx, sp, op))
+            goto exception;
+        break;
+    case OP_not:
+        if (js_not_slow(ctx, sp))
+            goto exception;
+        break;
+    case OP_post_inc:
+    case OP_post_dec:
+        if (js_post_inc_slow(ctx, sp, op))
+            goto exception;
+        sp++;
+        break;
+    case OP_lnot:
+        ret = JS_ToBoolFree(ctx, sp[-1]);
+        sp[-1] = js_bool(!ret);
+        break;
+    case OP_inc_loc:
+    case OP_dec_loc:
+        /* must duplicate otherwise the variable value may be
+           destroyed before JS code accesses it */
+        val = js_dup(f->var_buf[a]);
+        if (js_unary_arith_slow(ctx, &val + 1,
+                                op == OP_inc_loc ? OP_inc : OP_dec))
+            goto exception;
+        set_value(ctx, &f->var_buf[a], val);
+        break;
+    case OP_add_loc:
+        {
+            JSValue ops[2];
+            /* In case of exception, js_add_slow frees ops[0] and ops[1],
+               so we must duplicate the variable */
+            ops[0] = js_dup(f->var_buf[a]);
+            ops[1] = sp[-1];
+            sp--;
+            if (js_add_slow(ctx, ops + 2))
+                goto exception;
+            set_value(ctx, &f->var_buf[a], ops[0]);
+        }
+        break;
+    case OP_typeof:
+        {
+            JSAtom atom = js_operator_typeof(ctx, sp[-1]);
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = JS_AtomToString(ctx, atom);
+        }
+        break;
+    case OP_to_propkey:
+        switch(JS_VALUE_GET_TAG(sp[-1])) {
+        case JS_TAG_STRING:
+        case JS_TAG_SYMBOL:
+            break;
+        default:
+            val = JS_ToPropertyKey(ctx, sp[-1]);
+            if (JS_IsException(val))
+                goto exception;
+            JS_FreeValue(ctx, sp[-1]);
+            sp[-1] = val;
+            break;
+        }
+        break;
+    case OP_typeof_is_undefined:
+    case OP_typeof_is_function:
+        ret = (js_operator_typeof(ctx, sp[-1]) ==
+               (op == OP_typeof_is_undefined ? JS_ATOM_undefined :
+                JS_ATOM_function));
+        JS_FreeValue(ctx, sp[-1]);
+        sp[-1] = js_bool(ret);
+        break;
+    default:
+        abort();
+    }
+    return sp;
+ exception:
+    f->sp = sp;
+    return NULL;
+}
+
+enum {
+    JIT_RAX, JIT_RCX, JIT_RDX, JIT_RBX, JIT_RSP, JIT_RBP, JIT_RSI, JIT_RDI,
+    JIT_R8, JIT_R9, JIT_R10, JIT_R11, JIT_R12, JIT_R13, JIT_R14, JIT_R15,
+};
+
+/* callee saved registers holding the interpreter state */
+#define JIT_SP  JIT_RBX /* value stack pointer */
+#define JIT_SF  JIT_RBP /* JSStackFrame */
+#define JIT_VAR JIT_R12 /* var_buf */
+#define JIT_ARG JIT_R13 /* arg_buf */
+#define JIT_F   JIT_R14 /* JSJITFrame */
+#define JIT_CTX JIT_R15
+
+enum {
+    JIT_CC_O  = 0x0,
+    JIT_CC_B  = 0x2,
+    JIT_CC_AE = 0x3,
+    JIT_CC_E  = 0x4,
+    JIT_CC_NE = 0x5,
+    JIT_CC_A  = 0x7,
+    JIT_CC_S  = 0x8,
+    JIT_CC_L  = 0xc,
+    JIT_CC_GE = 0xd,
+    JIT_CC_LE = 0xe,
+    JIT_CC_G  = 0xf,
+};
+
+/* x86 ALU opcodes in the 'reg, r/m' direction */
+enum {
+    JIT_ADD = 0x03,
+    JIT_OR  = 0x0b,
+    JIT_AND = 0x23,
+    JIT_SUB = 0x2b,
+    JIT_XOR = 0x33,
+    JIT_CMP = 0x3b,
+};
+
+typedef struct JSJITReloc {
+    uint32_t code_pos; /* position of the rel32 field */
+    uint32_t bc_pos; /* target in the byte code */
+} JSJITReloc;
+
+typedef struct JSJITState {
+    JSContext *ctx;
+    JSFunctionBytecode *b;
+    DynBuf code;
+    uint32_t *op_pos; /* native position of all the opcodes */
+    JSJITReloc *relocs;
+    int reloc_count;
+    int reloc_size;
+    /* common code emitted after the prologue */
+    uint32_t label_epilogue;
+    uint32_t label_exception;
+    uint32_t label_bailout;
+    uint32_t label_return;
+    uint32_t label_free_value;
+    uint32_t *pc_map;
+    int last_bailout_pos; /* position of the last opcode not supported */
+    /* cost model, see jit_is_profitable() */
+    bool has_loop;
+    int op_count;
+    int helper_count; /* opcodes calling js_jit_op() or not supported */
+} JSJITState;
+
+static inline void jit_byte(JSJITState *s, int v)
+{
+    dbuf_putc(&s->code, v);
+}
+
+static inline uint32_t jit_pos(JSJITState *s)
+{
+    return s->code.size;
+}
+
+static void jit_rex(JSJITState *s, int w, int reg, int rm)
+{
+    int rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40)
+        jit_byte(s, rex);
+}
+
+static void jit_opcode(JSJITState *s, int opc)
+{
+    if (opc > 0xff)
+        jit_byte(s, opc >> 8);
+    jit_byte(s, opc);
+}
+
+/* 'opc reg, [base + disp]' */
+static void jit_mem(JSJITState *s, int w, int opc, int reg, int base,
+                    int32_t disp)
+{
+    bool disp8 = (disp == (int8_t)disp);
+    jit_rex(s, w, reg, base);
+    jit_opcode(s, opc);
+    jit_byte(s, (disp8 ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == JIT_RSP)
+        jit_byte(s, 0x24); /* SIB byte */
+    if (disp8)
+        jit_byte(s, disp);
+    else
+        dbuf_put_u32(&s->code, disp);
+}
+
+/* 'opc reg, rm' */
+static void jit_rr(JSJITState *s, int w, int opc, int reg, int rm)
+{
+    jit_rex(s, w, reg, rm);
+    jit_opcode(s, opc);
+    jit_byte(s, 0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void jit_load(JSJITState *s, int reg, int base, int32_t disp)
+{
+    jit_mem(s, 1, 0x8b, reg, base, disp);
+}
+
+static void jit_store(JSJITState *s, int base, int32_t disp, int reg)
+{
+    jit_mem(s, 1, 0x89, reg, base, disp);
+}
+
+static void jit_load32(JSJITState *s, int reg, int base, int32_t disp)
+{
+    jit_mem(s, 0, 0x8b, reg, base, disp);
+}
+
+/* sign extended to 64 bits */
+static void jit_store_imm(JSJITState *s, int base, int32_t disp, int32_t v)
+{
+    jit_mem(s, 1, 0xc7, 0, base, disp);
+    dbuf_put_u32(&s->code, v);
+}
+
+static void jit_mov(JSJITState *s, int dst, int src)
+{
+    jit_rr(s, 1, 0x89, src, dst);
+}
+
+static void jit_mov_imm(JSJITState *s, int reg, uint64_t v)
+{
+    if (v <= UINT32_MAX) {
+        jit_rex(s, 0, 0, reg);
+        jit_byte(s, 0xb8 + (reg & 7));
+        dbuf_put_u32(&s->code, v);
+    } else {
+        jit_rex(s, 1, 0, reg);
+        jit_byte(s, 0xb8 + (reg & 7));
+        dbuf_put_u64(&s->code, v);
+    }
+}
+
+/* 64 bit 'add reg, v' */
+static void jit_add_imm(JSJITState *s, int reg, int32_t v)
+{
+    if (v == (int8_t)v) {
+        jit_rr(s, 1, 0x83, 0, reg);
+        jit_byte(s, v);
+    } else {
+        jit_rr(s, 1, 0x81, 0, reg);
+        dbuf_put_u32(&s->code, v);
+    }
+}
+
+/* 32 bit 'cmp reg, v' with -128 <= v <= 127 */
+static void jit_cmp_imm8(JSJITState *s, int reg, int v)
+{
+    jit_rr(s, 0, 0x83, 7, reg);
+    jit_byte(s, v);
+}
+
+/* 32 bit 'cmp [base + disp], v' with -128 <= v <= 127 */
+static void jit_cmp_mem_imm8(JSJITState *s, int base, int32_t disp, int v)
+{
+    jit_mem(s, 0, 0x83, 7, base, disp);
+    jit_byte(s, v);
+}
+
+static void jit_push(JSJITState *s, int reg)
+{
+    jit_rex(s, 0, 0, reg);
+    jit_byte(s, 0x50 + (reg & 7));
+}
+
+static void jit_pop(JSJITState *s, int reg)
+{
+    jit_rex(s, 0, 0, reg);
+    jit_byte(s, 0x58 + (reg & 7));
+}
+
+static void jit_call_abs(JSJITState *s, const void *fn)
+{
+    jit_mov_imm(s, JIT_RAX, (uintptr_t)fn);
+    jit_rr(s, 0, 0xff, 2, JIT_RAX); /* call rax */
+}
+
+/* forward jumps: return the position of the rel32 field */
+static uint32_t jit_jcc(JSJITState *s, int cc)
+{
+    jit_byte(s, 0x0f);
+    jit_byte(s, 0x80 | cc);
+    dbuf_put_u32(&s->code, 0);
+    return jit_pos(s) - 4;
+}
+
+static uint32_t jit_jmp(JSJITState *s)
+{
+    jit_byte(s, 0xe9);
+    dbuf_put_u32(&s->code, 0);
+    return jit_pos(s) - 4;
+}
+
+static void jit_set_rel32(JSJITState *s, uint32_t pos, uint32_t target)
+{
+    if (!s->code.error)
+        put_u32(s->code.buf + pos, target - (pos + 4));
+}
+
+/* resolve a forward jump to the current position */
+static void jit_label(JSJITState *s, uint32_t pos)
+{
+    jit_set_rel32(s, pos, jit_pos(s));
+}
+
+static void jit_jcc_to(JSJITState *s, int cc, uint32_t target)
+{
+    jit_set_rel32(s, jit_jcc(s, cc), target);
+}
+
+static void jit_jmp_to(JSJITState *s, uint32_t target)
+{
+    jit_set_rel32(s, jit_jmp(s), target);
+}
+
+static void jit_call_to(JSJITState *s, uint32_t target)
+{
+    jit_byte(s, 0xe8);
+    dbuf_put_u32(&s->code, 0);
+    jit_set_rel32(s, jit_pos(s) - 4, target);
+}
+
+/* jump to a byte code position. 'cc' < 0 for an unconditional jump */
+static void jit_jump_bc(JSJITState *s, int cc, uint32_t bc_pos)
+{
+    JSJITReloc *re;
+    uint32_t pos;
+
+    pos = (cc < 0) ? jit_jmp(s) : jit_jcc(s, cc);
+    if (js_resize_array(s->ctx, (void **)&s->relocs, sizeof(s->relocs[0]),
+                        &s->reloc_size, s->reloc_count + 1)) {
+        s->code.error = true;
+        return;
+    }
+    re = &s->relocs[s->reloc_count++];
+    re->code_pos = pos;
+    re->bc_pos = bc_pos;
+}
+
+/* value in (rax, rcx) */
+static void jit_load_value(JSJITState *s, int base, int32_t disp)
+{
+    jit_load(s, JIT_RAX, base, disp);
+    jit_load(s, JIT_RCX, base, disp + 8);
+}
+
+static void jit_store_value(JSJITState *s, int base, int32_t disp)
+{
+    jit_store(s, base, disp, JIT_RAX);
+    jit_store(s, base, disp + 8, JIT_RCX);
+}
+
+/* the reference count is stored in the allocator block header */
+#define JIT_REF_COUNT_DISP ((int)offsetof(JSMallocBlockHeader, ref_count) - \
+                            (int)offsetof(JSMallocBlockHeader, user_data))
+
+static void jit_dup_value(JSJITState *s)
+{
+    uint32_t l;
+    jit_cmp_imm8(s, JIT_RCX, JS_TAG_FIRST);
+    l = jit_jcc(s, JIT_CC_B);
+    jit_mem(s, 0, 0xff, 0, JIT_RAX, JIT_REF_COUNT_DISP); /* inc ref_count */
+    jit_label(s, l);
+}
+
+/* free (rax, rcx). Clobbers the caller saved registers */
+static void jit_free_value(JSJITState *s)
+{
+    uint32_t l1, l2;
+    jit_cmp_imm8(s, JIT_RCX, JS_TAG_FIRST);
+    l1 = jit_jcc(s, JIT_CC_B);
+    jit_mem(s, 0, 0xff, 1, JIT_RAX, JIT_REF_COUNT_DISP); /* dec ref_count */
+    l2 = jit_jcc(s, JIT_CC_G);
+    jit_mov(s, JIT_RSI, JIT_RAX);
+    jit_mov(s, JIT_RDX, JIT_RCX);
+    jit_call_to(s, s->label_free_value);
+    jit_label(s, l1);
+    jit_label(s, l2);
+}
+
+static void jit_push_imm(JSJITState *s, int32_t val, int tag)
+{
+    jit_store_imm(s, JIT_SP, 0, val);
+    jit_store_imm(s, JIT_SP, 8, tag);
+    jit_add_imm(s, JIT_SP, 16);
+}
+
+/* push a copy of [base + disp] */
+static void jit_get(JSJITState *s, int base, int32_t disp)
+{
+    jit_load_value(s, base, disp);
+    jit_dup_value(s);
+    jit_store_value(s, JIT_SP, 0);
+    jit_add_imm(s, JIT_SP, 16);
+}
+
+/* store the top of the stack to [base + disp]. The value is popped if
+   'keep' is false. 'base' must not be rax, rcx, rdx or rsi */
+static void jit_put(JSJITState *s, int base, int32_t disp, bool keep)
+{
+    if (keep) {
+        jit_load_value(s, JIT_SP, -16);
+        jit_dup_value(s);
+        jit_load(s, JIT_RDX, base, disp);
+        jit_load(s, JIT_RSI, base, disp + 8);
+        jit_store_value(s, base, disp);
+        jit_mov(s, JIT_RAX, JIT_RDX);
+        jit_mov(s, JIT_RCX, JIT_RSI);
+    } else {
+        jit_load_value(s, base, disp);
+        jit_load(s, JIT_RDX, JIT_SP, -16);
+        jit_store(s, base, disp, JIT_RDX);
+        jit_load(s, JIT_RDX, JIT_SP, -8);
+        jit_store(s, base, disp + 8, JIT_RDX);
+        jit_add_imm(s, JIT_SP, -16);
+    }
+    jit_free_value(s);
+}
+
+/* rdi = var_refs[idx]->pvalue */
+static void jit_load_var_ref(JSJITState *s, int idx)
+{
+    jit_load(s, JIT_RDI, JIT_F, offsetof(JSJITFrame, var_refs));
+    jit_load(s, JIT_RDI, JIT_RDI, idx * sizeof(JSVarRef *));
+    jit_load(s, JIT_RDI, JIT_RDI, offsetof(JSVarRef, pvalue));
+}
+
+/* the values of the stack top are reordered: the new i-th value is
+   the old perm[i]-th one */
+static void jit_permute(JSJITState *s, int n, const uint8_t *perm)
+{
+    int i;
+    for(i = 0; i < n; i++)
+        jit_mem(s, 0, 0x0f10, i, JIT_SP, (i - n) * 16); /* movups */
+    for(i = 0; i < n; i++)
+        jit_mem(s, 0, 0x0f11, perm[i], JIT_SP, (i - n) * 16);
+}
+
+/* call js_jit_op(f, sp, op, a, a2). The stack pointer is updated with
+   the result. */
+static void jit_call_op(JSJITState *s, const uint8_t *next_pc, int op,
+                        uint32_t a, uint32_t a2)
+{
+    jit_mov_imm(s, JIT_RDX, op);
+    jit_mov_imm(s, JIT_RCX, a);
+    jit_mov_imm(s, JIT_R8, a2);
+    /* the exception and the backtrace use the position of the opcode */
+    jit_mov_imm(s, JIT_RAX, (uintptr_t)next_pc);
+    jit_store(s, JIT_SF, offsetof(JSStackFrame, cur_pc), JIT_RAX);
+    jit_mov(s, JIT_RDI, JIT_F);
+    jit_mov(s, JIT_RSI, JIT_SP);
+    jit_call_abs(s, js_jit_op);
+    jit_rr(s, 1, 0x85, JIT_RAX, JIT_RAX); /* test rax, rax */
+    jit_jcc_to(s, JIT_CC_E, s->label_exception);
+    jit_mov(s, JIT_SP, JIT_RAX);
+}
+
+/* rdi = address of the global variable of the inline cache 'slot' if
+   its first way matches (same test as js_ic_find_global()). The
+   positions of the jumps taken otherwise are stored in 'slow'. Return
+   their count. */
+static int jit_find_global(JSJITState *s, int slot, uint32_t *slow)
+{
+    int32_t disp = slot * sizeof(JSInlineCache);
+    uint32_t l_own;
+    int n = 0;
+
+    jit_mov_imm(s, JIT_RDX, (uintptr_t)&s->b->ic);
+    jit_load(s, JIT_RDX, JIT_RDX, 0);
+    jit_rr(s, 1, 0x85, JIT_RDX, JIT_RDX); /* test rdx, rdx */
+    slow[n++] = jit_jcc(s, JIT_CC_E);
+    jit_load(s, JIT_RDI, JIT_CTX, offsetof(JSContext, global_var_obj));
+    jit_load(s, JIT_RAX, JIT_RDI, offsetof(JSObject, shape));
+    jit_load(s, JIT_RAX, JIT_RAX, offsetof(JSShape, id));
+    jit_mem(s, 1, JIT_CMP, JIT_RAX, JIT_RDX,
+            disp + offsetof(JSInlineCacheEntry, shape_id));
+    slow[n++] = jit_jcc(s, JIT_CC_NE);
+    jit_load(s, JIT_RCX, JIT_RDX,
+             disp + offsetof(JSInlineCacheEntry, holder_shape_id));
+    jit_rr(s, 1, 0x85, JIT_RCX, JIT_RCX);
+    l_own = jit_jcc(s, JIT_CC_E);
+    jit_load(s, JIT_RDI, JIT_CTX, offsetof(JSContext, global_obj));
+    jit_load(s, JIT_RAX, JIT_RDI, offsetof(JSObject, shape));
+    jit_mem(s, 1, JIT_CMP, JIT_RCX, JIT_RAX, offsetof(JSShape, id));
+    slow[n++] = jit_jcc(s, JIT_CC_NE);
+    jit_label(s, l_own);
+    jit_load32(s, JIT_RAX, JIT_RDX,
+               disp + offsetof(JSInlineCacheEntry, prop_idx));
+    jit_rr(s, 1, 0x6b, JIT_RAX, JIT_RAX); /* imul rax, rax, imm8 */
+    jit_byte(s, sizeof(JSProperty));
+    jit_mem(s, 1, JIT_ADD, JIT_RAX, JIT_RDI, offsetof(JSObject, prop));
+    jit_mov(s, JIT_RDI, JIT_RAX);
+    /* another realm may share the shape */
+    jit_cmp_mem_imm8(s, JIT_RDI, 8, JS_TAG_UNINITIALIZED);
+    slow[n++] = jit_jcc(s, JIT_CC_E);
+    return n;
+}
+
+/* opcode always implemented by js_jit_op() */
+static void jit_call_helper(JSJITState *s, const uint8_t *next_pc, int op,
+                            uint32_t a, uint32_t a2)
+{
+    s->helper_count++;
+    jit_call_op(s, next_pc, op, a, a2);
+}
+
+static void jit_setcc(JSJITState *s, int cc, int reg)
+{
+    jit_rr(s, 0, 0x0f90 | cc, 0, reg); /* setcc reg8 */
+    jit_rr(s, 0, 0x0fb6, reg, reg); /* movzx reg, reg8 */
+}
+
+/* jump to 'slow' unless the two values at the top of the stack are
+   int32 */
+static uint32_t jit_check_both_int(JSJITState *s)
+{
+    jit_load32(s, JIT_RAX, JIT_SP, -24);
+    jit_mem(s, 0, JIT_OR, JIT_RAX, JIT_SP, -8);
+    return jit_jcc(s, JIT_CC_NE);
+}
+
+/* OP_add, OP_sub or OP_mul with float64 arithmetic if the two values at
+   the top of the stack are int32 or float64. The positions of the jumps
+   taken otherwise are stored in 'slow'. Return their count. */
+static int jit_float_arith(JSJITState *s, int op, uint32_t *slow)
+{
+    uint32_t l_int, l_done;
+    int i, n = 0;
+
+    for(i = 0; i < 2; i++) {
+        int32_t disp = (i - 2) * 16;
+        jit_cmp_mem_imm8(s, JIT_SP, disp + 8, JS_TAG_FLOAT64);
+        l_int = jit_jcc(s, JIT_CC_NE);
+        jit_byte(s, 0xf2);
+        jit_mem(s, 0, 0x0f10, i, JIT_SP, disp); /* movsd xmm[i] */
+        l_done = jit_jmp(s);
+        jit_label(s, l_int);
+        jit_cmp_mem_imm8(s, JIT_SP, disp + 8, JS_TAG_INT);
+        slow[n++] = jit_jcc(s, JIT_CC_NE);
+        jit_byte(s, 0xf2);
+        jit_mem(s, 0, 0x0f2a, i, JIT_SP, disp); /* cvtsi2sd xmm[i] */
+        jit_label(s, l_done);
+    }
+    jit_byte(s, 0xf2);
+    /* addsd, subsd or mulsd xmm0, xmm1 */
+    jit_rr(s, 0, op == OP_add ? 0x0f58 : op == OP_sub ? 0x0f5c : 0x0f59, 0, 1);
+    jit_byte(s, 0xf2);
+    jit_mem(s, 0, 0x0f11, 0, JIT_SP, -32); /* movsd */
+    jit_store_imm(s, JIT_SP, -24, JS_TAG_FLOAT64);
+    jit_add_imm(s, JIT_SP, -16);
+    return n;
+}
+
+/* backward branch to 'target'. The interpreter enters the native code
+   at the loop heads, except if the loop contains opcodes which are not
+   supported: switching between the two at each iteration would be
+   slower than interpreting the loop. */
+static void jit_loop_head(JSJITState *s, int target)
+{
+    s->has_loop = true;
+    if (s->last_bailout_pos >= target)
+        s->pc_map[target] = 0;
+}
+
+/* decrement the interrupt counter and poll the interrupts when it
+   reaches zero */
+static void jit_poll_interrupts(JSJITState *s, const uint8_t *next_pc)
+{
+    uint32_t l;
+    jit_mem(s, 0, 0xff, 1, JIT_CTX, offsetof(JSContext, interrupt_counter));
+    l = jit_jcc(s, JIT_CC_G);
+    jit_call_op(s, next_pc, OP_goto, 0, 0);
+    jit_label(s, l);
+}
+
+static void jit_return(JSJITState *s)
+{
+    jit_load_value(s, JIT_SP, -16);
+    jit_add_imm(s, JIT_SP, -16);
+    jit_store_value(s, JIT_F, offsetof(JSJITFrame, ret_val));
+    jit_jmp_to(s, s->label_return);
+}
+
+/* 'obj prop a -> a obj prop a' for n = 3 */
+static void jit_insert(JSJITState *s, int n)
+{
+    int i;
+    jit_load_value(s, JIT_SP, -16);
+    jit_dup_value(s);
+    for(i = 1; i <= n; i++) {
+        jit_mem(s, 0, 0x0f10, 0, JIT_SP, -16 * i); /* movups */
+        jit_mem(s, 0, 0x0f11, 0, JIT_SP, -16 * i + 16);
+    }
+    jit_store_value(s, JIT_SP, -16 * n);
+    jit_add_imm(s, JIT_SP, 16);
+}
+
+/* remove the value at 'sp[-n]' */
+static void jit_nip(JSJITState *s, int n)
+{
+    int i;
+    jit_load_value(s, JIT_SP, -16 * n);
+    for(i = n - 1; i >= 1; i--) {
+        jit_mem(s, 0, 0x0f10, 0, JIT_SP, -16 * i);
+        jit_mem(s, 0, 0x0f11, 0, JIT_SP, -16 * i - 16);
+    }
+    jit_add_imm(s, JIT_SP, -16);
+    jit_free_value(s);
+}
+
+static int jit_compare_cc(int op)
+{
+    switch(op) {
+    case OP_lt:
+        return JIT_CC_L;
+    case OP_lte:
+        return JIT_CC_LE;
+    case OP_gt:
+        return JIT_CC_G;
+    case OP_gte:
+        return JIT_CC_GE;
+    case OP_eq:
+    case OP_strict_eq:
+        return JIT_CC_E;
+    default:
+        return JIT_CC_NE;
+    }
+}
+
+/* return the target of a conditional jump or -1 */
+static int jit_if_target(const uint8_t *pc, int pos, bool *is_true)
+{
+    switch(pc[0]) {
+    case OP_if_true:
+    case OP_if_false:
+        *is_true = (pc[0] == OP_if_true);
+        return pos + 1 + (int32_t)get_u32(pc + 1);
+    case OP_if_true8:
+    case OP_if_false8:
+        *is_true = (pc[0] == OP_if_true8);
+        return pos + 1 + (int8_t)pc[1];
+    default:
+        return -1;
+    }
+}
+
+/* emit the native code of the opcode at 'pos'. Return false if it is
+   not supported. */
+static bool jit_emit_op(JSJITState *s, int pos)
+{
+    static const uint8_t perm_swap[] = { 1, 0 };
+    static const uint8_t perm_perm3[] = { 1, 0, 2 };
+    static const uint8_t perm_rot3l[] = { 1, 2, 0 };
+    static const uint8_t perm_rot3r[] = { 2, 0, 1 };
+    static const uint8_t perm_perm4[] = { 2, 0, 1, 3 };
+    static const uint8_t perm_perm5[] = { 3, 0, 1, 2, 4 };
+    static const uint8_t perm_rot4l[] = { 1, 2, 3, 0 };
+    static const uint8_t perm_rot5l[] = { 1, 2, 3, 4, 0 };
+    static const uint8_t perm_swap2[] = { 2, 3, 0, 1 };
+    JSFunctionBytecode *b = s->b;
+    const uint8_t *pc = b->byte_code_buf + pos;
+    const uint8_t *next_pc;
+    uint32_t l_slow, l_slow2, l_slow3, l_done, l_done2, slow[4];
+    int op, idx, cc, target, i, n_slow;
+    bool is_true = false;
+
+    op = pc[0];
+    next_pc = pc + short_opcode_info(op).size;
+    switch(op) {
+    case OP_push_i32:
+        jit_push_imm(s, get_u32(pc + 1), JS_TAG_INT);
+        break;
+    case OP_push_minus1:
+    case OP_push_0:
+    case OP_push_1:
+    case OP_push_2:
+    case OP_push_3:
+    case OP_push_4:
+    case OP_push_5:
+    case OP_push_6:
+    case OP_push_7:
+        jit_push_imm(s, op - OP_push_0, JS_TAG_INT);
+        break;
+    case OP_push_i8:
+        jit_push_imm(s, (int8_t)pc[1], JS_TAG_INT);
+        break;
+    case OP_push_i16:
+        jit_push_imm(s, (int16_t)get_u16(pc + 1), JS_TAG_INT);
+        break;
+    case OP_undefined:
+        jit_push_imm(s, 0, JS_TAG_UNDEFINED);
+        break;
+    case OP_null:
+        jit_push_imm(s, 0, JS_TAG_NULL);
+        break;
+    case OP_push_false:
+    case OP_push_true:
+        jit_push_imm(s, op - OP_push_false, JS_TAG_BOOL);
+        break;
+    case OP_push_const:
+    case OP_push_const8:
+        idx = (op == OP_push_const) ? get_u32(pc + 1) : pc[1];
+        jit_mov_imm(s, JIT_RDX, (uintptr_t)&b->cpool[idx]);
+        jit_get(s, JIT_RDX, 0);
+        break;
+    case OP_fclosure:
+    case OP_fclosure8:
+        idx = (op == OP_fclosure) ? get_u32(pc + 1) : pc[1];
+        jit_call_helper(s, next_pc, OP_fclosure, idx, 0);
+        break;
+    case OP_push_atom_value:
+        jit_call_helper(s, next_pc, op, get_u32(pc + 1), 0);
+        break;
+    case OP_push_empty_string:
+    case OP_push_this:
+    case OP_object:
+    case OP_get_array_el:
+    case OP_get_array_el2:
+    case OP_put_array_el:
+    case OP_throw:
+    case OP_div:
+    case OP_mod:
+    case OP_pow:
+    case OP_in:
+    case OP_instanceof:
+    case OP_typeof:
+    case OP_typeof_is_undefined:
+    case OP_typeof_is_function:
+        jit_call_helper(s, next_pc, op, 0, 0);
+        break;
+    case OP_special_object:
+        jit_call_helper(s, next_pc, op, pc[1], 0);
+        break;
+    case OP_rest:
+    case OP_get_length:
+    case OP_get_var_ref_check:
+    case OP_put_var_ref_check:
+    case OP_put_var_ref_check_init:
+    case OP_close_loc:
+    case OP_array_from:
+    case OP_call:
+    case OP_call_method:
+    case OP_call_constructor:
+        jit_call_helper(s, next_pc, op, get_u16(pc + 1), 0);
+        break;
+    case OP_call0:
+    case OP_call1:
+    case OP_call2:
+    case OP_call3:
+        jit_call_helper(s, next_pc, OP_call, op - OP_call0, 0);
+        break;
+    case OP_tail_call:
+    case OP_tail_call_method:
+        jit_call_helper(s, next_pc, op, get_u16(pc + 1), 0);
+        jit_jmp_to(s, s->label_return);
+        break;
+    case OP_get_var_undef:
+    case OP_get_var:
+    case OP_put_var:
+        idx = get_u16(pc + 5);
+        if (idx >= b->ic_count)
+            goto has_field;
+        n_slow = jit_find_global(s, idx, slow);
+        if (op == OP_put_var)
+            jit_put(s, JIT_RDI, 0, false);
+        else
+            jit_get(s, JIT_RDI, 0);
+        l_done = jit_jmp(s);
+        for(i = 0; i < n_slow; i++)
+            jit_label(s, slow[i]);
+        jit_call_op(s, next_pc, op, get_u32(pc + 1), idx);
+        jit_label(s, l_done);
+        break;
+    case OP_get_field:
+    case OP_get_field2:
+    case OP_put_field:
+    has_field:
+        jit_call_helper(s, next_pc, op, get_u32(pc + 1), get_u16(pc + 5));
+        break;
+    case OP_define_field:
+        jit_call_helper(s, next_pc, op, get_u32(pc + 1), 0);
+        break;
+    case OP_return:
+        jit_return(s);
+        break;
+    case OP_return_undef:
+        jit_store_imm(s, JIT_F, offsetof(JSJITFrame, ret_val), 0);
+        jit_store_imm(s, JIT_F, offsetof(JSJITFrame, ret_val) + 8,
+                      JS_TAG_UNDEFINED);
+        jit_jmp_to(s, s->label_return);
+        break;
+
+        /* local variables */
+    case OP_get_loc:
+    case OP_put_loc:
+    case OP_set_loc:
+        idx = get_u16(pc + 1);
+        goto has_loc;
+    case OP_get_loc8:
+    case OP_put_loc8:
+    case OP_set_loc8:
+        idx = pc[1];
+        op = op - OP_get_loc8 + OP_get_loc;
+        goto has_loc;
+    case OP_get_loc0:
+    case OP_get_loc1:
+    case OP_get_loc2:
+    case OP_get_loc3:
+        idx = op - OP_get_loc0;
+        op = OP_get_loc;
+        goto has_loc;
+    case OP_put_loc0:
+    case OP_put_loc1:
+    case OP_put_loc2:
+    case OP_put_loc3:
+        idx = op - OP_put_loc0;
+        op = OP_put_loc;
+        goto has_loc;
+    case OP_set_loc0:
+    case OP_set_loc1:
+    case OP_set_loc2:
+    case OP_set_loc3:
+        idx = op - OP_set_loc0;
+        op = OP_set_loc;
+    has_loc:
+        if (op == OP_get_loc)
+            jit_get(s, JIT_VAR, idx * 16);
+        else
+            jit_put(s, JIT_VAR, idx * 16, op == OP_set_loc);
+        break;
+    case OP_get_loc0_loc1:
+        jit_get(s, JIT_VAR, 0);
+        jit_get(s, JIT_VAR, 16);
+        break;
+    case OP_get_arg:
+    case OP_put_arg:
+    case OP_set_arg:
+        idx = get_u16(pc + 1);
+        goto has_arg;
+    case OP_get_arg0:
+    case OP_get_arg1:
+    case OP_get_arg2:
+    case OP_get_arg3:
+        idx = op - OP_get_arg0;
+        op = OP_get_arg;
+        goto has_arg;
+    case OP_put_arg0:
+    case OP_put_arg1:
+    case OP_put_arg2:
+    case OP_put_arg3:
+        idx = op - OP_put_arg0;
+        op = OP_put_arg;
+        goto has_arg;
+    case OP_set_arg0:
+    case OP_set_arg1:
+    case OP_set_arg2:
+    case OP_set_arg3:
+        idx = op - OP_set_arg0;
+        op = OP_set_arg;
+    has_arg:
+        if (op == OP_get_arg)
+            jit_get(s, JIT_ARG, idx * 16);
+        else
+            jit_put(s, JIT_ARG, idx * 16, op == OP_set_arg);
+        break;
+    case OP_get_var_ref:
+    case OP_put_var_ref:
+    case OP_set_var_ref:
+        idx = get_u16(pc + 1);
+        goto has_var_ref;
+    case OP_get_var_ref0:
+    case OP_get_var_ref1:
+    case OP_get_var_ref2:
+    case OP_get_var_ref3:
+        idx = op - OP_get_var_ref0;
+        op = OP_get_var_ref;
+        goto has_var_ref;
+    case OP_put_var_ref0:
+    case OP_put_var_ref1:
+    case OP_put_var_ref2:
+    case OP_put_var_ref3:
+        idx = op - OP_put_var_ref0;
+        op = OP_put_var_ref;
+        goto has_var_ref;
+    case OP_set_var_ref0:
+    case OP_set_var_ref1:
+    case OP_set_var_ref2:
+    case OP_set_var_ref3:
+        idx = op - OP_set_var_ref0;
+        op = OP_set_var_ref;
+    has_var_ref:
+        jit_load_var_ref(s, idx);
+        if (op == OP_get_var_ref)
+            jit_get(s, JIT_RDI, 0);
+        else
+            jit_put(s, JIT_RDI, 0, op == OP_set_var_ref);
+        break;
+    case OP_set_loc_uninitialized:
+        idx = get_u16(pc + 1);
+        jit_load_value(s, JIT_VAR, idx * 16);
+        jit_store_imm(s, JIT_VAR, idx * 16, 0);
+        jit_store_imm(s, JIT_VAR, idx * 16 + 8, JS_TAG_UNINITIALIZED);
+        jit_free_value(s);
+        break;
+    case OP_get_loc_check:
+    case OP_put_loc_check:
+    case OP_put_loc_check_init:
+        idx = get_u16(pc + 1);
+        jit_cmp_mem_imm8(s, JIT_VAR, idx * 16 + 8, JS_TAG_UNINITIALIZED);
+        l_done = jit_jcc(s, op == OP_put_loc_check_init ?
+                         JIT_CC_E : JIT_CC_NE);
+        /* always raises an exception */
+        jit_call_op(s, next_pc, op == OP_put_loc_check ? OP_get_loc_check : op,
+                    idx, 0);
+        jit_label(s, l_done);
+        if (op == OP_get_loc_check)
+            jit_get(s, JIT_VAR, idx * 16);
+        else
+            jit_put(s, JIT_VAR, idx * 16, false);
+        break;
+
+        /* stack manipulation */
+    case OP_drop:
+        jit_load_value(s, JIT_SP, -16);
+        jit_add_imm(s, JIT_SP, -16);
+        jit_free_value(s);
+        break;
+    case OP_nip:
+        jit_nip(s, 2);
+        break;
+    case OP_nip1:
+        jit_nip(s, 3);
+        break;
+    case OP_dup:
+        jit_get(s, JIT_SP, -16);
+        break;
+    case OP_dup1:
+        jit_mem(s, 0, 0x0f10, 0, JIT_SP, -16);
+        jit_mem(s, 0, 0x0f11, 0, JIT_SP, 0);
+        jit_load_value(s, JIT_SP, -32);
+        jit_dup_value(s);
+        jit_store_value(s, JIT_SP, -16);
+        jit_add_imm(s, JIT_SP, 16);
+        break;
+    case OP_dup2:
+        jit_get(s, JIT_SP, -32);
+        jit_get(s, JIT_SP, -32);
+        break;
+    case OP_insert2:
+        jit_insert(s, 2);
+        break;
+    case OP_insert3:
+        jit_insert(s, 3);
+        break;
+    case OP_swap:
+        jit_permute(s, 2, perm_swap);
+        break;
+    case OP_perm3:
+        jit_permute(s, 3, perm_perm3);
+        break;
+    case OP_rot3l:
+        jit_permute(s, 3, perm_rot3l);
+        break;
+    case OP_rot3r:
+        jit_permute(s, 3, perm_rot3r);
+        break;
+    case OP_perm4:
+        jit_permute(s, 4, perm_perm4);
+        break;
+    case OP_perm5:
+        jit_permute(s, 5, perm_perm5);
+        break;
+    case OP_rot4l:
+        jit_permute(s, 4, perm_rot4l);
+        break;
+    case OP_rot5l:
+        jit_permute(s, 5, perm_rot5l);
+        break;
+    case OP_swap2:
+        jit_permute(s, 4, perm_swap2);
+        break;
+    case OP_nop:
+        break;
+
+        /* branches */
+    case OP_goto:
+    case OP_goto16:
+    case OP_goto8:
+        if (op == OP_goto)
+            target = pos + 1 + (int32_t)get_u32(pc + 1);
+        else if (op == OP_goto16)
+            target = pos + 1 + (int16_t)get_u16(pc + 1);
+        else
+            target = pos + 1 + (int8_t)pc[1];
+        if (target <= pos) {
+            jit_loop_head(s, target);
+            jit_poll_interrupts(s, next_pc);
+        }
+        jit_jump_bc(s, -1, target);
+        break;
+    case OP_if_true:
+    case OP_if_false:
+    case OP_if_true8:
+    case OP_if_false8:
+        target = jit_if_target(pc, pos, &is_true);
+        if (target <= pos) {
+            jit_loop_head(s, target);
+            jit_poll_interrupts(s, next_pc);
+        }
+        jit_load_value(s, JIT_SP, -16);
+        jit_add_imm(s, JIT_SP, -16);
+        jit_cmp_imm8(s, JIT_RCX, JS_TAG_UNDEFINED);
+        l_slow = jit_jcc(s, JIT_CC_A);
+        jit_rr(s, 0, 0x85, JIT_RAX, JIT_RAX); /* test eax, eax */
+        jit_jump_bc(s, is_true ? JIT_CC_NE : JIT_CC_E, target);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_mov(s, JIT_RDI, JIT_CTX);
+        jit_mov(s, JIT_RSI, JIT_RAX);
+        jit_mov(s, JIT_RDX, JIT_RCX);
+        jit_call_abs(s, JS_ToBoolFree);
+        jit_rr(s, 0, 0x85, JIT_RAX, JIT_RAX);
+        jit_jump_bc(s, is_true ? JIT_CC_NE : JIT_CC_E, target);
+        jit_label(s, l_done);
+        break;
+
+        /* int32 arithmetic */
+    case OP_add:
+    case OP_sub:
+    case OP_mul:
+        l_slow = jit_check_both_int(s);
+        jit_load32(s, JIT_RAX, JIT_SP, -32);
+        if (op == OP_add)
+            jit_mem(s, 0, JIT_ADD, JIT_RAX, JIT_SP, -16);
+        else if (op == OP_sub)
+            jit_mem(s, 0, JIT_SUB, JIT_RAX, JIT_SP, -16);
+        else
+            jit_mem(s, 0, 0x0faf, JIT_RAX, JIT_SP, -16); /* imul */
+        l_slow2 = jit_jcc(s, JIT_CC_O);
+        l_slow3 = 0;
+        if (op == OP_mul) {
+            /* the result may be -0 */
+            jit_rr(s, 0, 0x85, JIT_RAX, JIT_RAX);
+            l_slow3 = jit_jcc(s, JIT_CC_E);
+        }
+        goto int_result;
+    case OP_and:
+    case OP_or:
+    case OP_xor:
+        l_slow = jit_check_both_int(s);
+        jit_load32(s, JIT_RAX, JIT_SP, -32);
+        jit_mem(s, 0, op == OP_and ? JIT_AND : op == OP_or ? JIT_OR : JIT_XOR,
+                JIT_RAX, JIT_SP, -16);
+        l_slow2 = l_slow3 = 0;
+        goto int_result;
+    case OP_shl:
+    case OP_sar:
+    case OP_shr:
+        l_slow = jit_check_both_int(s);
+        jit_load32(s, JIT_RAX, JIT_SP, -32);
+        jit_load32(s, JIT_RCX, JIT_SP, -16);
+        /* the shift count is masked by the CPU as required */
+        jit_rr(s, 0, 0xd3, op == OP_shl ? 4 : op == OP_sar ? 7 : 5, JIT_RAX);
+        l_slow2 = l_slow3 = 0;
+        if (op == OP_shr) {
+            /* the result does not fit an int32 */
+            jit_rr(s, 0, 0x85, JIT_RAX, JIT_RAX);
+            l_slow2 = jit_jcc(s, JIT_CC_S);
+        }
+    int_result:
+        jit_store(s, JIT_SP, -32, JIT_RAX);
+        jit_add_imm(s, JIT_SP, -16);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        if (l_slow2)
+            jit_label(s, l_slow2);
+        n_slow = 0;
+        l_done2 = 0;
+        if (op == OP_add || op == OP_sub || op == OP_mul) {
+            /* float64 operands or int32 overflow */
+            n_slow = jit_float_arith(s, op, slow);
+            l_done2 = jit_jmp(s);
+        }
+        for(i = 0; i < n_slow; i++)
+            jit_label(s, slow[i]);
+        if (l_slow3)
+            jit_label(s, l_slow3);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        if (l_done2)
+            jit_label(s, l_done2);
+        break;
+    case OP_lt:
+    case OP_lte:
+    case OP_gt:
+    case OP_gte:
+    case OP_eq:
+    case OP_neq:
+    case OP_strict_eq:
+    case OP_strict_neq:
+        cc = jit_compare_cc(op);
+        l_slow = jit_check_both_int(s);
+        l_slow2 = 0;
+        jit_load32(s, JIT_RAX, JIT_SP, -32);
+        jit_mem(s, 0, JIT_CMP, JIT_RAX, JIT_SP, -16);
+    compare_result:
+        target = jit_if_target(next_pc, next_pc - b->byte_code_buf, &is_true);
+        if (target > next_pc - b->byte_code_buf) {
+            /* fused with the following forward conditional jump. The
+               slow path continues with the jump opcode */
+            /* lea rbx, [rbx - 32] does not modify the flags */
+            jit_mem(s, 1, 0x8d, JIT_SP, JIT_SP, -32);
+            jit_jump_bc(s, is_true ? cc : cc ^ 1, target);
+            jit_jump_bc(s, -1, next_pc - b->byte_code_buf +
+                        short_opcode_info(next_pc[0]).size);
+            jit_label(s, l_slow);
+            if (l_slow2)
+                jit_label(s, l_slow2);
+            jit_call_op(s, next_pc, op, 0, 0);
+            break;
+        }
+        jit_setcc(s, cc, JIT_RAX);
+        jit_store(s, JIT_SP, -32, JIT_RAX);
+        jit_store_imm(s, JIT_SP, -24, JS_TAG_BOOL);
+        jit_add_imm(s, JIT_SP, -16);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        if (l_slow2)
+            jit_label(s, l_slow2);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_lt_f64:
+    case OP_lte_f64:
+    case OP_gt_f64:
+    case OP_gte_f64:
+        /* a < b is computed as b > a so that the unordered result (NaN
+           operand) gives false with the 'above' conditions */
+        {
+            bool swap = (op == OP_lt_f64 || op == OP_lte_f64);
+            cc = (op == OP_lt_f64 || op == OP_gt_f64) ? JIT_CC_A : JIT_CC_AE;
+            op = js_generic_opcode(op);
+            jit_cmp_mem_imm8(s, JIT_SP, -24, JS_TAG_FLOAT64);
+            l_slow = jit_jcc(s, JIT_CC_NE);
+            jit_cmp_mem_imm8(s, JIT_SP, -8, JS_TAG_FLOAT64);
+            l_slow2 = jit_jcc(s, JIT_CC_NE);
+            jit_byte(s, 0xf2);
+            jit_mem(s, 0, 0x0f10, 0, JIT_SP, swap ? -16 : -32); /* movsd xmm0 */
+            jit_byte(s, 0x66);
+            jit_mem(s, 0, 0x0f2e, 0, JIT_SP, swap ? -32 : -16); /* ucomisd xmm0 */
+        }
+        goto compare_result;
+    case OP_inc:
+    case OP_dec:
+    case OP_post_inc:
+    case OP_post_dec:
+        jit_cmp_mem_imm8(s, JIT_SP, -8, JS_TAG_INT);
+        l_slow = jit_jcc(s, JIT_CC_NE);
+        jit_load32(s, JIT_RAX, JIT_SP, -16);
+        jit_rr(s, 0, 0x83, (op == OP_inc || op == OP_post_inc) ? 0 : 5,
+               JIT_RAX); /* add/sub eax, 1 */
+        jit_byte(s, 1);
+        l_slow2 = jit_jcc(s, JIT_CC_O);
+        if (op == OP_inc || op == OP_dec) {
+            jit_store(s, JIT_SP, -16, JIT_RAX);
+        } else {
+            jit_store(s, JIT_SP, 0, JIT_RAX);
+            jit_store_imm(s, JIT_SP, 8, JS_TAG_INT);
+            jit_add_imm(s, JIT_SP, 16);
+        }
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_label(s, l_slow2);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_inc_loc:
+    case OP_dec_loc:
+        idx = pc[1];
+        jit_cmp_mem_imm8(s, JIT_VAR, idx * 16 + 8, JS_TAG_INT);
+        l_slow = jit_jcc(s, JIT_CC_NE);
+        jit_load32(s, JIT_RAX, JIT_VAR, idx * 16);
+        jit_rr(s, 0, 0x83, op == OP_inc_loc ? 0 : 5, JIT_RAX);
+        jit_byte(s, 1);
+        l_slow2 = jit_jcc(s, JIT_CC_O);
+        jit_store(s, JIT_VAR, idx * 16, JIT_RAX);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_label(s, l_slow2);
+        jit_call_op(s, next_pc, op, idx, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_add_loc:
+        idx = pc[1];
+        jit_load32(s, JIT_RAX, JIT_VAR, idx * 16 + 8);
+        jit_mem(s, 0, JIT_OR, JIT_RAX, JIT_SP, -8);
+        l_slow = jit_jcc(s, JIT_CC_NE);
+        jit_load32(s, JIT_RAX, JIT_VAR, idx * 16);
+        jit_mem(s, 0, JIT_ADD, JIT_RAX, JIT_SP, -16);
+        l_slow2 = jit_jcc(s, JIT_CC_O);
+        jit_store(s, JIT_VAR, idx * 16, JIT_RAX);
+        jit_add_imm(s, JIT_SP, -16);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_label(s, l_slow2);
+        jit_call_op(s, next_pc, op, idx, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_neg:
+        jit_cmp_mem_imm8(s, JIT_SP, -8, JS_TAG_INT);
+        l_slow = jit_jcc(s, JIT_CC_NE);
+        jit_load32(s, JIT_RAX, JIT_SP, -16);
+        /* 0 and INT32_MIN have no int32 negation */
+        jit_byte(s, 0xa9); /* test eax, 0x7fffffff */
+        dbuf_put_u32(&s->code, 0x7fffffff);
+        l_slow2 = jit_jcc(s, JIT_CC_E);
+        jit_rr(s, 0, 0xf7, 3, JIT_RAX); /* neg eax */
+        jit_store(s, JIT_SP, -16, JIT_RAX);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_label(s, l_slow2);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_plus:
+    case OP_not:
+        jit_cmp_mem_imm8(s, JIT_SP, -8, JS_TAG_INT);
+        l_slow = jit_jcc(s, JIT_CC_NE);
+        if (op == OP_not)
+            jit_mem(s, 0, 0xf7, 2, JIT_SP, -16); /* not dword [sp - 16] */
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_lnot:
+        jit_cmp_mem_imm8(s, JIT_SP, -8, JS_TAG_UNDEFINED);
+        l_slow = jit_jcc(s, JIT_CC_A);
+        jit_load32(s, JIT_RAX, JIT_SP, -16);
+        jit_rr(s, 0, 0x85, JIT_RAX, JIT_RAX);
+        jit_setcc(s, JIT_CC_E, JIT_RAX);
+        jit_store(s, JIT_SP, -16, JIT_RAX);
+        jit_store_imm(s, JIT_SP, -8, JS_TAG_BOOL);
+        l_done = jit_jmp(s);
+        jit_label(s, l_slow);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_to_propkey:
+        jit_cmp_mem_imm8(s, JIT_SP, -8, JS_TAG_INT);
+        l_done = jit_jcc(s, JIT_CC_E);
+        jit_call_op(s, next_pc, op, 0, 0);
+        jit_label(s, l_done);
+        break;
+    case OP_is_undefined:
+    case OP_is_null:
+    case OP_is_undefined_or_null:
+        jit_load_value(s, JIT_SP, -16);
+        jit_mov(s, JIT_RDX, JIT_RCX);
+        if (op == OP_is_undefined_or_null) {
+            /* JS_TAG_NULL = 2 and JS_TAG_UNDEFINED = 3 */
+            jit_rr(s, 0, 0x83, 1, JIT_RDX); /* or edx, 1 */
+            jit_byte(s, 1);
+        }
+        jit_cmp_imm8(s, JIT_RDX, op == OP_is_null ?
+                     JS_TAG_NULL : JS_TAG_UNDEFINED);
+        jit_setcc(s, JIT_CC_E, JIT_RDX);
+        jit_store(s, JIT_SP, -16, JIT_RDX);
+        jit_store_imm(s, JIT_SP, -8, JS_TAG_BOOL);
+        jit_free_value(s);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+/* The native code of a function without loops is entered at each call,
+   which costs more than interpreting a few opcodes. The calls to
+   js_jit_op() are also a bit slower than the interpreter, so the call
+   intensive functions (e.g. recursive ones) stay interpreted. */
+static bool jit_is_profitable(JSJITState *s)
+{
+    if (s->has_loop)
+        return true;
+    return s->op_count - s->helper_count >= JS_JIT_MIN_INLINE_OPS &&
+           s->op_count >= JS_JIT_HELPER_RATIO * s->helper_count;
+}
+
+static bool js_jit_compile(JSContext *ctx, JSFunctionBytecode *b)
+{
+    JSJITState s_s, *s = &s_s;
+    JSJITCode *jit;
+    uint32_t *pc_map;
+    int pos, i;
+    size_t size;
+    uint8_t *code;
+
+    /* the generators and async functions (including the scripts with
+       top level await) are suspended and resumed by opcodes which are
+       not translated, so only their loops run in the native code */
+    if (b->byte_code_len > JS_JIT_MAX_BYTECODE_LEN)
+        return false;
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->b = b;
+    js_dbuf_init(ctx, &s->code);
+    pc_map = js_mallocz(ctx, sizeof(pc_map[0]) * b->byte_code_len);
+    s->op_pos = js_mallocz(ctx, sizeof(s->op_pos[0]) * b->byte_code_len);
+    if (!pc_map || !s->op_pos)
+        goto fail;
+    s->pc_map = pc_map;
+    s->last_bailout_pos = -1;
+
+    /* prologue: JSJITStatusEnum code(JSJITFrame *f) */
+    jit_push(s, JIT_RBP);
+    jit_push(s, JIT_RBX);
+    jit_push(s, JIT_R12);
+    jit_push(s, JIT_R13);
+    jit_push(s, JIT_R14);
+    jit_push(s, JIT_R15);
+    jit_add_imm(s, JIT_RSP, -8); /* align the stack on 16 bytes */
+    jit_mov(s, JIT_F, JIT_RDI);
+    jit_load(s, JIT_SP, JIT_F, offsetof(JSJITFrame, sp));
+    jit_load(s, JIT_SF, JIT_F, offsetof(JSJITFrame, sf));
+    jit_load(s, JIT_VAR, JIT_F, offsetof(JSJITFrame, var_buf));
+    jit_load(s, JIT_ARG, JIT_F, offsetof(JSJITFrame, arg_buf));
+    jit_load(s, JIT_CTX, JIT_F, offsetof(JSJITFrame, ctx));
+    jit_mem(s, 0, 0xff, 4, JIT_F, offsetof(JSJITFrame, entry)); /* jmp */
+
+    s->label_epilogue = jit_pos(s);
+    jit_store(s, JIT_F, offsetof(JSJITFrame, sp), JIT_SP);
+    jit_add_imm(s, JIT_RSP, 8);
+    jit_pop(s, JIT_R15);
+    jit_pop(s, JIT_R14);
+    jit_pop(s, JIT_R13);
+    jit_pop(s, JIT_R12);
+    jit_pop(s, JIT_RBX);
+    jit_pop(s, JIT_RBP);
+    jit_byte(s, 0xc3); /* ret */
+
+    /* js_jit_op() has stored the stack pointer */
+    s->label_exception = jit_pos(s);
+    jit_load(s, JIT_SP, JIT_F, offsetof(JSJITFrame, sp));
+    jit_load(s, JIT_RAX, JIT_SF, offsetof(JSStackFrame, cur_pc));
+    jit_store(s, JIT_F, offsetof(JSJITFrame, pc), JIT_RAX);
+    jit_mov_imm(s, JIT_RAX, JS_JIT_EXCEPTION);
+    jit_jmp_to(s, s->label_epilogue);
+
+    /* rax contains the byte code position */
+    s->label_bailout = jit_pos(s);
+    jit_store(s, JIT_F, offsetof(JSJITFrame, pc), JIT_RAX);
+    jit_mov_imm(s, JIT_RAX, JS_JIT_BAILOUT);
+    jit_jmp_to(s, s->label_epilogue);
+
+    s->label_return = jit_pos(s);
+    jit_mov_imm(s, JIT_RAX, JS_JIT_RETURN);
+    jit_jmp_to(s, s->label_epilogue);
+
+    /* js_free_value_rt(rt, (rsi, rdx)) */
+    s->label_free_value = jit_pos(s);
+    jit_load(s, JIT_RDI, JIT_CTX, offsetof(JSContext, rt));
+    jit_mov_imm(s, JIT_RAX, (uintptr_t)js_free_value_rt);
+    jit_rr(s, 0, 0xff, 4, JIT_RAX); /* jmp rax */
+
+    for(pos = 0; pos < b->byte_code_len;
+        pos += short_opcode_info(b->byte_code_buf[pos]).size) {
+        s->op_pos[pos] = jit_pos(s);
+        s->op_count++;
+        if (jit_emit_op(s, pos)) {
+            pc_map[pos] = s->op_pos[pos];
+        } else {
+            s->helper_count++;
+            s->last_bailout_pos = pos;
+            jit_mov_imm(s, JIT_RAX, (uintptr_t)(b->byte_code_buf + pos));
+            jit_jmp_to(s, s->label_bailout);
+        }
+    }
+    if (!jit_is_profitable(s))
+        goto fail;
+    for(i = 0; i < s->reloc_count; i++) {
+        jit_set_rel32(s, s->relocs[i].code_pos,
+                      s->op_pos[s->relocs[i].bc_pos]);
+    }
+    if (s->code.error)
+        goto fail;
+
+    size = s->code.size;
+    code = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+        goto fail;
+    memcpy(code, s->code.buf, size);
+    if (mprotect(code, size, PROT_READ | PROT_EXEC)) {
+        munmap(code, size);
+        goto fail;
+    }
+    jit = js_malloc(ctx, sizeof(*jit));
+    if (!jit) {
+        munmap(code, size);
+        goto fail;
+    }
+    jit->code = code;
+    jit->code_size = size;
+    jit->pc_map = pc_map;
+    b->jit = jit;
+    dbuf_free(&s->code);
+    js_free(ctx, s->op_pos);
+    js_free(ctx, s->relocs);
+    return true;
+ fail:
+    dbuf_free(&s->code);
+    js_free(ctx, s->op_pos);
+    js_free(ctx, s->relocs);
+    js_free(ctx, pc_map);
+    return false;
+}
+
+static void js_jit_free(JSRuntime *rt, JSJITCode *jit)
+{
+    munmap(jit->code, jit->code_size);
+    js_free_rt(rt, jit->pc_map);
+    js_free_rt(rt, jit);
+}
+
+#endif /* CONFIG_JIT */
+
 static void json_free_token(JSParseState *s, JSToken *token) {
     // Only free actual allocated values
     switch(token->val) {
@@ -23527,6 +27189,12 @@ static int json_parse_error(JSParseState *s, const uint8_t *curp, const char *ms
     const uint8_t *p, *line_start;
     int position = curp - s->buf_start;
     int line = 1;
+
+    if (s->json_stream_pos >= 0) {
+        /* the lines of the previous values are not known */
+        return js_parse_error(s, "%s in JSON at position %" PRId64, msg,
+                              s->json_stream_pos + position);
+    }
     for (line_start = p = s->buf_start; p < curp; p++) {
         /* column count does not account for TABs nor wide characters */
         if (*p == '\r' || *p == '\n') {
@@ -23539,29 +27207,97 @@ static int json_parse_error(JSParseState *s, const uint8_t *curp, const char *ms
                           msg, position, line, (int)(p - line_start) + 1);
 }
 
+/* same as js_parse_error() but the position is added when parsing a
+   value of a JSON stream */
+static int JS_PRINTF_FORMAT_ATTR(3, 4) json_parse_error_fmt(JSParseState *s, const uint8_t *curp,
+                                                           JS_PRINTF_FORMAT const char *fmt, ...)
+{
+    char buf[ATOM_GET_STR_BUF_SIZE];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (s->json_stream_pos >= 0)
+        return json_parse_error(s, curp, buf);
+    return js_parse_error(s, "%s", buf);
+}
+
+/* return a pointer to the first quote, backslash, control or non ASCII
+   character of 'p[0..end-1]' or 'end' */
+static const uint8_t *json_skip_plain_ascii(const uint8_t *p,
+                                            const uint8_t *end)
+{
+#if defined(JS_HAVE_SSE2)
+    __m128i vquote = _mm_set1_epi8('"');
+    __m128i vbackslash = _mm_set1_epi8('\\');
+    __m128i vspace = _mm_set1_epi8(0x20);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        /* signed comparison: also true for the bytes >= 0x80 */
+        __m128i m = _mm_or_si128(_mm_cmplt_epi8(v, vspace),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, vquote),
+                                              _mm_cmpeq_epi8(v, vbackslash)));
+        int mask = _mm_movemask_epi8(m);
+        if (mask)
+            return p + ctz32(mask);
+        p += 16;
+    }
+#elif defined(JS_HAVE_NEON)
+    uint8x16_t vquote = vdupq_n_u8('"');
+    uint8x16_t vbackslash = vdupq_n_u8('\\');
+    int8x16_t vspace = vdupq_n_s8(0x20);
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8(p);
+        /* signed comparison: also true for the bytes >= 0x80 */
+        uint8x16_t m = vorrq_u8(vcltq_s8(vreinterpretq_s8_u8(v), vspace),
+                                vorrq_u8(vceqq_u8(v, vquote),
+                                         vceqq_u8(v, vbackslash)));
+        /* 4 bits per byte */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+        if (mask)
+            return p + (ctz64(mask) >> 2);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && *p >= 0x20 && *p < 0x80)
+        p++;
+    return p;
+}
+
 static int json_parse_string(JSParseState *s, const uint8_t **pp)
 {
-    const uint8_t *p, *p_next;
+    const uint8_t *p, *p_next, *p_start;
     int i;
     uint32_t c;
+    JSValue str;
     StringBuffer b_s, *b = &b_s;
 
-    if (string_buffer_init(s->ctx, b, 48))
-        goto fail;
-
     p = *pp;
+    /* fast path: no escape sequence nor non ASCII character */
+    p_start = p;
+    p = json_skip_plain_ascii(p, s->buf_end);
+    if (p < s->buf_end && *p == '"') {
+        str = js_new_string8_len(s->ctx, (const char *)p_start, p - p_start);
+        if (JS_IsException(str))
+            return -1;
+        s->token.val = TOK_STRING;
+        s->token.u.str.sep = '"';
+        s->token.u.str.str = str;
+        *pp = p + 1;
+        return 0;
+    }
+    if (string_buffer_init(s->ctx, b, max_int(48, p - p_start + 16)))
+        goto fail;
+    p = p_start;
     for(;;) {
         if (p >= s->buf_end) {
             goto end_of_input;
         }
 
-        // Fast path: batch consecutive ASCII characters
-        const uint8_t *p_start = p;
-        while (p < s->buf_end && *p != '"' && *p != '\\' && *p >= 0x20 && *p < 0x80) {
-            p++;
-        }
-
-        // Write batched ASCII in one call
+        /* copy the runs of plain ASCII characters at once */
+        p_start = p;
+        p = json_skip_plain_ascii(p, s->buf_end);
         if (p > p_start) {
             if (string_buffer_write8(b, p_start, p - p_start))
                 goto fail;
@@ -23630,41 +27366,92 @@ static int json_parse_string(JSParseState *s, const uint8_t **pp)
     return -1;
 }
 
+/* the powers of 10 which are exactly representable as double */
+static const double json_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
 static int json_parse_number(JSParseState *s, const uint8_t **pp)
 {
     const uint8_t *p = *pp;
     const uint8_t *p_start = p;
+    uint64_t mant;
+    int n_digits, exp, exp1;
+    bool neg, exp_neg, is_int;
+    double d;
 
-    if (*p == '+' || *p == '-')
+    neg = false;
+    if (*p == '+' || *p == '-') {
+        neg = (*p == '-');
         p++;
+    }
 
     if (!is_digit(*p))
-        return js_parse_error(s, "Unexpected token '%c'", *p_start);
+        return json_parse_error_fmt(s, p_start, "Unexpected token '%c'", *p_start);
 
     if (p[0] == '0' && is_digit(p[1]))
         return json_parse_error(s, p, "Unexpected number");
 
-    while (is_digit(*p))
-        p++;
+    /* the digits are accumulated in 'mant' as long as it stays below
+       2^53 (at most 15 digits) */
+    mant = 0;
+    n_digits = 0;
+    exp = 0;
+    is_int = true;
+    while (is_digit(*p)) {
+        mant = mant * 10 + (*p++ - '0');
+        n_digits++;
+    }
 
     if (*p == '.') {
         p++;
         if (!is_digit(*p))
             return json_parse_error(s, p, "Unterminated fractional number");
-        while (is_digit(*p))
-            p++;
+        is_int = false;
+        while (is_digit(*p)) {
+            mant = mant * 10 + (*p++ - '0');
+            n_digits++;
+            exp--;
+        }
     }
     if (*p == 'e' || *p == 'E') {
         p++;
-        if (*p == '+' || *p == '-')
+        exp_neg = false;
+        if (*p == '+' || *p == '-') {
+            exp_neg = (*p == '-');
             p++;
+        }
         if (!is_digit(*p))
             return json_parse_error(s, p, "Exponent part is missing a number");
-        while (is_digit(*p))
+        is_int = false;
+        exp1 = 0;
+        while (is_digit(*p)) {
+            if (exp1 < 10000)
+                exp1 = exp1 * 10 + (*p - '0');
             p++;
+        }
+        exp += exp_neg ? -exp1 : exp1;
     }
     s->token.val = TOK_NUMBER;
-    s->token.u.num.val = js_float64(strtod((const char *)p_start, NULL));
+    if (n_digits <= 15 && exp >= -22 && exp <= 22) {
+        /* exact: both operands are exactly representable and the
+           result is correctly rounded */
+        if (is_int && mant <= INT32_MAX && !(neg && mant == 0)) {
+            s->token.u.num.val = js_int32(neg ? -(int32_t)mant : mant);
+        } else {
+            d = (double)mant;
+            if (exp < 0)
+                d /= json_pow10[-exp];
+            else
+                d *= json_pow10[exp];
+            s->token.u.num.val = js_number(neg ? -d : d);
+        }
+    } else {
+        JSATODTempMem atod_mem;
+        d = js_atod((const char *)p_start, NULL, 10, 0, &atod_mem);
+        s->token.u.num.val = js_number(d);
+    }
     *pp = p;
     return 0;
 }
@@ -23815,12 +27602,12 @@ static __exception int json_next_token(JSParseState *s)
         if (c >= 0x80) {
             c = utf8_decode(p, &p_next);
             if (p_next == p + 1) {
-                js_parse_error(s, "Unexpected token '\\x%02x' in JSON", *p);
+                json_parse_error_fmt(s, p, "Unexpected token '\\x%02x'", *p);
             } else {
                 if (c > 0xFFFF) {
                     c = get_hi_surrogate(c);
                 }
-                js_parse_error(s, "Unexpected token '\\u%04x' in JSON", c);
+                json_parse_error_fmt(s, p, "Unexpected token '\\u%04x'", c);
             }
             goto fail;
         }
@@ -24030,6 +27817,13 @@ static void emit_atom(JSParseState *s, JSAtom name)
     bc->size += 4;
 }
 
+/* placeholder for the inline cache slot of a property access. The slots
+   are numbered once the final byte code is known (js_bytecode_init_ic) */
+static void emit_ic(JSParseState *s)
+{
+    emit_u16(s, 0);
+}
+
 static int update_label(JSFunctionDef *s, int label, int delta)
 {
     LabelSlot *ls;
@@ -24800,6 +28594,7 @@ static __exception int js_parse_template(JSParseState *s, int call, int *argc)
                         goto done1;
                     emit_op(s, OP_get_field2);
                     emit_atom(s, JS_ATOM_concat);
+                    emit_ic(s);
                 }
                 depth++;
             } else {
@@ -26103,6 +29898,7 @@ static __exception int js_parse_array_literal(JSParseState *s)
             emit_u32(s, idx);
             emit_op(s, OP_put_field);
             emit_atom(s, JS_ATOM_length);
+            emit_ic(s);
         }
         goto done;
     }
@@ -26141,6 +29937,7 @@ static __exception int js_parse_array_literal(JSParseState *s)
         emit_op(s, OP_dup1);    /* array length - array array length */
         emit_op(s, OP_put_field);
         emit_atom(s, JS_ATOM_length);
+        emit_ic(s);
     } else {
         emit_op(s, OP_drop);    /* array length - array */
     }
@@ -26254,6 +30051,7 @@ static __exception int get_lvalue(JSParseState *s, int *popcode, int *pscope,
         case OP_get_field:
             emit_op(s, OP_get_field2);
             emit_atom(s, name);
+            emit_ic(s);
             break;
         case OP_scope_get_private_field:
             emit_op(s, OP_scope_get_private_field2);
@@ -26418,6 +30216,7 @@ static void put_lvalue(JSParseState *s, int opcode, int scope,
     case OP_get_field:
         emit_op(s, OP_put_field);
         emit_u32(s, name);  /* name has refcount */
+        emit_ic(s);
         break;
     case OP_scope_get_private_field:
         emit_op(s, OP_scope_put_private_field);
@@ -26694,6 +30493,7 @@ static int js_parse_destructuring_element(JSParseState *s, int tok,
                         /* get the named property from the source object */
                         emit_op(s, OP_get_field2);
                         emit_u32(s, prop_name);
+                        emit_ic(s);
                     }
                     if (js_parse_destructuring_element(s, tok, is_arg, true, -1, true, export_flag) < 0)
                         return -1;
@@ -26791,6 +30591,7 @@ static int js_parse_destructuring_element(JSParseState *s, int tok,
                     /* source -- val */
                     emit_op(s, OP_get_field);
                     emit_u32(s, prop_name);
+                    emit_ic(s);
                 }
             } else {
                 /* prop_type = PROP_TYPE_VAR, cannot be a computed property */
@@ -26822,6 +30623,7 @@ static int js_parse_destructuring_element(JSParseState *s, int tok,
                 /* source -- source val */
                 emit_op(s, OP_get_field2);
                 emit_u32(s, prop_name);
+                emit_ic(s);
             }
         set_val:
             if (tok) {
@@ -27378,10 +31180,10 @@ static __exception int js_parse_postfix_expr(JSParseState *s, int parse_flags)
                     {
                         int opt_chain_label, next_label;
                         opt_chain_label = get_u32(fd->byte_code.buf +
-                                                  fd->last_opcode_pos + 1 + 4 + 1);
+                                                  fd->last_opcode_pos + 1 + 4 + 2 + 1);
                         /* keep the object on the stack */
                         fd->byte_code.buf[fd->last_opcode_pos] = OP_get_field2;
-                        fd->byte_code.size = fd->last_opcode_pos + 1 + 4;
+                        fd->byte_code.size = fd->last_opcode_pos + 1 + 4 + 2;
                         next_label = emit_goto(s, OP_goto, -1);
                         emit_label(s, opt_chain_label);
                         /* need an additional undefined value for the
@@ -27652,6 +31454,7 @@ static __exception int js_parse_postfix_expr(JSParseState *s, int parse_flags)
                     }
                     emit_op(s, OP_get_field);
                     emit_atom(s, s->token.u.ident.atom);
+                    emit_ic(s);
                 }
             }
             if (next_token(s))
@@ -27717,7 +31520,7 @@ static __exception int js_parse_delete(JSParseState *s)
             int ret, opt_chain_label, next_label;
             if (opcode == OP_get_field_opt_chain) {
                 opt_chain_label = get_u32(fd->byte_code.buf +
-                                          fd->last_opcode_pos + 1 + 4 + 1);
+                                          fd->last_opcode_pos + 1 + 4 + 2 + 1);
             } else {
                 opt_chain_label = -1;
             }
@@ -28240,12 +32043,14 @@ static __exception int js_parse_assign_expr2(JSParseState *s, int parse_flags)
             emit_op(s, OP_check_object);
             emit_op(s, OP_get_field2);
             emit_atom(s, JS_ATOM_done);
+            emit_ic(s);
             label_next = emit_goto(s, OP_if_true, -1); /* end of loop */
             emit_label(s, label_yield);
             if (is_async) {
                 /* OP_async_yield_star takes the value as parameter */
                 emit_op(s, OP_get_field);
                 emit_atom(s, JS_ATOM_value);
+                emit_ic(s);
                 emit_op(s, OP_async_yield_star);
             } else {
                 /* OP_yield_star takes (value, done) as parameter */
@@ -28273,10 +32078,12 @@ static __exception int js_parse_assign_expr2(JSParseState *s, int parse_flags)
             emit_op(s, OP_check_object);
             emit_op(s, OP_get_field2);
             emit_atom(s, JS_ATOM_done);
+            emit_ic(s);
             emit_goto(s, OP_if_false, label_yield);
 
             emit_op(s, OP_get_field);
             emit_atom(s, JS_ATOM_value);
+            emit_ic(s);
 
             emit_label(s, label_return1);
             emit_op(s, OP_nip);
@@ -28294,6 +32101,7 @@ static __exception int js_parse_assign_expr2(JSParseState *s, int parse_flags)
             emit_op(s, OP_check_object);
             emit_op(s, OP_get_field2);
             emit_atom(s, JS_ATOM_done);
+            emit_ic(s);
             emit_goto(s, OP_if_false, label_yield);
             emit_goto(s, OP_goto, label_next);
             /* close the iterator and throw a type error exception */
@@ -28312,6 +32120,7 @@ static __exception int js_parse_assign_expr2(JSParseState *s, int parse_flags)
             emit_label(s, label_next);
             emit_op(s, OP_get_field);
             emit_atom(s, JS_ATOM_value);
+            emit_ic(s);
             emit_op(s, OP_nip); /* keep the value associated with
                                    done = true */
             emit_op(s, OP_nip);
@@ -28574,6 +32383,7 @@ static void emit_iterator_close(JSParseState *s, bool is_async,
     label_done = emit_goto(s, OP_if_true, -1);
     emit_op(s, OP_get_field2);
     emit_atom(s, JS_ATOM_return);
+    emit_ic(s);
     /* completion? iter_obj return_func */
     emit_op(s, OP_dup);
     emit_op(s, OP_is_undefined_or_null);
@@ -33674,12 +37484,13 @@ static bool can_opt_put_ref_value(const uint8_t *bc_buf, int pos)
              opcode == OP_rot3l));
 }
 
+/* OP_insert3 is not accepted because there is no room for OP_dup and
+   OP_put_var in the replaced code */
 static bool can_opt_put_global_ref_value(const uint8_t *bc_buf, int pos)
 {
     int opcode = bc_buf[pos];
     return (bc_buf[pos + 1] == OP_put_ref_value &&
-            (opcode == OP_insert3 ||
-             opcode == OP_perm4 ||
+            (opcode == OP_perm4 ||
              opcode == OP_nop ||
              opcode == OP_rot3l));
 }
@@ -33733,7 +37544,7 @@ static int optimize_scope_make_global_ref(JSContext *ctx, JSFunctionDef *s,
                                           LabelSlot *ls, int pos_next,
                                           JSAtom var_name)
 {
-    int label_pos, end_pos, pos, op;
+    int label_pos, end_pos, pos;
 
     /* replace the reference get/put with normal variable
        accesses */
@@ -33741,6 +37552,7 @@ static int optimize_scope_make_global_ref(JSContext *ctx, JSFunctionDef *s,
     if (bc_buf[pos_next] == OP_get_ref_value) {
         dbuf_putc(bc, OP_get_var);
         dbuf_put_u32(bc, JS_DupAtom(ctx, var_name));
+        dbuf_put_u16(bc, 0);
         pos_next++;
     }
     /* remove the OP_label to make room for replacement */
@@ -33750,13 +37562,11 @@ static int optimize_scope_make_global_ref(JSContext *ctx, JSFunctionDef *s,
     pos = label_pos - 5;
     assert(bc_buf[pos] == OP_label);
     end_pos = label_pos + 2;
-    op = bc_buf[label_pos];
-    if (op == OP_insert3)
-        bc_buf[pos++] = OP_dup;
     bc_buf[pos] = OP_put_var;
     /* XXX: need 2 extra OP_drop if destructuring an array */
     put_u32(bc_buf + pos + 1, JS_DupAtom(ctx, var_name));
-    pos += 5;
+    put_u16(bc_buf + pos + 5, 0);
+    pos += 7;
     /* pad with OP_nop */
     while (pos < end_pos)
         bc_buf[pos++] = OP_nop;
@@ -34269,12 +38079,14 @@ static int resolve_scope_var(JSContext *ctx, JSFunctionDef *s,
         dbuf_putc(bc, OP_undefined);
         dbuf_putc(bc, OP_get_var);
         dbuf_put_u32(bc, JS_DupAtom(ctx, var_name));
+        dbuf_put_u16(bc, 0);
         break;
     case OP_scope_get_var_undef:
     case OP_scope_get_var:
     case OP_scope_put_var:
         dbuf_putc(bc, OP_get_var_undef + (op - OP_scope_get_var_undef));
         dbuf_put_u32(bc, JS_DupAtom(ctx, var_name));
+        dbuf_put_u16(bc, 0);
         break;
     case OP_scope_put_var_init:
         dbuf_putc(bc, OP_put_var_init);
@@ -34999,6 +38811,7 @@ static void instantiate_hoisted_definitions(JSContext *ctx, JSFunctionDef *s, Dy
                 /* XXX: Check if variable is writable and enumerable */
                 dbuf_putc(bc, OP_put_var);
                 dbuf_put_u32(bc, JS_DupAtom(ctx, hf->var_name));
+                dbuf_put_u16(bc, 0);
             }
         }
     done_global_var:
@@ -35462,6 +39275,7 @@ static __exception int resolve_variables(JSContext *ctx, JSFunctionDef *s)
                 JSAtom name = get_u32(bc_buf + pos + 1);
                 dbuf_putc(&bc_out, OP_get_field);
                 dbuf_put_u32(&bc_out, name);
+                dbuf_put_u16(&bc_out, 0);
             }
             break;
         case OP_get_array_el_opt_chain: /* equivalent to OP_get_array_el */
@@ -36181,6 +39995,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     JS_FreeAtom(ctx, atom);
                     add_pc2line_info(s, bc_out.size, line_num, col_num);
                     dbuf_putc(&bc_out, OP_get_length);
+                    dbuf_put_u16(&bc_out, 0);
                     break;
                 }
             }
@@ -36270,6 +40085,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                 add_pc2line_info(s, bc_out.size, line_num, col_num);
                 dbuf_putc(&bc_out, OP_put_field);
                 dbuf_put_u32(&bc_out, cc.atom);
+                dbuf_put_u16(&bc_out, 0);
                 pos_next = cc.pos;
                 break;
             }
@@ -36459,6 +40275,7 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     dbuf_putc(&bc_out, OP_dec + (op - OP_post_dec));
                     dbuf_putc(&bc_out, OP_put_field);
                     dbuf_put_u32(&bc_out, cc.atom);
+                    dbuf_put_u16(&bc_out, 0);
                     pos_next = cc.pos;
                     break;
                 }
@@ -37043,6 +40860,7 @@ static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
     memcpy(b->byte_code_buf, fd->byte_code.buf, fd->byte_code.size);
     js_free(ctx, fd->byte_code.buf);
     fd->byte_code.buf = NULL;
+    b->ic_count = js_bytecode_init_ic(b->byte_code_buf, b->byte_code_len);
 
     b->func_name = fd->func_name;
     if (fd->arg_count + fd->var_count > 0) {
@@ -37153,12 +40971,18 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
 
     JS_FreeAtomRT(rt, b->func_name);
     JS_FreeAtomRT(rt, b->filename);
-    js_free_rt(rt, b->pc2line_buf);
+    if (!b->read_only_pc2line)
+        js_free_rt(rt, b->pc2line_buf);
     js_free_rt(rt, b->source);
+    js_free_rt(rt, b->ic);
+#ifdef CONFIG_JIT
+    if (b->jit)
+        js_jit_free(rt, b->jit);
+#endif
 
     remove_gc_object(&b->header);
     if (rt->gc_phase == JS_GC_PHASE_REMOVE_CYCLES && JS_REF_COUNT(b) != 0) {
-        list_add_tail(&b->header.link, &rt->gc_zero_ref_count_list);
+        list_add_tail(&b->header.link, &rt->gc_zombie_obj_list);
     } else {
         js_free_rt(rt, b);
     }
@@ -38019,6 +41843,7 @@ static __exception int js_parse_program(JSParseState *s)
                 emit_u16(s, fd->eval_ret_idx);
                 emit_op(s, OP_put_field);
                 emit_atom(s, JS_ATOM_value);
+                emit_ic(s);
             } else {
                 emit_op(s, OP_get_loc);
                 emit_u16(s, fd->eval_ret_idx);
@@ -38044,6 +41869,7 @@ static __exception int js_parse_program(JSParseState *s)
                 emit_u16(s, fd->eval_ret_idx);
                 emit_op(s, OP_put_field);
                 emit_atom(s, JS_ATOM_value);
+                emit_ic(s);
             } else {
                 emit_op(s, OP_get_loc);
                 emit_u16(s, fd->eval_ret_idx);
@@ -38076,6 +41902,7 @@ static void js_parse_init(JSContext *ctx, JSParseState *s,
     s->token.val = ' ';
     s->token.line_num = 1;
     s->token.col_num = 1;
+    s->json_stream_pos = -1;
 }
 
 static JSValue JS_EvalFunctionInternal(JSContext *ctx, JSValue fun_obj,
@@ -38469,9 +42296,10 @@ typedef enum BCTagEnum {
     BC_TAG_MAP,
     BC_TAG_SET,
     BC_TAG_SYMBOL,
+    BC_TAG_TRANSFERRED_ARRAY_BUFFER,
 } BCTagEnum;
 
-#define BC_VERSION 27
+#define BC_VERSION 30
 
 typedef struct BCWriterState {
     JSContext *ctx;
@@ -38490,6 +42318,9 @@ typedef struct BCWriterState {
     uint8_t **sab_tab;
     int sab_tab_len;
     int sab_tab_size;
+    /* ArrayBuffers written as an index */
+    JSValueConst *transfer_tab;
+    int transfer_len;
     /* list of referenced objects (used if allow_reference = true) */
     JSObjectList object_list;
 } BCWriterState;
@@ -38520,6 +42351,7 @@ static const char * const bc_tag_str[] = {
     "Map",
     "Set",
     "Symbol",
+    "TransferredArrayBuffer",
 };
 
 static const char *bc_tag_name(uint8_t tag)
@@ -38663,7 +42495,8 @@ static int JS_WriteFunctionBytecode(BCWriterState *s,
 
     pos = 0;
     while (pos < bc_len) {
-        op = bc_buf[pos];
+        op = js_generic_opcode(bc_buf[pos]);
+        bc_buf[pos] = op;
         len = short_opcode_info(op).size;
         switch(short_opcode_info(op).fmt) {
         case OP_FMT_atom:
@@ -38739,7 +42572,11 @@ static int JS_WriteBigInt(BCWriterState *s, JSValueConst obj)
     bc_put_leb128(s, len);
     if (len > 0) {
         for(i = 0; i < (len / (JS_LIMB_BITS / 8)); i++) {
+#if JS_LIMB_BITS == 32
             bc_put_u32(s, p->tab[i]);
+#else
+            bc_put_u64(s, p->tab[i]);
+#endif
         }
         for(i = 0; i < len % (JS_LIMB_BITS / 8); i++) {
             bc_put_u8(s, (p->tab[p->len - 1] >> (i * 8)) & 0xff);
@@ -38993,6 +42830,17 @@ static int JS_WriteArrayBuffer(BCWriterState *s, JSValueConst obj)
 {
     JSObject *p = JS_VALUE_GET_OBJ(obj);
     JSArrayBuffer *abuf = p->u.array_buffer;
+    int i;
+
+    for(i = 0; i < s->transfer_len; i++) {
+        if (JS_VALUE_GET_TAG(s->transfer_tab[i]) == JS_TAG_OBJECT &&
+            JS_VALUE_GET_OBJ(s->transfer_tab[i]) == p) {
+            /* the contents are moved by the caller */
+            bc_put_u8(s, BC_TAG_TRANSFERRED_ARRAY_BUFFER);
+            bc_put_leb128(s, i);
+            return 0;
+        }
+    }
     if (abuf->detached) {
         JS_ThrowTypeErrorDetachedArrayBuffer(s->ctx);
         return -1;
@@ -39246,8 +43094,9 @@ static int JS_WriteObjectAtoms(BCWriterState *s)
     return -1;
 }
 
-uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
-                         int flags, JSSABTab *psab_tab)
+uint8_t *JS_WriteObject3(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, JSSABTab *psab_tab,
+                         JSValueConst *transfer_tab, int transfer_len)
 {
     BCWriterState ss, *s = &ss;
     uint32_t h;
@@ -39255,6 +43104,8 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
 
     memset(s, 0, sizeof(*s));
     s->ctx = ctx;
+    s->transfer_tab = transfer_tab;
+    s->transfer_len = transfer_len;
     s->allow_bytecode = ((flags & JS_WRITE_OBJ_BYTECODE) != 0);
     s->allow_sab = ((flags & JS_WRITE_OBJ_SAB) != 0);
     s->allow_reference = ((flags & JS_WRITE_OBJ_REFERENCE) != 0);
@@ -39300,6 +43151,12 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     return NULL;
 }
 
+uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, JSSABTab *psab_tab)
+{
+    return JS_WriteObject3(ctx, psize, obj, flags, psab_tab, NULL, 0);
+}
+
 uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
                         int flags)
 {
@@ -39316,6 +43173,7 @@ typedef struct BCReaderState {
     bool allow_sab;
     bool allow_bytecode;
     bool allow_reference;
+    bool is_rom_data;
     /* object references */
     JSObject **objects;
     int objects_count;
@@ -39324,6 +43182,9 @@ typedef struct BCReaderState {
     uint8_t **sab_tab;
     int sab_tab_len;
     int sab_tab_size;
+    /* ArrayBuffers read as an index */
+    JSValueConst *transfer_tab;
+    int transfer_len;
     /* used for JS_DUMP_READ_OBJECT */
     const uint8_t *ptr_last;
     int level;
@@ -39522,21 +43383,28 @@ static JSString *JS_ReadString(BCReaderState *s)
         JS_ThrowInternalError(s->ctx, "string too long");
         return NULL;
     }
-    p = js_alloc_string(s->ctx, len, is_wide_char);
-    if (!p) {
-        s->error_state = -1;
-        return NULL;
-    }
     size = (size_t)len << is_wide_char;
     if ((s->buf_end - s->ptr) < size) {
         bc_read_error_end(s);
-        js_free_string(s->ctx->rt, p);
         return NULL;
     }
-    memcpy(str8(p), s->ptr, size);
+    /* the 16 bit strings are copied if they are not aligned */
+    if (s->is_rom_data && size >= JS_STRING_ROM_LEN_MIN &&
+        !((uintptr_t)s->ptr & is_wide_char)) {
+        p = js_new_rom_string(s->ctx, s->ptr, len, is_wide_char);
+    } else {
+        p = js_alloc_string(s->ctx, len, is_wide_char);
+        if (p) {
+            memcpy(str8(p), s->ptr, size);
+            if (!is_wide_char)
+                str8(p)[size] = '\0'; /* add the trailing zero for 8 bit strings */
+        }
+    }
+    if (!p) {
+        s->error_state = -1;
+        return NULL;
+    }
     s->ptr += size;
-    if (!is_wide_char)
-        str8(p)[size] = '\0'; /* add the trailing zero for 8 bit strings */
 #ifdef ENABLE_DUMPS // JS_DUMP_READ_OBJECT
     if (check_dump_flag(s->ctx->rt, JS_DUMP_READ_OBJECT)) {
         bc_read_trace(s, "%s", ""); // hex dump and indentation
@@ -39604,6 +43472,8 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
 #endif
         pos += len;
     }
+    /* the slot numbers are not trusted */
+    b->ic_count = js_bytecode_init_ic(bc_buf, bc_len);
     return 0;
 }
 
@@ -39627,8 +43497,13 @@ static JSValue JS_ReadBigInt(BCReaderState *s)
     if (!p)
         goto fail;
     for(i = 0; i < len / (JS_LIMB_BITS / 8); i++) {
+#if JS_LIMB_BITS == 32
         if (bc_get_u32(s, &v))
             goto fail;
+#else
+        if (bc_get_u64(s, &v))
+            goto fail;
+#endif
         p->tab[i] = v;
     }
     n = len % (JS_LIMB_BITS / 8);
@@ -39880,11 +43755,21 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s)
         goto fail;
     if (b->pc2line_len) {
         bc_read_trace(s, "positions: %d bytes\n", b->pc2line_len);
-        b->pc2line_buf = js_mallocz(ctx, b->pc2line_len);
-        if (!b->pc2line_buf)
-            goto fail;
-        if (bc_get_buf(s, b->pc2line_buf, b->pc2line_len))
-            goto fail;
+        if (s->is_rom_data) {
+            if (s->buf_end - s->ptr < (uint32_t)b->pc2line_len) {
+                bc_read_error_end(s);
+                goto fail;
+            }
+            b->pc2line_buf = (uint8_t *)s->ptr;
+            b->read_only_pc2line = true;
+            s->ptr += b->pc2line_len;
+        } else {
+            b->pc2line_buf = js_mallocz(ctx, b->pc2line_len);
+            if (!b->pc2line_buf)
+                goto fail;
+            if (bc_get_buf(s, b->pc2line_buf, b->pc2line_len))
+                goto fail;
+        }
     }
     if (bc_get_leb128_int(s, &b->source_len))
         goto fail;
@@ -40207,6 +44092,23 @@ static JSValue JS_ReadArrayBuffer(BCReaderState *s)
     return JS_EXCEPTION;
 }
 
+static JSValue JS_ReadTransferredArrayBuffer(BCReaderState *s)
+{
+    JSValue obj;
+    uint32_t idx;
+
+    if (bc_get_leb128(s, &idx))
+        return JS_EXCEPTION;
+    if (idx >= s->transfer_len || !JS_IsArrayBuffer(s->transfer_tab[idx]))
+        return JS_ThrowTypeError(s->ctx, "invalid transferred array buffer");
+    obj = js_dup(s->transfer_tab[idx]);
+    if (BC_add_object_ref(s, obj)) {
+        JS_FreeValue(s->ctx, obj);
+        return JS_EXCEPTION;
+    }
+    return obj;
+}
+
 static JSValue JS_ReadSharedArrayBuffer(BCReaderState *s)
 {
     JSContext *ctx = s->ctx;
@@ -40405,6 +44307,9 @@ static JSValue JS_ReadObjectRec(BCReaderState *s)
     case BC_TAG_ARRAY_BUFFER:
         obj = JS_ReadArrayBuffer(s);
         break;
+    case BC_TAG_TRANSFERRED_ARRAY_BUFFER:
+        obj = JS_ReadTransferredArrayBuffer(s);
+        break;
     case BC_TAG_SHARED_ARRAY_BUFFER:
         if (!s->allow_sab || !ctx->rt->sab_funcs.sab_dup)
             goto invalid_tag;
@@ -40545,8 +44450,9 @@ static void bc_reader_free(BCReaderState *s)
     js_free(s->ctx, s->objects);
 }
 
-JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
-                       int flags, JSSABTab *psab_tab)
+JSValue JS_ReadObject3(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                       int flags, JSSABTab *psab_tab,
+                       JSValueConst *transfer_tab, int transfer_len)
 {
     BCReaderState ss, *s = &ss;
     JSValue obj;
@@ -40556,12 +44462,15 @@ JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
 
     memset(s, 0, sizeof(*s));
     s->ctx = ctx;
+    s->transfer_tab = transfer_tab;
+    s->transfer_len = transfer_len;
     s->buf_start = buf;
     s->buf_end = buf + buf_len;
     s->ptr = buf;
     s->allow_bytecode = ((flags & JS_READ_OBJ_BYTECODE) != 0);
     s->allow_sab = ((flags & JS_READ_OBJ_SAB) != 0);
     s->allow_reference = ((flags & JS_READ_OBJ_REFERENCE) != 0);
+    s->is_rom_data = ((flags & JS_READ_OBJ_IN_PLACE) != 0);
     if (s->allow_bytecode)
         s->first_atom = JS_ATOM_END;
     else
@@ -40581,6 +44490,12 @@ JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
     return obj;
 }
 
+JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                       int flags, JSSABTab *psab_tab)
+{
+    return JS_ReadObject3(ctx, buf, buf_len, flags, psab_tab, NULL, 0);
+}
+
 JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
                       int flags)
 {
@@ -47205,6 +51120,8 @@ slow_path:
 static int string_cmp(JSString *p1, JSString *p2, int x1, int x2, int len)
 {
     int i, c1, c2;
+    if (!p1->is_wide_char && !p2->is_wide_char)
+        return memcmp(str8(p1) + x1, str8(p2) + x2, len);
     for (i = 0; i < len; i++) {
         if ((c1 = string_get(p1, x1 + i)) != (c2 = string_get(p2, x2 + i)))
             return c1 - c2;
@@ -47212,21 +51129,122 @@ static int string_cmp(JSString *p1, JSString *p2, int x1, int x2, int len)
     return 0;
 }
 
+/* return the index of the first 'c' in 'str[0..len-1]' or -1 */
+static int js_memchr16(const uint16_t *str, uint16_t c, int len)
+{
+    int i = 0;
+#if defined(JS_HAVE_SSE2)
+    __m128i vc = _mm_set1_epi16(c);
+    for (; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, vc));
+        if (mask)
+            return i + (ctz32(mask) >> 1);
+    }
+#elif defined(JS_HAVE_NEON)
+    uint16x8_t vc = vdupq_n_u16(c);
+    for (; i + 8 <= len; i += 8) {
+        uint16x8_t eq = vceqq_u16(vld1q_u16(str + i), vc);
+        /* one byte per lane */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(eq, 4)), 0);
+        if (mask)
+            return i + (ctz64(mask) >> 3);
+    }
+#endif
+    for (; i < len; i++) {
+        if (str[i] == c)
+            return i;
+    }
+    return -1;
+}
+
+/* Search 'needle[0..n-1]' in 'str[from..len-1]', with 2 <= n. The
+   candidate positions are those matching both the first and the last
+   character of the needle, which are tested 16 at a time when vector
+   instructions are available. */
+static int js_memmem8(const uint8_t *str, int len, const uint8_t *needle,
+                      int n, int from)
+{
+    const uint8_t *q;
+    int i = from, last = len - n;
+#if defined(JS_HAVE_SSE2)
+    __m128i vfirst = _mm_set1_epi8(needle[0]);
+    __m128i vlast = _mm_set1_epi8(needle[n - 1]);
+    for (; i + 16 <= last + 1; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(str + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(str + i + n - 1));
+        int k, mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v0, vfirst),
+                                                      _mm_cmpeq_epi8(v1, vlast)));
+        while (mask) {
+            k = ctz32(mask);
+            if (!memcmp(str + i + k + 1, needle + 1, n - 2))
+                return i + k;
+            mask &= mask - 1;
+        }
+    }
+#elif defined(JS_HAVE_NEON)
+    uint8x16_t vfirst = vdupq_n_u8(needle[0]);
+    uint8x16_t vlast = vdupq_n_u8(needle[n - 1]);
+    for (; i + 16 <= last + 1; i += 16) {
+        uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(str + i), vfirst),
+                                 vceqq_u8(vld1q_u8(str + i + n - 1), vlast));
+        /* 4 bits per byte */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        int k;
+        while (mask) {
+            k = ctz64(mask) >> 2;
+            if (!memcmp(str + i + k + 1, needle + 1, n - 2))
+                return i + k;
+            mask &= ~((uint64_t)0xf << (k * 4));
+        }
+    }
+#endif
+    while (i <= last) {
+        q = memchr(str + i, needle[0], last - i + 1);
+        if (!q)
+            break;
+        i = q - str;
+        if (str[i + n - 1] == needle[n - 1] &&
+            !memcmp(str + i + 1, needle + 1, n - 2))
+            return i;
+        i++;
+    }
+    return -1;
+}
+
+static int js_memmem16(const uint16_t *str, int len, const uint16_t *needle,
+                       int n, int from)
+{
+    int i = from, j, last = len - n;
+    while (i <= last) {
+        j = js_memchr16(str + i, needle[0], last - i + 1);
+        if (j < 0)
+            break;
+        i += j;
+        if (str[i + n - 1] == needle[n - 1] &&
+            !memcmp(str + i + 1, needle + 1, (n - 2) * 2))
+            return i;
+        i++;
+    }
+    return -1;
+}
+
 static int string_indexof_char(JSString *p, int c, int from)
 {
     /* assuming 0 <= from <= p->len */
-    int i, len = p->len;
+    const uint8_t *q;
+    int i;
     if (p->is_wide_char) {
-        for (i = from; i < len; i++) {
-            if (str16(p)[i] == c)
-                return i;
+        if ((c & ~0xffff) == 0) {
+            i = js_memchr16(str16(p) + from, c, p->len - from);
+            if (i >= 0)
+                return from + i;
         }
     } else {
         if ((c & ~0xff) == 0) {
-            for (i = from; i < len; i++) {
-                if (str8(p)[i] == (uint8_t)c)
-                    return i;
-            }
+            q = memchr(str8(p) + from, c, p->len - from);
+            if (q)
+                return q - str8(p);
         }
     }
     return -1;
@@ -47238,7 +51256,18 @@ static int string_indexof(JSString *p1, JSString *p2, int from)
     int c, i, j, len1 = p1->len, len2 = p2->len;
     if (len2 == 0)
         return from;
-    for (i = from, c = string_get(p2, 0); i + len2 <= len1; i = j + 1) {
+    if (len2 > len1 - from)
+        return -1;
+    c = string_get(p2, 0);
+    if (len2 == 1)
+        return string_indexof_char(p1, c, from);
+    if (p1->is_wide_char == p2->is_wide_char) {
+        if (p1->is_wide_char)
+            return js_memmem16(str16(p1), len1, str16(p2), len2, from);
+        else
+            return js_memmem8(str8(p1), len1, str8(p2), len2, from);
+    }
+    for (i = from; i + len2 <= len1; i = j + 1) {
         j = string_indexof_char(p1, c, i);
         if (j < 0 || j + len2 > len1)
             break;
@@ -47380,7 +51409,9 @@ static JSValue js_string_indexOf(JSContext *ctx, JSValueConst this_val,
         inc = 1;
     }
     ret = -1;
-    if (len >= v_len && inc * (stop - start) >= 0) {
+    if (!lastIndexOf) {
+        ret = string_indexof(p, p1, pos);
+    } else if (len >= v_len && inc * (stop - start) >= 0) {
         for (i = start;; i += inc) {
             if (!string_cmp(p, p1, i, 0, v_len)) {
                 ret = i;
@@ -47407,7 +51438,7 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
                                   int argc, JSValueConst *argv, int magic)
 {
     JSValue str, v = JS_UNDEFINED;
-    int i, len, v_len, pos, start, stop, ret;
+    int len, v_len, pos, start, stop, ret;
     JSString *p;
     JSString *p1;
 
@@ -47447,13 +51478,10 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
         start = stop = pos;
     }
     if (start >= 0 && start <= stop) {
-        for (i = start;; i++) {
-            if (!string_cmp(p, p1, i, 0, v_len)) {
-                ret = 1;
-                break;
-            }
-            if (i == stop)
-                break;
+        if (magic == 0) {
+            ret = (string_indexof(p, p1, start) >= 0);
+        } else {
+            ret = !string_cmp(p, p1, start, 0, v_len);
         }
     }
  done:
@@ -49134,6 +53162,89 @@ static void js_regexp_finalizer(JSRuntime *rt, JSValueConst val)
     JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, re->pattern));
 }
 
+static void js_regexp_cache_remove(JSRuntime *rt, JSRegExpCacheEntry *e)
+{
+    JSRegExpCacheEntry **pe;
+
+    pe = &rt->regexp_cache_hash[e->hash & (JS_REGEXP_CACHE_HASH_SIZE - 1)];
+    while (*pe != e)
+        pe = &(*pe)->hash_next;
+    *pe = e->hash_next;
+    list_del(&e->link);
+    JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, e->pattern));
+    JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, e->bytecode));
+    js_free_rt(rt, e);
+    rt->regexp_cache_count--;
+}
+
+static void js_regexp_cache_free(JSRuntime *rt)
+{
+    struct list_head *el, *el1;
+
+    list_for_each_safe(el, el1, &rt->regexp_cache_list) {
+        js_regexp_cache_remove(rt, list_entry(el, JSRegExpCacheEntry, link));
+    }
+    js_free_rt(rt, rt->regexp_cache_hash);
+    rt->regexp_cache_hash = NULL;
+}
+
+static uint32_t js_regexp_cache_hash(JSString *pattern, int re_flags)
+{
+    return js_string_hash(pattern) ^ ((uint32_t)re_flags * 0x9e3779b1);
+}
+
+/* return the cached bytecode of the regexp or NULL if not found */
+static JSString *js_regexp_cache_find(JSRuntime *rt, JSString *pattern,
+                                      int re_flags, uint32_t hash)
+{
+    JSRegExpCacheEntry *e;
+
+    if (!rt->regexp_cache_hash)
+        return NULL;
+    e = rt->regexp_cache_hash[hash & (JS_REGEXP_CACHE_HASH_SIZE - 1)];
+    for(; e != NULL; e = e->hash_next) {
+        if (e->hash == hash && e->re_flags == re_flags &&
+            js_string_eq(e->pattern, pattern)) {
+            /* move to the head of the LRU list */
+            list_del(&e->link);
+            list_add(&e->link, &rt->regexp_cache_list);
+            return e->bytecode;
+        }
+    }
+    return NULL;
+}
+
+/* failing to add an entry is not an error */
+static void js_regexp_cache_add(JSRuntime *rt, JSString *pattern,
+                                int re_flags, uint32_t hash, JSString *bc)
+{
+    JSRegExpCacheEntry *e, **pe;
+
+    if (!rt->regexp_cache_hash) {
+        rt->regexp_cache_hash = js_mallocz_rt(rt, sizeof(rt->regexp_cache_hash[0]) *
+                                              JS_REGEXP_CACHE_HASH_SIZE);
+        if (!rt->regexp_cache_hash)
+            return;
+    }
+    if (rt->regexp_cache_count >= JS_REGEXP_CACHE_SIZE) {
+        /* evict the least recently used entry */
+        js_regexp_cache_remove(rt, list_entry(rt->regexp_cache_list.prev,
+                                              JSRegExpCacheEntry, link));
+    }
+    e = js_malloc_rt(rt, sizeof(*e));
+    if (!e)
+        return;
+    e->hash = hash;
+    e->re_flags = re_flags;
+    e->pattern = JS_VALUE_GET_STRING(js_dup(JS_MKPTR(JS_TAG_STRING, pattern)));
+    e->bytecode = JS_VALUE_GET_STRING(js_dup(JS_MKPTR(JS_TAG_STRING, bc)));
+    pe = &rt->regexp_cache_hash[hash & (JS_REGEXP_CACHE_HASH_SIZE - 1)];
+    e->hash_next = *pe;
+    *pe = e;
+    list_add(&e->link, &rt->regexp_cache_list);
+    rt->regexp_cache_count++;
+}
+
 /* create a string containing the RegExp bytecode */
 static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
                                  JSValueConst flags)
@@ -49145,6 +53256,8 @@ static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
     int re_bytecode_len;
     JSValue ret;
     char error_msg[64];
+    bool cacheable;
+    uint32_t hash;
 
     re_flags = 0;
     if (!JS_IsUndefined(flags)) {
@@ -49195,6 +53308,22 @@ static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
         if (re_flags & LRE_FLAG_UNICODE_SETS)
             return JS_ThrowSyntaxError(ctx, "invalid regular expression flags");
 
+    /* the bytecode only depends on the pattern and the flags */
+    cacheable = (JS_VALUE_GET_TAG(pattern) == JS_TAG_STRING &&
+                 JS_VALUE_GET_STRING(pattern)->len <= JS_REGEXP_CACHE_PATTERN_LEN_MAX);
+    hash = 0;
+    if (cacheable) {
+        JSString *bc;
+        hash = js_regexp_cache_hash(JS_VALUE_GET_STRING(pattern), re_flags);
+        bc = js_regexp_cache_find(ctx->rt, JS_VALUE_GET_STRING(pattern),
+                                  re_flags, hash);
+        if (bc) {
+            ctx->rt->regexp_cache_hit_count++;
+            return js_dup(JS_MKPTR(JS_TAG_STRING, bc));
+        }
+        ctx->rt->regexp_cache_miss_count++;
+    }
+
     /* The v flag implies full Unicode, like u, so the pattern must be
        UTF-8 (not CESU-8) for both. */
     str = JS_ToCStringLen2(ctx, &len, pattern,
@@ -49217,6 +53346,9 @@ static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
         JSString *p = JS_VALUE_GET_STRING(ret);
         p->kind = JS_STRING_KIND_INDIRECT;
         p->len = re_bytecode_len;
+        if (cacheable)
+            js_regexp_cache_add(ctx->rt, JS_VALUE_GET_STRING(pattern),
+                                re_flags, hash, p);
     }
     return ret;
 }
@@ -50971,8 +55103,44 @@ static void json_free_parse_record(JSContext *ctx, JSONParseRecord *pr)
     pr->value = JS_UNDEFINED; /* fail safe */
 }
 
-/* 'pr' can be NULL */
-static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
+/* Shapes of the last object parsed in an array: shapes[k] is its shape
+   with its first k properties. The next objects with the same keys take
+   the same shape transitions without looking up their keys. */
+typedef struct JSONShapeChain {
+    JSShape **shapes;
+    int count;
+    int size;
+} JSONShapeChain;
+
+static void json_shape_chain_free(JSRuntime *rt, JSONShapeChain *chain)
+{
+    int i;
+
+    for(i = 0; i < chain->count; i++)
+        js_free_shape(rt, chain->shapes[i]);
+    js_free_rt(rt, chain->shapes);
+}
+
+/* set the shape with 'k' properties. The following ones are removed. */
+static int json_shape_chain_set(JSContext *ctx, JSONShapeChain *chain,
+                                int k, JSShape *sh)
+{
+    while (chain->count > k)
+        js_free_shape(ctx->rt, chain->shapes[--chain->count]);
+    if (chain->count != k || !sh->is_hashed)
+        return 0;
+    if (js_resize_array(ctx, (void **)&chain->shapes, sizeof(chain->shapes[0]),
+                        &chain->size, k + 1))
+        return -1;
+    chain->shapes[chain->count++] = js_dup_shape(sh);
+    return 0;
+}
+
+/* 'pr' can be NULL. 'chain' is the shape chain of the array containing
+   the value, or NULL if the value is not an array element or if there is
+   a reviver. */
+static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr,
+                                JSONShapeChain *chain)
 {
     JSContext *ctx = s->ctx;
     JSValue val = JS_NULL;
@@ -50992,7 +55160,10 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
             JSValue prop_val;
             JSAtom prop_name;
             JSONParseRecord *pr1;
-            int pr_size;
+            JSObject *p;
+            JSShape *sh, *sh1;
+            JSShapeProperty *prs;
+            int pr_size, k, prop_alloc;
 
             if (json_next_token(s))
                 goto fail;
@@ -51003,8 +55174,69 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
                 json_parse_record_init_obj(ctx, pr, val);
                 pr_size = 0;
             }
+            p = JS_VALUE_GET_OBJ(val);
+            prop_alloc = p->shape->prop_size;
+            if (chain) {
+                if (chain->count > 0 && chain->shapes[0] == p->shape) {
+                    /* allocate the properties of the previous object */
+                    sh1 = chain->shapes[chain->count - 1];
+                    if (sh1->prop_size > prop_alloc) {
+                        JSProperty *new_prop;
+                        new_prop = js_realloc(ctx, p->prop, sizeof(p->prop[0]) *
+                                              sh1->prop_size);
+                        if (!new_prop)
+                            goto fail;
+                        p->prop = new_prop;
+                        prop_alloc = sh1->prop_size;
+                    }
+                } else {
+                    if (json_shape_chain_set(ctx, chain, 0, p->shape))
+                        goto fail;
+                }
+            }
             if (s->token.val != '}') {
                 for(;;) {
+                    sh = p->shape;
+                    k = sh->prop_count;
+                    if (chain && chain->count > k + 1 &&
+                        chain->shapes[k] == sh &&
+                        s->token.val == TOK_STRING) {
+                        /* same key as in the previous object: its shape
+                           is used directly */
+                        sh1 = chain->shapes[k + 1];
+                        prs = &get_shape_prop(sh1)[k];
+                        if (!__JS_AtomIsTaggedInt(prs->atom) &&
+                            prs->flags == JS_PROP_C_W_E &&
+                            js_string_eq(ctx->rt->atom_array[prs->atom],
+                                         JS_VALUE_GET_STRING(s->token.u.str.str))) {
+                            if (json_next_token(s))
+                                goto fail;
+                            if (s->token.val != ':') {
+                                json_parse_error(s, s->token.ptr, "Expected ':' after property name");
+                                goto fail;
+                            }
+                            if (json_next_token(s))
+                                goto fail;
+                            prop_val = json_parse_value(s, NULL, NULL);
+                            if (JS_IsException(prop_val))
+                                goto fail;
+                            if (sh1->prop_size > prop_alloc) {
+                                JSProperty *new_prop;
+                                new_prop = js_realloc(ctx, p->prop, sizeof(p->prop[0]) *
+                                                      sh1->prop_size);
+                                if (!new_prop) {
+                                    JS_FreeValue(ctx, prop_val);
+                                    goto fail;
+                                }
+                                p->prop = new_prop;
+                                prop_alloc = sh1->prop_size;
+                            }
+                            p->prop[k].u.value = prop_val;
+                            p->shape = js_dup_shape(sh1);
+                            js_free_shape(ctx->rt, sh);
+                            goto next_prop;
+                        }
+                    }
                     if (s->token.val == TOK_STRING) {
                         prop_name = JS_ValueToAtom(ctx, s->token.u.str.str);
                         if (prop_name == JS_ATOM_NULL)
@@ -51028,7 +55260,7 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
                     } else {
                         pr1 = NULL;
                     }
-                    prop_val = json_parse_value(s, pr1);
+                    prop_val = json_parse_value(s, pr1, NULL);
                     if (JS_IsException(prop_val)) {
                     fail1:
                         JS_FreeAtom(ctx, prop_name);
@@ -51039,6 +55271,15 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
                     JS_FreeAtom(ctx, prop_name);
                     if (ret < 0)
                         goto fail;
+                    /* the property array has the size of the new shape
+                       if it was reallocated */
+                    prop_alloc = min_int(prop_alloc, p->shape->prop_size);
+                    if (chain && p->shape->prop_count == k + 1 &&
+                        chain->count > k && chain->shapes[k] == sh) {
+                        if (json_shape_chain_set(ctx, chain, k + 1, p->shape))
+                            goto fail;
+                    }
+                next_prop:
 
                     if (s->token.val == '}')
                         break;
@@ -51059,6 +55300,7 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
             JSValue el;
             uint32_t idx;
             JSONParseRecord *pr1;
+            JSONShapeChain chain1 = { NULL, 0, 0 };
             int pr_size;
 
             if (json_next_token(s))
@@ -51081,22 +55323,27 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
                     } else {
                         pr1 = NULL;
                     }
-                    el = json_parse_value(s, pr1);
+                    /* the reviver needs the property names */
+                    el = json_parse_value(s, pr1, pr1 ? NULL : &chain1);
                     if (JS_IsException(el))
-                        goto fail;
+                        goto fail2;
                     ret = JS_DefinePropertyValueUint32(ctx, val, idx, el, JS_PROP_C_W_E);
                     if (ret < 0)
-                        goto fail;
+                        goto fail2;
                     if (s->token.val == ']')
                         break;
                     if (s->token.val != ',') {
                         json_parse_error(s, s->token.ptr, "Expected ',' or ']' after array element");
-                        goto fail;
+                        goto fail2;
                     }
-                    if (json_next_token(s))
+                    if (json_next_token(s)) {
+                    fail2:
+                        json_shape_chain_free(ctx->rt, &chain1);
                         goto fail;
+                    }
                 }
             }
+            json_shape_chain_free(ctx->rt, &chain1);
             if (json_next_token(s))
                 goto fail;
         }
@@ -51146,10 +55393,10 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
     default:
     def_token:
         if (s->token.val == TOK_EOF) {
-            js_parse_error(s, "Unexpected end of JSON input");
+            json_parse_error_fmt(s, s->token.ptr, "Unexpected end of JSON input");
         } else {
-            js_parse_error(s, "unexpected token: '%.*s'",
-                           (int)(s->buf_ptr - s->token.ptr), s->token.ptr);
+            json_parse_error_fmt(s, s->token.ptr, "unexpected token: '%.*s'",
+                                 (int)(s->buf_ptr - s->token.ptr), s->token.ptr);
         }
         goto fail;
     }
@@ -51160,20 +55407,23 @@ static JSValue json_parse_value(JSParseState *s, JSONParseRecord *pr)
     return JS_EXCEPTION;
 }
 
+/* 'stream_pos' is the position of 'buf' in a JSON stream or -1 */
 static JSValue JS_ParseJSON_internal(JSContext *ctx, const char *buf, size_t buf_len,
-                                     const char *filename, JSONParseRecord *pr)
+                                     const char *filename, JSONParseRecord *pr,
+                                     int64_t stream_pos)
 {
     JSParseState s1, *s = &s1;
     JSValue val = JS_UNDEFINED;
 
     js_parse_init(ctx, s, buf, buf_len, filename, 1);
+    s->json_stream_pos = stream_pos;
     if (json_next_token(s))
         goto fail;
-    val = json_parse_value(s, pr);
+    val = json_parse_value(s, pr, NULL);
     if (JS_IsException(val))
         goto fail;
     if (s->token.val != TOK_EOF) {
-        if (js_parse_error(s, "unexpected data at the end")) {
+        if (json_parse_error_fmt(s, s->token.ptr, "unexpected data at the end")) {
             json_free_parse_record(ctx, pr);
             goto fail;
         }
@@ -51188,7 +55438,386 @@ static JSValue JS_ParseJSON_internal(JSContext *ctx, const char *buf, size_t buf
 /* 'buf' must be zero terminated i.e. buf[buf_len] = '\0'. */
 JSValue JS_ParseJSON(JSContext *ctx, const char *buf, size_t buf_len, const char *filename)
 {
-    return JS_ParseJSON_internal(ctx, buf, buf_len, filename, NULL);
+    return JS_ParseJSON_internal(ctx, buf, buf_len, filename, NULL, -1);
+}
+
+/* Streaming JSON parser: the input is given by chunks and the values at
+   the depth 'max_depth' (or the scalar values above it) are returned
+   to a callback, so that the enclosing containers are never built. The
+   extent of each returned value is found by scanning its brackets and
+   strings, then it is parsed with JS_ParseJSON_internal(). */
+
+typedef enum {
+    JSON_STREAM_VALUE,       /* a value */
+    JSON_STREAM_FIRST_VALUE, /* after '[': a value or ']' */
+    JSON_STREAM_FIRST_KEY,   /* after '{': a key or '}' */
+    JSON_STREAM_KEY,         /* after ',' in an object */
+    JSON_STREAM_COLON,       /* after a key */
+    JSON_STREAM_NEXT,        /* after a value: ',' or the end of the container */
+} JSONStreamStateEnum;
+
+typedef struct JSONStreamLevel {
+    bool is_array;
+    uint32_t index; /* index of the current element */
+} JSONStreamLevel;
+
+struct JSJSONParser {
+    JSContext *ctx;
+    JSJSONParserCallback *cb;
+    void *opaque;
+    int max_depth;
+    int depth; /* number of open containers */
+    JSONStreamLevel *levels; /* 'max_depth' entries */
+    JSONStreamStateEnum state;
+    bool failed; /* a syntax error was found */
+    bool in_callback;
+    bool free_pending; /* freed by the callback */
+    JSValue key; /* key of the current object member */
+    int64_t top_index; /* index of the current top level value */
+    int64_t offset; /* position in the stream of buf.buf[0] */
+    DynBuf buf; /* input, one more byte is always allocated */
+    size_t pos; /* start of the unprocessed input */
+    /* scanning of a value or a key starting at 'pos' */
+    bool scanning;
+    bool scan_in_string;
+    bool scan_escape;
+    int scan_depth; /* -1 for a number or a literal */
+    size_t scan_pos;
+};
+
+static void *js_json_parser_realloc(void *opaque, void *ptr, size_t size)
+{
+    return js_realloc_rt(opaque, ptr, size);
+}
+
+JSJSONParser *JS_NewJSONParser(JSContext *ctx, int max_depth,
+                               JSJSONParserCallback *cb, void *opaque)
+{
+    JSJSONParser *p;
+
+    if (max_depth < 0) {
+        JS_ThrowRangeError(ctx, "invalid depth");
+        return NULL;
+    }
+    p = js_mallocz(ctx, sizeof(*p));
+    if (!p)
+        return NULL;
+    if (max_depth > 0) {
+        p->levels = js_malloc(ctx, sizeof(p->levels[0]) * max_depth);
+        if (!p->levels) {
+            js_free(ctx, p);
+            return NULL;
+        }
+    }
+    p->ctx = ctx;
+    p->cb = cb;
+    p->opaque = opaque;
+    p->max_depth = max_depth;
+    p->state = JSON_STREAM_VALUE;
+    p->key = JS_UNDEFINED;
+    dbuf_init2(&p->buf, ctx->rt, js_json_parser_realloc);
+    return p;
+}
+
+void JS_FreeJSONParser(JSRuntime *rt, JSJSONParser *p)
+{
+    if (!p)
+        return;
+    if (p->in_callback) {
+        /* freed when JS_WriteJSONParser() or JS_EndJSONParser() returns */
+        p->free_pending = true;
+        return;
+    }
+    JS_FreeValueRT(rt, p->key);
+    dbuf_free(&p->buf);
+    js_free_rt(rt, p->levels);
+    js_free_rt(rt, p);
+}
+
+static int json_parser_error(JSJSONParser *p, size_t pos, const char *msg)
+{
+    p->failed = true;
+    JS_ThrowSyntaxError(p->ctx, "%s in JSON at position %" PRId64,
+                        msg, p->offset + (int64_t)pos);
+    return -1;
+}
+
+static inline bool json_is_space(int c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/* return 1 if the scanned value or key is complete, 0 if more input is
+   needed */
+static int json_parser_scan(JSJSONParser *p, bool eof)
+{
+    const uint8_t *buf = p->buf.buf;
+    size_t i, size = p->buf.size;
+    int c;
+
+    i = p->scan_pos;
+    if (p->scan_depth < 0) {
+        /* number or literal: ends at the next delimiter */
+        for(; i < size; i++) {
+            c = buf[i];
+            if (json_is_space(c) || c == ',' || c == ']' || c == '}')
+                break;
+        }
+        p->scan_pos = i;
+        return i < size || eof;
+    }
+    for(; i < size; i++) {
+        c = buf[i];
+        if (p->scan_in_string) {
+            if (p->scan_escape) {
+                p->scan_escape = false;
+            } else if (c == '\\') {
+                p->scan_escape = true;
+            } else if (c == '"') {
+                p->scan_in_string = false;
+                if (p->scan_depth == 0) {
+                    p->scan_pos = i + 1;
+                    return 1;
+                }
+            }
+        } else if (c == '"') {
+            p->scan_in_string = true;
+        } else if (c == '[' || c == '{') {
+            p->scan_depth++;
+        } else if (c == ']' || c == '}') {
+            if (--p->scan_depth == 0) {
+                p->scan_pos = i + 1;
+                return 1;
+            }
+        }
+    }
+    p->scan_pos = i;
+    return 0;
+}
+
+static void json_parser_start_scan(JSJSONParser *p)
+{
+    int c = p->buf.buf[p->pos];
+
+    p->scanning = true;
+    p->scan_in_string = false;
+    p->scan_escape = false;
+    p->scan_pos = p->pos + 1;
+    if (c == '[' || c == '{') {
+        p->scan_depth = 1;
+    } else if (c == '"') {
+        p->scan_depth = 0;
+        p->scan_in_string = true;
+    } else {
+        p->scan_depth = -1;
+    }
+}
+
+/* the current value is complete: go to the next one */
+static void json_parser_next(JSJSONParser *p)
+{
+    if (p->depth == 0) {
+        p->top_index++;
+        p->state = JSON_STREAM_VALUE;
+    } else {
+        p->state = JSON_STREAM_NEXT;
+    }
+}
+
+static int json_parser_emit(JSJSONParser *p, JSValue val)
+{
+    JSContext *ctx = p->ctx;
+    JSONStreamLevel *l;
+    JSValue key;
+    int ret;
+
+    if (p->depth == 0) {
+        key = js_int64(p->top_index);
+    } else {
+        l = &p->levels[p->depth - 1];
+        if (l->is_array) {
+            key = js_uint32(l->index);
+        } else {
+            key = p->key;
+            p->key = JS_UNDEFINED;
+        }
+    }
+    /* the state is updated before the call so that the parsing can
+       continue after an exception in the callback */
+    json_parser_next(p);
+    p->in_callback = true;
+    ret = p->cb(ctx, key, val, p->depth, p->opaque);
+    p->in_callback = false;
+    JS_FreeValue(ctx, key);
+    JS_FreeValue(ctx, val);
+    if (ret < 0)
+        return -1;
+    /* stop the parsing if the parser was freed by the callback */
+    return p->free_pending;
+}
+
+/* return < 0 if exception, 1 if the parser was freed by the callback
+   or 0 otherwise */
+static int json_parser_process(JSJSONParser *p, bool eof)
+{
+    JSContext *ctx = p->ctx;
+    JSONStreamLevel *l;
+    size_t end;
+    JSValue val;
+    uint8_t *buf;
+    int c, ret;
+
+    for(;;) {
+        buf = p->buf.buf;
+        if (p->scanning) {
+            if (!json_parser_scan(p, eof))
+                break;
+            /* JS_ParseJSON_internal() needs a terminating zero */
+            end = p->scan_pos;
+            c = buf[end];
+            buf[end] = '\0';
+            val = JS_ParseJSON_internal(ctx, (char *)buf + p->pos, end - p->pos,
+                                        "<input>", NULL, p->offset + p->pos);
+            buf[end] = c;
+            if (JS_IsException(val)) {
+                p->failed = true;
+                return -1;
+            }
+            p->scanning = false;
+            p->pos = end;
+            if (p->state == JSON_STREAM_KEY ||
+                p->state == JSON_STREAM_FIRST_KEY) {
+                p->key = val;
+                p->state = JSON_STREAM_COLON;
+            } else {
+                ret = json_parser_emit(p, val);
+                if (ret)
+                    return ret;
+            }
+            continue;
+        }
+        while (p->pos < p->buf.size && json_is_space(buf[p->pos]))
+            p->pos++;
+        if (p->pos >= p->buf.size)
+            break;
+        c = buf[p->pos];
+        switch(p->state) {
+        case JSON_STREAM_FIRST_VALUE:
+            if (c == ']')
+                goto close;
+            /* fall thru */
+        case JSON_STREAM_VALUE:
+            if ((c == '[' || c == '{') && p->depth < p->max_depth) {
+                /* the container is not built */
+                JS_FreeValue(ctx, p->key);
+                p->key = JS_UNDEFINED;
+                l = &p->levels[p->depth++];
+                l->is_array = (c == '[');
+                l->index = 0;
+                p->state = l->is_array ? JSON_STREAM_FIRST_VALUE :
+                    JSON_STREAM_FIRST_KEY;
+                p->pos++;
+            } else if (c == '[' || c == '{' || c == '"' || c == '-' ||
+                       is_digit(c) || c == 't' || c == 'f' || c == 'n') {
+                json_parser_start_scan(p);
+            } else {
+                return json_parser_error(p, p->pos, "unexpected character");
+            }
+            break;
+        case JSON_STREAM_FIRST_KEY:
+            if (c == '}')
+                goto close;
+            /* fall thru */
+        case JSON_STREAM_KEY:
+            if (c != '"')
+                return json_parser_error(p, p->pos, "expected property name");
+            json_parser_start_scan(p);
+            break;
+        case JSON_STREAM_COLON:
+            if (c != ':')
+                return json_parser_error(p, p->pos, "expected ':'");
+            p->state = JSON_STREAM_VALUE;
+            p->pos++;
+            break;
+        case JSON_STREAM_NEXT:
+            l = &p->levels[p->depth - 1];
+            if (c == ',') {
+                if (l->is_array) {
+                    l->index++;
+                    p->state = JSON_STREAM_VALUE;
+                } else {
+                    p->state = JSON_STREAM_KEY;
+                }
+                p->pos++;
+                break;
+            }
+            if (c != (l->is_array ? ']' : '}'))
+                return json_parser_error(p, p->pos, "expected ',' or the end of the container");
+        close:
+            p->depth--;
+            p->pos++;
+            json_parser_next(p);
+            break;
+        }
+    }
+    if (eof && (p->scanning || p->depth != 0 || p->state != JSON_STREAM_VALUE))
+        return json_parser_error(p, p->buf.size, "unexpected end of input");
+    return 0;
+}
+
+/* free the parser if it was freed by the callback */
+static int json_parser_end_feed(JSJSONParser *p, int ret)
+{
+    if (p->free_pending) {
+        JS_FreeJSONParser(p->ctx->rt, p);
+        ret = min_int(ret, 0);
+    }
+    return ret;
+}
+
+static int json_parser_check(JSJSONParser *p)
+{
+    if (p->in_callback) {
+        JS_ThrowTypeError(p->ctx, "JSON parser is busy");
+        return -1;
+    }
+    if (p->failed) {
+        JS_ThrowTypeError(p->ctx, "JSON parser is in error state");
+        return -1;
+    }
+    return 0;
+}
+
+int JS_WriteJSONParser(JSJSONParser *p, const char *buf, size_t len)
+{
+    if (json_parser_check(p))
+        return -1;
+    /* remove the processed input */
+    if (p->pos > 0) {
+        memmove(p->buf.buf, p->buf.buf + p->pos, p->buf.size - p->pos);
+        p->buf.size -= p->pos;
+        p->offset += p->pos;
+        if (p->scanning)
+            p->scan_pos -= p->pos;
+        p->pos = 0;
+    }
+    if (dbuf_claim(&p->buf, len + 1)) {
+        JS_ThrowOutOfMemory(p->ctx);
+        return -1;
+    }
+    dbuf_put(&p->buf, (const uint8_t *)buf, len);
+    return json_parser_end_feed(p, json_parser_process(p, false));
+}
+
+int JS_EndJSONParser(JSJSONParser *p)
+{
+    if (json_parser_check(p))
+        return -1;
+    if (dbuf_claim(&p->buf, 1)) {
+        JS_ThrowOutOfMemory(p->ctx);
+        return -1;
+    }
+    return json_parser_end_feed(p, json_parser_process(p, true));
 }
 
 /* if pr != NULL, then pr->value = holder by construction */
@@ -51323,7 +55952,7 @@ static JSValue js_json_parse(JSContext *ctx, JSValueConst this_val,
         if (!pr1)
             goto fail1;
 
-        obj = JS_ParseJSON_internal(ctx, str, len, "<input>", pr1);
+        obj = JS_ParseJSON_internal(ctx, str, len, "<input>", pr1, -1);
         if (JS_IsException(obj))
             goto fail1;
 
@@ -51340,7 +55969,7 @@ static JSValue js_json_parse(JSContext *ctx, JSValueConst this_val,
         json_free_parse_record(ctx, pr);
         JS_FreeValue(ctx, root);
     } else {
-        obj = JS_ParseJSON_internal(ctx, str, len, "<input>", NULL);
+        obj = JS_ParseJSON_internal(ctx, str, len, "<input>", NULL, -1);
     }
     JS_FreeCString(ctx, str);
     return obj;
@@ -51405,6 +56034,19 @@ static JSValue js_json_rawJSON(JSContext *ctx, JSValueConst this_val,
     return JS_EXCEPTION;
 }
 
+#define JSON_SHAPE_CACHE_SIZE 64 /* must be a power of two */
+#define JSON_SHAPE_CACHE_PROBE 4
+
+/* quoted keys of the enumerable properties of a shape */
+typedef struct JSONShapeCacheEntry {
+    JSShape *sh;
+    uint64_t shape_id;
+    /* '"key":' for each property, JS_NULL if the shape has array index
+       properties and the keys must be enumerated in order */
+    JSValue keys;
+    uint32_t *key_pos; /* sh->prop_count + 1 positions in 'keys' */
+} JSONShapeCacheEntry;
+
 typedef struct JSONStringifyContext {
     JSValueConst replacer_func;
     JSValue stack;
@@ -51412,6 +56054,7 @@ typedef struct JSONStringifyContext {
     JSValue gap;
     JSValue empty;
     StringBuffer *b;
+    JSONShapeCacheEntry *shape_cache; /* allocated on the first object */
 } JSONStringifyContext;
 
 static JSValue JS_ToQuotedStringFree(JSContext *ctx, JSValue val) {
@@ -51420,6 +56063,93 @@ static JSValue JS_ToQuotedStringFree(JSContext *ctx, JSValue val) {
     return r;
 }
 
+static void js_json_free_shape_cache(JSRuntime *rt, JSONStringifyContext *jsc)
+{
+    JSONShapeCacheEntry *e;
+    int i;
+
+    if (!jsc->shape_cache)
+        return;
+    for(i = 0; i < JSON_SHAPE_CACHE_SIZE; i++) {
+        e = &jsc->shape_cache[i];
+        if (e->sh) {
+            js_free_shape(rt, e->sh);
+            JS_FreeValueRT(rt, e->keys);
+            js_free_rt(rt, e->key_pos);
+        }
+    }
+    js_free_rt(rt, jsc->shape_cache);
+}
+
+/* Return the cached keys of the hashed shape 'sh' in '*pe' or NULL if
+   the cache is full. Return -1 if exception. The entries are never
+   replaced during a JSON.stringify() call. */
+static int js_json_get_shape_keys(JSContext *ctx, JSONStringifyContext *jsc,
+                                  JSShape *sh, JSONShapeCacheEntry **pe)
+{
+    JSONShapeCacheEntry *e;
+    JSShapeProperty *prs;
+    StringBuffer b_s, *b = &b_s;
+    uint32_t *key_pos, idx;
+    int i, h;
+
+    *pe = NULL;
+    if (!jsc->shape_cache) {
+        jsc->shape_cache = js_mallocz(ctx, sizeof(jsc->shape_cache[0]) *
+                                      JSON_SHAPE_CACHE_SIZE);
+        if (!jsc->shape_cache)
+            return -1;
+    }
+    h = sh->hash;
+    for(i = 0; i < JSON_SHAPE_CACHE_PROBE; i++) {
+        e = &jsc->shape_cache[(h + i) & (JSON_SHAPE_CACHE_SIZE - 1)];
+        if (e->sh == sh && e->shape_id == sh->id) {
+            *pe = e;
+            return 0;
+        }
+        if (!e->sh)
+            goto found;
+    }
+    return 0;
+ found:
+    key_pos = js_malloc(ctx, sizeof(key_pos[0]) * (sh->prop_count + 1));
+    if (!key_pos)
+        return -1;
+    string_buffer_init(ctx, b, 0);
+    for(i = 0, prs = get_shape_prop(sh); i < sh->prop_count; i++, prs++) {
+        key_pos[i] = b->len;
+        if (prs->atom == JS_ATOM_NULL || !(prs->flags & JS_PROP_ENUMERABLE) ||
+            JS_AtomGetKind(ctx, prs->atom) != JS_ATOM_KIND_STRING)
+            continue;
+        if (JS_AtomIsArrayIndex(ctx, &idx, prs->atom)) {
+            /* the array indexes are enumerated first */
+            string_buffer_free(b);
+            js_free(ctx, key_pos);
+            key_pos = NULL;
+            e->keys = JS_NULL;
+            goto done;
+        }
+        if (string_buffer_put_quoted(b, ctx->rt->atom_array[prs->atom]) ||
+            string_buffer_putc8(b, ':')) {
+            string_buffer_free(b);
+            js_free(ctx, key_pos);
+            return -1;
+        }
+    }
+    key_pos[i] = b->len;
+    e->keys = string_buffer_end(b);
+    if (JS_IsException(e->keys)) {
+        js_free(ctx, key_pos);
+        return -1;
+    }
+ done:
+    e->sh = js_dup_shape(sh);
+    e->shape_id = sh->id;
+    e->key_pos = key_pos;
+    *pe = e;
+    return 0;
+}
+
 static JSValue js_json_check(JSContext *ctx, JSONStringifyContext *jsc,
                              JSValueConst holder, JSValue val,
                              JSValueConst key)
@@ -51558,13 +56288,24 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
                 if (i > 0)
                     string_buffer_putc8(jsc->b, ',');
                 string_buffer_concat_value(jsc->b, sep);
-                v = JS_GetPropertyInt64(ctx, val, i);
-                if (JS_IsException(v))
-                    goto exception;
-                /* XXX: could do this string conversion only when needed */
-                prop = JS_ToStringFree(ctx, js_int64(i));
-                if (JS_IsException(prop))
-                    goto exception;
+                /* 'val' may be modified by toJSON() or the replacer */
+                if (p->class_id == JS_CLASS_ARRAY && p->fast_array &&
+                    i < p->u.array.count) {
+                    v = js_dup(p->u.array.u.values[i]);
+                } else {
+                    v = JS_GetPropertyInt64(ctx, val, i);
+                    if (JS_IsException(v))
+                        goto exception;
+                }
+                /* the key is only used by toJSON() and the replacer */
+                if (JS_IsObject(v) || JS_IsBigInt(v) ||
+                    !JS_IsUndefined(jsc->replacer_func)) {
+                    prop = JS_ToStringFree(ctx, js_int64(i));
+                    if (JS_IsException(prop)) {
+                        JS_FreeValue(ctx, v);
+                        goto exception;
+                    }
+                }
                 v = js_json_check(ctx, jsc, val, v, prop);
                 JS_FreeValue(ctx, prop);
                 prop = JS_UNDEFINED;
@@ -51581,6 +56322,61 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
             }
             string_buffer_putc8(jsc->b, ']');
         } else {
+            JSONShapeCacheEntry *e = NULL;
+
+            if (JS_IsUndefined(jsc->property_list) &&
+                p->class_id == JS_CLASS_OBJECT && p->shape->is_hashed) {
+                if (js_json_get_shape_keys(ctx, jsc, p->shape, &e))
+                    goto exception;
+            }
+            if (e && !JS_IsNull(e->keys)) {
+                JSShape *sh = e->sh;
+                JSShapeProperty *prs;
+                JSString *keys = JS_VALUE_GET_STRING(e->keys);
+
+                /* fast path: the properties are read in the shape order
+                   and the quoted keys come from the cache */
+                string_buffer_putc8(jsc->b, '{');
+                has_content = false;
+                for(i = 0; i < sh->prop_count; i++) {
+                    if (e->key_pos[i] == e->key_pos[i + 1])
+                        continue;
+                    prs = &get_shape_prop(sh)[i];
+                    if (p->shape == sh && sh->id == e->shape_id &&
+                        (prs->flags & JS_PROP_TMASK) == JS_PROP_NORMAL) {
+                        v = js_dup(p->prop[i].u.value);
+                    } else {
+                        v = JS_GetProperty(ctx, val, prs->atom);
+                        if (JS_IsException(v))
+                            goto exception;
+                    }
+                    if (JS_IsObject(v) || JS_IsBigInt(v) ||
+                        !JS_IsUndefined(jsc->replacer_func)) {
+                        prop = JS_AtomToString(ctx, prs->atom);
+                        if (JS_IsException(prop)) {
+                            JS_FreeValue(ctx, v);
+                            goto exception;
+                        }
+                    }
+                    v = js_json_check(ctx, jsc, val, v, prop);
+                    JS_FreeValue(ctx, prop);
+                    prop = JS_UNDEFINED;
+                    if (JS_IsException(v))
+                        goto exception;
+                    if (!JS_IsUndefined(v)) {
+                        if (has_content)
+                            string_buffer_putc8(jsc->b, ',');
+                        string_buffer_concat_value(jsc->b, sep);
+                        string_buffer_concat(jsc->b, keys, e->key_pos[i],
+                                             e->key_pos[i + 1]);
+                        string_buffer_concat_value(jsc->b, sep1);
+                        if (js_json_to_str(ctx, jsc, val, v, indent1))
+                            goto exception;
+                        has_content = true;
+                    }
+                }
+                goto end_object;
+            }
             if (!JS_IsUndefined(jsc->property_list))
                 tab = js_dup(jsc->property_list);
             else
@@ -51620,6 +56416,7 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
                     has_content = true;
                 }
             }
+        end_object:
             if (has_content && JS_VALUE_GET_STRING(jsc->gap)->len != 0) {
                 string_buffer_putc8(jsc->b, '\n');
                 string_buffer_concat_value(jsc->b, indent);
@@ -51638,20 +56435,37 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
     }
  concat_primitive:
     switch (JS_VALUE_GET_NORM_TAG(val)) {
-    case JS_TAG_STRING:
     case JS_TAG_STRING_ROPE:
-        val = JS_ToQuotedStringFree(ctx, val);
+        val = JS_ToStringFree(ctx, val);
         if (JS_IsException(val))
             goto exception;
-        goto concat_value;
+        /* fall thru */
+    case JS_TAG_STRING:
+        ret = string_buffer_put_quoted(jsc->b, JS_VALUE_GET_STRING(val));
+        JS_FreeValue(ctx, val);
+        return ret;
     case JS_TAG_FLOAT64:
-        if (!isfinite(JS_VALUE_GET_FLOAT64(val))) {
-            val = JS_NULL;
+        {
+            /* written directly to the buffer */
+            char buf[128];
+            JSDTOATempMem dtoa_mem;
+            double d = JS_VALUE_GET_FLOAT64(val);
+            if (!isfinite(d))
+                return string_buffer_puts8(jsc->b, "null");
+            len = js_dtoa(buf, d, 10, 0, JS_DTOA_FORMAT_FREE, &dtoa_mem);
+            return string_buffer_write8(jsc->b, (uint8_t *)buf, len);
         }
-        goto concat_value;
     case JS_TAG_INT:
+        {
+            char buf[16];
+            len = i32toa(buf, JS_VALUE_GET_INT(val));
+            return string_buffer_write8(jsc->b, (uint8_t *)buf, len);
+        }
     case JS_TAG_BOOL:
+        return string_buffer_puts8(jsc->b, JS_VALUE_GET_BOOL(val) ?
+                                   "true" : "false");
     case JS_TAG_NULL:
+        return string_buffer_puts8(jsc->b, "null");
     concat_value:
         return string_buffer_concat_value_free(jsc->b, val);
     case JS_TAG_SHORT_BIG_INT:
@@ -51687,6 +56501,7 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
     jsc->property_list = JS_UNDEFINED;
     jsc->gap = JS_UNDEFINED;
     jsc->b = &b_s;
+    jsc->shape_cache = NULL;
     jsc->empty = js_empty_string(ctx->rt);
     ret = JS_UNDEFINED;
     wrapper = JS_UNDEFINED;
@@ -51808,6 +56623,7 @@ done:
     JS_FreeValue(ctx, jsc->gap);
     JS_FreeValue(ctx, jsc->property_list);
     JS_FreeValue(ctx, jsc->stack);
+    js_json_free_shape_cache(ctx->rt, jsc);
     return ret;
 }
 
@@ -53211,12 +58027,6 @@ static JSValue js_map_constructor(JSContext *ctx, JSValueConst new_target,
     init_list_head(&s->records);
     s->is_weak = is_weak;
     JS_SetOpaqueInternal(obj, s);
-    s->hash_size = 1;
-    s->hash_table = js_malloc(ctx, sizeof(s->hash_table[0]) * s->hash_size);
-    if (!s->hash_table)
-        goto fail;
-    init_list_head(&s->hash_table[0]);
-    s->record_count_threshold = 4;
 
     arr = JS_UNDEFINED;
     if (argc > 0)
@@ -53330,10 +58140,11 @@ static uint32_t map_hash_key(JSContext *ctx, JSValueConst key)
         h = JS_VALUE_GET_INT(key);
         break;
     case JS_TAG_STRING:
-        h = hash_string(JS_VALUE_GET_STRING(key), 0);
+        h = js_string_hash(JS_VALUE_GET_STRING(key));
         break;
     case JS_TAG_STRING_ROPE:
-        h = hash_string_rope(key, 0);
+        h = hash_string_rope(key, JS_ATOM_TYPE_STRING) & JS_ATOM_HASH_MASK;
+        tag = JS_TAG_STRING;
         break;
     case JS_TAG_OBJECT:
     case JS_TAG_SYMBOL:
@@ -53366,50 +58177,86 @@ static uint32_t map_hash_key(JSContext *ctx, JSValueConst key)
     return h ^ ctx->hash_seed ^ hash32(tag);
 }
 
+#define MAP_HASH_SIZE_MIN 8
+#define MAP_TOMBSTONE ((JSMapRecord *)(uintptr_t)1)
+
+static inline uint32_t map_hash_index(JSMapState *s, uint32_t h)
+{
+    /* the low bits of map_hash_key() are poor for small integers, so
+       take the high bits of the product (Fibonacci hashing) */
+    return (h * 0x9e3779b9) >> (32 - s->hash_bits);
+}
+
 static JSMapRecord *map_find_record(JSContext *ctx, JSMapState *s,
                                     JSValueConst key)
 {
-    struct list_head *el;
     JSMapRecord *mr;
-    uint32_t h;
-    h = map_hash_key(ctx, key) & (s->hash_size - 1);
-    list_for_each(el, &s->hash_table[h]) {
-        mr = list_entry(el, JSMapRecord, hash_link);
-        if (js_same_value_zero(ctx, mr->key, key))
+    uint32_t h, i, mask;
+
+    if (s->hash_size == 0)
+        return NULL;
+    h = map_hash_key(ctx, key);
+    mask = s->hash_size - 1;
+    /* the table always has free slots, so the loop terminates */
+    for(i = map_hash_index(s, h);; i = (i + 1) & mask) {
+        mr = s->hash_table[i];
+        if (!mr)
+            return NULL;
+        if (mr != MAP_TOMBSTONE && mr->hash == h &&
+            js_same_value_zero(ctx, mr->key, key))
             return mr;
     }
-    return NULL;
 }
 
-static void map_hash_resize(JSContext *ctx, JSMapState *s)
+/* Rebuild the index, which also drops the tombstones. The record list
+   is not modified so it is safe with active iterators. Return -1 if
+   memory allocation failed, in which case the old index is kept. */
+static int map_hash_resize(JSRuntime *rt, JSMapState *s,
+                           uint32_t new_hash_size)
 {
-    uint32_t new_hash_size, i, h;
-    struct list_head *new_hash_table, *el;
-    JSMapRecord *mr;
+    JSMapRecord **new_hash_table, *mr;
+    struct list_head *el;
+    uint32_t i, mask;
 
-    /* XXX: no reporting of memory allocation failure */
-    if (s->hash_size == 1)
-        new_hash_size = 4;
-    else
-        new_hash_size = s->hash_size * 2;
-    new_hash_table = js_realloc(ctx, s->hash_table,
-                                sizeof(new_hash_table[0]) * new_hash_size);
+    new_hash_table = js_mallocz_rt(rt, sizeof(new_hash_table[0]) *
+                                   new_hash_size);
     if (!new_hash_table)
-        return;
-
-    for(i = 0; i < new_hash_size; i++)
-        init_list_head(&new_hash_table[i]);
-
+        return -1;
+    js_free_rt(rt, s->hash_table);
+    s->hash_table = new_hash_table;
+    s->hash_size = new_hash_size;
+    s->hash_bits = ctz32(new_hash_size);
+    s->tombstone_count = 0;
+    mask = new_hash_size - 1;
     list_for_each(el, &s->records) {
         mr = list_entry(el, JSMapRecord, link);
         if (!mr->empty) {
-            h = map_hash_key(ctx, mr->key) & (new_hash_size - 1);
-            list_add_tail(&mr->hash_link, &new_hash_table[h]);
+            i = map_hash_index(s, mr->hash);
+            while (new_hash_table[i])
+                i = (i + 1) & mask;
+            new_hash_table[i] = mr;
         }
     }
-    s->hash_table = new_hash_table;
-    s->hash_size = new_hash_size;
-    s->record_count_threshold = new_hash_size * 2;
+    return 0;
+}
+
+/* remove a record from the index. It must not be used by the
+   probing sequences anymore but it stays in the record list. */
+static void map_hash_remove(JSMapState *s, JSMapRecord *mr)
+{
+    uint32_t i, mask;
+
+    mask = s->hash_size - 1;
+    i = map_hash_index(s, mr->hash);
+    while (s->hash_table[i] != mr)
+        i = (i + 1) & mask;
+    /* no probing sequence goes through a slot followed by a free one */
+    if (!s->hash_table[(i + 1) & mask]) {
+        s->hash_table[i] = NULL;
+    } else {
+        s->hash_table[i] = MAP_TOMBSTONE;
+        s->tombstone_count++;
+    }
 }
 
 static JSWeakRefRecord **get_first_weak_ref(JSValueConst key)
@@ -53436,9 +58283,21 @@ static JSWeakRefRecord **get_first_weak_ref(JSValueConst key)
 static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
                                    JSValueConst key)
 {
-    uint32_t h;
     JSMapRecord *mr;
-
+    uint32_t h, i, mask, new_hash_size;
+
+    /* keep the load factor, tombstones included, below 3/4. The new
+       size only depends on the live records: when most of the slots
+       are tombstones, the index is rebuilt at the same size. */
+    if ((s->record_count + s->tombstone_count + 1) * 4 > s->hash_size * 3) {
+        new_hash_size = MAP_HASH_SIZE_MIN;
+        while (new_hash_size < (s->record_count + 1) * 3)
+            new_hash_size *= 2;
+        if (map_hash_resize(ctx->rt, s, new_hash_size)) {
+            JS_ThrowOutOfMemory(ctx);
+            return NULL;
+        }
+    }
     mr = js_malloc(ctx, sizeof(*mr));
     if (!mr)
         return NULL;
@@ -53458,13 +58317,18 @@ static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
     } else {
         mr->key = js_dup(key);
     }
-    h = map_hash_key(ctx, key) & (s->hash_size - 1);
-    list_add_tail(&mr->hash_link, &s->hash_table[h]);
+    h = map_hash_key(ctx, key);
+    mr->hash = h;
+    mask = s->hash_size - 1;
+    for(i = map_hash_index(s, h); s->hash_table[i] != NULL; i = (i + 1) & mask) {
+        if (s->hash_table[i] == MAP_TOMBSTONE) {
+            s->tombstone_count--;
+            break;
+        }
+    }
+    s->hash_table[i] = mr;
     list_add_tail(&mr->link, &s->records);
     s->record_count++;
-    if (s->record_count >= s->record_count_threshold) {
-        map_hash_resize(ctx, s);
-    }
     return mr;
 }
 
@@ -53492,7 +58356,7 @@ static void map_delete_record(JSRuntime *rt, JSMapState *s, JSMapRecord *mr)
 {
     if (mr->empty)
         return;
-    list_del(&mr->hash_link);
+    map_hash_remove(s, mr);
     if (s->is_weak) {
         delete_map_weak_ref(rt, mr);
     } else {
@@ -53509,6 +58373,10 @@ static void map_delete_record(JSRuntime *rt, JSMapState *s, JSMapRecord *mr)
         mr->value = JS_UNDEFINED;
     }
     s->record_count--;
+    /* shrink the index when most of the records were deleted. Failing
+       to do it is harmless. */
+    if (s->hash_size > MAP_HASH_SIZE_MIN && s->record_count * 8 < s->hash_size)
+        map_hash_resize(rt, s, s->hash_size / 2);
 }
 
 static void map_decref_record(JSRuntime *rt, JSMapRecord *mr)
@@ -59587,6 +64455,124 @@ fini:
     return ret;
 }
 
+/* 'data' is a large block of the allocator 'mf' so that a runtime using
+   the same allocator can take it without copy */
+struct JSTransferredArrayBuffer {
+    JSMallocFunctions mf;
+    void *opaque;
+    uint8_t *data;
+    int byte_length;
+    int max_byte_length; /* -1 if not resizable */
+};
+
+JSTransferredArrayBuffer *JS_TransferArrayBuffer(JSContext *ctx,
+                                                 JSValueConst obj)
+{
+    JSRuntime *rt = ctx->rt;
+    JSMallocState *s = &rt->malloc_state;
+    JSTransferredArrayBuffer *tb;
+    JSArrayBuffer *abuf;
+    JSMallocBlockHeader *b;
+
+    abuf = JS_GetOpaque2(ctx, obj, JS_CLASS_ARRAY_BUFFER);
+    if (!abuf)
+        return NULL;
+    if (abuf->immutable) {
+        JS_ThrowTypeErrorImmutableArrayBuffer(ctx);
+        return NULL;
+    }
+    if (abuf->detached) {
+        JS_ThrowTypeErrorDetachedArrayBuffer(ctx);
+        return NULL;
+    }
+    tb = rt->mf.js_malloc(s->opaque, sizeof(*tb));
+    if (!tb) {
+        JS_ThrowOutOfMemory(ctx);
+        return NULL;
+    }
+    tb->mf = rt->mf;
+    tb->opaque = s->opaque;
+    tb->byte_length = abuf->byte_length;
+    tb->max_byte_length = abuf->max_byte_length;
+    if (abuf->realloc_func == js_array_buffer_realloc &&
+        (b = container_of(abuf->data, JSMallocBlockHeader, user_data),
+         b->u.block_idx == JS_ARENA_FREE_NIL && b != arena_zero_block(rt))) {
+        /* the block is no longer counted in the memory usage of 'rt' */
+        s->malloc_count--;
+        s->malloc_size -= js_arena_usable_size(rt, abuf->data) + MALLOC_OVERHEAD;
+        tb->data = abuf->data;
+        /* JS_DetachArrayBuffer() must not free it */
+        abuf->realloc_func = NULL;
+    } else {
+        /* small arena blocks and external memory are copied */
+        b = rt->mf.js_malloc(s->opaque, sizeof(JSMallocBlockHeader) +
+                             max_int(abuf->byte_length, 1));
+        if (!b) {
+            rt->mf.js_free(s->opaque, tb);
+            JS_ThrowOutOfMemory(ctx);
+            return NULL;
+        }
+        b->u.block_idx = JS_ARENA_FREE_NIL;
+        b->block_size_idx = 0xff; /* fail safe */
+        memcpy(b->user_data, abuf->data, abuf->byte_length);
+        tb->data = b->user_data;
+    }
+    JS_DetachArrayBuffer(ctx, obj);
+    return tb;
+}
+
+JSValue JS_NewTransferredArrayBuffer(JSContext *ctx,
+                                     JSTransferredArrayBuffer *tb)
+{
+    JSRuntime *rt = ctx->rt;
+    JSMallocState *s = &rt->malloc_state;
+    uint64_t max_len, *pmax_len;
+    size_t size;
+    JSValue obj;
+
+    pmax_len = NULL;
+    if (tb->max_byte_length >= 0) {
+        max_len = tb->max_byte_length;
+        pmax_len = &max_len;
+    }
+    if (!memcmp(&rt->mf, &tb->mf, sizeof(rt->mf)) && s->opaque == tb->opaque) {
+        size = js_arena_usable_size(rt, tb->data) + MALLOC_OVERHEAD;
+        /* When malloc_limit is 0 (unlimited), malloc_limit - 1 will be SIZE_MAX. */
+        if (s->malloc_size + size > s->malloc_limit - 1) {
+            JS_FreeTransferredArrayBuffer(tb);
+            return JS_ThrowOutOfMemory(ctx);
+        }
+        s->malloc_count++;
+        s->malloc_size += size;
+        js_malloc_update_peak(s);
+        obj = js_array_buffer_constructor3(ctx, JS_UNDEFINED,
+                                           tb->byte_length, pmax_len,
+                                           JS_CLASS_ARRAY_BUFFER, tb->data,
+                                           js_array_buffer_realloc, NULL,
+                                           /*alloc_flag*/false);
+        if (JS_IsException(obj))
+            js_free_rt(rt, tb->data);
+        tb->mf.js_free(tb->opaque, tb);
+    } else {
+        obj = js_array_buffer_constructor3(ctx, JS_UNDEFINED,
+                                           tb->byte_length, pmax_len,
+                                           JS_CLASS_ARRAY_BUFFER, tb->data,
+                                           js_array_buffer_realloc, NULL,
+                                           /*alloc_flag*/true);
+        JS_FreeTransferredArrayBuffer(tb);
+    }
+    return obj;
+}
+
+void JS_FreeTransferredArrayBuffer(JSTransferredArrayBuffer *tb)
+{
+    if (!tb)
+        return;
+    tb->mf.js_free(tb->opaque,
+                   container_of(tb->data, JSMallocBlockHeader, user_data));
+    tb->mf.js_free(tb->opaque, tb);
+}
+
 static JSValue js_array_buffer_resize(JSContext *ctx, JSValueConst this_val,
                                       int argc, JSValueConst *argv, int class_id)
 {
@@ -63292,7 +68278,7 @@ static void reset_weak_ref(JSRuntime *rt, JSWeakRefRecord **first_weak_ref)
             s = mr->map;
             assert(s->is_weak);
             assert(!mr->empty); /* no iterator on WeakMap/WeakSet */
-            list_del(&mr->hash_link);
+            map_hash_remove(s, mr);
             list_del(&mr->link);
             s->record_count--;
             break;
@@ -177,6 +177,20 @@ typedef uint32_t JSAtom;
 #endif
 #endif
 
+/* Number of bits of the BigInts stored inline in a JSValue. 64 bit
+   short BigInts need the struct representation and a 128 bit integer
+   type for the limb products. The value is part of the ABI, so it is
+   decided when the library is built and the CMake and meson builds
+   export it to the users of the library as a compile definition. */
+#ifndef JS_SHORT_BIG_INT_BITS
+#if !defined(JS_CHECK_JSVALUE) && !(defined(JS_NAN_BOXING) && JS_NAN_BOXING) && \
+    defined(__SIZEOF_INT128__)
+#define JS_SHORT_BIG_INT_BITS 64
+#else
+#define JS_SHORT_BIG_INT_BITS 32
+#endif
+#endif
+
 enum {
     /* all tags with a reference count are negative */
     JS_TAG_FIRST       = -9, /* first negative tag */
@@ -319,7 +333,11 @@ typedef union JSValueUnion {
     int32_t int32;
     double float64;
     void *ptr;
+#if JS_SHORT_BIG_INT_BITS == 32
     int32_t short_big_int;
+#else
+    int64_t short_big_int;
+#endif
 } JSValueUnion;
 
 typedef struct JSValue {
@@ -530,6 +548,9 @@ typedef void JS_MarkFunc(JSRuntime *rt, JSGCObjectHeader *gp);
 JS_EXTERN void JS_MarkValue(JSRuntime *rt, JSValueConst val,
                             JS_MarkFunc *mark_func);
 JS_EXTERN void JS_RunGC(JSRuntime *rt);
+/* Incremental GC: do a bounded amount of GC work (about 'budget_us'
+   microseconds). Return true if there is remaining work. */
+JS_EXTERN bool JS_RunGCStep(JSRuntime *rt, int budget_us);
 JS_EXTERN bool JS_IsLiveObject(JSRuntime *rt, JSValueConst obj);
 
 JS_EXTERN JSContext *JS_NewContext(JSRuntime *rt);
@@ -590,6 +611,7 @@ JS_EXTERN char *js_strndup(JSContext *ctx, const char *s, size_t n);
 
 typedef struct JSMemoryUsage {
     int64_t malloc_size, malloc_limit, memory_used_size;
+    int64_t malloc_peak_size; /* highest malloc_size since the runtime creation */
     int64_t malloc_count;
     int64_t memory_used_count;
     int64_t atom_count, atom_size;
@@ -602,11 +624,23 @@ typedef struct JSMemoryUsage {
     int64_t c_func_count, array_count;
     int64_t fast_array_count, fast_array_elements;
     int64_t binary_object_count, binary_object_size;
+    int64_t gc_count, gc_young_count; /* number of major and young GCs */
+    /* cache of the compiled regexps */
+    int64_t regexp_cache_count, regexp_cache_hit_count, regexp_cache_miss_count;
 } JSMemoryUsage;
 
 JS_EXTERN void JS_ComputeMemoryUsage(JSRuntime *rt, JSMemoryUsage *s);
 JS_EXTERN void JS_DumpMemoryUsage(FILE *fp, const JSMemoryUsage *s, JSRuntime *rt);
 
+/* Sampling CPU profiler. The JS stack is sampled about every
+   'interval_us' microseconds of JS execution. The profile is dumped in
+   the folded stack format (one "frame;frame;... count" line per
+   distinct stack) understood by flamegraph.pl and speedscope. A frame is
+   "function (file:line)" where 'line' is the line being executed. */
+JS_EXTERN int JS_StartCPUProfile(JSRuntime *rt, int interval_us);
+JS_EXTERN void JS_StopCPUProfile(JSRuntime *rt);
+JS_EXTERN void JS_DumpCPUProfile(FILE *fp, JSRuntime *rt);
+
 /* atom support */
 #define JS_ATOM_NULL 0
 
@@ -1069,6 +1103,30 @@ JS_EXTERN JSValue JS_ParseJSON(JSContext *ctx, const char *buf, size_t buf_len,
 JS_EXTERN JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
                                    JSValueConst replacer, JSValueConst space0);
 
+/* Streaming JSON parser. The input is given by chunks with
+   JS_WriteJSONParser() and the callback is called for each value at the
+   depth 'max_depth' and for each scalar value above it (e.g. with
+   max_depth = 1, for each element of a top level array). The containers
+   above 'max_depth' are not built. Several top level values may follow
+   each other (e.g. newline delimited JSON). 'key' is the property name
+   or the array index of the value in its parent, or the index of the
+   value in the stream for the top level values. The callback returns
+   < 0 with a pending exception to stop the parsing. The callback may
+   free the parser: the parsing then stops and the parser is freed when
+   JS_WriteJSONParser() or JS_EndJSONParser() returns. The syntax errors
+   report the position in the whole stream. The parser must be freed
+   before its context. */
+typedef struct JSJSONParser JSJSONParser;
+typedef int JSJSONParserCallback(JSContext *ctx, JSValueConst key,
+                                 JSValueConst value, int depth, void *opaque);
+JS_EXTERN JSJSONParser *JS_NewJSONParser(JSContext *ctx, int max_depth,
+                                         JSJSONParserCallback *cb, void *opaque);
+JS_EXTERN void JS_FreeJSONParser(JSRuntime *rt, JSJSONParser *p);
+/* return < 0 if exception */
+JS_EXTERN int JS_WriteJSONParser(JSJSONParser *p, const char *buf, size_t len);
+/* signal the end of the input. Return < 0 if exception. */
+JS_EXTERN int JS_EndJSONParser(JSJSONParser *p);
+
 /* Manages the backing memory of an externally created ArrayBuffer.
    When 'size' is zero, 'ptr' must be freed and NULL returned. Otherwise the
    block must be resized to 'size' bytes and the new pointer returned, or NULL
@@ -1089,6 +1147,19 @@ JS_EXTERN JSValue JS_NewArrayBuffer(JSContext *ctx, uint8_t *buf, size_t len,
                                     void *opaque, bool is_shared);
 JS_EXTERN JSValue JS_NewArrayBufferCopy(JSContext *ctx, const uint8_t *buf, size_t len);
 JS_EXTERN void JS_DetachArrayBuffer(JSContext *ctx, JSValueConst obj);
+/* Backing memory of an ArrayBuffer moved out of its runtime, e.g. to
+   send it to another thread. JS_TransferArrayBuffer() detaches 'obj' and
+   returns NULL with an exception if it is not a transferable
+   ArrayBuffer. JS_NewTransferredArrayBuffer() takes the ownership of
+   'tb' and reuses its memory without copy if the runtime has the same
+   allocator as the original one. The allocator must be thread-safe and
+   outlive 'tb'. */
+typedef struct JSTransferredArrayBuffer JSTransferredArrayBuffer;
+JS_EXTERN JSTransferredArrayBuffer *JS_TransferArrayBuffer(JSContext *ctx,
+                                                           JSValueConst obj);
+JS_EXTERN JSValue JS_NewTransferredArrayBuffer(JSContext *ctx,
+                                               JSTransferredArrayBuffer *tb);
+JS_EXTERN void JS_FreeTransferredArrayBuffer(JSTransferredArrayBuffer *tb);
 JS_EXTERN uint8_t *JS_GetArrayBuffer(JSContext *ctx, size_t *psize, JSValueConst obj);
 JS_EXTERN bool JS_IsArrayBuffer(JSValueConst obj);
 // returns true or false if obj is an ArrayBuffer, -1 otherwise
@@ -1260,12 +1331,23 @@ typedef struct JSSABTab {
 JS_EXTERN uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj, int flags);
 JS_EXTERN uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
                                    int flags, JSSABTab *psab_tab);
+/* The ArrayBuffers of 'transfer_tab' are written as their index in the
+   table instead of their contents. */
+JS_EXTERN uint8_t *JS_WriteObject3(JSContext *ctx, size_t *psize, JSValueConst obj,
+                                   int flags, JSSABTab *psab_tab,
+                                   JSValueConst *transfer_tab, int transfer_len);
 
 /* WARNING: only enable JS_READ_OBJ_BYTECODE on input from a trusted
    writer. The bytecode format is not designed to resist a hostile
    producer; loading adversarial bytecode can lead to memory corruption. */
 #define JS_READ_OBJ_BYTECODE  (1 << 0) /* allow function/module */
 #define JS_READ_OBJ_ROM_DATA  (0)      /* avoid duplicating 'buf' data (obsolete, broken by ICs) */
+/* With JS_READ_OBJ_IN_PLACE, the string constants and the debug line
+   tables reference 'buf' instead of being copied, so that many runtimes
+   reading the same mapped file share its pages. The byte code itself is
+   still copied because it is patched at load and at run time. 'buf' must
+   stay valid and unmodified until the runtime is freed. */
+#define JS_READ_OBJ_IN_PLACE  (1 << 1) /* reference 'buf' data */
 /* WARNING: serialized SharedArrayBuffers carry a literal host pointer in
    the blob; only enable JS_READ_OBJ_SAB on input produced by a trusted
    writer in the same process (e.g. another Worker on the same runtime). */
@@ -1274,6 +1356,11 @@ JS_EXTERN uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst o
 JS_EXTERN JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len, int flags);
 JS_EXTERN JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
                                  int flags, JSSABTab *psab_tab);
+/* The ArrayBuffers written with their index by JS_WriteObject3() are
+   replaced by the corresponding element of 'transfer_tab'. */
+JS_EXTERN JSValue JS_ReadObject3(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                                 int flags, JSSABTab *psab_tab,
+                                 JSValueConst *transfer_tab, int transfer_len);
 /* instantiate and evaluate a bytecode function. Only used when
    reading a script or module with JS_ReadObject() */
 JS_EXTERN JSValue JS_EvalFunction(JSContext *ctx, JSValue fun_obj);
@@ -0,0 +1,196 @@
+/*
+ * Benchmark runner: the tests of microbench.js and macrobench.js are run
+ * in parallel, each one in a new worker so that it has its own runtime.
+ * The results are written as JSON and optionally compared with a
+ * previous report.
+ *
+ * usage: qjs tests/bench.js [-j jobs] [-o report.json] [-b baseline.json]
+ *                           [-t threshold] [name_prefix...]
+ */
+import * as std from "qjs:std";
+import * as os from "qjs:os";
+
+var suites = {
+    micro: "./microbench.js",
+    macro: "./macrobench.js",
+};
+
+function worker_main(parent)
+{
+    parent.onmessage = async function (e) {
+        var ev = e.data, mod, f, r, mem, res;
+        parent.onmessage = null;
+        res = { id: ev.id, ok: false };
+        try {
+            mod = await import(suites[ev.suite]);
+            f = mod.test_list.find((f) => f.name == ev.name);
+            r = mod.measure ? mod.measure(f, f.name) : measure(f);
+        } catch(err) {
+            print(ev.id + ": " + err);
+            r = null;
+        }
+        if (r) {
+            res.ok = true;
+            res.n = r.n;
+            res.ns_per_op = Math.round(r.ns * 100) / 100;
+            res.ops_per_sec = Math.round(1e9 / r.ns);
+        }
+        mem = std.memoryUsage();
+        /* the workers share the process, so its RSS would include the
+           other tests. The peak of the runtime of the test is used. */
+        res.malloc_size = mem.malloc_size;
+        res.malloc_peak_size = mem.malloc_peak_size;
+        res.memory_used_size = mem.memory_used_size;
+        res.obj_count = mem.obj_count;
+        res.gc_count = mem.gc_count;
+        res.gc_young_count = mem.gc_young_count;
+        parent.postMessage(res);
+    };
+}
+
+/* used for the suites without their own measure() function */
+function measure(f)
+{
+    var n, t, nb_its;
+    for(n = 1;; n *= 2) {
+        t = os.now();
+        nb_its = f(n);
+        if (nb_its < 0)
+            return null;
+        t = os.now() - t;
+        if (t >= 100000)
+            return { n: n, ns: t * 1000 / nb_its };
+    }
+}
+
+function usage()
+{
+    print("usage: bench.js [-j jobs] [-o report.json] [-b baseline.json] [-t threshold] [name_prefix...]\n" +
+          "-j  number of tests run in parallel (default 1)\n" +
+          "-o  write the results to a JSON file\n" +
+          "-b  compare the results with a previous JSON report\n" +
+          "-t  relative slowdown reported as a regression (default 0.1)");
+    std.exit(1);
+}
+
+async function main(argv)
+{
+    var jobs = 1, out_file, baseline_file, threshold = 0.1, filters = [];
+    var i, arg, suite, mod, f, tests = [], results = {}, running = 0;
+    var next = 0, failed = 0, report, base, t0;
+
+    for(i = 1; i < argv.length;) {
+        arg = argv[i++];
+        if (arg == "-j") {
+            jobs = Math.max(1, argv[i++] | 0);
+        } else if (arg == "-o") {
+            out_file = argv[i++];
+        } else if (arg == "-b") {
+            baseline_file = argv[i++];
+        } else if (arg == "-t") {
+            threshold = +argv[i++];
+        } else if (arg[0] == "-") {
+            usage();
+        } else {
+            filters.push(arg);
+        }
+    }
+    if (baseline_file) {
+        base = std.loadFile(baseline_file);
+        if (base === null) {
+            print("cannot read " + baseline_file);
+            std.exit(1);
+        }
+        base = JSON.parse(base);
+    }
+
+    for(suite in suites) {
+        mod = await import(suites[suite]);
+        for(f of mod.test_list) {
+            arg = suite + "/" + f.name;
+            if (filters.length && !filters.some((s) => arg.startsWith(s) ||
+                                                 f.name.startsWith(s)))
+                continue;
+            tests.push({ id: arg, suite: suite, name: f.name });
+        }
+    }
+
+    t0 = os.now();
+    await new Promise((resolve) => {
+        function start() {
+            while (running < jobs && next < tests.length) {
+                let t = tests[next++];
+                let w = new os.Worker("./bench.js");
+                w.onmessage = function (e) {
+                    var res = e.data;
+                    w.onmessage = null;
+                    running--;
+                    delete res.id;
+                    results[t.id] = res;
+                    if (res.ok) {
+                        print(t.id.padEnd(36), String(res.ops_per_sec).padStart(12), "ops/s");
+                    } else {
+                        print(t.id.padEnd(36), "FAILED".padStart(12));
+                        failed++;
+                    }
+                    start();
+                };
+                w.postMessage({ id: t.id, suite: t.suite, name: t.name });
+                running++;
+            }
+            if (running == 0)
+                resolve();
+        }
+        start();
+    });
+
+    report = {
+        version: 1,
+        engine: typeof navigator != "undefined" ? navigator.userAgent : "",
+        date: new Date().toISOString(),
+        jobs: jobs,
+        time_ms: Math.round((os.now() - t0) / 1000),
+        tests: {},
+    };
+    /* same order as the test list */
+    for(f of tests)
+        report.tests[f.id] = results[f.id];
+    if (out_file) {
+        f = std.open(out_file, "w");
+        f.puts(JSON.stringify(report, null, 2));
+        f.puts("\n");
+        f.close();
+    }
+    if (base)
+        failed += compare(base, report, threshold);
+    std.exit(failed ? 1 : 0);
+}
+
+/* return the number of regressions */
+function compare(base, report, threshold)
+{
+    var id, a, b, ratio, regressions = 0, s;
+    print("\n" + "TEST".padEnd(36), "BASE (ops/s)".padStart(12),
+          "NEW (ops/s)".padStart(12), "CHANGE".padStart(8));
+    for(id in report.tests) {
+        a = base.tests[id];
+        b = report.tests[id];
+        if (!a || !a.ok || !b.ok)
+            continue;
+        ratio = b.ops_per_sec / a.ops_per_sec;
+        s = ((ratio - 1) * 100).toFixed(1) + "%";
+        if (ratio < 1 - threshold) {
+            s += " REGRESSION";
+            regressions++;
+        }
+        print(id.padEnd(36), String(a.ops_per_sec).padStart(12),
+              String(b.ops_per_sec).padStart(12), s.padStart(8));
+    }
+    print(regressions + " regression(s)");
+    return regressions;
+}
+
+if (os.Worker?.parent)
+    worker_main(os.Worker.parent);
+else
+    main(scriptArgs);
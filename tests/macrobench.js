@@ -0,0 +1,214 @@
+/*
+ * Javascript macro benchmarks: small complete programs, run by
+ * tests/bench.js. Like in tests/microbench.js, each test runs 'n'
+ * iterations and returns the number of iterations.
+ */
+
+var global_res; /* to be sure the code is not optimized */
+
+/* allocation of short lived trees (GC) */
+function binary_trees(n)
+{
+    function make(depth) {
+        if (depth == 0)
+            return { left: null, right: null };
+        return { left: make(depth - 1), right: make(depth - 1) };
+    }
+    function check(t) {
+        if (!t.left)
+            return 1;
+        return 1 + check(t.left) + check(t.right);
+    }
+    var i, r = 0, long_lived = make(10);
+    for(i = 0; i < n; i++)
+        r += check(make(12));
+    global_res = r + check(long_lived);
+    return n;
+}
+
+/* floating point arithmetic and property accesses */
+function nbody(n)
+{
+    var PI = Math.PI, SOLAR_MASS = 4 * PI * PI, DAYS_PER_YEAR = 365.24;
+    function body(x, y, z, vx, vy, vz, mass) {
+        return { x: x, y: y, z: z,
+                 vx: vx * DAYS_PER_YEAR, vy: vy * DAYS_PER_YEAR,
+                 vz: vz * DAYS_PER_YEAR, mass: mass * SOLAR_MASS };
+    }
+    var bodies = [
+        body(0, 0, 0, 0, 0, 0, 1),
+        body(4.84143144246472090e+00, -1.16032004402742839e+00,
+             -1.03622044471123109e-01, 1.66007664274403694e-03,
+             7.69901118419740425e-03, -6.90460016972063023e-05,
+             9.54791938424326609e-04),
+        body(8.34336671824457987e+00, 4.12479856412430479e+00,
+             -4.03523417114321381e-01, -2.76742510726862411e-03,
+             4.99852801234917238e-03, 2.30417297573763929e-05,
+             2.85885980666130812e-04),
+        body(1.28943695621391310e+01, -1.51111514016986312e+01,
+             -2.23307578892655734e-01, 2.96460137564761618e-03,
+             2.37847173959480950e-03, -2.96589568540237556e-05,
+             4.36624404335156298e-05),
+        body(1.53796971148509165e+01, -2.59193146099879641e+01,
+             1.79258772950371181e-01, 2.68067772490389322e-03,
+             1.62824170038242295e-03, -9.51592254519715870e-05,
+             5.15138902046611451e-05),
+    ];
+    var i, j, k, a, b, dx, dy, dz, d2, mag, dt = 0.01;
+    for(k = 0; k < n; k++) {
+        for(i = 0; i < bodies.length; i++) {
+            a = bodies[i];
+            for(j = i + 1; j < bodies.length; j++) {
+                b = bodies[j];
+                dx = a.x - b.x;
+                dy = a.y - b.y;
+                dz = a.z - b.z;
+                d2 = dx * dx + dy * dy + dz * dz;
+                mag = dt / (d2 * Math.sqrt(d2));
+                a.vx -= dx * b.mass * mag;
+                a.vy -= dy * b.mass * mag;
+                a.vz -= dz * b.mass * mag;
+                b.vx += dx * a.mass * mag;
+                b.vy += dy * a.mass * mag;
+                b.vz += dz * a.mass * mag;
+            }
+        }
+        for(i = 0; i < bodies.length; i++) {
+            a = bodies[i];
+            a.x += dt * a.vx;
+            a.y += dt * a.vy;
+            a.z += dt * a.vz;
+        }
+    }
+    global_res = bodies[0].x;
+    return n;
+}
+
+/* integer arithmetic on small arrays */
+function fannkuch(n)
+{
+    function run(m) {
+        var perm = new Array(m), perm1 = new Array(m), count = new Array(m);
+        var i, k, r, t, flips, max_flips = 0, checksum = 0, nperm = 0;
+        for(i = 0; i < m; i++)
+            perm1[i] = i;
+        r = m;
+        for(;;) {
+            while (r != 1) {
+                count[r - 1] = r;
+                r--;
+            }
+            for(i = 0; i < m; i++)
+                perm[i] = perm1[i];
+            flips = 0;
+            while ((k = perm[0]) != 0) {
+                for(i = 0; i < (k + 1) >> 1; i++) {
+                    t = perm[i];
+                    perm[i] = perm[k - i];
+                    perm[k - i] = t;
+                }
+                flips++;
+            }
+            if (max_flips < flips)
+                max_flips = flips;
+            checksum += (nperm & 1) ? -flips : flips;
+            for(;;) {
+                if (r == m)
+                    return checksum + max_flips;
+                t = perm1[0];
+                for(i = 0; i < r; i++)
+                    perm1[i] = perm1[i + 1];
+                perm1[r] = t;
+                if (--count[r] > 0)
+                    break;
+                r++;
+            }
+            nperm++;
+        }
+    }
+    var i;
+    for(i = 0; i < n; i++)
+        global_res = run(7);
+    return n;
+}
+
+function json_roundtrip(n)
+{
+    var i, j, obj, s;
+    obj = { items: [] };
+    for(i = 0; i < 100; i++) {
+        obj.items.push({ id: i, name: "item" + i, price: i * 1.25,
+                         tags: [ "a", "b", "c" ], in_stock: (i & 1) == 0 });
+    }
+    for(j = 0; j < n; j++) {
+        s = JSON.stringify(obj);
+        global_res = JSON.parse(s);
+    }
+    return n;
+}
+
+function regexp_scan(n)
+{
+    var i, j, s, r, re;
+    s = "";
+    for(i = 0; i < 200; i++)
+        s += "user" + i + "@example" + (i % 7) + ".com, some text; ";
+    re = /([a-z0-9]+)@([a-z0-9]+)\.com/g;
+    for(j = 0; j < n; j++) {
+        r = 0;
+        for (var m of s.matchAll(re))
+            r += m[1].length;
+        global_res = s.replace(/example/g, "test").length + r;
+    }
+    return n;
+}
+
+/* string building and splitting */
+function text_process(n)
+{
+    var i, j, words, counts, s, w;
+    for(j = 0; j < n; j++) {
+        s = "";
+        for(i = 0; i < 500; i++)
+            s += "w" + (i % 37) + " ";
+        words = s.split(" ");
+        counts = new Map();
+        for(w of words)
+            counts.set(w, (counts.get(w) || 0) + 1);
+        global_res = [...counts.keys()].sort().join(",");
+    }
+    return n;
+}
+
+/* method calls through classes and closures */
+function class_dispatch(n)
+{
+    class Shape {
+        constructor(k) { this.k = k; }
+        area() { return 0; }
+    }
+    class Square extends Shape {
+        area() { return this.k * this.k; }
+    }
+    class Circle extends Shape {
+        area() { return 3 * this.k * this.k; }
+    }
+    var i, j, r, shapes = [];
+    for(i = 0; i < 100; i++)
+        shapes.push((i & 1) ? new Square(i) : new Circle(i));
+    for(j = 0; j < n; j++) {
+        r = shapes.map(s => s.area()).reduce((a, b) => a + b, 0);
+        global_res = r;
+    }
+    return n;
+}
+
+export var test_list = [
+    binary_trees,
+    nbody,
+    fannkuch,
+    json_roundtrip,
+    regexp_scan,
+    text_process,
+    class_dispatch,
+];
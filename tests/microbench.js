@@ -100,6 +100,11 @@ var clock_threshold = 2000;  /* favoring short measuring spans */
 var min_n_argument = 1;
 var get_clock = os.cputime ?? os.now;
 
+/* os.cputime() is the CPU time of the whole process, so the workers of
+   tests/bench.js use the wall clock */
+if (os.Worker?.parent)
+    get_clock = os.now;
+
 function log_one(text, n, ti) {
     var ref;
 
@@ -121,9 +126,11 @@ function log_one(text, n, ti) {
     }
 }
 
-function bench(f, text)
+/* return the number of iterations of the last run and the best time
+   per iteration in nano seconds, or null if the test failed */
+export function measure(f, text)
 {
-    var i, j, n, t, t1, ti, nb_its, ref, ti_n, ti_n1, min_ti;
+    var i, j, n, t, t1, ti, nb_its, ti_n, ti_n1, min_ti;
 
     nb_its = n = 1;
     if (f.bench) {
@@ -139,7 +146,7 @@ function bench(f, text)
                     continue;
                 nb_its = f(n);
                 if (nb_its < 0)
-                    return; // test failure
+                    return null; // test failure
                 t1 = get_clock() - t1;
                 if (ti > t1)
                     ti = t1;
@@ -158,7 +165,14 @@ function bench(f, text)
         //ti_n = ti / nb_its;
     }
     /* nano seconds per iteration */
-    log_one(text, n, ti_n * 1e9 / clocks_per_sec);
+    return { n: n, ns: ti_n * 1e9 / clocks_per_sec };
+}
+
+function bench(f, text)
+{
+    var r = measure(f, text);
+    if (r)
+        log_one(text, r.n, r.ns);
 }
 
 var global_res; /* to be sure the code is not optimized */
@@ -1135,76 +1149,77 @@ function save_result(filename, obj)
     f.close();
 }
 
+export var test_list = [
+    empty_loop,
+    date_now,
+    prop_read,
+    prop_write,
+    prop_create,
+    prop_delete,
+    array_read,
+    array_write,
+    array_prop_create,
+    array_length_decr,
+    array_hole_length_decr,
+    array_push,
+    array_pop,
+    typed_array_read,
+    typed_array_write,
+    global_read,
+    global_write,
+    global_write_strict,
+    local_destruct,
+    global_destruct,
+    global_destruct_strict,
+    func_call,
+    closure_var,
+    int_arith,
+    float_arith,
+    map_set,
+    map_delete,
+    weak_map_set,
+    weak_map_delete,
+    array_for,
+    array_for_in,
+    array_for_of,
+    math_min,
+    object_null,
+    regexp_ascii,
+    regexp_utf16,
+    string_build1,
+    string_build2,
+    //string_build3,
+    //string_build4,
+    string_concat0,
+    string_concat1,
+    string_concat2,
+    string_concat3,
+    string_slice1,
+    string_slice2,
+    string_slice3,
+    sort_bench,
+    int_to_string,
+    int_toString,
+    float_to_string,
+    float_toString,
+    float_toFixed,
+    float_toPrecision,
+    float_toExponential,
+    string_to_int,
+    string_to_float,
+];
+
+if (typeof BigInt == "function") {
+    /* BigInt test */
+    test_list.push(bigint64_arith);
+    test_list.push(bigint256_arith);
+}
+
 function main(argc, argv, g)
 {
-    var test_list = [
-        empty_loop,
-        date_now,
-        prop_read,
-        prop_write,
-        prop_create,
-        prop_delete,
-        array_read,
-        array_write,
-        array_prop_create,
-        array_length_decr,
-        array_hole_length_decr,
-        array_push,
-        array_pop,
-        typed_array_read,
-        typed_array_write,
-        global_read,
-        global_write,
-        global_write_strict,
-        local_destruct,
-        global_destruct,
-        global_destruct_strict,
-        func_call,
-        closure_var,
-        int_arith,
-        float_arith,
-        map_set,
-        map_delete,
-        weak_map_set,
-        weak_map_delete,
-        array_for,
-        array_for_in,
-        array_for_of,
-        math_min,
-        object_null,
-        regexp_ascii,
-        regexp_utf16,
-        string_build1,
-        string_build2,
-        //string_build3,
-        //string_build4,
-        string_concat0,
-        string_concat1,
-        string_concat2,
-        string_concat3,
-        string_slice1,
-        string_slice2,
-        string_slice3,
-        sort_bench,
-        int_to_string,
-        int_toString,
-        float_to_string,
-        float_toString,
-        float_toFixed,
-        float_toPrecision,
-        float_toExponential,
-        string_to_int,
-        string_to_float,
-    ];
     var tests = [];
     var i, j, n, f, name, found;
 
-    if (typeof BigInt == "function") {
-        /* BigInt test */
-        test_list.push(bigint64_arith);
-        test_list.push(bigint256_arith);
-    }
-
     for (i = 1; i < argc;) {
         name = argv[i++];
         if (name == "-a") {
@@ -1259,9 +1274,12 @@ function main(argc, argv, g)
         save_result("microbench-new.txt", log_data);
 }
 
-if (typeof scriptArgs === "undefined") {
-    scriptArgs = [];
-    if (typeof process.argv === "object")
-        scriptArgs = process.argv.slice(1);
+/* the tests are also imported by tests/bench.js */
+if (import.meta.main !== false) {
+    if (typeof scriptArgs === "undefined") {
+        scriptArgs = [];
+        if (typeof process.argv === "object")
+            scriptArgs = process.argv.slice(1);
+    }
+    main(scriptArgs.length, scriptArgs, this);
 }
-main(scriptArgs.length, scriptArgs, this);
@@ -131,7 +131,141 @@ function test_bigint_asintn()
     assert(BigInt.asIntN(64, 123n), 123n);
 }
 
+/* values around the limits of the BigInts stored in a JSValue */
+function test_bigint64()
+{
+    var min = -(1n << 63n), max = (1n << 63n) - 1n, a, b, ta;
+
+    a = max;
+    a++;
+    assert(a, 0x8000000000000000n);
+    a = min;
+    a--;
+    assert(a, -0x8000000000000001n);
+    assert(-min, 0x8000000000000000n);
+    assert(~max, min);
+    assert(max + 1n - 1n, max);
+    assert(min - 1n + 1n, min);
+    assert(max * max, 0x3fffffffffffffff0000000000000001n);
+    assert(min * min, 1n << 126n);
+    assert(min * -1n, 1n << 63n);
+    assert(min / -1n, 1n << 63n);
+    assert(min % -1n, 0n);
+    assert(max / 3n, 3074457345618258602n);
+    assert(max % 10n, 7n);
+    assert(1n << 63n >> 63n, 1n);
+    assert(min >> 62n, -2n);
+    assert(-1n << 63n, min);
+    assert(max & -2n, max - 1n);
+    assert(min | 1n, min + 1n);
+    assert(max ^ min, -1n);
+
+    assert(max.toString(), "9223372036854775807");
+    assert(min.toString(16), "-8000000000000000");
+    assert(BigInt("-9223372036854775809"), min - 1n);
+    assert(BigInt("18446744073709551615"), (1n << 64n) - 1n);
+    assert((10n ** 19n).toString(), "10000000000000000000");
+
+    assert(Number(min), -9223372036854775808);
+    assert(Number(max), 9223372036854775808);
+    assert(Number(1n << 64n), 18446744073709551616);
+    assert(Number(1n << 127n), 1.7014118346046923e+38);
+    assert(Number(-(1n << 127n) - 1n), -1.7014118346046923e+38);
+    assert(BigInt(9223372036854775808), 1n << 63n);
+    assert(BigInt(-9223372036854775808), min);
+    assert(max < 9223372036854775808);
+    assert(min == -9223372036854775808);
+
+    ta = new BigInt64Array([min, max, -1n, 1n << 63n, 1n << 64n]);
+    assert(ta[0], min);
+    assert(ta[1], max);
+    assert(ta[2], -1n);
+    assert(ta[3], min);
+    assert(ta[4], 0n);
+    ta = new BigUint64Array([min, max, -1n]);
+    assert(ta[0], 1n << 63n);
+    assert(ta[1], max);
+    assert(ta[2], (1n << 64n) - 1n);
+    b = new DataView(new ArrayBuffer(8));
+    b.setBigInt64(0, min + 1n);
+    assert(b.getBigInt64(0), min + 1n);
+    assert(b.getBigUint64(0, true), 0x0100000000000080n);
+}
+
+function test_bigint_large()
+{
+    var seed = 1, sizes, i, j, a, b, s, r, v, k;
+
+    function rand_bigint(bits) {
+        var r = 0n, i;
+        for(i = 0; i < bits; i += 30) {
+            seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+            r = (r << 30n) | BigInt(seed & 0x3fffffff);
+        }
+        return r;
+    }
+
+    /* multiplication by 16 bit slices of 'b' */
+    function mul_ref(a, b) {
+        var neg = (a < 0n) != (b < 0n), r = 0n, shift = 0n;
+        if (a < 0n)
+            a = -a;
+        if (b < 0n)
+            b = -b;
+        while (b != 0n) {
+            r += (a * (b & 0xffffn)) << shift;
+            b >>= 16n;
+            shift += 16n;
+        }
+        return neg ? -r : r;
+    }
+
+    /* sizes around the thresholds of the Karatsuba multiplication */
+    sizes = [ 100, 1000, 1024, 1056, 2000, 4100, 10000, 40000 ];
+    for(i = 0; i < sizes.length; i++) {
+        for(j = 0; j < sizes.length; j++) {
+            a = rand_bigint(sizes[i]);
+            b = rand_bigint(sizes[j]);
+            if ((i + j) & 1)
+                a = -a;
+            r = a * b;
+            assert(r == mul_ref(a, b));
+            assert(r / b, a);
+            assert(r % b, 0n);
+        }
+    }
+    for(k = 1000n; k < 100000n; k *= 7n) {
+        a = (1n << k) - 1n;
+        assert(a * a, (1n << (2n * k)) - (1n << (k + 1n)) + 1n);
+    }
+
+    /* radix conversions */
+    for(i = 0; i < sizes.length; i++) {
+        a = rand_bigint(sizes[i]);
+        s = a.toString();
+        assert(BigInt(s), a);
+        assert(BigInt("-" + s), -a);
+        assert((-a).toString(), "-" + s);
+        s = a.toString(7);
+        r = 0n;
+        for(j = 0; j < s.length; j += 10) {
+            v = s.substring(j, j + 10);
+            r = r * 7n ** BigInt(v.length) + BigInt(parseInt(v, 7));
+        }
+        assert(r, a);
+    }
+    for(k = 300; k < 100000; k *= 3) {
+        a = 10n ** BigInt(k);
+        assert(a.toString(), "1" + "0".repeat(k));
+        assert((a - 1n).toString(), "9".repeat(k));
+        assert(BigInt("9".repeat(k)), a - 1n);
+        assert(BigInt("1" + "0".repeat(k - 1) + "1"), a + 1n);
+    }
+}
+
 test_bigint1();
 test_bigint2();
 test_bigint_map();
 test_bigint_asintn();
+test_bigint64();
+test_bigint_large();
@@ -285,11 +285,11 @@ function bjson_test_bytecode()
 function bjson_test_fuzz()
 {
     var corpus = [
-        ["G/////8QAAAAAARg"],
-        ["G//////m5uaCLQ=="],
-        ["G/////8AEQATBgYGBgYGBgYGBgb/////EAARAC8R/78vEf+/"],
-        ["G/////8ACH8ACv////9//////////////////////////////9//AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABgAAAAAAAAAAAAAA+fn5+fn5+fn5+fn5AAAAAAAGAKs="],
-        ["G/////8ADgAAABQA=", bjson.READ_OBJ_REFERENCE],
+        ["Hv////8QAAAAAARg"],
+        ["Hv/////m5uaCLQ=="],
+        ["Hv////8AEQATBgYGBgYGBgYGBgb/////EAARAC8R/78vEf+/"],
+        ["Hv////8ACH8ACv////9//////////////////////////////9//AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAABgAAAAAAAAAAAAAA+fn5+fn5+fn5+fn5AAAAAAAGAKs="],
+        ["Hv////8ADgAAABQA=", bjson.READ_OBJ_REFERENCE],
     ];
     for (var [input, flags] of corpus) {
         var buf = base64decode(input);
@@ -329,6 +329,22 @@ function test_string()
     assert("aaa".indexOf("", 4), 3);
     assert("aaa".indexOf("", Infinity), 3);
 
+    /* long strings are searched by blocks */
+    a = "x".repeat(40) + "abcab" + "x".repeat(40) + "abcabc";
+    assert(a.indexOf("abcabc"), 85);
+    assert(a.indexOf("abcab", 41), 85);
+    assert(a.indexOf("bcabcx"), -1);
+    assert(a.indexOf("x", 85), -1);
+    assert(a.includes("xabcabc"));
+    assert(!a.includes("abcabcx"));
+    a = "\u0101".repeat(20) + "xyz\u0101" + "\u0101".repeat(20);
+    assert(a.indexOf("xyz\u0101\u0101"), 20);
+    assert(a.indexOf("xyz"), 20);
+    assert(a.indexOf("y"), 21);
+    assert(a.indexOf("\u0102"), -1);
+    assert(a.slice(20).indexOf("xyz"), 0);
+    assert(a.split("z").length, 2);
+
     assert("aaa".lastIndexOf("a"), 2);
     assert("aaa".lastIndexOf("a", NaN), 2);
     assert("aaa".lastIndexOf("a", -Infinity), 0);
@@ -748,6 +764,75 @@ function test_json()
     var wide = "é".repeat(600) + "è".repeat(600);
     assert(JSON.stringify({x:1}, null, wide),
            '{\n' + "é".repeat(10) + '"x": 1\n}');
+
+    /* the array indexes are enumerated first */
+    assert(JSON.stringify({b:1, 2:3, a:"x", 1:[1,,3]}),
+           '{"1":[1,null,3],"2":3,"b":1,"a":"x"}');
+    a = {a:1, get b() { return 2 }, c:undefined, d:() => 1, [Symbol()]:1,
+         e:{ toJSON(k) { return "k" + k } } };
+    Object.defineProperty(a, "h", { value: 5, enumerable: false });
+    assert(JSON.stringify(a), '{"a":1,"b":2,"e":"ke"}');
+    /* the object is modified during its serialization */
+    a = {a:1, b:{ toJSON() { delete a.c; a.d = 4; return 2; } }, c:3};
+    assert(JSON.stringify(a), '{"a":1,"b":2}');
+    a = {a:{ toJSON() { a.b = 9; return 1; } }, b:2};
+    assert(JSON.stringify(a), '{"a":1,"b":9}');
+    a = [1, 2, { toJSON() { a.length = 1; return 3; } }, 4];
+    assert(JSON.stringify(a), '[1,2,3,null]');
+    a = [1, 2, 3];
+    a.length = 5;
+    assert(JSON.stringify(a), '[1,2,3,null,null]');
+    assert(JSON.stringify({"\u00e9\n": " \ud800"}), '{"\u00e9\\n":" \\ud800"}');
+    assert(JSON.stringify([1.5, -0, 1e21, NaN, Infinity, 2**31, -5, false]),
+           '[1.5,0,1e+21,null,null,2147483648,-5,false]');
+    assert(JSON.stringify([{x:1}, {x:2}, {x:3, y:4}], null, 1),
+           '[\n {\n  "x": 1\n },\n {\n  "x": 2\n },\n {\n  "x": 3,\n  "y": 4\n }\n]');
+    assert(JSON.stringify({a:1, b:2}, (k, v) => k == "a" ? undefined : v),
+           '{"b":2}');
+    assert(JSON.stringify({a:1, b:2, c:3}, ["c", "a"]), '{"c":3,"a":1}');
+    a = Object.create({ inherited: 1 });
+    a.own = 2;
+    assert(JSON.stringify(a), '{"own":2}');
+
+    /* numbers parsed with and without the exact fast path */
+    for (s of ["0", "-0", "0.0", "-0.0", "1E+2", "0e0", "0.1", "-12.5e-3",
+               "2147483647", "2147483648", "-2147483648", "-2147483649",
+               "123456789012345", "1234567890123456", "9007199254740993",
+               "1e22", "1e23", "1.5e-22", "5e-324", "1e400", "-1e-400",
+               "1.7976931348623157e308", "0.30000000000000004"]) {
+        assert(Object.is(JSON.parse(s), Number(s)), true, s);
+    }
+    /* strings on both sides of the vector scan boundaries */
+    for (var i = 0; i < 40; i++) {
+        s = "a".repeat(i);
+        assert(JSON.parse('"' + s + '"'), s);
+        assert(JSON.parse('"' + s + '\\t' + s + '"'), s + "\t" + s);
+        assert(JSON.parse('"' + s + '\u20ac' + s + '"'), s + "\u20ac" + s);
+        assertThrows(SyntaxError, () => JSON.parse('"' + s + '\x01"'));
+        assertThrows(SyntaxError, () => JSON.parse('"' + s));
+    }
+
+    /* the objects of an array reuse the shapes of the previous one */
+    s = '[{"a":1,"b":2},{"a":3,"b":4},{"a":5},{"a":6,"b":7,"c":8},' +
+        '{"b":1,"a":2},{"a":1,"a":2,"b":3},{},{"__proto__":1,"x":2},' +
+        '{"__proto__":3,"x":4},{"1":1,"a":2},{"1":3,"a":4}]';
+    a = JSON.parse(s);
+    assert(JSON.stringify(a), s.replace('"a":1,"a":2', '"a":2'));
+    assert(Object.getPrototypeOf(a[8]), Object.prototype);
+    a[1].c = 9;
+    assert(a[0].c, undefined);
+    delete a[0].a;
+    assert(JSON.stringify(a[0]), '{"b":2}');
+    assert(a[1].a, 3);
+    s = [];
+    for (i = 0; i < 50; i++)
+        s.push('"k' + i + '":' + i);
+    a = JSON.parse('[{' + s + '},{' + s + '},{' + s.slice(0, 25) + ',"z":1}]');
+    assert(a[1].k49, 49);
+    assert(Object.keys(a[2]).length, 26);
+    assert(a[2].z, 1);
+    assertThrows(SyntaxError, () => JSON.parse('[{"a":1},{"a" 1}]'));
+    assertThrows(SyntaxError, () => JSON.parse('[{"a":1},{"a":1'));
 }
 
 function test_date()
@@ -940,6 +1025,57 @@ function test_regexp()
     assert(a, ["123a23", "3"]);
     a = "ab".split(/(c)*/);
     assert(a, ["a", undefined, "b"]);
+
+    /* counted quantifiers */
+    a = /^(ab){2,4}/.exec("abababababab");
+    assert(a, ["abababab", "ab"]);
+    a = /^(ab){2,4}?/.exec("abababababab");
+    assert(a, ["abab", "ab"]);
+    a = /^(?:(a)|b){0,3}c/.exec("abac");
+    assert(a, ["abac", "a"]);
+    a = /^(?:(a)|b){0,3}c/.exec("abc");
+    assert(a, ["abc", undefined]);
+    a = /x{3}/.exec("xxyxxxx");
+    assert(a.index, 3);
+
+    /* exponential backtracking: must complete in linear time */
+    assert(/^(a+)+$/.test("a".repeat(40) + "b"), false);
+    assert(/(x+x+)+y/.test("x".repeat(5000)), false);
+    assert(/^(\w+\s?)*$/.test("An input string that takes a long time or even makes this regex to hang!"), false);
+    a = /^(a+)+$/.exec("aaa");
+    assert(a, ["aaa", "aaa"]);
+    /* same with loops whose body can be empty */
+    str = "a".repeat(30);
+    assert(/^(a|a?)+$/.test(str + "b"), false);
+    assert(/^(a*)*$/.test(str + "b"), false);
+    assert(/^(a*){2,}$/.test(str + "b"), false);
+    assert(/^(a|a?)+$/.exec(str), [str, "a"]);
+    assert(/^(a*)*$/.exec(str), [str, str]);
+    assert(/(a?){3,5}b/.exec("aab"), ["aab", ""]);
+    assert(/(a|){2,4}$/.exec("aa"), ["aa", "a"]);
+    assert(/(?:a?b?){3,}c/.exec("ababc"), ["ababc"]);
+
+    /* search with a literal prefix or a set of first characters */
+    str = "x".repeat(100) + "needle" + "x".repeat(100);
+    assert(/needle/.exec(str).index, 100);
+    assert(/needle/.exec(str + "€").index, 100);
+    assert(/needle/.exec("€needl"), null);
+    assert(/€€/.exec("a€ €€").index, 3);
+    assert(/[0-9]+/.exec(str + "42")[0], "42");
+    assert(/(?<=e)dle|x$/.exec(str).index, 103);
+    a = /a/g;
+    a.lastIndex = 2;
+    assert(a.exec("a-a-a").index, 2);
+    assert("a-a-a".replace(/a/g, "b"), "b-b-b");
+    assert(/K/i.exec("xk").index, 1);
+    assert(/\u212a/i.exec("xk"), null);
+    assert(/\u212a/iu.exec("xk").index, 1);
+    assert(/k/iu.exec("x\u212a").index, 1);
+    assert(/s/iu.exec("x\u017f").index, 1);
+    assert(/\uDE00/u.exec("😀"), null);
+    assert(/\uDE00/u.exec("😀\uDE00").index, 2);
+    assert(/\uDE00/.exec("😀").index, 1);
+    assert(/[\uDE00-\uDE10]/u.exec("a😀"), null);
 }
 
 function test_symbol()
@@ -1011,6 +1147,54 @@ function test_map()
     });
 
     assert(a.size, 0);
+
+    /* the index is rebuilt while iterating */
+    a = new Map();
+    for(i = 0; i < 4; i++)
+        a.set(i, i);
+    tab = [];
+    for (const [k] of a) {
+        tab.push(k);
+        a.delete(k);
+        if (k < n)
+            a.set(k + 4, k + 4);
+    }
+    assert(tab.length, n + 4);
+    assert(tab[n + 3], n + 3);
+    assert(a.size, 0);
+
+    /* deleted slots are reused, keys keep their insertion order */
+    a = new Map();
+    for(i = 0; i < n; i++) {
+        a.set("k" + i, i);
+        if (i >= 10)
+            assert(a.delete("k" + (i - 10)));
+    }
+    assert(a.size, 10);
+    assert([...a.values()].join(), "990,991,992,993,994,995,996,997,998,999");
+    assert(a.get("k995"), 995);
+    assert(!a.has("k5"));
+    a.set(-0, 1);
+    assert(a.get(0), 1);
+    a.set(NaN, 2);
+    assert(a.get(NaN), 2);
+    a.clear();
+    assert(a.size, 0);
+    assert(!a.has("k995"));
+
+    /* concatenated strings and flat strings are the same keys */
+    o = "x".repeat(600);
+    v = "y".repeat(600);
+    a = new Map();
+    a.set(o + v, 1);
+    assert(a.get((o + v).slice(0)), 1);
+    assert(a.get(o.concat(v)), 1);
+    a.set("xy".repeat(300), 2);
+    assert(a.get("xy".repeat(150) + "xy".repeat(150)), 2);
+    a.set(o, 3);
+    o += v; /* may append in place */
+    assert(a.get("x".repeat(600)), 3);
+    assert(a.get(o), 1);
 }
 
 function test_weak_map()
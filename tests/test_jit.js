@@ -0,0 +1,77 @@
+import { assert } from "./assert.js";
+
+/* the loops are long enough for the functions to be compiled when the
+   JIT is enabled. The results must be the same as the interpreter. */
+
+function test_arith()
+{
+    var vals = [ [1.5, 2], [2, 0.25], [0x7fffffff, 1], [-0x80000000, 1],
+                 [0, -5], [-0, 3], [65536, 65536], [NaN, 1], ["a", 1],
+                 [1, { valueOf() { return 3; } }] ];
+    var r = [], i, j, a, b;
+    for(i = 0; i < 200; i++) {
+        for(j = 0; j < vals.length; j++) {
+            a = vals[j][0];
+            b = vals[j][1];
+            r[j] = [a + b, a - b, a * b];
+        }
+    }
+    assert(r[0], [3.5, -0.5, 3]);
+    assert(r[1], [2.25, 1.75, 0.5]);
+    assert(r[2], [2147483648, 2147483646, 2147483647]);
+    assert(r[3], [-2147483647, -2147483649, -2147483648]);
+    assert(Object.is(r[4][2], -0));
+    assert(r[5], [3, -3, -0]);
+    assert(r[6], [131072, 0, 4294967296]);
+    assert(r[7].every(Number.isNaN));
+    assert(r[8][0], "a1");
+    assert(r[9], [4, -2, 3]);
+}
+
+function test_global_var()
+{
+    var g = globalThis, i;
+    /* global code is a script */
+    (0, eval)("var jit_s = 0; for (var jit_i = 0; jit_i < 1000; jit_i++) jit_s += jit_i * 0.5;");
+    assert(g.jit_s, 249750);
+    /* the global variable becomes an accessor in a hot loop */
+    g.jit_s = 0;
+    g.jit_redefine = function() {
+        Object.defineProperty(g, "jit_s", { get() { return 1; },
+                                            set(v) {},
+                                            configurable: true });
+    };
+    (0, eval)("for (var jit_i = 0; jit_i < 1000; jit_i++) {" +
+              "  if (jit_i == 500) jit_redefine();" +
+              "  jit_s = jit_s + 1;" +
+              "}");
+    assert(g.jit_s, 1);
+    delete g.jit_s;
+    delete g.jit_i;
+    delete g.jit_redefine;
+}
+
+async function test_async_loop()
+{
+    var s = 0, i;
+    for(i = 0; i < 1000; i++) {
+        s += i;
+        if (i % 100 == 0)
+            await null;
+    }
+    assert(s, 499500);
+}
+
+function *gen_loop()
+{
+    var i;
+    for(i = 0; i < 1000; i++) {
+        if (i % 250 == 0)
+            yield i;
+    }
+}
+
+test_arith();
+test_global_var();
+test_async_loop();
+assert([...gen_loop()], [0, 250, 500, 750]);
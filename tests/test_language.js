@@ -149,6 +149,43 @@ function test_eq()
     assert({} != "abc");
 }
 
+function test_relational()
+{
+    function lt(a, b) { return a < b; }
+    function lte(a, b) { return a <= b; }
+    function gt(a, b) { return a > b; }
+    function gte(a, b) { return a >= b; }
+    var i, r;
+
+    /* the same comparison sees int32, float64 and non number operands */
+    for(i = 0; i < 3; i++) {
+        assert(lt(1, 2), true);
+        assert(lt(1.5, 2.5), true);
+        assert(lt(2.5, 1), false);
+        assert(lt(NaN, 1.5), false);
+        assert(lt(-0, 0.0), false);
+        assert(lt("a", "b"), true);
+        assert(lt(1n, 1.5), true);
+        assert(lte(1.5, 1.5), true);
+        assert(lte(NaN, NaN), false);
+        assert(lte("10", 9.5), false);
+        assert(gt(2.5, 1), true);
+        assert(gt(1.5, NaN), false);
+        assert(gt({ valueOf() { return 3.5; } }, 2.5), true);
+        assert(gte(1.5, 1.5), true);
+        assert(gte(-Infinity, 1.5), false);
+        assert(gte(null, -0.5), true);
+    }
+
+    /* quickened comparisons in a loop */
+    r = 0;
+    for(i = 0.5; i < 100.5; i += 1.0) {
+        if (i >= 50)
+            r++;
+    }
+    assert(r, 50);
+}
+
 function test_inc_dec()
 {
     var a, r;
@@ -1085,6 +1122,7 @@ async function test_await_using()
 test_op1();
 test_cvt();
 test_eq();
+test_relational();
 test_inc_dec();
 test_op2();
 test_delete();
@@ -1,6 +1,6 @@
 import * as std from "qjs:std";
 import * as os from "qjs:os";
-import { assert } from  "./assert.js";
+import { assert, assertThrows } from  "./assert.js";
 
 const isWin = os.platform === 'win32';
 const isCygwin = os.platform === 'cygwin';
@@ -280,6 +280,135 @@ function test_os_exec()
     }
 }
 
+function test_rw_handlers()
+{
+    var n = 200, pipes = [], order = [], buf = new Uint8Array(1), i, f;
+
+    /* many handlers, only the ready ones are called */
+    for(i = 0; i < n; i++) {
+        let fds = os.pipe();
+        pipes.push(fds);
+        os.setReadHandler(fds[0], function () {
+            assert(os.read(fds[0], buf.buffer, 0, 1), 1);
+            order.push(buf[0]);
+            os.setReadHandler(fds[0], null);
+            os.close(fds[0]);
+            if (order.length == 3)
+                os.setTimeout(check_order, 0);
+        });
+    }
+    /* the write handler can be added and removed independently */
+    os.setWriteHandler(pipes[7][1], function () {
+        os.setWriteHandler(pipes[7][1], null);
+        buf[0] = 7;
+        os.write(pipes[7][1], buf.buffer, 0, 1);
+    });
+    buf[0] = 150;
+    os.write(pipes[150][1], buf.buffer, 0, 1);
+    buf[0] = 42;
+    os.write(pipes[42][1], buf.buffer, 0, 1);
+
+    function check_order() {
+        order.sort((a, b) => a - b);
+        assert(order.join(), "7,42,150");
+        for(i = 0; i < n; i++) {
+            if (i != 7 && i != 42 && i != 150) {
+                os.setReadHandler(pipes[i][0], null);
+                os.close(pipes[i][0]);
+            }
+            os.close(pipes[i][1]);
+        }
+    }
+
+    /* regular files are always ready */
+    f = std.tmpfile();
+    os.setReadHandler(f.fileno(), function () {
+        os.setReadHandler(f.fileno(), null);
+        f.close();
+    });
+}
+
+function test_rw_handler_closed_fd()
+{
+    var [r, w] = os.pipe(), r2 = os.dup(r), p = os.pipe();
+    var buf = new Uint8Array(1);
+
+    /* 'r' is closed before its handler is removed while 'r2' keeps the
+       pipe open: its events must not reach the freed handler */
+    os.setReadHandler(r, function () {
+        throw new Error("removed handler called");
+    });
+    os.close(r);
+    os.setReadHandler(r, null);
+    os.setReadHandler(p[0], function () {
+        os.setReadHandler(p[0], null);
+        os.close(p[0]);
+        os.close(p[1]);
+        os.close(r2);
+        os.close(w);
+        test_rw_handler_reused_open_fd();
+    });
+    os.write(w, buf.buffer, 0, 1);
+    os.setTimeout(function () { os.write(p[1], buf.buffer, 0, 1); }, 10);
+}
+
+function test_rw_handler_reused_open_fd()
+{
+    var [r, w] = os.pipe(), r2 = os.dup(r), fds, written = false;
+    var buf = new Uint8Array(1);
+
+    /* 'r' is closed with its handler set while 'r2' keeps the pipe open,
+       then its number is reused: the events of the old pipe must not
+       reach the new handler */
+    os.setReadHandler(r, function () {
+        throw new Error("old handler called");
+    });
+    os.close(r);
+    fds = os.pipe();
+    if (fds[0] != r) {
+        os.dup2(fds[0], r);
+        os.close(fds[0]);
+    }
+    os.setReadHandler(r, function () {
+        assert(written, true, "handler called for the old pipe");
+        os.setReadHandler(r, null);
+        os.close(r);
+        os.close(fds[1]);
+        os.close(r2);
+        os.close(w);
+    });
+    os.write(w, buf.buffer, 0, 1);
+    os.setTimeout(function () {
+        written = true;
+        os.write(fds[1], buf.buffer, 0, 1);
+    }, 10);
+}
+
+function test_rw_handler_reused_fd()
+{
+    var [r, w] = os.pipe(), fds, buf = new Uint8Array(1);
+
+    /* 'r' is closed with its handler set and its number is reused */
+    os.setReadHandler(r, function () {
+        throw new Error("old handler called");
+    });
+    os.close(r);
+    os.close(w);
+    fds = os.pipe();
+    if (fds[0] != r) {
+        os.dup2(fds[0], r);
+        os.close(fds[0]);
+    }
+    os.setReadHandler(r, function () {
+        os.setReadHandler(r, null);
+        os.close(r);
+        os.close(fds[1]);
+        /* not before: it recreates the epoll set, which re-arms 'r' */
+        test_rw_handler_closed_fd();
+    });
+    os.write(fds[1], buf.buffer, 0, 1);
+}
+
 function test_interval()
 {
     var t = os.setInterval(f, 1);
@@ -327,6 +456,85 @@ function test_stdio_close()
     }
 }
 
+function test_memory_usage()
+{
+    var m, n;
+    m = std.memoryUsage();
+    assert(m.malloc_size > 0);
+    assert(m.obj_count > 0);
+    n = m.gc_count;
+    std.gc();
+    assert(std.memoryUsage().gc_count, n + 1);
+}
+
+function test_json_parser()
+{
+    var p, res, str, i;
+
+    res = [];
+    p = new std.JSONParser((v, k, d) => res.push([k, JSON.stringify(v), d]),
+                           { depth: 2 });
+    /* written by chunks which split the tokens */
+    str = '[1, {"a": [true, "x\\"]"], "b": {}}, -1.5e3 ,"s"] {"z":1}\n42';
+    for(i = 0; i < str.length; i += 3)
+        p.write(str.slice(i, i + 3));
+    p.end();
+    assert(JSON.stringify(res), JSON.stringify([
+        [0, "1", 1], ["a", '[true,"x\\"]"]', 2], ["b", "{}", 2],
+        [2, "-1500", 1], [3, '"s"', 1], ["z", "1", 1], [2, "42", 0]]));
+
+    /* UTF-8 input in a typed array */
+    res = [];
+    p = new std.JSONParser((v, k) => res.push(k, v), { depth: 1 });
+    p.write(new Uint8Array([0, 0x7b, 0x22, 0xc3, 0xa9, 0x22, 0x3a, 0x31,
+                            0x7d, 0]).subarray(1, -1));
+    p.end();
+    assert(res.length, 2);
+    assert(res[0], "\u00e9");
+    assert(res[1], 1);
+
+    p = new std.JSONParser(() => {}, { depth: 1 });
+    assertThrows(SyntaxError, () => p.write("[1,]"));
+    assertThrows(TypeError, () => p.write("1"));
+    p = new std.JSONParser(() => {}, { depth: 1 });
+    p.write("[1, 2");
+    assertThrows(SyntaxError, () => p.end());
+
+    /* the errors report the position in the whole stream */
+    for (var depth of [0, 1]) {
+        p = new std.JSONParser(() => {}, { depth });
+        p.write('[1]\n[2, ');
+        try {
+            p.write('tru]');
+            assert(false);
+        } catch (e) {
+            assert(e instanceof SyntaxError);
+            assert(e.message.endsWith(" at position 8"), true, e.message);
+        }
+    }
+
+    /* the parsing continues after an exception in the callback */
+    res = [];
+    p = new std.JSONParser((v) => {
+        if (v == 2)
+            throw new Error("stop");
+        res.push(v);
+    }, { depth: 1 });
+    assertThrows(Error, () => p.write("[1,2,3"));
+    p.write(",4]");
+    p.end();
+    assert(res.join(), "1,3,4");
+    res = [];
+    p = new std.JSONParser(function(v) {
+        assertThrows(TypeError, () => p.write("1"));
+        res.push(v);
+    });
+    p.write("0 ");
+    assert(res.join(), "0");
+    assertThrows(TypeError, () => new std.JSONParser(1));
+    assertThrows(RangeError, () => new std.JSONParser(() => {}, { depth: -1 }));
+}
+
 test_printf();
 test_file1();
 test_file2();
@@ -334,7 +542,11 @@ test_getline();
 test_popen();
 test_os();
 !isWin && test_os_exec();
+!isWin && test_rw_handlers();
+!isWin && test_rw_handler_reused_fd();
 test_interval();
 test_timeout();
 test_timeout_order();
 test_stdio_close();
+test_memory_usage();
+test_json_parser();
@@ -5,7 +5,7 @@ var worker;
 
 function test_worker()
 {
-    var counter;
+    var counter, log;
 
     worker = new os.Worker("./test_worker_module.js");
 
@@ -29,9 +29,61 @@ function test_worker()
                 let buf = ev.buf;
                 /* check that the SharedArrayBuffer was modified */
                 assert(buf[2], 10);
-                worker.postMessage({ type: "abort" });
+                counter = 0;
+                worker.postMessage({ type: "burst", count: 10000 });
             }
             break;
+        case "burst_num":
+            assert(ev.num, counter);
+            counter++;
+            if (counter == 5000) {
+                /* the pending messages are kept for the next handler */
+                let handler = worker.onmessage;
+                worker.onmessage = null;
+                os.setTimeout(function () { worker.onmessage = handler; }, 10);
+            }
+            break;
+        case "burst_done":
+            assert(counter, 10000);
+            test_transfer_errors();
+            {
+                /* a large buffer is moved, a small one is copied */
+                let big = new ArrayBuffer(1 << 20, { maxByteLength: 2 << 20 });
+                let small = new ArrayBuffer(16);
+                let ta = new Uint8Array(big);
+                ta[0] = 1;
+                ta[ta.length - 1] = 2;
+                new Uint8Array(small)[3] = 3;
+                worker.postMessage({ type: "transfer", ta: ta, small: small },
+                                   [big, small]);
+                assert(big.detached, true);
+                assert(big.byteLength, 0);
+                assert(ta.length, 0);
+                assert(small.detached, true);
+            }
+            break;
+        case "transfer_done":
+            {
+                let ta = new Uint8Array(ev.buf);
+                assert(ev.buf.byteLength, 2 << 20);
+                assert(ta[0], 1);
+                assert(ta[(1 << 20) - 1], 2);
+                assert(ta[(2 << 20) - 1], 4);
+            }
+            log = [];
+            worker.postMessage({ type: "order", count: 3 });
+            /* let the messages be queued together */
+            os.sleep(100);
+            break;
+        case "order_num":
+            /* the promise jobs run before the next message */
+            log.push("h" + ev.num);
+            Promise.resolve().then(() => log.push("m" + ev.num));
+            break;
+        case "order_done":
+            assert(log.join(" "), "h1 m1 h2 m2 h3 m3");
+            worker.postMessage({ type: "abort" });
+            break;
         case "done":
             /* terminate */
             worker.onmessage = null;
@@ -40,4 +92,30 @@ function test_worker()
     };
 }
 
+function test_transfer_errors()
+{
+    var buf = new ArrayBuffer(8);
+    var threw;
+
+    function check(transfer) {
+        threw = false;
+        try {
+            worker.postMessage({ buf: buf }, transfer);
+        } catch (e) {
+            threw = e instanceof TypeError;
+        }
+        assert(threw, true);
+        /* nothing is detached on failure */
+        assert(buf.byteLength, 8);
+    }
+    check([buf, buf]);
+    check([buf, new SharedArrayBuffer(8)]);
+    check([buf, new Uint8Array(8)]);
+    check(buf);
+    check([buf, new ArrayBuffer(8).transferToImmutable()]);
+    let detached = new ArrayBuffer(8);
+    detached.transfer();
+    check([buf, detached]);
+}
+
 test_worker();
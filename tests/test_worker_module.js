@@ -1,5 +1,6 @@
 /* Worker code for test_worker.js */
 import * as os from "qjs:os";
+import { assert } from "./assert.js";
 
 var parent = os.Worker.parent;
 
@@ -15,6 +16,32 @@ function handle_msg(e) {
         ev.buf[2] = 10;
         parent.postMessage({ type: "sab_done", buf: ev.buf });
         break;
+    case "transfer":
+        {
+            let buf = ev.ta.buffer;
+            assert(buf === ev.small, false);
+            assert(buf.byteLength, 1 << 20);
+            assert(buf.resizable, true);
+            assert(ev.ta[0], 1);
+            assert(ev.ta[ev.ta.length - 1], 2);
+            assert(new Uint8Array(ev.small)[3], 3);
+            /* the received buffer is owned by this runtime */
+            buf.resize(2 << 20);
+            new Uint8Array(buf)[(2 << 20) - 1] = 4;
+            parent.postMessage({ type: "transfer_done", buf: buf }, [buf]);
+            assert(buf.detached, true);
+        }
+        break;
+    case "order":
+        for(var i = 1; i <= ev.count; i++)
+            parent.postMessage({ type: "order_num", num: i });
+        parent.postMessage({ type: "order_done" });
+        break;
+    case "burst":
+        for(var i = 0; i < ev.count; i++)
+            parent.postMessage({ type: "burst_num", num: i });
+        parent.postMessage({ type: "burst_done" });
+        break;
     }
 }
 